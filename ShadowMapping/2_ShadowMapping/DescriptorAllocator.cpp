@@ -0,0 +1,181 @@
+#include "DescriptorAllocator.h"
+
+/* Sets of the first pool of a chain - every next pool is twice as large, up to the maximum. */
+static const uint32_t POOL_INITIAL_SETS  = 64;
+static const uint32_t POOL_MAX_SETS      = 4096;
+
+/* Descriptors of each type per set - a pool holds maxSets times as many. Culling sets use most storage buffers. */
+static const std::array<std::pair<VkDescriptorType, float>, 6> POOL_RATIOS = {{
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1.f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         6.f },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1.f },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          1.f },
+    { VK_DESCRIPTOR_TYPE_SAMPLER,                .5f },
+}};
+
+DescriptorAllocator::DescriptorAllocator(VkDevice device)
+    : _device(device)
+{
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    for( VkDescriptorPool pool : _persistent.pools )
+        vkDestroyDescriptorPool(_device, pool, nullptr);
+
+    for( const auto& frame : _frames )
+    {
+        for( VkDescriptorPool pool : frame.pools )
+            vkDestroyDescriptorPool(_device, pool, nullptr);
+    }
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout setLayout)
+{
+    return allocate(_persistent, setLayout);
+}
+
+VkDescriptorSet DescriptorAllocator::cached_set(VkDescriptorSetLayout setLayout, uint32_t writeCount, const VkWriteDescriptorSet* writes)
+{
+    std::vector<uint64_t> key = { reinterpret_cast<uint64_t>(setLayout) };
+
+    for( uint32_t i = 0; i < writeCount; i++ )
+    {
+        const VkWriteDescriptorSet& write = writes[i];
+        key.insert(key.end(), { write.dstBinding, write.dstArrayElement, static_cast<uint64_t>(write.descriptorType), write.descriptorCount });
+
+        for( uint32_t element = 0; element < write.descriptorCount; element++ )
+        {
+            if( write.pBufferInfo != nullptr )
+            {
+                const VkDescriptorBufferInfo& info = write.pBufferInfo[element];
+                key.insert(key.end(), { reinterpret_cast<uint64_t>(info.buffer), info.offset, info.range });
+            }
+            else if( write.pImageInfo != nullptr )
+            {
+                const VkDescriptorImageInfo& info = write.pImageInfo[element];
+                key.insert(key.end(), { reinterpret_cast<uint64_t>(info.sampler), reinterpret_cast<uint64_t>(info.imageView), static_cast<uint64_t>(info.imageLayout) });
+            }
+            else if( write.pTexelBufferView != nullptr )
+            {
+                key.push_back(reinterpret_cast<uint64_t>(write.pTexelBufferView[element]));
+            }
+        }
+    }
+
+    auto cached = _cache.find(key);
+    if( cached != _cache.end() )
+        return cached->second;
+
+    VkDescriptorSet descriptorSet = allocate(_persistent, setLayout);
+
+    std::vector<VkWriteDescriptorSet> setWrites(writes, writes + writeCount);
+    for( auto& write : setWrites )
+        write.dstSet = descriptorSet;
+
+    vkUpdateDescriptorSets(_device, writeCount, setWrites.data(), 0, nullptr);
+
+    _cache[key] = descriptorSet;
+
+    return descriptorSet;
+}
+
+void DescriptorAllocator::begin_frame(uint32_t frame)
+{
+    if( frame >= _frames.size() )
+        _frames.resize(frame + 1);
+
+    reset(_frames[frame]);
+}
+
+VkDescriptorSet DescriptorAllocator::allocate_frame(uint32_t frame, VkDescriptorSetLayout setLayout)
+{
+    if( frame >= _frames.size() )
+        _frames.resize(frame + 1);
+
+    return allocate(_frames[frame], setLayout);
+}
+
+void DescriptorAllocator::reset()
+{
+    _cache.clear();
+    reset(_persistent);
+
+    for( auto& frame : _frames )
+        reset(frame);
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(Pool_Chain& chain, VkDescriptorSetLayout setLayout)
+{
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount    = 1;
+    allocInfo.pSetLayouts           = &setLayout;
+
+    /* Try the current pool, then the next one of the chain - which is created when the chain ends. */
+    for( bool freshPool = false; ; freshPool = true )
+    {
+        if( chain.current == chain.pools.size() )
+        {
+            uint32_t maxSets = POOL_INITIAL_SETS << std::min<size_t>(chain.pools.size(), 6);
+            chain.pools.push_back(create_pool(std::min(maxSets, POOL_MAX_SETS)));
+        }
+
+        allocInfo.descriptorPool = chain.pools[chain.current];
+
+        VkDescriptorSet descriptorSet;
+        VkResult result = vkAllocateDescriptorSets(_device, &allocInfo, &descriptorSet);
+
+        if( result == VK_SUCCESS )
+            return descriptorSet;
+
+        /* Set which does not fit even into an empty pool will not fit into the next one either. */
+        if( freshPool || (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) )
+            throw std::runtime_error("Failed to allocate descriptor sets. :( \n");
+
+        chain.current++;
+    }
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool(uint32_t maxSets)
+{
+    std::vector<VkDescriptorPoolSize> poolSize;
+    for( const auto& ratio : POOL_RATIOS )
+        poolSize.push_back({ ratio.first, static_cast<uint32_t>(ratio.second * maxSets) });
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType  = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount  = static_cast<uint32_t>(poolSize.size());
+    poolInfo.pPoolSizes     = poolSize.data();
+    poolInfo.maxSets        = maxSets;
+    poolInfo.flags          = 0; /* Sets are never freed one by one - pools are reset */
+
+    VkDescriptorPool pool;
+    if( vkCreateDescriptorPool(_device, &poolInfo, nullptr, &pool) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create descriptor pool. :( \n");
+
+    return pool;
+}
+
+void DescriptorAllocator::reset(Pool_Chain& chain)
+{
+    /* Only pools allocated from since the last reset hold any sets. */
+    for( size_t i = 0; i < chain.pools.size() && i <= chain.current; i++ )
+        vkResetDescriptorPool(_device, chain.pools[i], 0);
+
+    chain.current = 0;
+}
+
+size_t DescriptorAllocator::Key_Hash::operator()(const std::vector<uint64_t>& key) const
+{
+    /* FNV-1a over the words of key */
+    uint64_t hash = 14695981039346656037ull;
+    for( uint64_t word : key )
+    {
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+
+    return static_cast<size_t>(hash);
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "libs.h"
+
+/* Descriptor sets allocated from chains of pools - when a pool runs out of sets or descriptors another one is chained,
+*  so the number of sets is not fixed up front. Pools are never freed one set at a time, they are reset in bulk.
+*   - Persistent sets live until reset() (swap chain recreation). Sets described by the same writes are allocated once.
+*   - Frame sets live until the same frame begins again - no allocation is returned to the driver in between.
+*  Used by the render thread only.
+*/
+class DescriptorAllocator
+{
+public:
+    explicit DescriptorAllocator(VkDevice device);
+    ~DescriptorAllocator();
+
+    DescriptorAllocator(const DescriptorAllocator&) = delete;
+    DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+    /* Empty persistent set - caller writes it. */
+    VkDescriptorSet     allocate(VkDescriptorSetLayout setLayout);
+
+    /* Persistent set with the given contents (dstSet of writes is ignored). Set with the same layout and contents
+    *  is shared - it is written only when allocated, so it must not be updated by the caller afterwards.
+    */
+    VkDescriptorSet     cached_set(VkDescriptorSetLayout setLayout, uint32_t writeCount, const VkWriteDescriptorSet* writes);
+
+    /* Resets pools of frame sets - previous sets of this frame may not be in use by the device anymore. */
+    void                begin_frame(uint32_t frame);
+    VkDescriptorSet     allocate_frame(uint32_t frame, VkDescriptorSetLayout setLayout);
+
+    /* Releases every set at once - pools are kept for next allocations. */
+    void                reset();
+
+private:
+    /* Allocations go to the last pool, full pools are kept until reset. */
+    struct Pool_Chain {
+        std::vector<VkDescriptorPool>   pools {};
+        size_t                          current = 0;
+    };
+
+    struct Key_Hash {
+        size_t operator()(const std::vector<uint64_t>& key) const;
+    };
+
+    VkDevice                        _device;
+    Pool_Chain                      _persistent {};
+    std::vector<Pool_Chain>         _frames {};
+
+    /* Key is the layout followed by every field of every write and of the descriptors it references. */
+    std::unordered_map<std::vector<uint64_t>, VkDescriptorSet, Key_Hash>   _cache {};
+
+    VkDescriptorSet     allocate(Pool_Chain& chain, VkDescriptorSetLayout setLayout);
+    VkDescriptorPool    create_pool(uint32_t maxSets);
+    void                reset(Pool_Chain& chain);
+};
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "FileWatcher.h"
+
+#include <filesystem>
+#include <map>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+/* Longest wait for a change - bounds the time destructor waits for the watching thread. */
+static const int WATCH_INTERVAL_MS = 100;
+
+FileWatcher::FileWatcher(const std::string& directory)
+    : _directory(directory)
+{
+    _thread = std::thread(&FileWatcher::watch, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+    _stopping = true;
+    _thread.join();
+}
+
+std::vector<std::string> FileWatcher::poll_changes()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<std::string> changes(_changes.begin(), _changes.end());
+    _changes.clear();
+
+    return changes;
+}
+
+void FileWatcher::add_change(const std::string& fileName)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _changes.insert(fileName);
+}
+
+#if defined(__linux__)
+
+void FileWatcher::watch()
+{
+    /* Editors either rewrite the file (close after write) or replace it by renaming a temporary one (moved to). */
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if( fd < 0 || inotify_add_watch(fd, _directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 )
+    {
+        std::cerr << "Failed to watch " << _directory << " - shaders will not be reloaded :( \n";
+        if( fd >= 0 )
+            close(fd);
+        return;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+
+    while( !_stopping )
+    {
+        pollfd pollInfo = { fd, POLLIN, 0 };
+        if( poll(&pollInfo, 1, WATCH_INTERVAL_MS) <= 0 )
+            continue;
+
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+
+        for( ssize_t offset = 0; offset < length; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if( event->len > 0 )
+                add_change(event->name);
+
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    close(fd);
+}
+
+#else
+
+/* Last write time of every file inside directory. */
+static std::map<std::string, std::filesystem::file_time_type> write_times(const std::string& directory)
+{
+    std::map<std::string, std::filesystem::file_time_type> times;
+    std::error_code error;
+
+    for( const auto& entry : std::filesystem::directory_iterator(directory, error) )
+    {
+        if( entry.is_regular_file(error) )
+            times[entry.path().filename().string()] = entry.last_write_time(error);
+    }
+
+    return times;
+}
+
+void FileWatcher::watch()
+{
+    /* Notification (or timeout without it) only tells that something may have changed - modified files are found by write times. */
+    auto snapshot = write_times(_directory);
+
+#if defined(_WIN32)
+    HANDLE notification = FindFirstChangeNotificationA(_directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if( notification == INVALID_HANDLE_VALUE )
+    {
+        std::cerr << "Failed to watch " << _directory << " - shaders will not be reloaded :( \n";
+        return;
+    }
+#endif
+
+    while( !_stopping )
+    {
+#if defined(_WIN32)
+        if( WaitForSingleObject(notification, WATCH_INTERVAL_MS) != WAIT_OBJECT_0 )
+            continue;
+
+        FindNextChangeNotification(notification);
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_INTERVAL_MS));
+#endif
+
+        auto current = write_times(_directory);
+
+        for( const auto& file : current )
+        {
+            auto previous = snapshot.find(file.first);
+            if( previous == snapshot.end() || previous->second != file.second )
+                add_change(file.first);
+        }
+
+        snapshot = std::move(current);
+    }
+
+#if defined(_WIN32)
+    FindCloseChangeNotification(notification);
+#endif
+}
+
+#endif
\ No newline at end of file
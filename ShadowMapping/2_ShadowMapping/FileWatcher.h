@@ -0,0 +1,31 @@
+#pragma once
+
+#include "libs.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/* Watches a directory for modified files on a background thread - inotify on Linux, change notifications on Windows,
+*  periodic scan elsewhere. Changes are collected until they are polled, every modified file is reported once.
+*/
+class FileWatcher
+{
+public:
+    explicit FileWatcher(const std::string& directory);
+    ~FileWatcher();
+
+    /* Names (without directory) of files modified since previous call. */
+    std::vector<std::string>    poll_changes();
+
+private:
+    std::string             _directory;
+    std::thread             _thread;
+    std::atomic<bool>       _stopping { false };
+
+    std::mutex              _mutex;
+    std::set<std::string>   _changes;
+
+    void    watch();
+    void    add_change(const std::string& fileName);
+};
\ No newline at end of file
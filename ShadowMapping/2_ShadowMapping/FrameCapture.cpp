@@ -0,0 +1,241 @@
+#include "FrameCapture.h"
+
+#include <filesystem>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+FrameCapture::FrameCapture(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkFormat format, const std::string& directory)
+    : _device(device), _extent(extent), _directory(directory)
+{
+    if( !supports(format) )
+        throw std::runtime_error("Frames of swap chain format cannot be captured :( \n");
+
+    _swizzle = (format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB);
+
+    std::filesystem::create_directories(_directory);
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    _slots.resize(CAPTURE_RING_SIZE);
+    for( Slot& slot : _slots )
+    {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType        = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size         = static_cast<VkDeviceSize>(_extent.width) * _extent.height * 4;
+        bufferInfo.usage        = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
+
+        if( vkCreateBuffer(_device, &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS )
+            throw std::runtime_error("Failed to create readback buffer. :( \n");
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(_device, slot.buffer, &memRequirements);
+
+        /* Host reads every byte - cached memory is read many times faster than write-combined one. */
+        const VkMemoryPropertyFlags preferred[] = {
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        };
+
+        uint32_t memoryType = UINT32_MAX;
+        for( VkMemoryPropertyFlags properties : preferred )
+        {
+            for( uint32_t i = 0; i < memProperties.memoryTypeCount && memoryType == UINT32_MAX; i++ )
+            {
+                if( (memRequirements.memoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties )
+                    memoryType = i;
+            }
+        }
+
+        if( memoryType == UINT32_MAX )
+            throw std::runtime_error("Failed to find suitable memory type. :( \n");
+
+        _coherent = (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize    = memRequirements.size;
+        allocInfo.memoryTypeIndex   = memoryType;
+
+        if( vkAllocateMemory(_device, &allocInfo, nullptr, &slot.memory) != VK_SUCCESS )
+            throw std::runtime_error("Failed to allocate readback buffer memory! :( \n");
+
+        vkBindBufferMemory(_device, slot.buffer, slot.memory, 0);
+
+        void* data;
+        vkMapMemory(_device, slot.memory, 0, VK_WHOLE_SIZE, 0, &data);
+        slot.pixels = static_cast<const uint8_t*>(data);
+    }
+
+    _thread = std::thread(&FrameCapture::write_files, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_one();
+    _thread.join();
+
+    for( Slot& slot : _slots )
+    {
+        vkDestroyBuffer(_device, slot.buffer, nullptr);
+        vkFreeMemory(_device, slot.memory, nullptr);
+    }
+}
+
+bool FrameCapture::supports(VkFormat format)
+{
+    return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB ||
+           format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+uint32_t FrameCapture::record(VkCommandBuffer commandBuffer, VkImage image, const std::string& name, capture_format fileFormat)
+{
+    uint32_t slotIndex = NO_SLOT;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for( uint32_t i = 0; i < _slots.size() && slotIndex == NO_SLOT; i++ )
+        {
+            if( !_slots[i].busy )
+                slotIndex = i;
+        }
+
+        if( slotIndex == NO_SLOT )
+            return NO_SLOT;
+
+        _slots[slotIndex].busy = true;
+    }
+
+    Slot& slot  = _slots[slotIndex];
+    slot.name   = name;
+    slot.format = fileFormat;
+
+    /* Image was transitioned to present layout at the end of the frame - it is copied right after that and handed back. */
+    VkImageMemoryBarrier imageBarrier = {};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask          = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imageBarrier.dstAccessMask          = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.oldLayout              = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    imageBarrier.newLayout              = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image                  = image;
+    imageBarrier.subresourceRange       = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset         = 0;
+    region.bufferRowLength      = 0;    /* Tightly packed */
+    region.bufferImageHeight    = 0;
+    region.imageSubresource     = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageOffset          = { 0, 0, 0 };
+    region.imageExtent          = { _extent.width, _extent.height, 1 };
+
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+    /* Presentation engine waits for the semaphore of the frame - no access has to be made visible to it. */
+    imageBarrier.srcAccessMask  = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.dstAccessMask  = 0;
+    imageBarrier.oldLayout      = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.newLayout      = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkBufferMemoryBarrier bufferBarrier = {};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask         = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask         = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer                = slot.buffer;
+    bufferBarrier.offset                = 0;
+    bufferBarrier.size                  = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr, 1, &bufferBarrier, 1, &imageBarrier);
+
+    return slotIndex;
+}
+
+void FrameCapture::complete(uint32_t slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(slot);
+    }
+    _wake.notify_one();
+}
+
+void FrameCapture::write_files()
+{
+    /* Conversion buffer is reused by every file - it is allocated once. */
+    std::vector<uint8_t> rgba(static_cast<size_t>(_extent.width) * _extent.height * 4);
+
+    while( true )
+    {
+        uint32_t slot;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+
+            /* Queue is drained before stopping - completed captures are never lost. */
+            if( _queue.empty() )
+                return;
+
+            slot = _queue.front();
+            _queue.pop_front();
+        }
+
+        write_file(_slots[slot], rgba);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _slots[slot].busy = false;
+    }
+}
+
+void FrameCapture::write_file(Slot& slot, std::vector<uint8_t>& rgba)
+{
+    if( !_coherent )
+    {
+        VkMappedMemoryRange range = {};
+        range.sType     = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory    = slot.memory;
+        range.offset    = 0;
+        range.size      = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(_device, 1, &range);
+    }
+
+    /* Alpha of swap chain image is not meaningful - files are opaque. */
+    for( size_t i = 0; i < rgba.size(); i += 4 )
+    {
+        rgba[i + 0] = slot.pixels[i + (_swizzle ? 2 : 0)];
+        rgba[i + 1] = slot.pixels[i + 1];
+        rgba[i + 2] = slot.pixels[i + (_swizzle ? 0 : 2)];
+        rgba[i + 3] = 255;
+    }
+
+    std::string path = (std::filesystem::path(_directory) / slot.name).string();
+    bool written;
+
+    if( slot.format == CAPTURE_FORMAT_PNG )
+    {
+        path += ".png";
+        written = stbi_write_png(path.c_str(), _extent.width, _extent.height, 4, rgba.data(), _extent.width * 4) != 0;
+    }
+    else
+    {
+        path += ".raw";
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(rgba.data()), rgba.size());
+        written = file.good();
+    }
+
+    /* Worker cannot throw - failure is reported and capture goes on. */
+    if( !written )
+        std::cerr << "Failed to write " << path << " :( \n";
+}
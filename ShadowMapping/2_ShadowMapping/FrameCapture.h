@@ -0,0 +1,71 @@
+#pragma once
+
+#include "libs.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/* File format of captured frames - PNG is compressed by the worker thread, raw is written as RGBA8 rows without any header. */
+enum capture_format
+{
+    CAPTURE_FORMAT_PNG = 0,
+    CAPTURE_FORMAT_RAW,
+};
+
+/* Frame capture - swap chain images are copied by vkCmdCopyImageToBuffer into a ring of host visible readback buffers
+*  and written into files by a worker thread. Render thread never waits for a capture: copy is recorded only if a buffer
+*  is free (the frame is dropped otherwise), the buffer is handed over to the worker once fence of its frame was waited for
+*  and it is free again when its file is written. Buffers are sized by swap chain - capture is recreated with it.
+*/
+class FrameCapture
+{
+public:
+    /* Returned by record() when all buffers are busy */
+    static const uint32_t NO_SLOT = UINT32_MAX;
+
+    FrameCapture(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkFormat format, const std::string& directory);
+
+    /* Files of all completed captures are written before it returns - recorded ones which were not completed are discarded. */
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    /* Swap chain formats pixels can be converted from - 8 bit RGBA and BGRA. */
+    static bool     supports(VkFormat format);
+
+    /* Records copy of the image into a free buffer - image is in present layout before and after it. Name is without extension. */
+    uint32_t        record(VkCommandBuffer commandBuffer, VkImage image, const std::string& name, capture_format fileFormat);
+
+    /* Commands recorded into the slot were executed - its file is written by the worker thread. */
+    void            complete(uint32_t slot);
+
+private:
+    struct Slot {
+        VkBuffer            buffer = VK_NULL_HANDLE;
+        VkDeviceMemory      memory = VK_NULL_HANDLE;
+        const uint8_t*      pixels = nullptr;   /* Persistently mapped */
+        std::string         name;
+        capture_format      format = CAPTURE_FORMAT_PNG;
+        bool                busy = false;       /* From record() until its file is written */
+    };
+
+    VkDevice            _device;
+    VkExtent2D          _extent;
+    bool                _swizzle;               /* BGRA source - red and blue are swapped by the worker */
+    bool                _coherent = true;       /* Cached memory may not be coherent - it is invalidated before read */
+    std::string         _directory;
+
+    std::vector<Slot>   _slots;
+
+    std::mutex              _mutex;             /* Guards busy flags and the queue */
+    std::condition_variable _wake;
+    std::deque<uint32_t>    _queue;             /* Completed slots waiting for the worker */
+    bool                    _stopping = false;
+    std::thread             _thread;
+
+    void    write_files();
+    void    write_file(Slot& slot, std::vector<uint8_t>& rgba);
+};
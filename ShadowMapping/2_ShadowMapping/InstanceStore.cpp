@@ -0,0 +1,122 @@
+#include "InstanceStore.h"
+
+uint32_t InstanceStore::add(uint32_t meshIndex, const glm::vec3& position, float rotation, float scale)
+{
+    uint32_t id = size();
+
+    _positions.push_back(position);
+    _rotations.push_back(rotation);
+    _scales.push_back(scale);
+    _mesh_indices.push_back(meshIndex);
+    _material_indices.push_back(0);
+    _models.push_back(model_matrix(id));
+    _prev_models.push_back(_models.back());
+
+    mark_dirty(id);
+    return id;
+}
+
+void InstanceStore::set_position(uint32_t id, const glm::vec3& position)
+{
+    _positions[id] = position;
+    mark_dirty(id);
+}
+
+void InstanceStore::set_rotation(uint32_t id, float rotation)
+{
+    _rotations[id] = rotation;
+    mark_dirty(id);
+}
+
+void InstanceStore::set_scale(uint32_t id, float scale)
+{
+    _scales[id] = scale;
+    mark_dirty(id);
+}
+
+void InstanceStore::set_material(uint32_t id, uint32_t materialIndex)
+{
+    _material_indices[id] = materialIndex;
+    mark_dirty(id);
+}
+
+glm::mat4 InstanceStore::model_matrix(uint32_t id) const
+{
+    glm::mat4 model = glm::translate(glm::mat4(1.f), _positions[id]);
+    model = glm::rotate(model, _rotations[id], glm::vec3(0.f, 1.f, 0.f));
+    return glm::scale(model, glm::vec3(_scales[id]));
+}
+
+void InstanceStore::set_copy_count(uint32_t count)
+{
+    Dirty_Range all = {};
+    all.end = size();
+    _dirty.assign(count, all);
+}
+
+uint32_t InstanceStore::flush(uint32_t copy, const std::vector<MeshInfo>& meshes, ObjectData* dst)
+{
+    advance_frame();
+
+    Dirty_Range& range = _dirty[copy];
+
+    for( uint32_t id = range.begin; id < range.end; id++ )
+    {
+        const MeshInfo& mesh = meshes[_mesh_indices[id]];
+
+        ObjectData object = {};
+        object.model            = _models[id];
+        object.prev_model       = _prev_models[id];
+        object.bounding_sphere  = glm::vec4(glm::vec3(object.model * glm::vec4(glm::vec3(mesh.bounding_sphere), 1.f)), mesh.bounding_sphere.w * _scales[id]);
+        object.mesh_index       = _mesh_indices[id];
+        object.material_index   = _material_indices[id];
+        dst[id] = object;
+    }
+
+    uint32_t written = range.end - range.begin;
+    range = {};
+    return written;
+}
+
+void InstanceStore::advance_frame()
+{
+    Dirty_Range range = _moving;
+    extend(range, _modified.begin, _modified.end);
+
+    for( uint32_t id = range.begin; id < range.end; id++ )
+    {
+        _prev_models[id]    = _models[id];
+        _models[id]         = model_matrix(id);
+    }
+
+    /* Instances which were not modified again stop moving - their equal matrices have to reach every copy. */
+    for( auto& dirty : _dirty )
+        extend(dirty, _moving.begin, _moving.end);
+
+    _moving     = _modified;
+    _modified   = {};
+}
+
+void InstanceStore::mark_dirty(uint32_t id)
+{
+    extend(_modified, id, id + 1);
+
+    for( auto& range : _dirty )
+        extend(range, id, id + 1);
+}
+
+void InstanceStore::extend(Dirty_Range& range, uint32_t begin, uint32_t end)
+{
+    if( begin == end )
+        return;
+
+    if( range.begin == range.end )
+    {
+        range.begin = begin;
+        range.end   = end;
+        return;
+    }
+
+    range.begin = std::min(range.begin, begin);
+    range.end   = std::max(range.end, end);
+}
\ No newline at end of file
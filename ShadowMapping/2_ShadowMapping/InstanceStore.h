@@ -0,0 +1,84 @@
+#pragma once
+
+#include "libs.h"
+#include "Mesh.h"
+
+/* Per-object data read by culling compute shaders and by vertex shaders.
+*  Layout has to match std430 'ObjectData' structure declared inside shaders.
+*/
+struct ObjectData {
+    glm::mat4   model;
+
+    /* Bounding sphere in world space: xyz - center, w - radius. */
+    glm::vec4   bounding_sphere;
+
+    /* Levels of detail, instance list range and drawing method are taken from the mesh. */
+    uint32_t    mesh_index;
+    uint32_t    material_index;     /* Entry of bindless texture array */
+    uint32_t    pad[2];
+
+    /* Model matrix of the previous frame - vertex shader reprojects by it, so moving objects get their own velocity. */
+    glm::mat4   prev_model;
+};
+
+/* CPU side copy of all instances placed in the scene, stored as structure of arrays.
+*  GPU copies (one per swap chain image) are kept up to date incrementally - every copy remembers
+*  range of instances modified since its last flush, only this range is rebuilt and uploaded.
+*  Model matrices of the last two frames are cached - an instance which stops moving is rewritten once more into every copy,
+*  so its previous model matrix catches up with the current one.
+*/
+class InstanceStore
+{
+public:
+    /* Returns id of new instance. Rotation is an angle around Y axis, scale is uniform. */
+    uint32_t    add(uint32_t meshIndex, const glm::vec3& position, float rotation = 0.f, float scale = 1.f);
+
+    void        set_position(uint32_t id, const glm::vec3& position);
+    void        set_rotation(uint32_t id, float rotation);
+    void        set_scale(uint32_t id, float scale);
+    void        set_material(uint32_t id, uint32_t materialIndex);
+
+    uint32_t            size() const                    { return static_cast<uint32_t>(_mesh_indices.size()); }
+    uint32_t            mesh_index(uint32_t id) const   { return _mesh_indices[id]; }
+    const glm::vec3&    position(uint32_t id) const     { return _positions[id]; }
+    float               rotation(uint32_t id) const     { return _rotations[id]; }
+    float               scale(uint32_t id) const        { return _scales[id]; }
+    uint32_t            material_index(uint32_t id) const { return _material_indices[id]; }
+
+    glm::mat4   model_matrix(uint32_t id) const;
+
+    /* Sets number of GPU copies - all of them start with every instance dirty. */
+    void        set_copy_count(uint32_t count);
+
+    /* Writes ObjectData of instances modified since last flush of given copy. Returns number of written instances.
+    *  Called once per frame - the frame advances previous model matrices of instances modified or moving in the last one.
+    */
+    uint32_t    flush(uint32_t copy, const std::vector<MeshInfo>& meshes, ObjectData* dst);
+
+private:
+    std::vector<glm::vec3>  _positions;
+    std::vector<float>      _rotations;
+    std::vector<float>      _scales;
+    std::vector<uint32_t>   _mesh_indices;
+    std::vector<uint32_t>   _material_indices;
+
+    /* Model matrices written by the last and by the previous flush. */
+    std::vector<glm::mat4>  _models;
+    std::vector<glm::mat4>  _prev_models;
+
+    /* Modified instances [begin; end) of every GPU copy. */
+    struct Dirty_Range {
+        uint32_t begin  = 0;
+        uint32_t end    = 0;
+    };
+    std::vector<Dirty_Range> _dirty;
+
+    /* Instances modified since the last flush and instances modified before it - the latter may still have different previous matrix. */
+    Dirty_Range             _modified;
+    Dirty_Range             _moving;
+
+    void        mark_dirty(uint32_t id);
+    void        advance_frame();
+
+    static void extend(Dirty_Range& range, uint32_t begin, uint32_t end);
+};
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "LayoutCache.h"
+
+LayoutCache::LayoutCache(VkDevice device)
+    : _device(device)
+{
+}
+
+LayoutCache::~LayoutCache()
+{
+    for( const auto& layout : _pipeline_layouts )
+        vkDestroyPipelineLayout(_device, layout.second, nullptr);
+
+    for( const auto& layout : _set_layouts )
+        vkDestroyDescriptorSetLayout(_device, layout.second, nullptr);
+}
+
+VkDescriptorSetLayout LayoutCache::set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlagsEXT>& flags)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return get_set_layout(bindings, flags);
+}
+
+VkPipelineLayout LayoutCache::pipeline_layout(const ShaderLayout& layout)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    for( size_t set = 0; set < layout.sets.size(); set++ )
+    {
+        static const std::vector<VkDescriptorBindingFlagsEXT> noFlags;
+        setLayouts.push_back(get_set_layout(layout.sets[set], (set < layout.binding_flags.size()) ? layout.binding_flags[set] : noFlags));
+    }
+
+    /* Set layouts are interned already - their handles identify them. */
+    std::vector<uint64_t> key;
+    for( VkDescriptorSetLayout setLayout : setLayouts )
+        key.push_back(reinterpret_cast<uint64_t>(setLayout));
+
+    key.push_back(UINT64_MAX);  /* Separates sets from push constant ranges */
+    for( const auto& range : layout.push_constants )
+        key.insert(key.end(), { range.stageFlags, range.offset, range.size });
+
+    auto cached = _pipeline_layouts.find(key);
+    if( cached != _pipeline_layouts.end() )
+        return cached->second;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount         = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts            = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(layout.push_constants.size());
+    pipelineLayoutInfo.pPushConstantRanges    = layout.push_constants.data();
+
+    VkPipelineLayout pipelineLayout;
+    if( vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create pipeline layout! :(\n");
+
+    _pipeline_layouts[key] = pipelineLayout;
+
+    return pipelineLayout;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> LayoutCache::bindings(VkDescriptorSetLayout setLayout)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _set_bindings.at(setLayout);
+}
+
+VkDescriptorSetLayout LayoutCache::get_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlagsEXT>& flags)
+{
+    if( !flags.empty() && flags.size() != bindings.size() )
+        throw std::runtime_error("Binding flags do not match bindings of descriptor set layout :( \n");
+
+    /* Layout without flags equals one with all flags zero. */
+    std::vector<VkDescriptorBindingFlagsEXT> bindingFlags = flags;
+    bindingFlags.resize(bindings.size(), 0);
+
+    std::vector<uint64_t> key;
+    for( size_t i = 0; i < bindings.size(); i++ )
+    {
+        const auto& binding = bindings[i];
+        key.insert(key.end(), { binding.binding, static_cast<uint64_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags, bindingFlags[i] });
+    }
+
+    auto cached = _set_layouts.find(key);
+    if( cached != _set_layouts.end() )
+        return cached->second;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType    = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings    = bindings.data();
+
+    /* Flags are chained only when used - devices without descriptor indexing do not know the structure. */
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    flagsInfo.bindingCount  = static_cast<uint32_t>(bindingFlags.size());
+    flagsInfo.pBindingFlags = bindingFlags.data();
+
+    for( VkDescriptorBindingFlagsEXT bindingFlag : bindingFlags )
+    {
+        if( bindingFlag != 0 )
+            layoutInfo.pNext = &flagsInfo;
+
+        /* Sets of such layout have to be allocated from pools created with update-after-bind flag as well. */
+        if( bindingFlag & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT )
+            layoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    }
+
+    VkDescriptorSetLayout setLayout;
+    if( vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create Descriptor Set Layout. :( \n");
+
+    _set_layouts[key]       = setLayout;
+    _set_bindings[setLayout] = bindings;
+
+    return setLayout;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "libs.h"
+#include "ShaderReflection.h"
+
+#include <map>
+#include <mutex>
+
+/* Descriptor set layouts and pipeline layouts interned by their contents - pipelines with the same shader interface
+*  share one layout object, so adding pipelines does not multiply layouts. Objects live until the cache is destroyed.
+*  Safe to use from several threads.
+*/
+class LayoutCache
+{
+public:
+    explicit LayoutCache(VkDevice device);
+    ~LayoutCache();
+
+    LayoutCache(const LayoutCache&) = delete;
+    LayoutCache& operator=(const LayoutCache&) = delete;
+
+    /* Flags are optional - one for each binding. */
+    VkDescriptorSetLayout   set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlagsEXT>& flags = {});
+
+    /* Layout of every set of 'layout' (including empty ones between used sets) and its push constant ranges. */
+    VkPipelineLayout        pipeline_layout(const ShaderLayout& layout);
+
+    /* Bindings set layout was created from - used to size descriptor pools. */
+    std::vector<VkDescriptorSetLayoutBinding>   bindings(VkDescriptorSetLayout setLayout);
+
+private:
+    VkDevice                _device;
+    std::mutex              _mutex;
+
+    /* Keys are flattened contents - every field of every binding or range in order. */
+    std::map<std::vector<uint64_t>, VkDescriptorSetLayout>  _set_layouts;
+    std::map<std::vector<uint64_t>, VkPipelineLayout>       _pipeline_layouts;
+
+    std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSetLayoutBinding>>    _set_bindings;
+
+    VkDescriptorSetLayout   get_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlagsEXT>& flags);
+};
\ No newline at end of file
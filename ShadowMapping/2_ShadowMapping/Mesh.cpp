@@ -0,0 +1,523 @@
+#include "Mesh.h"
+
+#include <filesystem>
+
+/* Identifies mesh cache files - 'MSHC' */
+static const uint32_t MESH_CACHE_MAGIC      = 0x4348534D;
+/* Has to be increased whenever layout of the cache or of stored structures changes. */
+static const uint32_t MESH_CACHE_VERSION    = 2;
+
+struct Mesh_Cache_Header {
+    uint32_t    magic;
+    uint32_t    version;
+
+    /* Size and modification time of source file the cache was built from. */
+    uint64_t    source_size;
+    int64_t     source_time;
+
+    uint32_t    vertex_count;
+    uint32_t    index_count;
+    uint32_t    meshlet_count;
+    uint32_t    lod_count;
+};
+
+/* Bounding sphere and normal cone of a single meshlet. */
+static void compute_meshlet_bounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Meshlet& meshlet)
+{
+    uint32_t lastIndex = meshlet.first_index + 3 * meshlet.triangle_count;
+
+    /* Sphere is centered in the middle of meshlet bounding box. */
+    glm::vec3 minPos = vertices[indices[meshlet.first_index]].pos;
+    glm::vec3 maxPos = minPos;
+    for( uint32_t i = meshlet.first_index; i < lastIndex; i++ )
+    {
+        minPos = glm::min(minPos, vertices[indices[i]].pos);
+        maxPos = glm::max(maxPos, vertices[indices[i]].pos);
+    }
+
+    glm::vec3 center = 0.5f * (minPos + maxPos);
+    float radius = 0.f;
+    for( uint32_t i = meshlet.first_index; i < lastIndex; i++ )
+        radius = std::max(radius, glm::length(vertices[indices[i]].pos - center));
+
+    meshlet.bounding_sphere = glm::vec4(center, radius);
+
+    /* Cone axis is area weighted average of triangle normals. Degenerate triangles do not restrict the cone. */
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangle_count);
+
+    glm::vec3 axis = glm::vec3(0.f);
+    for( uint32_t i = meshlet.first_index; i < lastIndex; i += 3 )
+    {
+        const glm::vec3& a = vertices[indices[i + 0]].pos;
+        const glm::vec3& b = vertices[indices[i + 1]].pos;
+        const glm::vec3& c = vertices[indices[i + 2]].pos;
+
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float area = glm::length(normal);
+        if( area <= 0.f )
+            continue;
+
+        axis += normal;
+        normals.push_back(normal / area);
+    }
+
+    meshlet.cone = glm::vec4(0.f, 1.f, 0.f, 1.f);
+    if( normals.empty() || glm::length(axis) <= 0.f )
+        return;
+
+    axis = glm::normalize(axis);
+
+    float minDot = 1.f;
+    for( const auto& normal : normals )
+        minDot = std::min(minDot, glm::dot(axis, normal));
+
+    /* Cone spreading close to a hemisphere or more - cluster always has some front-facing triangle. */
+    if( minDot <= 0.1f )
+    {
+        meshlet.cone = glm::vec4(axis, 1.f);
+        return;
+    }
+
+    /* Triangle normals are within acos(minDot) of the axis, back-facing region is the cone widened by 90 degrees. */
+    meshlet.cone = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+}
+
+void build_meshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                    uint32_t firstIndex, uint32_t indexCount, std::vector<Meshlet>& meshlets)
+{
+    /* Id of the last meshlet which referenced given vertex - avoids per-meshlet vertex sets. */
+    std::vector<uint32_t> vertexMeshlet(vertices.size(), UINT32_MAX);
+
+    uint32_t meshletId      = static_cast<uint32_t>(meshlets.size());
+    uint32_t vertexCount    = 0;
+
+    Meshlet meshlet = {};
+    meshlet.first_index = firstIndex;
+
+    for( uint32_t i = firstIndex; i + 2 < firstIndex + indexCount; i += 3 )
+    {
+        /* Vertices of the triangle which are not referenced by current meshlet yet. */
+        auto count_new_vertices = [&]()
+        {
+            uint32_t count = 0;
+            for( uint32_t k = 0; k < 3; k++ )
+            {
+                bool repeated = (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+                if( vertexMeshlet[indices[i + k]] != meshletId && !repeated )
+                    count++;
+            }
+            return count;
+        };
+
+        if( vertexCount + count_new_vertices() > MESHLET_MAX_VERTICES || meshlet.triangle_count == MESHLET_MAX_TRIANGLES )
+        {
+            compute_meshlet_bounds(vertices, indices, meshlet);
+            meshlets.push_back(meshlet);
+
+            meshletId++;
+            vertexCount = 0;
+            meshlet = {};
+            meshlet.first_index = i;
+        }
+
+        vertexCount += count_new_vertices();
+        for( uint32_t k = 0; k < 3; k++ )
+            vertexMeshlet[indices[i + k]] = meshletId;
+
+        meshlet.triangle_count++;
+    }
+
+    if( meshlet.triangle_count > 0 )
+    {
+        compute_meshlet_bounds(vertices, indices, meshlet);
+        meshlets.push_back(meshlet);
+    }
+}
+
+/* Sum of squared distances to a set of planes - symmetric 4x4 matrix stored as its upper triangle. */
+struct Quadric {
+    double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+    double b2 = 0.0, bc = 0.0, bd = 0.0;
+    double c2 = 0.0, cd = 0.0;
+    double d2 = 0.0;
+
+    /* Plane n.p + d = 0 with unit normal n. */
+    void add_plane(const glm::dvec3& n, double d)
+    {
+        a2 += n.x * n.x;    ab += n.x * n.y;    ac += n.x * n.z;    ad += n.x * d;
+        b2 += n.y * n.y;    bc += n.y * n.z;    bd += n.y * d;
+        c2 += n.z * n.z;    cd += n.z * d;
+        d2 += d * d;
+    }
+
+    void add(const Quadric& q)
+    {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+    }
+
+    double evaluate(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+                     + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+                     + c2 * z * z + 2.0 * cd * z
+                     + d2;
+
+        /* Rounding may push error of points lying on all planes slightly below zero. */
+        return std::max(error, 0.0);
+    }
+};
+
+float simplify_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& srcIndices,
+                    uint32_t targetIndexCount, std::vector<uint32_t>& dstIndices)
+{
+    /* Vertices sharing a position are welded - topology and quadrics are built on positions, triangles keep original vertices. */
+    std::unordered_map<glm::vec3, uint32_t> positionIds;
+    std::vector<uint32_t>   vertexPosition(vertices.size(), UINT32_MAX);
+    std::vector<glm::vec3>  positions;
+    std::vector<uint32_t>   positionVertex;     /* Vertex of the position - only one for positions which can move */
+    std::vector<uint8_t>    locked;
+
+    for( uint32_t index : srcIndices )
+    {
+        if( vertexPosition[index] != UINT32_MAX )
+            continue;
+
+        auto found = positionIds.find(vertices[index].pos);
+        if( found == positionIds.end() )
+        {
+            vertexPosition[index] = static_cast<uint32_t>(positions.size());
+            positionIds.emplace(vertices[index].pos, vertexPosition[index]);
+            positions.push_back(vertices[index].pos);
+            positionVertex.push_back(index);
+            locked.push_back(0);
+            continue;
+        }
+
+        /* Normal or UV seam - moving the position would tear the surface apart or stretch attributes. */
+        vertexPosition[index] = found->second;
+        locked[found->second] = 1;
+    }
+
+    auto position_of = [&](uint32_t index) { return vertexPosition[index]; };
+
+    /* Drop triangles already degenerate in position space. */
+    std::vector<uint32_t> triangles;
+    triangles.reserve(srcIndices.size());
+    for( size_t i = 0; i + 2 < srcIndices.size(); i += 3 )
+    {
+        uint32_t a = position_of(srcIndices[i + 0]);
+        uint32_t b = position_of(srcIndices[i + 1]);
+        uint32_t c = position_of(srcIndices[i + 2]);
+        if( a == b || b == c || a == c )
+            continue;
+
+        triangles.insert(triangles.end(), { srcIndices[i + 0], srcIndices[i + 1], srcIndices[i + 2] });
+    }
+
+    /* Borders (edges of a single triangle) and non-manifold edges keep their positions. */
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    for( size_t i = 0; i < triangles.size(); i += 3 )
+    {
+        for( uint32_t k = 0; k < 3; k++ )
+        {
+            uint32_t a = position_of(triangles[i + k]);
+            uint32_t b = position_of(triangles[i + (k + 1) % 3]);
+            edgeUse[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)]++;
+        }
+    }
+
+    for( const auto& edge : edgeUse )
+    {
+        if( edge.second == 2 )
+            continue;
+
+        locked[static_cast<uint32_t>(edge.first >> 32)]         = 1;
+        locked[static_cast<uint32_t>(edge.first & 0xFFFFFFFF)]  = 1;
+    }
+
+    /* Every position starts with planes of its surrounding triangles. */
+    std::vector<Quadric> quadrics(positions.size());
+    for( size_t i = 0; i < triangles.size(); i += 3 )
+    {
+        glm::dvec3 a = positions[position_of(triangles[i + 0])];
+        glm::dvec3 b = positions[position_of(triangles[i + 1])];
+        glm::dvec3 c = positions[position_of(triangles[i + 2])];
+
+        glm::dvec3 normal = glm::cross(b - a, c - a);
+        double length = glm::length(normal);
+        if( length <= 0.0 )
+            continue;
+
+        normal /= length;
+        for( uint32_t k = 0; k < 3; k++ )
+            quadrics[position_of(triangles[i + k])].add_plane(normal, -glm::dot(normal, a));
+    }
+
+    struct Collapse {
+        uint32_t    from;
+        uint32_t    to;
+        double      cost;
+    };
+
+    std::vector<uint32_t>               remap(vertices.size());
+    std::vector<std::vector<uint32_t>>  fans(positions.size());
+    std::vector<uint8_t>                touched(positions.size());
+    std::vector<Collapse>               collapses;
+    double                              maxCost = 0.0;
+
+    for( uint32_t i = 0; i < remap.size(); i++ )
+        remap[i] = i;
+
+    /* Every pass applies cheapest independent collapses - fans of collapsed positions do not overlap. */
+    while( triangles.size() > targetIndexCount )
+    {
+        for( auto& fan : fans )
+            fan.clear();
+        for( uint32_t t = 0; t < triangles.size() / 3; t++ )
+        {
+            for( uint32_t k = 0; k < 3; k++ )
+                fans[position_of(triangles[3 * t + k])].push_back(t);
+        }
+
+        /* Source position is merged into target one - cost is error of source planes at target position. */
+        collapses.clear();
+        for( size_t i = 0; i < triangles.size(); i += 3 )
+        {
+            for( uint32_t k = 0; k < 3; k++ )
+            {
+                uint32_t a = position_of(triangles[i + k]);
+                uint32_t b = position_of(triangles[i + (k + 1) % 3]);
+                if( !locked[a] )
+                    collapses.push_back({ a, b, quadrics[a].evaluate(positions[b]) });
+                if( !locked[b] )
+                    collapses.push_back({ b, a, quadrics[b].evaluate(positions[a]) });
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+        std::fill(touched.begin(), touched.end(), 0);
+        std::vector<uint32_t> remapped;
+        uint32_t trianglesToRemove = static_cast<uint32_t>(triangles.size() - targetIndexCount) / 3;
+        uint32_t removed = 0;
+
+        for( const auto& collapse : collapses )
+        {
+            if( removed >= trianglesToRemove )
+                break;
+
+            /* Triangles around source position may not be changed by another collapse of this pass. */
+            bool valid = true;
+            for( uint32_t t : fans[collapse.from] )
+            {
+                for( uint32_t k = 0; k < 3 && valid; k++ )
+                    valid = !touched[position_of(triangles[3 * t + k])];
+            }
+
+            /* Remaining triangles of the fan may not flip. Shared triangles disappear - target vertex is taken from them. */
+            uint32_t targetVertex   = UINT32_MAX;
+            uint32_t shared         = 0;
+            for( uint32_t t = 0; valid && t < fans[collapse.from].size(); t++ )
+            {
+                const uint32_t* triangle = &triangles[3 * fans[collapse.from][t]];
+
+                glm::vec3 p[3];
+                glm::vec3 moved[3];
+                bool containsTarget = false;
+                for( uint32_t k = 0; k < 3; k++ )
+                {
+                    uint32_t position = position_of(triangle[k]);
+                    p[k]     = positions[position];
+                    moved[k] = (position == collapse.from) ? positions[collapse.to] : p[k];
+
+                    if( position == collapse.to )
+                    {
+                        containsTarget  = true;
+                        targetVertex    = triangle[k];
+                    }
+                }
+
+                if( containsTarget )
+                {
+                    shared++;
+                    continue;
+                }
+
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after  = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                valid = glm::dot(before, after) > 0.2f * glm::length(before) * glm::length(after);
+            }
+
+            if( !valid || targetVertex == UINT32_MAX )
+                continue;
+
+            remap[positionVertex[collapse.from]] = targetVertex;
+            remapped.push_back(positionVertex[collapse.from]);
+
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            maxCost  = std::max(maxCost, collapse.cost);
+            removed += shared;
+
+            for( uint32_t t : fans[collapse.from] )
+            {
+                for( uint32_t k = 0; k < 3; k++ )
+                    touched[position_of(triangles[3 * t + k])] = 1;
+            }
+        }
+
+        if( remapped.empty() )
+            break;
+
+        /* Apply collapses - triangles which lost an edge disappear. */
+        size_t write = 0;
+        for( size_t i = 0; i < triangles.size(); i += 3 )
+        {
+            uint32_t a = remap[triangles[i + 0]];
+            uint32_t b = remap[triangles[i + 1]];
+            uint32_t c = remap[triangles[i + 2]];
+            if( position_of(a) == position_of(b) || position_of(b) == position_of(c) || position_of(a) == position_of(c) )
+                continue;
+
+            triangles[write++] = a;
+            triangles[write++] = b;
+            triangles[write++] = c;
+        }
+        triangles.resize(write);
+
+        for( uint32_t vertex : remapped )
+            remap[vertex] = vertex;
+    }
+
+    dstIndices = std::move(triangles);
+    return static_cast<float>(std::sqrt(maxCost));
+}
+
+uint32_t build_mesh_lods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets,
+                         uint32_t firstIndex, uint32_t indexCount, MeshLod* lods)
+{
+    std::vector<uint32_t> lodIndices(indices.begin() + firstIndex, indices.begin() + firstIndex + indexCount);
+    float    error      = 0.f;
+    uint32_t lodCount   = 0;
+
+    while( true )
+    {
+        MeshLod& lod = lods[lodCount];
+        lod.first_index = firstIndex;
+        if( lodCount > 0 )
+        {
+            lod.first_index = static_cast<uint32_t>(indices.size());
+            indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        }
+
+        lod.index_count     = static_cast<uint32_t>(lodIndices.size());
+        lod.first_meshlet   = static_cast<uint32_t>(meshlets.size());
+        build_meshlets(vertices, indices, lod.first_index, lod.index_count, meshlets);
+        lod.meshlet_count   = static_cast<uint32_t>(meshlets.size()) - lod.first_meshlet;
+        lod.error           = error;
+        lodCount++;
+
+        if( lodCount == MESH_MAX_LODS || lod.index_count / 3 <= MESH_LOD_MIN_TRIANGLES )
+            break;
+
+        std::vector<uint32_t> simplified;
+        float stepError = simplify_mesh(vertices, lodIndices, (lod.index_count / 6) * 3, simplified);
+
+        /* Remaining vertices are locked by seams and borders - next level would be almost the same. */
+        if( simplified.size() * 4 > lodIndices.size() * 3 )
+            break;
+
+        /* Every level is simplified from the previous one - errors add up. */
+        error += stepError;
+        lodIndices.swap(simplified);
+    }
+
+    return lodCount;
+}
+
+/* Size and modification time of the source file. Returns false if file does not exist. */
+static bool get_source_stamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    size = std::filesystem::file_size(sourcePath, error);
+    if( error )
+        return false;
+
+    time = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+    return !error;
+}
+
+bool read_mesh_cache(const std::string& cachePath, const std::string& sourcePath,
+                     std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets,
+                     std::vector<MeshLod>& lods)
+{
+    std::ifstream file(cachePath, std::ios::binary);
+    if( !file.is_open() )
+        return false;
+
+    Mesh_Cache_Header header = {};
+    if( !file.read(reinterpret_cast<char*>(&header), sizeof(header)) )
+        return false;
+
+    if( header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION )
+        return false;
+
+    /* Source is optional - cache alone is enough to run, but if source exists it has to be the same one. */
+    uint64_t sourceSize;
+    int64_t  sourceTime;
+    if( get_source_stamp(sourcePath, sourceSize, sourceTime) && (sourceSize != header.source_size || sourceTime != header.source_time) )
+        return false;
+
+    std::vector<Vertex>     cachedVertices(header.vertex_count);
+    std::vector<uint32_t>   cachedIndices(header.index_count);
+    std::vector<Meshlet>    cachedMeshlets(header.meshlet_count);
+    std::vector<MeshLod>    cachedLods(header.lod_count);
+
+    file.read(reinterpret_cast<char*>(cachedVertices.data()), sizeof(Vertex) * cachedVertices.size());
+    file.read(reinterpret_cast<char*>(cachedIndices.data()), sizeof(uint32_t) * cachedIndices.size());
+    file.read(reinterpret_cast<char*>(cachedMeshlets.data()), sizeof(Meshlet) * cachedMeshlets.size());
+    file.read(reinterpret_cast<char*>(cachedLods.data()), sizeof(MeshLod) * cachedLods.size());
+    if( !file || cachedLods.empty() || cachedLods.size() > MESH_MAX_LODS )
+        return false;
+
+    vertices.insert(vertices.end(), cachedVertices.begin(), cachedVertices.end());
+    indices.insert(indices.end(), cachedIndices.begin(), cachedIndices.end());
+    meshlets.insert(meshlets.end(), cachedMeshlets.begin(), cachedMeshlets.end());
+    lods = cachedLods;
+
+    return true;
+}
+
+void write_mesh_cache(const std::string& cachePath, const std::string& sourcePath,
+                      const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<Meshlet>& meshlets,
+                      const std::vector<MeshLod>& lods)
+{
+    Mesh_Cache_Header header = {};
+    header.magic            = MESH_CACHE_MAGIC;
+    header.version          = MESH_CACHE_VERSION;
+    header.vertex_count     = static_cast<uint32_t>(vertices.size());
+    header.index_count      = static_cast<uint32_t>(indices.size());
+    header.meshlet_count    = static_cast<uint32_t>(meshlets.size());
+    header.lod_count        = static_cast<uint32_t>(lods.size());
+
+    if( !get_source_stamp(sourcePath, header.source_size, header.source_time) )
+        return;
+
+    /* Cache is only an optimization - failing to write it is not an error. */
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    if( !file.is_open() )
+    {
+        std::cout << "WARNING::MESH_CACHE_NOT_WRITTEN " << cachePath << "\n";
+        return;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(vertices.data()), sizeof(Vertex) * vertices.size());
+    file.write(reinterpret_cast<const char*>(indices.data()), sizeof(uint32_t) * indices.size());
+    file.write(reinterpret_cast<const char*>(meshlets.data()), sizeof(Meshlet) * meshlets.size());
+    file.write(reinterpret_cast<const char*>(lods.data()), sizeof(MeshLod) * lods.size());
+}
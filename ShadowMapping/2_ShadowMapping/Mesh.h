@@ -0,0 +1,183 @@
+#pragma once
+
+#include "libs.h"
+
+struct Vertex {
+    glm::vec3 pos;
+    glm::vec3 color;
+    glm::vec2 texCoord;
+    glm::vec3 normal;
+
+    static VkVertexInputBindingDescription getBindingDescription() 
+    {
+        /* Structure describing data rate */
+        VkVertexInputBindingDescription bindingDescription = {};
+        bindingDescription.binding      = 0;                            /* Specifies the index of binding in the array of bindings. */
+        bindingDescription.stride       = sizeof(Vertex);               /* Number of bytes from one entry to next one. */
+        bindingDescription.inputRate    = VK_VERTEX_INPUT_RATE_VERTEX;  /* RATE_VERTEX means: move to next data entry after each vertex. */
+
+        return bindingDescription;
+    }
+    
+    /* An attribute description struct describes how to extract a vertex attribute from a chunk of vertex data. 
+    *  Thats why we have here 2 structures- one description for position, one description for color.
+    *  Corresponding formats of data:
+    *       float: VK_FORMAT_R32_SFLOAT
+    *       vec2: VK_FORMAT_R32G32_SFLOAT
+    *       vec3: VK_FORMAT_R32G32B32_SFLOAT
+    *       vec4: VK_FORMAT_R32G32B32A32_SFLOAT
+    *       ivec2: VK_FORMAT_R32G32_SINT
+    *       uvec4: VK_FORMAT_R32G32B32A32_UINT
+    *       double: VK_FORMAT_R64_SFLOAT
+    */
+    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() 
+    {
+        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = {};
+
+        /* Description of pos attribute */
+        attributeDescriptions[0].binding    = 0;
+        attributeDescriptions[0].location   = 0;  /* References to location inside Vertex Shader - 0 for position. */
+        attributeDescriptions[0].format     = VK_FORMAT_R32G32B32_SFLOAT;  /* Format of vertex position data - vec3 */
+        attributeDescriptions[0].offset     = offsetof(Vertex, pos);
+        
+        /* Description of color attribute */
+        attributeDescriptions[1].binding    = 0;
+        attributeDescriptions[1].location   = 1;
+        attributeDescriptions[1].format     = VK_FORMAT_R32G32B32_SFLOAT;   /* vec3 format */
+        attributeDescriptions[1].offset     = offsetof(Vertex, color);
+
+        /* Description of Texture coordinate attribute */
+        attributeDescriptions[2].binding    = 0;
+        attributeDescriptions[2].location   = 2;
+        attributeDescriptions[2].format     = VK_FORMAT_R32G32_SFLOAT;      /* vec2 format */
+        attributeDescriptions[2].offset     = offsetof(Vertex, texCoord);
+
+        /* Description of normal vector attribute */
+        attributeDescriptions[3].binding    = 0;
+        attributeDescriptions[3].location   = 3;
+        attributeDescriptions[3].format     = VK_FORMAT_R32G32B32_SFLOAT;      /* vec3 format */
+        attributeDescriptions[3].offset     = offsetof(Vertex, normal);
+
+        return attributeDescriptions;
+    }
+
+    /* Override == operator to specify equality comparison. */
+    bool operator==(const Vertex& other) const 
+    {
+        return (pos == other.pos) && 
+            (color      == other.color) && 
+            (texCoord   == other.texCoord) && 
+            (normal     == other.normal);
+    }
+};
+
+/* Hash calculation function for unordered map. */
+namespace std {
+    template<> struct hash<Vertex>
+    {
+        size_t operator()(Vertex const& vertex) const noexcept
+        {
+            return ((hash<glm::vec3>()(vertex.pos) ^ 
+                    (hash<glm::vec3>()(vertex.color) << 1 )) >> 1) ^
+                    (hash<glm::vec2>()(vertex.texCoord) << 1) ^
+                    (hash<glm::vec3>()(vertex.normal) << 1);
+        }
+    };
+}
+
+/* Cluster of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles.
+*  Triangles of a meshlet occupy contiguous range of the index buffer.
+*  Layout has to match std430 'MeshletData' structure declared inside meshlet.comp.
+*/
+struct Meshlet {
+    /* Bounding sphere in model space: xyz - center, w - radius. */
+    glm::vec4   bounding_sphere;
+
+    /* Normal cone: xyz - axis, w - cutoff. Cluster is back-facing for eye position E if
+    *  dot(center - E, axis) >= cutoff * length(center - E) + radius. Cutoff 1 disables the test.
+    */
+    glm::vec4   cone;
+
+    uint32_t    first_index;
+    uint32_t    triangle_count;
+    uint32_t    pad[2];
+};
+
+/* Single level of detail - range of the index buffer and meshlets covering the same triangles.
+*  Layout has to match std430 'MeshLodData' structure declared inside cull.comp and meshlet.comp.
+*/
+struct MeshLod {
+    uint32_t    first_index     = 0;
+    uint32_t    index_count     = 0;
+    uint32_t    first_meshlet   = 0;
+    uint32_t    meshlet_count   = 0;
+
+    /* Upper bound of distance between this level and full resolution surface - in model space units. */
+    float       error           = 0.f;
+    uint32_t    pad[3]          = {};
+};
+
+/* Range of shared vertex/index buffers occupied by a single mesh. */
+struct MeshInfo {
+    int32_t     vertex_offset   = 0;
+
+    /* Levels of detail from full resolution to the coarsest one. */
+    MeshLod     lods[MESH_MAX_LODS] = {};
+    uint32_t    lod_count       = 0;
+
+    /* Bounding sphere in model space: xyz - center, w - radius. */
+    glm::vec4   bounding_sphere {};
+
+    /* Objects using this mesh - they occupy range [first_instance; first_instance + instance_count) of every view's visible instance list. */
+    uint32_t    first_instance  = 0;
+    uint32_t    instance_count  = 0;
+
+    /* Drawn by a single instanced draw per view instead of per-object meshlet culling. */
+    bool        instanced       = false;
+};
+
+/* GPU copy of MeshInfo. Layout has to match std430 'MeshData' structure declared inside cull.comp and meshlet.comp. */
+struct MeshData {
+    glm::vec4   bounding_sphere;
+    int32_t     vertex_offset;
+    uint32_t    lod_count;
+
+    /* Visible instance list range of the mesh: MESH_MAX_LODS sub-ranges of instance_count entries, one per level. */
+    uint32_t    instance_base;
+    uint32_t    instance_count;
+    uint32_t    instanced;
+    uint32_t    pad[3];
+
+    MeshLod     lods[MESH_MAX_LODS];
+};
+
+/* Split triangles [firstIndex; firstIndex + indexCount) into meshlets appended to 'meshlets'.
+*  Triangle order is preserved, so every meshlet is a contiguous range of 'indices'.
+*/
+void build_meshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                    uint32_t firstIndex, uint32_t indexCount, std::vector<Meshlet>& meshlets);
+
+/* Quadric error metric edge collapse - removes triangles of 'srcIndices' until at most targetIndexCount indices remain
+*  or no collapse is possible. Vertices are only merged into their neighbours, so no new vertices are created.
+*  Positions shared by several vertices (normal or UV seams) and mesh borders are never moved.
+*  Returns upper bound of distance between simplified and source surface.
+*/
+float simplify_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& srcIndices,
+                    uint32_t targetIndexCount, std::vector<uint32_t>& dstIndices);
+
+/* LOD chain of triangles [firstIndex; firstIndex + indexCount). LOD 0 is the source range, every next level
+*  is simplified from the previous one to about half of its triangles. Indices and meshlets of all levels are appended.
+*  Returns number of written levels.
+*/
+uint32_t build_mesh_lods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets,
+                         uint32_t firstIndex, uint32_t indexCount, MeshLod* lods);
+
+/* Binary mesh cache - deduplicated vertices, indices, meshlets and LOD chain of a model.
+*  Cache is rejected if it was written by a different format version or source file has changed since.
+*/
+bool read_mesh_cache(const std::string& cachePath, const std::string& sourcePath,
+                     std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets,
+                     std::vector<MeshLod>& lods);
+void write_mesh_cache(const std::string& cachePath, const std::string& sourcePath,
+                      const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<Meshlet>& meshlets,
+                      const std::vector<MeshLod>& lods);
\ No newline at end of file
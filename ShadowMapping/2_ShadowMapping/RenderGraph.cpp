@@ -0,0 +1,721 @@
+#include "RenderGraph.h"
+
+#include <map>
+
+/* Accesses which modify memory - everything else only reads it. */
+static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                          VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+RenderGraph::Pass::Pass(RenderGraph* graph, const std::string& name, Record_Fn record, graph_queue queue)
+    : _graph(graph), _name(name), _record(std::move(record)), _queue(queue)
+{
+}
+
+RenderGraph::Pass& RenderGraph::Pass::read(Resource resource, const Resource_Access& access, uint32_t baseMip, uint32_t mipCount)
+{
+    return this->access(resource, access, baseMip, mipCount, false);
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write(Resource resource, const Resource_Access& access, uint32_t baseMip, uint32_t mipCount)
+{
+    return this->access(resource, access, baseMip, mipCount, true);
+}
+
+RenderGraph::Pass& RenderGraph::Pass::side_effects()
+{
+    _side_effects = true;
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::access(Resource resource, const Resource_Access& access, uint32_t baseMip, uint32_t mipCount, bool write)
+{
+    if( resource >= _graph->_resources.size() )
+        throw std::runtime_error("Pass '" + _name + "' uses resource which is not part of render graph :( \n");
+
+    const Resource_Info& info = _graph->_resources[resource];
+    if( mipCount == ALL_MIPS && baseMip < info.mip_levels )
+        mipCount = info.mip_levels - baseMip;
+
+    if( baseMip + mipCount > info.mip_levels || mipCount == 0 )
+        throw std::runtime_error("Pass '" + _name + "' uses mip levels which '" + info.name + "' does not have :( \n");
+
+    _accesses.push_back({ resource, access, baseMip, mipCount, write });
+    return *this;
+}
+
+RenderGraph::RenderGraph(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t graphicsFamily, uint32_t computeFamily)
+    : _device(device), _physical_device(physicalDevice), _async_compute(computeFamily != VK_QUEUE_FAMILY_IGNORED)
+{
+    _queue_families[GRAPH_QUEUE_GRAPHICS]   = graphicsFamily;
+    _queue_families[GRAPH_QUEUE_COMPUTE]    = _async_compute ? computeFamily : graphicsFamily;
+}
+
+RenderGraph::~RenderGraph()
+{
+    for( const auto& resource : _resources )
+    {
+        if( resource.transient )
+            vkDestroyImage(_device, resource.images[0], nullptr);
+    }
+
+    for( VkDeviceMemory memory : _memory )
+        vkFreeMemory(_device, memory, nullptr);
+}
+
+RenderGraph::Resource RenderGraph::create_image(const std::string& name, const VkImageCreateInfo& imageInfo, VkImageAspectFlags aspect)
+{
+    if( _compiled )
+        throw std::runtime_error("Render graph is compiled already - image '" + name + "' cannot be added :( \n");
+
+    VkImage image;
+    if( vkCreateImage(_device, &imageInfo, nullptr, &image) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create image. :( \n");
+
+    Resource_Info info;
+    info.name       = name;
+    info.is_image   = true;
+    info.transient  = true;
+    info.lazy       = (imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
+    info.images     = { image };
+    info.aspect     = aspect;
+    info.mip_levels = imageInfo.mipLevels;
+
+    _resources.push_back(info);
+    return static_cast<Resource>(_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::import_image(const std::string& name, const std::vector<VkImage>& images, VkImageAspectFlags aspect, uint32_t mipLevels,
+    const Resource_Access& initial, const Resource_Access& final)
+{
+    if( _compiled || images.empty() )
+        throw std::runtime_error("Image '" + name + "' cannot be imported into render graph :( \n");
+
+    Resource_Info info;
+    info.name       = name;
+    info.is_image   = true;
+    info.exported   = true;     /* Caller owns the image - it is used after the frame */
+    info.images     = images;
+    info.aspect     = aspect;
+    info.mip_levels = mipLevels;
+    info.initial    = initial;
+    info.final      = final;
+
+    _resources.push_back(info);
+    return static_cast<Resource>(_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::import_buffer(const std::string& name, uint32_t flags, const Resource_Access& final)
+{
+    if( _compiled )
+        throw std::runtime_error("Render graph is compiled already - buffer '" + name + "' cannot be added :( \n");
+
+    Resource_Info info;
+    info.name       = name;
+    info.exported   = (flags & BUFFER_EXPORTED) || final.stages != 0;
+    info.per_image  = (flags & BUFFER_PER_IMAGE) != 0;
+    info.final      = final;
+
+    _resources.push_back(info);
+    return static_cast<Resource>(_resources.size() - 1);
+}
+
+RenderGraph::Pass& RenderGraph::add_pass(const std::string& name, Record_Fn record, graph_queue queue)
+{
+    if( _compiled )
+        throw std::runtime_error("Render graph is compiled already - pass '" + name + "' cannot be added :( \n");
+
+    if( !_async_compute )
+        queue = GRAPH_QUEUE_GRAPHICS;
+
+    _passes.push_back(std::unique_ptr<Pass>(new Pass(this, name, std::move(record), queue)));
+    return *_passes.back();
+}
+
+void RenderGraph::compile()
+{
+    if( _compiled )
+        throw std::runtime_error("Render graph is compiled already :( \n");
+
+    cull_passes();
+    allocate_transients();
+
+    /* State every resource is in when frame starts - imported images are in their initial one. */
+    std::vector<std::vector<Sync_State>> states(_resources.size());
+    for( size_t i = 0; i < _resources.size(); i++ )
+    {
+        const Resource_Info& info = _resources[i];
+
+        Sync_State initial;
+        initial.layout          = info.initial.layout;
+        initial.write_stages    = info.initial.stages;
+        initial.write_access    = info.initial.access;
+
+        states[i].assign(info.mip_levels, initial);
+    }
+
+    /* Frame is recorded over and over - the first access of a resource has to wait for its last access of previous frame.
+    *  States left by one frame are the initial states of the next one. Contents of transient images are discarded.
+    *  Per image buffers were used by another command buffer - the previous use of this one was waited for by its fence.
+    */
+    build_schedule(states);
+
+    for( size_t i = 0; i < _resources.size(); i++ )
+    {
+        const Resource_Info& info = _resources[i];
+        for( auto& state : states[i] )
+        {
+            if( info.transient )
+                state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            else if( info.per_image )
+                state = Sync_State {};
+            else if( info.is_image )
+            {
+                state = Sync_State {};
+                state.layout        = info.initial.layout;
+                state.write_stages  = info.initial.stages;
+                state.write_access  = info.initial.access;
+            }
+        }
+    }
+
+    build_schedule(states);
+
+    if( _segments.empty() )
+        _segments.push_back(Segment {});
+
+    /* Resources used after the frame are handed over in their final state - by the segment which used them last. */
+    for( Resource i = 0; i < _resources.size(); i++ )
+    {
+        const Resource_Info& info = _resources[i];
+        if( info.final.stages == 0 && !(info.is_image && info.final.layout != VK_IMAGE_LAYOUT_UNDEFINED) )
+            continue;
+
+        uint32_t segment = 0;
+        for( const auto& state : states[i] )
+            segment = std::max(segment, (state.segment != NO_SEGMENT) ? state.segment : static_cast<uint32_t>(_segments.size() - 1));
+
+        sync(states, { i, info.final, 0, info.mip_levels, false }, segment, _segments[segment].end_barriers);
+    }
+
+    _stats.passes   = static_cast<uint32_t>(_passes.size());
+    _stats.segments = static_cast<uint32_t>(_segments.size());
+    for( const auto& segment : _segments )
+    {
+        for( const auto& step : segment.steps )
+        {
+            _stats.barrier_batches  += (step.barriers.src_stages != 0) ? 1 : 0;
+            _stats.image_barriers   += static_cast<uint32_t>(step.barriers.image_barriers.size());
+
+            for( const auto& barrier : step.barriers.image_barriers )
+                _stats.ownership_barriers += (barrier.src_family != barrier.dst_family) ? 1 : 0;
+        }
+        _stats.barrier_batches  += (segment.end_barriers.src_stages != 0) ? 1 : 0;
+        _stats.image_barriers   += static_cast<uint32_t>(segment.end_barriers.image_barriers.size());
+
+        /* Releases are recorded at the end of the segment which used the image last. */
+        for( const auto& barrier : segment.end_barriers.image_barriers )
+            _stats.ownership_barriers += (barrier.src_family != barrier.dst_family) ? 1 : 0;
+    }
+
+    _compiled = true;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t segment) const
+{
+    if( !_compiled )
+        throw std::runtime_error("Render graph has to be compiled before it is executed :( \n");
+
+    for( const auto& step : _segments[segment].steps )
+    {
+        record_barriers(commandBuffer, step.barriers, frame);
+
+        for( uint32_t pass : step.passes )
+            _passes[pass]->_record(commandBuffer, frame);
+    }
+
+    record_barriers(commandBuffer, _segments[segment].end_barriers, frame);
+}
+
+VkImage RenderGraph::image(Resource resource) const
+{
+    if( resource >= _resources.size() || !_resources[resource].is_image )
+        throw std::runtime_error("Render graph resource is not an image :( \n");
+
+    return _resources[resource].images[0];
+}
+
+Resource_Access RenderGraph::layout_access(VkImageLayout layout)
+{
+    switch( layout )
+    {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+        return { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, layout };
+    case VK_IMAGE_LAYOUT_GENERAL:
+        return { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, layout };
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+        return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, layout };
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+        return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, layout };
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+        return { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, layout };
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+        return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, layout };
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+        return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, layout };
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+        return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT, layout };
+    case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+        return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, layout };
+    default:
+        throw std::runtime_error("Unsupported image layout! :( \n");
+    }
+}
+
+void RenderGraph::cull_passes()
+{
+    /* Walk backwards - pass is needed if it writes something read later or used after the frame. */
+    std::vector<bool> needed(_resources.size());
+    for( size_t i = 0; i < _resources.size(); i++ )
+        needed[i] = _resources[i].exported;
+
+    for( auto pass = _passes.rbegin(); pass != _passes.rend(); ++pass )
+    {
+        bool live = (*pass)->_side_effects;
+        for( const auto& access : (*pass)->_accesses )
+            live |= access.write && needed[access.resource];
+
+        (*pass)->_culled = !live;
+        _stats.culled_passes += live ? 0 : 1;
+
+        if( !live )
+            continue;
+
+        /* Writes which also read (depth test, load of attachment, atomics) keep previous writers alive. */
+        for( const auto& access : (*pass)->_accesses )
+        {
+            if( !access.write || (access.access.access & ~WRITE_ACCESS) != 0 )
+                needed[access.resource] = true;
+        }
+    }
+}
+
+void RenderGraph::allocate_transients()
+{
+    std::vector<Resource> transients;
+
+    for( Resource i = 0; i < _resources.size(); i++ )
+    {
+        Resource_Info& info = _resources[i];
+        if( !info.transient )
+            continue;
+
+        /* Lifetime spans recorded passes which use the image. Image not used by any has no lifetime and may share memory with anything. */
+        for( uint32_t pass = 0; pass < _passes.size(); pass++ )
+        {
+            if( _passes[pass]->_culled )
+                continue;
+
+            for( const auto& access : _passes[pass]->_accesses )
+            {
+                if( access.resource != i )
+                    continue;
+
+                info.first_pass = std::min(info.first_pass, pass);
+                info.last_pass  = std::max(info.last_pass, pass);
+            }
+        }
+
+        vkGetImageMemoryRequirements(_device, info.images[0], &info.requirements);
+        info.memory_type = find_memory_type(info.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        /* Tile based GPUs keep such attachment in tile memory only - its memory is never committed. Images of other types do not alias it. */
+        if( info.lazy )
+        {
+            uint32_t lazyType = find_memory_type(info.requirements.memoryTypeBits,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, false);
+
+            if( lazyType != UINT32_MAX )
+                info.memory_type = lazyType;
+        }
+
+        transients.push_back(i);
+    }
+
+    /* Largest images are placed first - smaller ones fill gaps left between them. */
+    std::sort(transients.begin(), transients.end(), [this](Resource a, Resource b) {
+        return _resources[a].requirements.size > _resources[b].requirements.size;
+    });
+
+    auto lifetimesOverlap = [](const Resource_Info& a, const Resource_Info& b) {
+        return a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+    };
+    auto memoryOverlaps = [](const Resource_Info& a, const Resource_Info& b) {
+        return a.memory_type == b.memory_type &&
+               a.offset < b.offset + b.requirements.size && b.offset < a.offset + a.requirements.size;
+    };
+
+    std::map<uint32_t, VkDeviceSize> heapSizes;
+    std::vector<Resource> placed;
+
+    for( Resource resource : transients )
+    {
+        Resource_Info& info = _resources[resource];
+        VkDeviceSize alignment = info.requirements.alignment;
+
+        /* Lowest offset where memory is not used by any image living at the same time. */
+        info.offset = 0;
+        for( bool moved = true; moved; )
+        {
+            moved = false;
+            for( Resource other : placed )
+            {
+                const Resource_Info& otherInfo = _resources[other];
+                if( lifetimesOverlap(info, otherInfo) && memoryOverlaps(info, otherInfo) )
+                {
+                    info.offset = (otherInfo.offset + otherInfo.requirements.size + alignment - 1) / alignment * alignment;
+                    moved = true;
+                }
+            }
+        }
+
+        placed.push_back(resource);
+        heapSizes[info.memory_type] = std::max(heapSizes[info.memory_type], info.offset + info.requirements.size);
+        _stats.transient_memory_unaliased += info.requirements.size;
+    }
+
+    /* One allocation for each memory type, images are bound at their offsets. */
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(_physical_device, &memProperties);
+
+    std::map<uint32_t, VkDeviceMemory> heaps;
+    for( const auto& heap : heapSizes )
+    {
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize    = heap.second;
+        allocInfo.memoryTypeIndex   = heap.first;
+
+        VkDeviceMemory memory;
+        if( vkAllocateMemory(_device, &allocInfo, nullptr, &memory) != VK_SUCCESS )
+            throw std::runtime_error("Failed to allocate memory of transient images. :( \n");
+
+        _memory.push_back(memory);
+        heaps[heap.first] = memory;
+        _stats.transient_memory += heap.second;
+
+        if( memProperties.memoryTypes[heap.first].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT )
+            _stats.lazy_memory += heap.second;
+    }
+
+    for( Resource resource : transients )
+    {
+        Resource_Info& info = _resources[resource];
+        vkBindImageMemory(_device, info.images[0], heaps[info.memory_type], info.offset);
+
+        for( Resource other : transients )
+        {
+            if( other != resource && memoryOverlaps(info, _resources[other]) )
+                info.aliases.push_back(other);
+        }
+    }
+}
+
+void RenderGraph::build_schedule(std::vector<std::vector<Sync_State>>& states)
+{
+    _segments.clear();
+
+    Step step;
+    for( uint32_t i = 0; i < _passes.size(); i++ )
+    {
+        const Pass& pass = *_passes[i];
+        if( pass._culled )
+            continue;
+
+        /* Pass of the other queue starts new segment, pass depending on one of the merged passes needs barriers after them. */
+        bool newSegment = _segments.empty() || pass._queue != _segments.back().queue;
+        if( !step.passes.empty() && (newSegment || conflicts(pass, step.passes)) )
+        {
+            _segments.back().steps.push_back(std::move(step));
+            step = Step {};
+        }
+
+        if( newSegment )
+        {
+            _segments.push_back(Segment {});
+            _segments.back().queue = pass._queue;
+        }
+
+        for( const auto& access : pass._accesses )
+            sync(states, access, static_cast<uint32_t>(_segments.size() - 1), step.barriers);
+
+        step.passes.push_back(i);
+    }
+
+    if( !step.passes.empty() )
+        _segments.back().steps.push_back(std::move(step));
+}
+
+void RenderGraph::sync(std::vector<std::vector<Sync_State>>& states, const Pass::Access& access, uint32_t segment, Barrier_Batch& batch)
+{
+    const Resource_Info& info = _resources[access.resource];
+    const Resource_Access& use = access.access;
+    graph_queue queue = _segments[segment].queue;
+
+    /* Segment waits for all work submitted to the other queue before the previous segment - the first one waits for nothing. */
+    auto otherQueue = [&](const Sync_State& state) {
+        if( state.segment == NO_SEGMENT || state.queue == queue )
+            return false;
+
+        if( segment == 0 )
+            throw std::runtime_error("'" + info.name + "' is used by the first segment of a frame and by the other queue in previous frame :( \n");
+
+        return true;
+    };
+
+    for( uint32_t mip = access.base_mip; mip < access.base_mip + access.mip_count; mip++ )
+    {
+        Sync_State& state = states[access.resource][mip];
+
+        if( otherQueue(state) )
+        {
+            /* Image keeping its contents is released by the queue family which used it last and acquired by this one. */
+            if( info.is_image && state.layout != VK_IMAGE_LAYOUT_UNDEFINED && _queue_families[state.queue] != _queue_families[queue] )
+            {
+                Barrier_Batch& release = _segments[state.segment].end_barriers;
+                release.src_stages |= (state.write_stages | state.read_stages) != 0 ? (state.write_stages | state.read_stages) : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+                release.dst_stages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+                add_image_barrier(release, { access.resource, mip, 1, state.layout, use.layout, state.write_access, 0,
+                                             _queue_families[state.queue], _queue_families[queue] });
+
+                batch.src_stages |= use.stages;
+                batch.dst_stages |= use.stages;
+                add_image_barrier(batch, { access.resource, mip, 1, state.layout, use.layout, 0, use.access,
+                                           _queue_families[state.queue], _queue_families[queue] });
+
+                /* Acquire made the image visible to this access - the same as layout transition. */
+                VkImageLayout layout = use.layout;
+                state = Sync_State {};
+                state.layout            = layout;
+                state.write_stages      = use.stages;
+                state.read_stages       = use.stages;
+                state.visible_stages    = use.stages;
+                state.visible_access    = use.access;
+                state.segment           = segment;
+                state.queue             = queue;
+
+                if( access.write )
+                {
+                    state.write_access      = use.access & WRITE_ACCESS;
+                    state.read_stages       = 0;
+                    state.visible_stages    = 0;
+                    state.visible_access    = 0;
+                }
+                continue;
+            }
+
+            /* Semaphore made every access of the other queue available and visible - only layout is left to be changed. */
+            VkImageLayout layout = state.layout;
+            state = Sync_State {};
+            state.layout = layout;
+        }
+
+        bool transition = info.is_image && use.layout != state.layout;
+
+        VkPipelineStageFlags srcStages = 0;
+        VkAccessFlags        srcAccess = 0;
+        VkAccessFlags        aliasAccess = 0;
+
+        if( transition || access.write )
+        {
+            /* Write after write, write after read - layout transition writes as well. */
+            srcStages = state.write_stages | state.read_stages;
+            srcAccess = state.write_access;
+
+            /* Memory of transient image was used by images aliasing it since its contents were discarded. */
+            if( info.transient && state.layout == VK_IMAGE_LAYOUT_UNDEFINED )
+            {
+                for( Resource alias : info.aliases )
+                {
+                    for( const auto& aliasState : states[alias] )
+                    {
+                        if( otherQueue(aliasState) )
+                            continue;
+
+                        srcStages   |= aliasState.write_stages | aliasState.read_stages;
+                        aliasAccess |= aliasState.write_access;
+                    }
+                }
+            }
+        }
+        else if( state.write_stages != 0 && ((use.stages & ~state.visible_stages) != 0 || (use.access & ~state.visible_access) != 0) )
+        {
+            /* Read after write not made visible to this stage or access yet */
+            srcStages = state.write_stages;
+            srcAccess = state.write_access;
+        }
+
+        if( srcStages != 0 || transition )
+        {
+            batch.src_stages |= (srcStages != 0) ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+            batch.dst_stages |= use.stages;
+
+            if( transition )
+                add_image_barrier(batch, { access.resource, mip, 1, state.layout, use.layout, srcAccess, use.access });
+            else
+            {
+                batch.src_access |= srcAccess;
+                batch.dst_access |= use.access;
+            }
+
+            if( aliasAccess != 0 )
+            {
+                batch.src_access |= aliasAccess;
+                batch.dst_access |= use.access;
+            }
+        }
+
+        if( access.write )
+        {
+            state.write_stages      = use.stages;
+            state.write_access      = use.access & WRITE_ACCESS;
+            state.read_stages       = 0;
+            state.visible_stages    = 0;
+            state.visible_access    = 0;
+        }
+        else if( transition )
+        {
+            /* Transition is visible to the access it was made for - later accesses chain after it. */
+            state.write_stages      = use.stages;
+            state.write_access      = 0;
+            state.read_stages       = use.stages;
+            state.visible_stages    = use.stages;
+            state.visible_access    = use.access;
+        }
+        else
+        {
+            state.read_stages |= use.stages;
+            if( srcStages != 0 )
+            {
+                state.visible_stages    |= use.stages;
+                state.visible_access    |= use.access;
+            }
+        }
+
+        if( info.is_image )
+            state.layout = use.layout;
+
+        state.segment   = segment;
+        state.queue     = queue;
+    }
+}
+
+void RenderGraph::add_image_barrier(Barrier_Batch& batch, const Image_Barrier& barrier)
+{
+    /* Neighbouring mip levels with the same transition share one barrier. */
+    Image_Barrier* last = batch.image_barriers.empty() ? nullptr : &batch.image_barriers.back();
+    if( last != nullptr && last->resource == barrier.resource && last->base_mip + last->mip_count == barrier.base_mip &&
+        last->old_layout == barrier.old_layout && last->new_layout == barrier.new_layout && last->src_access == barrier.src_access &&
+        last->dst_access == barrier.dst_access && last->src_family == barrier.src_family && last->dst_family == barrier.dst_family )
+    {
+        last->mip_count += barrier.mip_count;
+        return;
+    }
+
+    batch.image_barriers.push_back(barrier);
+}
+
+bool RenderGraph::conflicts(const Pass& pass, const std::vector<uint32_t>& passes) const
+{
+    for( const auto& access : pass._accesses )
+    {
+        for( uint32_t other : passes )
+        {
+            for( const auto& otherAccess : _passes[other]->_accesses )
+            {
+                /* Transient images sharing memory - one of them is discarded when the other one is used first. */
+                const auto& aliases = _resources[access.resource].aliases;
+                if( std::find(aliases.begin(), aliases.end(), otherAccess.resource) != aliases.end() )
+                    return true;
+
+                if( access.resource != otherAccess.resource ||
+                    access.base_mip >= otherAccess.base_mip + otherAccess.mip_count ||
+                    otherAccess.base_mip >= access.base_mip + access.mip_count )
+                {
+                    continue;
+                }
+
+                if( access.write || otherAccess.write ||
+                    (_resources[access.resource].is_image && access.access.layout != otherAccess.access.layout) )
+                {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void RenderGraph::record_barriers(VkCommandBuffer commandBuffer, const Barrier_Batch& batch, uint32_t frame) const
+{
+    if( batch.src_stages == 0 )
+        return;
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = batch.src_access;
+    memoryBarrier.dstAccessMask = batch.dst_access;
+
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    for( const auto& barrier : batch.image_barriers )
+    {
+        const Resource_Info& info = _resources[barrier.resource];
+
+        VkImageMemoryBarrier imageBarrier = {};
+        imageBarrier.sType                  = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask          = barrier.src_access;
+        imageBarrier.dstAccessMask          = barrier.dst_access;
+        imageBarrier.oldLayout              = barrier.old_layout;
+        imageBarrier.newLayout              = barrier.new_layout;
+        imageBarrier.srcQueueFamilyIndex    = barrier.src_family;
+        imageBarrier.dstQueueFamilyIndex    = barrier.dst_family;
+        imageBarrier.image                  = info.images[frame % info.images.size()];
+        imageBarrier.subresourceRange.aspectMask        = info.aspect;
+        imageBarrier.subresourceRange.baseMipLevel      = barrier.base_mip;
+        imageBarrier.subresourceRange.levelCount        = barrier.mip_count;
+        imageBarrier.subresourceRange.baseArrayLayer    = 0;
+        imageBarrier.subresourceRange.layerCount        = 1;
+
+        imageBarriers.push_back(imageBarrier);
+    }
+
+    bool memory = (batch.src_access | batch.dst_access) != 0;
+
+    vkCmdPipelineBarrier(commandBuffer,
+        batch.src_stages,
+        batch.dst_stages,
+        0,
+        memory ? 1 : 0, &memoryBarrier,
+        0, nullptr,
+        static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+uint32_t RenderGraph::find_memory_type(uint32_t typeFilter, VkMemoryPropertyFlags properties, bool required) const
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(_physical_device, &memProperties);
+
+    for( uint32_t i = 0; i < memProperties.memoryTypeCount; i++ )
+    {
+        if( (typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties )
+            return i;
+    }
+
+    /* Optional memory type - caller falls back to another one. */
+    if( !required )
+        return UINT32_MAX;
+
+    throw std::runtime_error("Failed to find suitable memory type. :( \n");
+}
\ No newline at end of file
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "libs.h"
+
+#include <functional>
+#include <memory>
+
+/* How a pass uses a resource - pipeline stages, memory accesses and layout the image has to be in (ignored for buffers). */
+struct Resource_Access
+{
+    VkPipelineStageFlags    stages  = 0;
+    VkAccessFlags           access  = 0;
+    VkImageLayout           layout  = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+/* Queue a pass is submitted to - compute passes overlap graphics work of other passes (async compute). */
+enum graph_queue
+{
+    GRAPH_QUEUE_GRAPHICS = 0,
+    GRAPH_QUEUE_COMPUTE,
+    GRAPH_QUEUE_COUNT,
+};
+
+/* Frame render graph - passes declare resources they read and write, the graph derives everything else:
+*   - Barriers: every access waits only for conflicting accesses before it (including the ones of previous frame).
+*     Buffers and images which keep their layout are synchronized by one global memory barrier, images changing layout by image barriers.
+*   - Merging: consecutive passes without dependencies between them share one barrier batch issued in front of them.
+*   - Culling: passes whose writes are never read (and which have no side effects) are not recorded.
+*   - Aliasing: transient images whose lifetimes do not overlap share memory.
+*   - Queues: passes are split into segments - runs of passes submitted to one queue. Segment waits for the previous one (of the other queue)
+*     by a semaphore, images used by both queue families are handed over by ownership transfers.
+*  Graph is declared once, compiled and then recorded into every command buffer. Used by the render thread only.
+*/
+class RenderGraph
+{
+public:
+    using Resource  = uint32_t;
+
+    /* Records commands of a pass - receives index of swap chain image the command buffer belongs to. */
+    using Record_Fn = std::function<void(VkCommandBuffer, uint32_t)>;
+
+    static const uint32_t ALL_MIPS = ~0u;
+
+    /* Flags of imported buffers */
+    enum buffer_flags
+    {
+        BUFFER_EXPORTED     = 1 << 0,   /* Contents are read after the frame (by host or by next frame) - writers are never culled */
+        BUFFER_PER_IMAGE    = 1 << 1,   /* Every swap chain image has its own buffer - frame waits for its previous use by fence, not by the graph */
+    };
+
+    class Pass
+    {
+    public:
+        /* Accesses of a subresource are declared in order of execution inside the pass. */
+        Pass&   read(Resource resource, const Resource_Access& access, uint32_t baseMip = 0, uint32_t mipCount = ALL_MIPS);
+        Pass&   write(Resource resource, const Resource_Access& access, uint32_t baseMip = 0, uint32_t mipCount = ALL_MIPS);
+
+        /* Pass is recorded even if nothing reads what it writes. */
+        Pass&   side_effects();
+
+    private:
+        friend class RenderGraph;
+
+        struct Access {
+            Resource        resource;
+            Resource_Access access;
+            uint32_t        base_mip;
+            uint32_t        mip_count;
+            bool            write;
+        };
+
+        RenderGraph*        _graph;
+        std::string         _name;
+        Record_Fn           _record;
+        graph_queue         _queue;
+        std::vector<Access> _accesses {};
+        bool                _side_effects = false;
+        bool                _culled = false;
+
+        Pass(RenderGraph* graph, const std::string& name, Record_Fn record, graph_queue queue);
+        Pass&   access(Resource resource, const Resource_Access& access, uint32_t baseMip, uint32_t mipCount, bool write);
+    };
+
+    /* Reported after compile() */
+    struct Stats {
+        uint32_t        passes = 0;
+        uint32_t        culled_passes = 0;
+        uint32_t        barrier_batches = 0;    /* vkCmdPipelineBarrier calls per frame */
+        uint32_t        image_barriers = 0;
+        uint32_t        segments = 0;
+        uint32_t        ownership_barriers = 0;     /* Queue family release and acquire barriers - every transfer takes one of each */
+        VkDeviceSize    transient_memory = 0;
+        VkDeviceSize    transient_memory_unaliased = 0;
+        VkDeviceSize    lazy_memory = 0;            /* Part of transient memory which is lazily allocated - may never be committed */
+    };
+
+    /* Without compute queue family (VK_QUEUE_FAMILY_IGNORED) compute passes are submitted to the graphics queue. */
+    RenderGraph(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t graphicsFamily, uint32_t computeFamily = VK_QUEUE_FAMILY_IGNORED);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    /* Image owned by the graph - its contents are discarded at the beginning of every frame. Memory is bound by compile().
+    *  Image has to be created with exclusive sharing mode - the graph transfers its ownership between queue families.
+    *  Transient attachments (VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) get lazily allocated memory where device has such.
+    */
+    Resource        create_image(const std::string& name, const VkImageCreateInfo& imageInfo, VkImageAspectFlags aspect);
+
+    /* Image owned by the caller - images[i % count] is used by command buffer of swap chain image i.
+    *  Frame starts with the image in 'initial' state (stages to wait for and layout) and leaves it in 'final' one.
+    */
+    Resource        import_image(const std::string& name, const std::vector<VkImage>& images, VkImageAspectFlags aspect, uint32_t mipLevels,
+                        const Resource_Access& initial, const Resource_Access& final);
+
+    /* Buffer tracked for dependencies only - buffers are synchronized by global memory barriers, so no handle is needed.
+    *  Buffers used by both queues have to be created with concurrent sharing mode. Final access is made visible at the end of every frame.
+    */
+    Resource        import_buffer(const std::string& name, uint32_t flags = 0, const Resource_Access& final = {});
+
+    /* Passes are executed in order they are added. */
+    Pass&           add_pass(const std::string& name, Record_Fn record, graph_queue queue = GRAPH_QUEUE_GRAPHICS);
+
+    /* Culls passes, binds memory of transient images and derives barriers. Graph cannot be changed afterwards. */
+    void            compile();
+
+    /* Segments are submitted in order, each one to its queue - segment i waits for a semaphore signalled by segment i - 1.
+    *  Semaphore has to be waited for at all commands stage. Frame without compute passes has a single graphics segment.
+    */
+    uint32_t        segment_count() const { return static_cast<uint32_t>(_segments.size()); }
+    graph_queue     segment_queue(uint32_t segment) const { return _segments[segment].queue; }
+
+    void            execute(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t segment) const;
+
+    VkImage         image(Resource resource) const;
+    const Stats&    stats() const { return _stats; }
+
+    /* Usual access of an image in given layout - used by one-off layout transitions outside of the graph. */
+    static Resource_Access  layout_access(VkImageLayout layout);
+
+private:
+    static const uint32_t NO_SEGMENT = ~0u;
+
+    /* State of a buffer or of a single mip level of an image */
+    struct Sync_State {
+        VkImageLayout           layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags    write_stages = 0;   /* Last write or layout transition */
+        VkAccessFlags           write_access = 0;
+        VkPipelineStageFlags    read_stages = 0;    /* Reads since the last write */
+        VkPipelineStageFlags    visible_stages = 0; /* Accesses which see the last write already */
+        VkAccessFlags           visible_access = 0;
+        uint32_t                segment = NO_SEGMENT;   /* Segment of the last access - of previous frame at the beginning of a frame */
+        graph_queue             queue = GRAPH_QUEUE_GRAPHICS;
+    };
+
+    struct Resource_Info {
+        std::string             name;
+        bool                    is_image = false;
+        bool                    transient = false;
+        bool                    exported = false;
+        bool                    per_image = false;
+        bool                    lazy = false;       /* Transient attachment - lazily allocated memory is preferred */
+        std::vector<VkImage>    images {};
+        VkImageAspectFlags      aspect = 0;
+        uint32_t                mip_levels = 1;
+        Resource_Access         initial {};
+        Resource_Access         final {};
+
+        /* Transient images only - passes between first and last use, memory range and images sharing it. */
+        uint32_t                first_pass = UINT32_MAX;
+        uint32_t                last_pass = 0;
+        VkMemoryRequirements    requirements {};
+        uint32_t                memory_type = 0;
+        VkDeviceSize            offset = 0;
+        std::vector<Resource>   aliases {};
+    };
+
+    struct Image_Barrier {
+        Resource                resource;
+        uint32_t                base_mip;
+        uint32_t                mip_count;
+        VkImageLayout           old_layout;
+        VkImageLayout           new_layout;
+        VkAccessFlags           src_access;
+        VkAccessFlags           dst_access;
+        uint32_t                src_family = VK_QUEUE_FAMILY_IGNORED;   /* Ownership transfer */
+        uint32_t                dst_family = VK_QUEUE_FAMILY_IGNORED;
+    };
+
+    struct Barrier_Batch {
+        VkPipelineStageFlags        src_stages = 0;
+        VkPipelineStageFlags        dst_stages = 0;
+        VkAccessFlags               src_access = 0;     /* Global memory barrier */
+        VkAccessFlags               dst_access = 0;
+        std::vector<Image_Barrier>  image_barriers {};
+    };
+
+    /* Merged passes and barriers issued in front of them */
+    struct Step {
+        Barrier_Batch           barriers {};
+        std::vector<uint32_t>   passes {};
+    };
+
+    /* Steps submitted to one queue and barriers issued after them - ownership releases and final states of resources. */
+    struct Segment {
+        graph_queue             queue = GRAPH_QUEUE_GRAPHICS;
+        std::vector<Step>       steps {};
+        Barrier_Batch           end_barriers {};
+    };
+
+    VkDevice                            _device;
+    VkPhysicalDevice                    _physical_device;
+    uint32_t                            _queue_families[GRAPH_QUEUE_COUNT];
+    bool                                _async_compute;
+    bool                                _compiled = false;
+
+    std::vector<Resource_Info>          _resources {};
+    std::vector<std::unique_ptr<Pass>>  _passes {};
+    std::vector<VkDeviceMemory>         _memory {};
+
+    std::vector<Segment>                _segments {};
+    Stats                               _stats {};
+
+    void            cull_passes();
+    void            allocate_transients();
+    void            build_schedule(std::vector<std::vector<Sync_State>>& states);
+    void            sync(std::vector<std::vector<Sync_State>>& states, const Pass::Access& access, uint32_t segment, Barrier_Batch& batch);
+    static void     add_image_barrier(Barrier_Batch& batch, const Image_Barrier& barrier);
+    bool            conflicts(const Pass& pass, const std::vector<uint32_t>& passes) const;
+    void            record_barriers(VkCommandBuffer commandBuffer, const Barrier_Batch& batch, uint32_t frame) const;
+    uint32_t        find_memory_type(uint32_t typeFilter, VkMemoryPropertyFlags properties, bool required = true) const;
+};
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "ShaderManager.h"
+
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <thread>
+
+/* Part of every cache key - has to be changed together with compile options, so binaries of old options are not reused. */
+static const char* COMPILE_OPTIONS_KEY = "vulkan1.0;performance";
+
+ShaderManager::ShaderManager(const std::string& cacheDirectory)
+    : _cache_directory(cacheDirectory)
+{
+    std::filesystem::create_directories(_cache_directory);
+}
+
+std::vector<uint32_t> ShaderManager::get_spirv(const ShaderVariant& variant)
+{
+    /* Source is read every time - hash of its current text decides whether cached binary is still valid. */
+    std::string source  = read_source(variant.path);
+    uint64_t    hash    = variant_hash(variant, source);
+    std::string key     = variant_key(variant);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto cached = _spirv.find(key);
+        if( cached != _spirv.end() && cached->second.hash == hash )
+            return cached->second.spirv;
+    }
+
+    std::vector<uint32_t> spirv;
+    if( !read_cache(hash, spirv) )
+    {
+        spirv = compile_variant(variant, source);
+        write_cache(hash, spirv);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _spirv[key] = { hash, spirv };
+
+    return spirv;
+}
+
+void ShaderManager::compile(const std::vector<ShaderVariant>& variants, uint32_t threadCount)
+{
+    if( threadCount == 0 )
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    threadCount = std::min(threadCount, static_cast<uint32_t>(variants.size()));
+
+    std::atomic<size_t> nextVariant(0);
+    std::exception_ptr  error;
+    std::mutex          errorMutex;
+
+    auto worker = [&]()
+    {
+        for( size_t index = nextVariant++; index < variants.size(); index = nextVariant++ )
+        {
+            try
+            {
+                get_spirv(variants[index]);
+            }
+            catch( ... )
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if( !error )
+                    error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for( uint32_t i = 1; i < threadCount; i++ )
+        threads.emplace_back(worker);
+
+    worker();
+
+    for( auto& thread : threads )
+        thread.join();
+
+    if( error )
+        std::rethrow_exception(error);
+}
+
+std::string ShaderManager::read_source(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if( !file.is_open() )
+        throw std::runtime_error("Failed to open shader source: " + path + " :( \n");
+
+    std::stringstream source;
+    source << file.rdbuf();
+
+    return source.str();
+}
+
+shaderc_shader_kind ShaderManager::shader_kind(const std::string& path)
+{
+    std::string extension = std::filesystem::path(path).extension().string();
+
+    if( extension == ".vert" )
+        return shaderc_glsl_vertex_shader;
+    if( extension == ".frag" )
+        return shaderc_glsl_fragment_shader;
+    if( extension == ".comp" )
+        return shaderc_glsl_compute_shader;
+
+    throw std::runtime_error("Unknown shader stage of: " + path + " :( \n");
+}
+
+uint64_t ShaderManager::variant_hash(const ShaderVariant& variant, const std::string& source)
+{
+    /* FNV-1a over stage, options, defines and source. Fields are separated by zero byte, so their boundaries are part of the key. */
+    uint64_t hash = 14695981039346656037ull;
+
+    auto append = [&hash](const std::string& text)
+    {
+        for( unsigned char c : text )
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+
+        hash *= 1099511628211ull;   /* Zero byte separator */
+    };
+
+    append(std::to_string(shader_kind(variant.path)));
+    append(COMPILE_OPTIONS_KEY);
+
+    for( const auto& define : variant.defines )
+    {
+        append(define.name);
+        append(define.value);
+    }
+
+    append(source);
+
+    return hash;
+}
+
+std::string ShaderManager::variant_key(const ShaderVariant& variant)
+{
+    /* Zero byte separates fields, as in variant_hash(). */
+    std::string key = variant.path;
+
+    for( const auto& define : variant.defines )
+    {
+        key += '\0' + define.name;
+        key += '\0' + define.value;
+    }
+
+    return key;
+}
+
+std::string ShaderManager::cache_path(uint64_t hash) const
+{
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash << ".spv";
+
+    return (std::filesystem::path(_cache_directory) / name.str()).string();
+}
+
+bool ShaderManager::read_cache(uint64_t hash, std::vector<uint32_t>& spirv) const
+{
+    std::ifstream file(cache_path(hash), std::ios::ate | std::ios::binary);
+
+    if( !file.is_open() )
+        return false;
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    if( fileSize == 0 || fileSize % sizeof(uint32_t) != 0 )
+        return false;
+
+    spirv.resize(fileSize / sizeof(uint32_t));
+
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(spirv.data()), fileSize);
+
+    return static_cast<bool>(file);
+}
+
+void ShaderManager::write_cache(uint64_t hash, const std::vector<uint32_t>& spirv) const
+{
+    /* Binary is written under temporary name and renamed - concurrent reader never sees partially written file. */
+    std::string path            = cache_path(hash);
+    std::string temporaryPath   = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+        if( !file.is_open() )
+            return;     /* Cache is optional - shader is just compiled again next time. */
+
+        file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+
+    if( error )
+        std::filesystem::remove(temporaryPath, error);
+}
+
+std::vector<uint32_t> ShaderManager::compile_variant(const ShaderVariant& variant, const std::string& source) const
+{
+    /* Compiler per call - variants are compiled from several threads at once. */
+    shaderc::Compiler       compiler;
+    shaderc::CompileOptions options;
+
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+    options.SetOptimizationLevel(shaderc_optimization_level_performance);
+
+    for( const auto& define : variant.defines )
+        options.AddMacroDefinition(define.name, define.value);
+
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, shader_kind(variant.path), variant.path.c_str(), options);
+
+    if( result.GetCompilationStatus() != shaderc_compilation_status_success )
+        throw std::runtime_error("Failed to compile shader " + variant.path + ":\n" + result.GetErrorMessage() + " :( \n");
+
+    return std::vector<uint32_t>(result.cbegin(), result.cend());
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "libs.h"
+
+#include <mutex>
+
+#include <shaderc/shaderc.hpp>
+
+/* Macro definition passed to shader compiler - part of the cache key. */
+struct ShaderDefine {
+    std::string name;
+    std::string value;
+};
+
+/* Source file compiled with a set of macro definitions. Stage is taken from file extension (.vert, .frag, .comp). */
+struct ShaderVariant {
+    std::string                 path;
+    std::vector<ShaderDefine>   defines {};
+};
+
+/* Compiles GLSL sources through shaderc at runtime.
+*  SPIR-V is cached on disk under the hash of everything affecting compiler output - stage, source text, defines and compiler
+*  options. Edited source never hits a stale binary and unchanged one is compiled only once, across runs as well.
+*/
+class ShaderManager
+{
+public:
+    explicit ShaderManager(const std::string& cacheDirectory);
+
+    /* SPIR-V of variant - taken from memory, from disk cache or compiled. Throws with compiler log when compilation fails. */
+    std::vector<uint32_t>   get_spirv(const ShaderVariant& variant);
+
+    /* Brings variants into memory cache on a pool of threads. First error is rethrown once all threads are finished. */
+    void                    compile(const std::vector<ShaderVariant>& variants, uint32_t threadCount = 0);
+
+private:
+    std::string             _cache_directory;
+
+    /* Last SPIR-V of every variant (path and defines) with hash it was compiled from - edited source replaces the entry,
+    *  so memory holds one binary per variant. Filled concurrently by compile().
+    */
+    struct Cached_Spirv {
+        uint64_t                hash = 0;
+        std::vector<uint32_t>   spirv {};
+    };
+    std::unordered_map<std::string, Cached_Spirv> _spirv;
+    std::mutex              _mutex;
+
+    static std::string          read_source(const std::string& path);
+    static shaderc_shader_kind  shader_kind(const std::string& path);
+    static uint64_t             variant_hash(const ShaderVariant& variant, const std::string& source);
+    static std::string          variant_key(const ShaderVariant& variant);
+
+    std::string             cache_path(uint64_t hash) const;
+    bool                    read_cache(uint64_t hash, std::vector<uint32_t>& spirv) const;
+    void                    write_cache(uint64_t hash, const std::vector<uint32_t>& spirv) const;
+
+    std::vector<uint32_t>   compile_variant(const ShaderVariant& variant, const std::string& source) const;
+};
\ No newline at end of file
@@ -0,0 +1,421 @@
+#include "ShaderReflection.h"
+
+#include <vulkan/spirv.hpp>
+
+/* Declaration and decorations of a single SPIR-V id. */
+struct Spirv_Id {
+    uint32_t        opcode          = 0;
+    const uint32_t* words           = nullptr;  /* Declaring instruction - words[0] holds opcode and word count */
+
+    uint32_t        set             = UINT32_MAX;
+    uint32_t        binding         = UINT32_MAX;
+    uint32_t        location        = UINT32_MAX;
+    uint32_t        array_stride    = 0;
+    bool            builtin         = false;
+    bool            buffer_block    = false;
+
+    /* Struct types only - indexed by member. */
+    std::vector<uint32_t>   member_offsets {};
+    std::vector<uint32_t>   member_matrix_strides {};
+};
+
+static void check_id(const std::vector<Spirv_Id>& ids, uint32_t id)
+{
+    if( id >= ids.size() || ids[id].words == nullptr )
+        throw std::runtime_error("Malformed SPIR-V - undeclared id " + std::to_string(id) + " :( \n");
+}
+
+static uint32_t constant_value(const std::vector<Spirv_Id>& ids, uint32_t id)
+{
+    check_id(ids, id);
+
+    if( ids[id].opcode != spv::OpConstant && ids[id].opcode != spv::OpSpecConstant )
+        throw std::runtime_error("Malformed SPIR-V - array length is not a constant :( \n");
+
+    /* Specialization constant sizes are reflected with their default value. */
+    return ids[id].words[3];
+}
+
+/* Size of type laid out by explicit offsets and strides - used for push constant blocks. */
+static uint32_t type_size(const std::vector<Spirv_Id>& ids, uint32_t id, uint32_t matrixStride = 0)
+{
+    check_id(ids, id);
+    const Spirv_Id& type = ids[id];
+
+    switch( type.opcode )
+    {
+    case spv::OpTypeBool:
+        return sizeof(uint32_t);
+
+    case spv::OpTypeInt:
+    case spv::OpTypeFloat:
+        return type.words[2] / 8;
+
+    case spv::OpTypeVector:
+        return type.words[3] * type_size(ids, type.words[2]);
+
+    case spv::OpTypeMatrix:
+        return type.words[3] * (matrixStride != 0 ? matrixStride : type_size(ids, type.words[2]));
+
+    case spv::OpTypeArray:
+    {
+        uint32_t stride = type.array_stride != 0 ? type.array_stride : type_size(ids, type.words[2]);
+        return constant_value(ids, type.words[3]) * stride;
+    }
+
+    case spv::OpTypeStruct:
+    {
+        uint32_t memberCount = (type.words[0] >> spv::WordCountShift) - 2;
+        uint32_t size = 0;
+
+        for( uint32_t member = 0; member < memberCount; member++ )
+        {
+            uint32_t offset = member < type.member_offsets.size() ? type.member_offsets[member] : 0;
+            uint32_t stride = member < type.member_matrix_strides.size() ? type.member_matrix_strides[member] : 0;
+
+            size = std::max(size, offset + type_size(ids, type.words[2 + member], stride));
+        }
+
+        return size;
+    }
+
+    default:
+        throw std::runtime_error("Unsupported type inside push constant block :( \n");
+    }
+}
+
+static VkDescriptorType descriptor_type(const std::vector<Spirv_Id>& ids, uint32_t typeId, uint32_t storageClass)
+{
+    check_id(ids, typeId);
+    const Spirv_Id& type = ids[typeId];
+
+    if( storageClass == spv::StorageClassStorageBuffer )
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+    /* SPIR-V 1.0 marks std430 buffers as BufferBlock inside Uniform storage class. */
+    if( storageClass == spv::StorageClassUniform )
+        return type.buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    switch( type.opcode )
+    {
+    case spv::OpTypeSampler:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+
+    case spv::OpTypeSampledImage:
+        return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    case spv::OpTypeImage:
+    {
+        uint32_t dim        = type.words[3];
+        bool     storage    = type.words[7] == 2;   /* Sampled operand: 1 - used with sampler, 2 - read/write image */
+
+        if( dim == spv::DimSubpassData )
+            return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        if( dim == spv::DimBuffer )
+            return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+
+        return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+
+    default:
+        throw std::runtime_error("Unsupported descriptor resource type :( \n");
+    }
+}
+
+static VkFormat input_format(const std::vector<Spirv_Id>& ids, uint32_t typeId)
+{
+    check_id(ids, typeId);
+
+    uint32_t componentCount = 1;
+    uint32_t componentId    = typeId;
+
+    if( ids[typeId].opcode == spv::OpTypeVector )
+    {
+        if( ids[typeId].words[3] > 4 )
+            throw std::runtime_error("Malformed SPIR-V - vector of more than 4 components :( \n");
+
+        componentCount  = ids[typeId].words[3];
+        componentId     = ids[typeId].words[2];
+        check_id(ids, componentId);
+    }
+
+    const Spirv_Id& component = ids[componentId];
+
+    if( component.opcode == spv::OpTypeFloat && component.words[2] == 32 )
+    {
+        static const VkFormat formats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+        return formats[componentCount - 1];
+    }
+
+    if( component.opcode == spv::OpTypeInt && component.words[2] == 32 )
+    {
+        static const VkFormat signedFormats[]   = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+        static const VkFormat unsignedFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+        return component.words[3] ? signedFormats[componentCount - 1] : unsignedFormats[componentCount - 1];
+    }
+
+    throw std::runtime_error("Unsupported vertex input type - only 32 bit scalars and vectors are handled :( \n");
+}
+
+static VkShaderStageFlagBits shader_stage(uint32_t executionModel)
+{
+    switch( executionModel )
+    {
+    case spv::ExecutionModelVertex:                 return VK_SHADER_STAGE_VERTEX_BIT;
+    case spv::ExecutionModelTessellationControl:    return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case spv::ExecutionModelTessellationEvaluation: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case spv::ExecutionModelGeometry:               return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case spv::ExecutionModelFragment:               return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case spv::ExecutionModelGLCompute:              return VK_SHADER_STAGE_COMPUTE_BIT;
+    default:
+        throw std::runtime_error("Unsupported shader execution model :( \n");
+    }
+}
+
+ShaderReflection reflect_spirv(const std::vector<uint32_t>& spirv)
+{
+    /* Header: magic number, version, generator, id bound, schema. */
+    if( spirv.size() < 5 || spirv[0] != spv::MagicNumber )
+        throw std::runtime_error("Malformed SPIR-V - invalid header :( \n");
+
+    std::vector<Spirv_Id>   ids(spirv[3]);
+    std::vector<uint32_t>   variables;
+    uint32_t                executionModel = UINT32_MAX;
+
+    /* Decorations precede declarations - both are collected first, resources are resolved afterwards. */
+    for( size_t offset = 5; offset < spirv.size(); )
+    {
+        const uint32_t* words   = &spirv[offset];
+        uint32_t wordCount      = words[0] >> spv::WordCountShift;
+        uint32_t opcode         = words[0] & spv::OpCodeMask;
+
+        if( wordCount == 0 || offset + wordCount > spirv.size() )
+            throw std::runtime_error("Malformed SPIR-V - truncated instruction :( \n");
+
+        /* Instruction operand holding id - checked against id bound from header. */
+        auto id = [&](uint32_t operand) -> Spirv_Id&
+        {
+            if( operand >= wordCount || words[operand] >= ids.size() )
+                throw std::runtime_error("Malformed SPIR-V - id out of bound :( \n");
+
+            return ids[words[operand]];
+        };
+
+        auto declare = [&](uint32_t operand)
+        {
+            Spirv_Id& declared = id(operand);
+            declared.opcode = opcode;
+            declared.words  = words;
+        };
+
+        switch( opcode )
+        {
+        case spv::OpEntryPoint:
+            if( executionModel != UINT32_MAX )
+                throw std::runtime_error("Reflection of modules with several entry points is not supported :( \n");
+            executionModel = words[1];
+            break;
+
+        case spv::OpDecorate:
+        {
+            Spirv_Id& target    = id(1);
+            uint32_t value      = wordCount > 3 ? words[3] : 0;
+
+            switch( words[2] )
+            {
+            case spv::DecorationDescriptorSet:  target.set          = value;    break;
+            case spv::DecorationBinding:        target.binding      = value;    break;
+            case spv::DecorationLocation:       target.location     = value;    break;
+            case spv::DecorationArrayStride:    target.array_stride = value;    break;
+            case spv::DecorationBuiltIn:        target.builtin      = true;     break;
+            case spv::DecorationBufferBlock:    target.buffer_block = true;     break;
+            default: break;
+            }
+            break;
+        }
+
+        case spv::OpMemberDecorate:
+        {
+            Spirv_Id& target    = id(1);
+            uint32_t member     = words[2];
+            uint32_t value      = wordCount > 4 ? words[4] : 0;
+
+            if( words[3] == spv::DecorationOffset )
+            {
+                target.member_offsets.resize(std::max<size_t>(target.member_offsets.size(), member + 1), 0);
+                target.member_offsets[member] = value;
+            }
+            else if( words[3] == spv::DecorationMatrixStride )
+            {
+                target.member_matrix_strides.resize(std::max<size_t>(target.member_matrix_strides.size(), member + 1), 0);
+                target.member_matrix_strides[member] = value;
+            }
+            break;
+        }
+
+        case spv::OpTypeBool:
+        case spv::OpTypeInt:
+        case spv::OpTypeFloat:
+        case spv::OpTypeVector:
+        case spv::OpTypeMatrix:
+        case spv::OpTypeImage:
+        case spv::OpTypeSampler:
+        case spv::OpTypeSampledImage:
+        case spv::OpTypeArray:
+        case spv::OpTypeRuntimeArray:
+        case spv::OpTypeStruct:
+        case spv::OpTypePointer:
+            declare(1);
+            break;
+
+        case spv::OpConstant:
+        case spv::OpSpecConstant:
+            declare(2);
+            break;
+
+        case spv::OpVariable:
+            declare(2);
+            variables.push_back(words[2]);
+            break;
+
+        default:
+            break;
+        }
+
+        offset += wordCount;
+    }
+
+    if( executionModel == UINT32_MAX )
+        throw std::runtime_error("Malformed SPIR-V - missing entry point :( \n");
+
+    ShaderReflection reflection;
+    reflection.stage = shader_stage(executionModel);
+
+    for( uint32_t variableId : variables )
+    {
+        const Spirv_Id& variable    = ids[variableId];
+        uint32_t storageClass       = variable.words[3];
+
+        /* Variable type is always a pointer to the declared type. */
+        check_id(ids, variable.words[1]);
+        uint32_t typeId = ids[variable.words[1]].words[3];
+        check_id(ids, typeId);
+
+        if( storageClass == spv::StorageClassPushConstant )
+        {
+            const Spirv_Id& block = ids[typeId];
+            uint32_t firstOffset = block.member_offsets.empty() ? 0 : *std::min_element(block.member_offsets.begin(), block.member_offsets.end());
+
+            VkPushConstantRange range = {};
+            range.stageFlags    = reflection.stage;
+            range.offset        = firstOffset;
+            range.size          = type_size(ids, typeId) - firstOffset;
+
+            reflection.layout.push_constants.push_back(range);
+        }
+        else if( storageClass == spv::StorageClassInput )
+        {
+            if( reflection.stage != VK_SHADER_STAGE_VERTEX_BIT || variable.builtin || variable.location == UINT32_MAX )
+                continue;
+
+            VkVertexInputAttributeDescription input = {};
+            input.location  = variable.location;
+            input.format    = input_format(ids, typeId);
+
+            reflection.inputs.push_back(input);
+        }
+        else if( storageClass == spv::StorageClassUniform || storageClass == spv::StorageClassUniformConstant ||
+                 storageClass == spv::StorageClassStorageBuffer )
+        {
+            if( variable.binding == UINT32_MAX )
+                continue;
+
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.binding         = variable.binding;
+            binding.descriptorCount = 1;
+            binding.stageFlags      = reflection.stage;
+
+            /* Array of descriptors - array of buffer blocks is declared as array of the block type. */
+            if( ids[typeId].opcode == spv::OpTypeArray )
+            {
+                binding.descriptorCount = constant_value(ids, ids[typeId].words[3]);
+                typeId = ids[typeId].words[2];
+            }
+            else if( ids[typeId].opcode == spv::OpTypeRuntimeArray )
+            {
+                throw std::runtime_error("Unsized descriptor arrays are not supported by reflection :( \n");
+            }
+
+            binding.descriptorType = descriptor_type(ids, typeId, storageClass);
+
+            uint32_t set = variable.set == UINT32_MAX ? 0 : variable.set;
+            if( reflection.layout.sets.size() <= set )
+                reflection.layout.sets.resize(set + 1);
+
+            reflection.layout.sets[set].push_back(binding);
+        }
+    }
+
+    for( auto& bindings : reflection.layout.sets )
+    {
+        std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+        {
+            return a.binding < b.binding;
+        });
+    }
+
+    std::sort(reflection.inputs.begin(), reflection.inputs.end(), [](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b)
+    {
+        return a.location < b.location;
+    });
+
+    return reflection;
+}
+
+void ShaderLayout::merge(const ShaderLayout& other)
+{
+    if( sets.size() < other.sets.size() )
+        sets.resize(other.sets.size());
+
+    for( size_t set = 0; set < other.sets.size(); set++ )
+    {
+        for( const auto& binding : other.sets[set] )
+        {
+            auto existing = std::find_if(sets[set].begin(), sets[set].end(), [&binding](const VkDescriptorSetLayoutBinding& b)
+            {
+                return b.binding == binding.binding;
+            });
+
+            if( existing == sets[set].end() )
+            {
+                sets[set].push_back(binding);
+                continue;
+            }
+
+            if( existing->descriptorType != binding.descriptorType || existing->descriptorCount != binding.descriptorCount )
+                throw std::runtime_error("Binding " + std::to_string(binding.binding) + " of set " + std::to_string(set) +
+                                         " is declared differently by pipeline stages :( \n");
+
+            existing->stageFlags |= binding.stageFlags;
+        }
+
+        std::sort(sets[set].begin(), sets[set].end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+        {
+            return a.binding < b.binding;
+        });
+    }
+
+    /* Stages reading the same block share its range. */
+    for( const auto& range : other.push_constants )
+    {
+        auto existing = std::find_if(push_constants.begin(), push_constants.end(), [&range](const VkPushConstantRange& r)
+        {
+            return r.offset == range.offset && r.size == range.size;
+        });
+
+        if( existing == push_constants.end() )
+            push_constants.push_back(range);
+        else
+            existing->stageFlags |= range.stageFlags;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "libs.h"
+
+/* Descriptor bindings of every set and push constant ranges - declared by a single stage or merged from all stages of a pipeline. */
+struct ShaderLayout {
+    /* Indexed by set number, bindings are sorted by binding number. Sets not used by any stage are empty. */
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>>  sets {};
+    std::vector<VkPushConstantRange>                        push_constants {};
+
+    /* Optional flags of bindings - indexed like 'sets', missing entries mean no flags. SPIR-V does not carry them,
+    *  host code sets them (update-after-bind or partially bound arrays) once all stages are merged.
+    */
+    std::vector<std::vector<VkDescriptorBindingFlagsEXT>>   binding_flags {};
+
+    /* Adds resources of another stage - binding declared by both stages gets combined stage flags.
+    *  Throws when the same binding is declared with different type or count.
+    */
+    void    merge(const ShaderLayout& other);
+};
+
+/* Interface of SPIR-V module. */
+struct ShaderReflection {
+    VkShaderStageFlagBits                           stage = VK_SHADER_STAGE_VERTEX_BIT;
+    ShaderLayout                                    layout {};
+
+    /* Vertex stage inputs sorted by location - only location and format are filled. Built-in inputs are skipped. */
+    std::vector<VkVertexInputAttributeDescription>  inputs {};
+};
+
+/* Reads descriptor bindings, push constant block and vertex inputs declared by module with single entry point.
+*  Throws when module is malformed or declares resource which cannot be mapped onto descriptor type.
+*/
+ShaderReflection reflect_spirv(const std::vector<uint32_t>& spirv);
\ No newline at end of file
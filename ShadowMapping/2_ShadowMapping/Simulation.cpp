@@ -5,6 +5,10 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+/* Texture Loader */
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
 /*
 * Callbacks Functionality.
 */
@@ -14,6 +18,13 @@ static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
     app->_framebufferResized = true;
 }
 
+/* LOD biases measured by benchmark mode, in order. */
+static const float BENCHMARK_LOD_BIASES[] = { -1.f, 0.f, 1.f, 2.f, 3.f, 4.f };
+
+/* Texture of every material - in order of material indices. */
+static const char* const MATERIAL_TEXTURE_PATHS[] = MATERIAL_TEXTURES;
+static const uint32_t MATERIAL_COUNT = static_cast<uint32_t>(std::size(MATERIAL_TEXTURE_PATHS));
+
 // ------------------------------------
 
 Simulation::Simulation( unsigned int windowWidth, unsigned int windowHeight, std::string windowName)
@@ -37,33 +48,193 @@ void Simulation::run()
     cleanup();
 }
 
+void Simulation::run_benchmark(uint32_t captureInterval)
+{
+    /* Camera stays in its initial position, so every bias renders the same view. */
+    _benchmark.enabled  = true;
+    _lod.bias           = BENCHMARK_LOD_BIASES[0];
+
+    /* Frames are captured from the first one - warm up frames included, sequence shows every step of the benchmark. */
+    if( captureInterval > 0 )
+    {
+        _capture.sequence_enabled   = _capture.capture != nullptr;
+        _capture.sequence_interval  = captureInterval;
+    }
+
+    /* Biases are compared at the same resolution - dynamic resolution would trade their cost for pixels. */
+    _resolution.enabled = false;
+
+    std::cout << "LOD benchmark: " << _instances.size() << " objects, " << BENCHMARK_FRAMES << " frames per bias\n";
+
+    main_loop();
+    cleanup();
+}
+
 void Simulation::init_vulkan()
 {
     create_instance();
     create_surface();
     pick_physical_device();
     create_logical_device();
+
+    /* Sample count of scene pass is known once device is - render passes are created with it. */
+    _scene_permutation.samples  = msaa_sample_count(MSAA_SAMPLES);
+    _msaa.requested_samples     = _scene_permutation.samples;
+    _scene_permutation.temporal_shadows = _taa.enabled ? VK_TRUE : VK_FALSE;
+
+    /* Images created with swap chain (TAA history) are transitioned by one-off command buffers. */
+    create_command_pool();
     create_swap_chain();
     create_image_views();
     create_scene_render_pass();
+    create_present_render_pass();
     create_offscreen_render_pass();
+    compile_shaders();
     create_descriptor_set_layout();
+    create_pipeline_cache();
     create_graphics_pipeline();
+    create_present_pipeline();
+    create_taa_history();
+    create_render_graph();
     create_depth_resources();
     create_scene_framebuffer();
     create_offscreen_framebuffer();
-    create_command_pool();
     create_depth_texture_sampler();
+    create_bindless_textures();
     load_model();
+    build_scene_objects();
+    build_scene_lights();
     create_vertex_buffer();
     create_index_buffer();
+    create_object_buffer();
+    create_mesh_buffer();
+    create_meshlet_buffer();
+    create_culling_pipeline();
+    create_hiz_pipeline();
+    create_meshlet_pipeline();
+    create_light_cluster_pipeline();
+    create_taa_pipeline();
+    create_exposure_pipeline();
     create_uniform_buffers();
-    create_descriptor_pool();
     create_descriptor_sets();
     create_command_buffers();
+    create_frame_capture();
     create_sync_objects();
 }
 
+void Simulation::compile_shaders()
+{
+    std::vector<ShaderDefine> cullDefines = {
+        { "VIEW_COUNT", std::to_string(CULL_VIEW_COUNT) },
+        { "MAX_LODS",   std::to_string(MESH_MAX_LODS) },
+    };
+
+    /* Bindless textures are used whenever device supports them - fragment shader declares the array only then. */
+    _bindless.enabled       = _device_support.descriptor_indexing;
+    _bindless.texture_count = _bindless.enabled ? _device_support.max_bindless_textures : 0;
+
+    std::vector<ShaderDefine> clusterDefines = {
+        { "CLUSTER_GRID_X", std::to_string(CLUSTER_GRID_X) },
+        { "CLUSTER_GRID_Y", std::to_string(CLUSTER_GRID_Y) },
+        { "CLUSTER_GRID_Z", std::to_string(CLUSTER_GRID_Z) },
+    };
+
+    std::vector<ShaderDefine> sceneFragDefines = {
+        { "BINDLESS_TEXTURES",      _bindless.enabled ? "1" : "0" },
+        { "BINDLESS_TEXTURE_COUNT", std::to_string(_bindless.texture_count) },
+        { "TEMPORAL_SHADOW_TAPS",   std::to_string(TEMPORAL_SHADOW_TAPS) },
+    };
+    sceneFragDefines.insert(sceneFragDefines.end(), clusterDefines.begin(), clusterDefines.end());
+
+    _shader_variants.scene_vert     = { VERT_SHADER };
+    _shader_variants.scene_frag     = { FRAG_SHADER, sceneFragDefines };
+    _shader_variants.offscreen_vert = { OFFSCREEN_VERT_SHADER };
+    _shader_variants.prepass_vert   = { PREPASS_VERT_SHADER };
+    _shader_variants.cull_comp      = { CULL_COMP_SHADER, cullDefines };
+    _shader_variants.hiz_comp       = { HIZ_COMP_SHADER, { { "HIZ_GROUP_SIZE", std::to_string(HIZ_GROUP_SIZE) }, { "MULTISAMPLED_SOURCE", "0" } } };
+    _shader_variants.hiz_resolve_comp = { HIZ_COMP_SHADER, { { "HIZ_GROUP_SIZE", std::to_string(HIZ_GROUP_SIZE) }, { "MULTISAMPLED_SOURCE", "1" } } };
+    _shader_variants.meshlet_comp   = { MESHLET_COMP_SHADER, cullDefines };
+    _shader_variants.cluster_comp   = { CLUSTER_COMP_SHADER, clusterDefines };
+    _shader_variants.taa_comp       = { TAA_COMP_SHADER, { { "TAA_GROUP_SIZE", std::to_string(TAA_GROUP_SIZE) } } };
+    _shader_variants.fullscreen_vert = { FULLSCREEN_VERT_SHADER };
+    _shader_variants.present_frag   = { PRESENT_FRAG_SHADER, { { "EXPOSURE_BINS", std::to_string(EXPOSURE_GROUP_SIZE * EXPOSURE_GROUP_SIZE) } } };
+    _shader_variants.exposure_comp  = { EXPOSURE_COMP_SHADER, {
+        { "EXPOSURE_GROUP_SIZE",        std::to_string(EXPOSURE_GROUP_SIZE) },
+        { "EXPOSURE_PIXELS_PER_THREAD", std::to_string(EXPOSURE_PIXELS_PER_THREAD) },
+    } };
+
+    _shader_variants.cull_comp.defines.push_back({ "CULL_GROUP_SIZE", std::to_string(CULL_GROUP_SIZE) });
+    _shader_variants.meshlet_comp.defines.push_back({ "MESHLET_GROUP_SIZE", std::to_string(MESHLET_GROUP_SIZE) });
+    _shader_variants.cluster_comp.defines.push_back({ "CLUSTER_GROUP_SIZE", std::to_string(CLUSTER_GROUP_SIZE) });
+    _shader_variants.cluster_comp.defines.push_back({ "CLUSTER_MAX_LIGHTS", std::to_string(CLUSTER_MAX_LIGHTS) });
+
+    /* Variants missing from the cache are compiled in parallel - pipeline creation then only reads them. */
+    _shaders.compile({
+        _shader_variants.scene_vert,
+        _shader_variants.scene_frag,
+        _shader_variants.offscreen_vert,
+        _shader_variants.prepass_vert,
+        _shader_variants.cull_comp,
+        _shader_variants.hiz_comp,
+        _shader_variants.hiz_resolve_comp,
+        _shader_variants.meshlet_comp,
+        _shader_variants.cluster_comp,
+        _shader_variants.taa_comp,
+        _shader_variants.fullscreen_vert,
+        _shader_variants.present_frag,
+        _shader_variants.exposure_comp,
+    });
+
+    /* Sources edited from now on are picked up by update_hot_reload(). */
+    _hot_reload.watcher = std::make_unique<FileWatcher>(SHADER_DIR);
+}
+
+void Simulation::create_pipeline_cache()
+{
+    /* Data of previous run - driver ignores it if it was saved by another device or driver version. */
+    std::vector<char> cacheData;
+    std::ifstream file(PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary);
+
+    if( file.is_open() )
+    {
+        cacheData.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(cacheData.data(), cacheData.size());
+
+        if( !file )
+            cacheData.clear();
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize   = cacheData.size();
+    cacheInfo.pInitialData      = cacheData.data();
+
+    if( vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_pipeline_cache) == VK_SUCCESS )
+        return;
+
+    /* Corrupted data - start with empty cache. */
+    cacheInfo.initialDataSize   = 0;
+    cacheInfo.pInitialData      = nullptr;
+
+    if( vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_pipeline_cache) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create pipeline cache! :( \n");
+}
+
+void Simulation::save_pipeline_cache()
+{
+    size_t dataSize = 0;
+    if( vkGetPipelineCacheData(_device, _pipeline_cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0 )
+        return;
+
+    std::vector<char> cacheData(dataSize);
+    if( vkGetPipelineCacheData(_device, _pipeline_cache, &dataSize, cacheData.data()) != VK_SUCCESS )
+        return;
+
+    std::ofstream file(PIPELINE_CACHE_PATH, std::ios::binary | std::ios::trunc);
+    file.write(cacheData.data(), dataSize);
+}
+
 void Simulation::create_instance()
 {
     if (enableValidationLayers && !check_validatio_layer_support())
@@ -75,7 +246,7 @@ void Simulation::create_instance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "eMKEngine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_1;    /* Extended device features and properties are queried through core 1.1 functions. */
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -135,6 +306,10 @@ void Simulation::create_logical_device()
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
+    _device_support.async_compute = indices.computeFamily.has_value();
+    if( _device_support.async_compute )
+        uniqueQueueFamilies.insert(indices.computeFamily.value());
+
     float queuePriority = 1.0f;
 
     for( uint32_t queueFamily : uniqueQueueFamilies )
@@ -147,14 +322,95 @@ void Simulation::create_logical_device()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(_physical_device, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy    = VK_TRUE;
+    deviceFeatures.sampleRateShading    = supportedFeatures.sampleRateShading;  /* Optional - sample shading of MSAA is unavailable without it. */
+    deviceFeatures.multiDrawIndirect    = VK_TRUE;     /* Many indirect draws recorded with single command. */
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE; /* firstInstance of indirect draw carries object index. */
+
+    /* Draw count read from GPU buffer is optional - without it we draw maximum number of (zeroed) commands. */
+    if( is_device_extension_available(_physical_device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) )
+    {
+        device_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        _device_support.draw_indirect_count = true;
+    }
+
+    /* Present times are optional - without them latency is measured up to GPU completion of the frame. */
+    if( is_device_extension_available(_physical_device, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) )
+    {
+        device_extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+        _device_support.display_timing = true;
+    }
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(_physical_device, &deviceProperties);
+    _device_support.max_draw_indirect_count = deviceProperties.limits.maxDrawIndirectCount;
+    _device_support.timestamp_period        = deviceProperties.limits.timestampComputeAndGraphics ? deviceProperties.limits.timestampPeriod : 0.f;
+    _device_support.sample_rate_shading     = supportedFeatures.sampleRateShading == VK_TRUE;
+
+    /* Scene depth is both multisampled attachment and sampled image of Hi-Z reduction. */
+    _device_support.msaa_sample_counts = deviceProperties.limits.framebufferColorSampleCounts &
+                                         deviceProperties.limits.framebufferDepthSampleCounts &
+                                         deviceProperties.limits.sampledImageDepthSampleCounts;
+
+    /* Bindless textures are optional - array of sampled images has to be indexed non-uniformly, written partially and updated after bind. */
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    if( deviceProperties.apiVersion >= VK_API_VERSION_1_1 && is_device_extension_available(_physical_device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) )
+    {
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &indexingFeatures;
+        vkGetPhysicalDeviceFeatures2(_physical_device, &features);
+
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+        VkPhysicalDeviceProperties2 properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(_physical_device, &properties);
+
+        /* Every texture is a combined image sampler - counted both as sampled image and as sampler. */
+        _device_support.max_bindless_textures = std::min({
+            static_cast<uint32_t>(MAX_BINDLESS_TEXTURES),
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+        });
+
+        _device_support.descriptor_indexing =
+            indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+            indexingFeatures.descriptorBindingPartiallyBound &&
+            _device_support.max_bindless_textures >= MATERIAL_COUNT;
+    }
+
+    /* Only features used by bindless textures are enabled. */
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexingFeatures = {};
+    enabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    if( _device_support.descriptor_indexing )
+    {
+        device_extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);    /* Required by descriptor indexing */
+        device_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+        enabledIndexingFeatures.shaderSampledImageArrayNonUniformIndexing       = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind    = VK_TRUE;
+        enabledIndexingFeatures.descriptorBindingPartiallyBound                 = VK_TRUE;
+    }
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pEnabledFeatures = &deviceFeatures;
+    createInfo.pNext = _device_support.descriptor_indexing ? &enabledIndexingFeatures : nullptr;
 
     createInfo.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
     createInfo.ppEnabledExtensionNames = device_extensions.data();
@@ -176,6 +432,31 @@ void Simulation::create_logical_device()
 
     vkGetDeviceQueue(_device, indices.graphicsFamily.value(), 0, &_queues.graphics_queue);
     vkGetDeviceQueue(_device, indices.presentFamily.value(), 0, &_queues.present_queue);
+
+    _queues.graphics_family = indices.graphicsFamily.value();
+    _queues.compute_family  = _device_support.async_compute ? indices.computeFamily.value() : indices.graphicsFamily.value();
+    vkGetDeviceQueue(_device, _queues.compute_family, 0, &_queues.compute_queue);
+
+    _layouts = std::make_unique<LayoutCache>(_device);
+    _descriptors = std::make_unique<DescriptorAllocator>(_device);
+
+    if( _device_support.draw_indirect_count )
+    {
+        _vkCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirectCountKHR"));
+
+        if( _vkCmdDrawIndexedIndirectCount == nullptr )
+            _device_support.draw_indirect_count = false;
+    }
+
+    if( _device_support.display_timing )
+    {
+        _vkGetPastPresentationTiming = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(
+            vkGetDeviceProcAddr(_device, "vkGetPastPresentationTimingGOOGLE"));
+
+        if( _vkGetPastPresentationTiming == nullptr )
+            _device_support.display_timing = false;
+    }
 }
 
 bool Simulation::check_device_extension_support(VkPhysicalDevice device)
@@ -197,6 +478,23 @@ bool Simulation::check_device_extension_support(VkPhysicalDevice device)
     return requiredExtension.empty();
 }
 
+bool Simulation::is_device_extension_available(VkPhysicalDevice device, const char* extensionName)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties( device, nullptr, &extensionCount, availableExtensions.data());
+
+    for( const auto& extension : availableExtensions )
+    {
+        if( strcmp(extension.extensionName, extensionName) == 0 )
+            return true;
+    }
+
+    return false;
+}
+
 void Simulation::create_swap_chain()
 {
     SwapChainSupportDetails swapChainSupport = query_swap_chain_support(_physical_device);
@@ -222,6 +520,11 @@ void Simulation::create_swap_chain()
     createInfo.imageArrayLayers = 1;    /* Specified number of layers that image is consist of. */
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+    /* Frame capture copies the presented images - it is not available if the surface does not allow that. */
+    _swap_chain.transfer_source = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if( _swap_chain.transfer_source )
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
     /*
      * We'll be drawing on the images in the swap chain 
      * from the graphics queue and then submitting them on the presentation queue. 
@@ -274,6 +577,11 @@ void Simulation::create_swap_chain()
 
     _swap_chain.swap_chain_image_format = surfaceFormat.format;
     _swap_chain.swap_chain_extent = extent;
+    _swap_chain.present_mode    = presentMode;
+    _swap_chain.present_modes   = swapChainSupport.presentModes;
+
+    /* Request falls back to the mode actually used - unsupported one is not requested again by every frame. */
+    _frame_pacing.requested_present_mode = presentMode;
 }
 
 void Simulation::create_image_views()
@@ -289,16 +597,21 @@ void Simulation::create_image_views()
 
 void Simulation::create_scene_render_pass()
 {
+    /* With MSAA color, velocity and depth are multisampled, color and velocity are resolved into single sampled images. */
+    VkSampleCountFlagBits samples   = _scene_permutation.samples;
+    bool multisampled               = samples != VK_SAMPLE_COUNT_1_BIT;
+
     /* COLOR ATTACHMENT */
     VkAttachmentDescription colorAttachment {};
-    colorAttachment.format  = _swap_chain.swap_chain_image_format;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.format  = SCENE_COLOR_FORMAT;
+    colorAttachment.samples = samples;
     colorAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;  // Clear data in attachment before rendering.
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Store rendered contents in memory, so it can be read later.
     colorAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    /* Layouts are transitioned by render graph barriers, render pass keeps them. */
+    colorAttachment.initialLayout   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef = {};
     colorAttachmentRef.attachment   = 0;
@@ -307,102 +620,226 @@ void Simulation::create_scene_render_pass()
     /* DEPTH ATTACHMENT */
     VkAttachmentDescription depthAttachment = {};
     depthAttachment.format  = DEPTH_FORMAT;//findDepthFormat();
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.samples = samples;
     depthAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;      /* Clear data in attachment before rendering. */
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; /* Do not store depth data for now. */
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;     /* Depth of occluders is reduced into Hi-Z pyramid. */
     depthAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.initialLayout   = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     depthAttachment.finalLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     
     VkAttachmentReference depthAttachmentRef = {};
     depthAttachmentRef.attachment   = 1;
     depthAttachmentRef.layout       = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    /* VELOCITY ATTACHMENT - screen-space motion of every pixel, read by temporal anti-aliasing. */
+    VkAttachmentDescription velocityAttachment = colorAttachment;
+    velocityAttachment.format   = VELOCITY_FORMAT;
+
+    VkAttachmentReference velocityAttachmentRef = {};
+    velocityAttachmentRef.attachment    = 2;
+    velocityAttachmentRef.layout        = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    /* RESOLVE ATTACHMENTS - single sampled color and velocity, written by resolve of multisampled ones at the end of the subpass. */
+    VkAttachmentDescription resolveAttachment = {};
+    resolveAttachment.format  = SCENE_COLOR_FORMAT;
+    resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    resolveAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;   /* Every pixel is overwritten by resolve */
+    resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    resolveAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolveAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    resolveAttachment.initialLayout   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    resolveAttachment.finalLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription velocityResolveAttachment = resolveAttachment;
+    velocityResolveAttachment.format    = VELOCITY_FORMAT;
+
+    std::array<VkAttachmentReference, 2> colorAttachmentRefs = { colorAttachmentRef, velocityAttachmentRef };
+    std::array<VkAttachmentReference, 2> resolveAttachmentRefs = {{
+        { 3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+        { 4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+    }};
     
     /* Define subpass attachments */
     VkSubpassDescription subpass    = {};
     subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount    = 1;
-    subpass.pColorAttachments       = &colorAttachmentRef;
+    subpass.colorAttachmentCount    = static_cast<uint32_t>(colorAttachmentRefs.size());
+    subpass.pColorAttachments       = colorAttachmentRefs.data();
+    subpass.pResolveAttachments     = multisampled ? resolveAttachmentRefs.data() : nullptr;
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-    /* Subpass dependencies */
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass   = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass   = 0;                    // Refers to our subpass, which is one and only one subpass here.
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstStageMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    /* No subpass dependencies - render graph synchronizes the pass with work before and after it. */
 
-    /* Render pass consist of two attachment- color and depth. */
-    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+    /* Render pass consist of three attachments- color, depth and velocity, with MSAA two more are resolve targets. */
+    std::array<VkAttachmentDescription, 5> attachments = {colorAttachment, depthAttachment, velocityAttachment, resolveAttachment, velocityResolveAttachment};
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType        = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount  = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.attachmentCount  = multisampled ? 5 : 3;
     renderPassInfo.pAttachments     = attachments.data();
     renderPassInfo.subpassCount     = 1;
     renderPassInfo.pSubpasses       = &subpass;
-    renderPassInfo.dependencyCount  = 1;
-    renderPassInfo.pDependencies    = &dependency;
 
     if( vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_scene_pass.render_pass) != VK_SUCCESS )
     {
         throw std::runtime_error("Failed to create render pass. :( \n");
     }
+
+    /* LATE RENDER PASS - continues drawing into attachments left by the first pass, after depth pyramid is built.
+    *  Multisampled color and velocity are not needed after the last pass - resolves of the early pass are overwritten by the late one.
+    */
+    attachments[0].loadOp           = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].storeOp          = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[1].loadOp           = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].storeOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[2].loadOp           = attachments[0].loadOp;
+    attachments[2].storeOp          = attachments[0].storeOp;
+
+    if( vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_scene_pass.late_render_pass) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create late render pass. :( \n");
+
+    /* SHADING RENDER PASS - follows depth pre-pass, which has laid down depth of both phases already. */
+    attachments[0].loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[2].loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
+
+    if( vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_scene_pass.shading_render_pass) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create shading render pass. :( \n");
+
+    /* DEPTH PRE-PASS - depth attachment only, compatible with pre-pass pipeline which draws into it. */
+    attachments[1].loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp          = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachmentRef.attachment   = 0;
+
+    subpass.colorAttachmentCount    = 0;
+    subpass.pColorAttachments       = nullptr;
+    subpass.pResolveAttachments     = nullptr;
+
+    renderPassInfo.attachmentCount  = 1;
+    renderPassInfo.pAttachments     = &attachments[1];
+
+    if( vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_depth_prepass.render_pass) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create depth pre-pass render pass. :( \n");
+
+    attachments[1].loadOp           = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+    if( vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_depth_prepass.late_render_pass) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create late depth pre-pass render pass. :( \n");
+}
+
+void Simulation::create_present_render_pass()
+{
+    /* Present pass draws the final frame into swap chain image - every pixel is overwritten, previous contents are not loaded. */
+    VkAttachmentDescription colorAttachment {};
+    colorAttachment.format  = _swap_chain.swap_chain_image_format;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    /* Transitioned to present layout by render graph */
+    colorAttachment.initialLayout   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef = {};
+    colorAttachmentRef.attachment   = 0;
+    colorAttachmentRef.layout       = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass    = {};
+    subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount    = 1;
+    subpass.pColorAttachments       = &colorAttachmentRef;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType        = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount  = 1;
+    renderPassInfo.pAttachments     = &colorAttachment;
+    renderPassInfo.subpassCount     = 1;
+    renderPassInfo.pSubpasses       = &subpass;
+
+    if( vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_present_pass.render_pass) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create present render pass. :( \n");
 }
 
 void Simulation::create_descriptor_set_layout()
 {
-    /* Binding to UniformBufferObject structure. */
-    VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-    uboLayoutBinding.binding    = 0;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;   /* Descriptor will be referenced in vertex shader stage. */
-    uboLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.descriptorCount    = 1;
-    uboLayoutBinding.pImmutableSamplers = nullptr;
-
-    /* Binding to texture image sampler. */
-    VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-    samplerLayoutBinding.binding    = 1;
-    samplerLayoutBinding.descriptorCount    = 1;
-    samplerLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-    samplerLayoutBinding.stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;  /* Descriptor will be referenced in fragment shader stage. */
-
-    /* Layout info describing all of the bindings. */
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
-    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-    layoutInfo.sType    = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-    layoutInfo.pBindings    = bindings.data();
-
-    if( vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_descriptor_set_layout) != VK_SUCCESS )
-        throw std::runtime_error("Failed to create Descriptor Set Layout. :( \n");
+    /* Bindings: uniform buffer (0), shadow map (1), per-object data (2), visible instance ids (3) - reflected from shaders. */
+    ShaderLayout layout = graphics_layout();
+    _descriptor_set_layout = _layouts->set_layout(layout.sets.at(0));
+
+    /* Set 1: bindless texture array (0). */
+    if( _bindless.enabled )
+        _bindless.descriptor_set_layout = _layouts->set_layout(layout.sets.at(1), layout.binding_flags.at(1));
 }
 
 void Simulation::create_graphics_pipeline()
 {
-    VkShaderModule vertShaderModule = creates_shader_module(read_file(VERT_SHADER));
-    VkShaderModule fragShaderModule = creates_shader_module(read_file(FRAG_SHADER));
+    /* Pipeline Layout - scene and offscreen pass bind the same descriptor sets, so both get the same interned layout. */
+    ShaderLayout layout = graphics_layout();
+
+    _pipeline_layouts.scene     = _layouts->pipeline_layout(layout);
+    _pipeline_layouts.offscreen = _layouts->pipeline_layout(layout);
+
+    /* Scene pipelines of other permutations are created once they are selected. */
+    build_graphics_pipelines(_scene_permutation, _pipelines.scene, &_pipelines.offscreen, &_pipelines.prepass);
+    _pipelines.scene_permutations[_scene_permutation] = _pipelines.scene;
+}
+
+void Simulation::build_graphics_pipelines(const Scene_Permutation& permutation, VkPipeline& scenePipeline, VkPipeline* offscreenPipeline,
+    VkPipeline* prepassPipeline)
+{
+    /* SPIR-V of all stages is obtained first - compilation error does not leave shader modules behind. */
+    std::vector<uint32_t> vertCode          = _shaders.get_spirv(_shader_variants.scene_vert);
+    std::vector<uint32_t> fragCode          = _shaders.get_spirv(_shader_variants.scene_frag);
+    std::vector<uint32_t> offscreenVertCode;
+    std::vector<uint32_t> prepassVertCode;
+
+    if( offscreenPipeline != nullptr )
+        offscreenVertCode = _shaders.get_spirv(_shader_variants.offscreen_vert);
+    if( prepassPipeline != nullptr )
+        prepassVertCode = _shaders.get_spirv(_shader_variants.prepass_vert);
+
+    /* Pipeline layouts are created once - edited shaders have to keep the interface they were created from. */
+    if( _layouts->pipeline_layout(graphics_layout()) != _pipeline_layouts.scene )
+        throw std::runtime_error("Descriptor bindings of scene shaders have changed - restart is required :( \n");
+
+    VkShaderModule vertShaderModule = creates_shader_module(vertCode);
+    VkShaderModule fragShaderModule = creates_shader_module(fragCode);
+
+    /* Permutation is passed to both stages - each one uses only constant ids it declares. */
+    std::array<VkSpecializationMapEntry, 5> specializationEntries = {{
+        { 0, offsetof(Scene_Permutation, shadow_filter_radius), sizeof(permutation.shadow_filter_radius) },
+        { 1, offsetof(Scene_Permutation, lighting_model),       sizeof(permutation.lighting_model) },
+        { 2, offsetof(Scene_Permutation, ambient),              sizeof(permutation.ambient) },
+        { 3, offsetof(Scene_Permutation, vertex_colors),        sizeof(permutation.vertex_colors) },
+        { 4, offsetof(Scene_Permutation, temporal_shadows),     sizeof(permutation.temporal_shadows) },
+    }};
+
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount    = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries      = specializationEntries.data();
+    specializationInfo.dataSize         = sizeof(Scene_Permutation);
+    specializationInfo.pData            = &permutation;
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertShaderStageInfo.module = vertShaderModule;
     vertShaderStageInfo.pName = "main";
+    vertShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
     VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
     fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-    /* Vertex Input */
+    /* Vertex Input - only attributes declared by vertex shader are fetched. */
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
     
     auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    auto attributeDescriptions = vertex_attributes(reflect_spirv(vertCode));
 
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputInfo.vertexBindingDescriptionCount   = 1;
@@ -456,9 +893,9 @@ void Simulation::create_graphics_pipeline()
     /* Multisampling */
     VkPipelineMultisampleStateCreateInfo multisampling = {};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable   = VK_FALSE;
-    multisampling.rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT;
-    multisampling.minSampleShading      = 1.f;      // Optional
+    multisampling.sampleShadingEnable   = (permutation.min_sample_shading > 0.f) ? VK_TRUE : VK_FALSE;   /* Shades more than one sample of a pixel - edges inside triangles are antialiased too */
+    multisampling.rasterizationSamples  = permutation.samples;
+    multisampling.minSampleShading      = permutation.min_sample_shading;
     multisampling.pSampleMask           = nullptr;  //Optional
     multisampling.alphaToCoverageEnable = VK_FALSE;
     multisampling.alphaToOneEnable      = VK_FALSE;
@@ -476,6 +913,13 @@ void Simulation::create_graphics_pipeline()
     depthStencil.front  = {};                   /* Optional due to stencil test disable. */
     depthStencil.back   = {};                   /* Optional due to stencil test disable. */
 
+    /* After depth pre-pass only the front-most fragment of every pixel passes - depth buffer is complete already. */
+    if( permutation.depth_prepass )
+    {
+        depthStencil.depthWriteEnable   = VK_FALSE;
+        depthStencil.depthCompareOp     = VK_COMPARE_OP_EQUAL;
+    }
+
 
     /* Color blending */
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
@@ -489,12 +933,15 @@ void Simulation::create_graphics_pipeline()
     colorBlendAttachment.dstAlphaBlendFactor  = VK_BLEND_FACTOR_ZERO;
     colorBlendAttachment.alphaBlendOp         = VK_BLEND_OP_ADD;
 
+    /* Color and velocity - neither of them is blended */
+    std::array<VkPipelineColorBlendAttachmentState, 2> colorBlendAttachments = { colorBlendAttachment, colorBlendAttachment };
+
     VkPipelineColorBlendStateCreateInfo colorBlending = {};
     colorBlending.sType  = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable   = VK_FALSE;
     colorBlending.logicOp         = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments    = &colorBlendAttachment;
+    colorBlending.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+    colorBlending.pAttachments    = colorBlendAttachments.data();
     colorBlending.blendConstants[0]  = 0.f;   // Optional
     colorBlending.blendConstants[1]  = 0.f;   // Optional
     colorBlending.blendConstants[2]  = 0.f;   // Optional
@@ -513,21 +960,17 @@ void Simulation::create_graphics_pipeline()
     dynamicState.dynamicStateCount   = static_cast<uint32_t>(dynamicStates->size());
     dynamicState.pDynamicStates      = dynamicStates->data();
 
-    /* Pipeline Layout */
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount         = 1;                          // One layout - Uniform Buffer Object bound to 0 position.
-    pipelineLayoutInfo.pSetLayouts            = &_descriptor_set_layout; // Pointer to descriptor set layout which bound all of the descriptors.
-    pipelineLayoutInfo.pushConstantRangeCount = 0;        // Optional
-    pipelineLayoutInfo.pPushConstantRanges    = nullptr;  // Optional
-   
-    if( vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_pipeline_layouts.scene) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create pipeline layout! :(\n");
+    /* Scene is rendered into a part of its attachments sized by dynamic resolution - viewport and scissor are set by command buffer. */
+    std::array<VkDynamicState, 2> sceneDynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo sceneDynamicState = {};
+    sceneDynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    sceneDynamicState.dynamicStateCount = static_cast<uint32_t>(sceneDynamicStates.size());
+    sceneDynamicState.pDynamicStates    = sceneDynamicStates.data();
 
-    /* Create pipeline layout for offscreen render pass. */
-    if( vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_pipeline_layouts.offscreen) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create pipeline layout! :(\n");
-    
     /* Combine structures to create pipeline */
     VkGraphicsPipelineCreateInfo pipelineInfo = {};
     pipelineInfo.sType      = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -540,7 +983,7 @@ void Simulation::create_graphics_pipeline()
     pipelineInfo.pMultisampleState      = &multisampling;
     pipelineInfo.pDepthStencilState     = &depthStencil;
     pipelineInfo.pColorBlendState       = &colorBlending;
-    pipelineInfo.pDynamicState          = nullptr;
+    pipelineInfo.pDynamicState          = &sceneDynamicState;
     
     pipelineInfo.layout                 = _pipeline_layouts.scene;
     pipelineInfo.renderPass             = _scene_pass.render_pass;
@@ -550,56 +993,316 @@ void Simulation::create_graphics_pipeline()
     pipelineInfo.basePipelineHandle     = VK_NULL_HANDLE;   // Optional
     pipelineInfo.basePipelineIndex      = -1;               // Optional
 
-    if( vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_pipelines.scene) != VK_SUCCESS)
+    if( vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipelineInfo, nullptr, &scenePipeline) != VK_SUCCESS)
         throw std::runtime_error("Failed to create Graphics Pipeline! :( \n");
 
+    vkDestroyShaderModule(_device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(_device, vertShaderModule, nullptr);
+
+    if( offscreenPipeline == nullptr )
+        return;
+
     /* Offscreen Pipeline - vertex shader only */
-    vertShaderStageInfo.module = creates_shader_module(read_file(OFFSCREEN_VERT_SHADER));
+    vertShaderStageInfo.module = creates_shader_module(offscreenVertCode);
+    vertShaderStageInfo.pSpecializationInfo = nullptr;
     shaderStages[0] = vertShaderStageInfo;
 
+    /* Depth only - position is the only attribute of offscreen vertex shader. */
+    auto offscreenAttributeDescriptions = vertex_attributes(reflect_spirv(offscreenVertCode));
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(offscreenAttributeDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions    = offscreenAttributeDescriptions.data();
+
     pipelineInfo.stageCount = 1;
     // No blend attachment states (no color attachments used)
     colorBlending.attachmentCount = 0;
     // Cull front faces
+    depthStencil.depthWriteEnable = VK_TRUE;
     depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
     // Enable depth bias
     rasterizer.depthBiasEnable = VK_TRUE;
-
+    // Shadow map is single sampled
+    multisampling.rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.sampleShadingEnable   = VK_FALSE;
+
     // Add depth bias to dynamic state, so we can change it at runtime
     pipelineInfo.pDynamicState = &dynamicState;
     
     pipelineInfo.layout     = _pipeline_layouts.offscreen;
     pipelineInfo.renderPass = _offscreen_pass.render_pass;
 
-    if( vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_pipelines.offscreen) != VK_SUCCESS)
+    if( vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipelineInfo, nullptr, offscreenPipeline) != VK_SUCCESS)
         throw std::runtime_error("Failed to create Graphics Pipeline- offscreen render pass! :( \n");
 
     /* Tidy up unused objects */
+    vkDestroyShaderModule(_device, vertShaderStageInfo.module, nullptr);
+
+    /* Depth pre-pass pipeline - the same depth only state with samples of scene pass. Scene pass tests its depth for equality, so no bias
+    *  and own vertex shader, which computes position with the uniform block and expression of scene vertex shader.
+    */
+    if( prepassPipeline != nullptr )
+    {
+        vertShaderStageInfo.module = creates_shader_module(prepassVertCode);
+        shaderStages[0] = vertShaderStageInfo;
+
+        auto prepassAttributeDescriptions = vertex_attributes(reflect_spirv(prepassVertCode));
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(prepassAttributeDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions    = prepassAttributeDescriptions.data();
+
+        rasterizer.depthBiasEnable          = VK_FALSE;
+        multisampling.rasterizationSamples  = permutation.samples;
+        pipelineInfo.renderPass             = _depth_prepass.render_pass;
+
+        VkResult result = vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipelineInfo, nullptr, prepassPipeline);
+        vkDestroyShaderModule(_device, vertShaderStageInfo.module, nullptr);
+
+        if( result != VK_SUCCESS )
+            throw std::runtime_error("Failed to create Graphics Pipeline- depth pre-pass! :( \n");
+    }
+}
+
+ShaderLayout Simulation::reflect_layout(const std::vector<ShaderVariant>& variants)
+{
+    ShaderLayout layout;
+
+    for( const auto& variant : variants )
+        layout.merge(reflect_spirv(_shaders.get_spirv(variant)).layout);
+
+    return layout;
+}
+
+ShaderLayout Simulation::graphics_layout()
+{
+    /* Descriptor sets are shared by scene, offscreen and depth pre-pass - layout covers stages of all three pipelines. */
+    ShaderLayout layout = reflect_layout({ _shader_variants.scene_vert, _shader_variants.scene_frag, _shader_variants.offscreen_vert,
+        _shader_variants.prepass_vert });
+
+    /* Only textures of existing materials are written, the rest of the array stays empty. Update after bind lets
+    *  textures be written while command buffers binding the set are pending.
+    */
+    if( _bindless.enabled )
+    {
+        layout.binding_flags.resize(layout.sets.size());
+        layout.binding_flags.at(1) = { VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT };
+    }
+
+    return layout;
+}
+
+std::vector<VkVertexInputAttributeDescription> Simulation::vertex_attributes(const ShaderReflection& vertexShader)
+{
+    auto available = Vertex::getAttributeDescriptions();
+    std::vector<VkVertexInputAttributeDescription> attributes;
+
+    for( const auto& input : vertexShader.inputs )
+    {
+        auto attribute = std::find_if(available.begin(), available.end(), [&input](const VkVertexInputAttributeDescription& a)
+        {
+            return a.location == input.location;
+        });
+
+        if( attribute == available.end() || attribute->format != input.format )
+            throw std::runtime_error("Vertex shader input at location " + std::to_string(input.location) + " does not match Vertex structure :( \n");
+
+        attributes.push_back(*attribute);
+    }
+
+    return attributes;
+}
+
+VkPipeline Simulation::scene_pipeline(const Scene_Permutation& permutation)
+{
+    auto cached = _pipelines.scene_permutations.find(permutation);
+    if( cached != _pipelines.scene_permutations.end() )
+        return cached->second;
+
+    VkPipeline pipeline;
+    build_graphics_pipelines(permutation, pipeline);
+
+    _pipelines.scene_permutations[permutation] = pipeline;
+
+    return pipeline;
+}
+
+void Simulation::select_scene_permutation(const Scene_Permutation& permutation)
+{
+    try
+    {
+        _pipelines.scene = scene_pipeline(permutation);
+    }
+    catch( const std::exception& error )
+    {
+        /* Source may be broken by an edit - selected permutation stays active. */
+        std::cerr << error.what();
+        return;
+    }
+
+    _scene_permutation = permutation;
+
+    /* Pipeline of previous permutation stays cached - command buffers are re-recorded once their images are free. */
+    _hot_reload.generation++;
+}
+
+void Simulation::create_present_pipeline()
+{
+    /* Bindings: frame to present (0), exposure (1) - reflected from shaders. */
+    ShaderLayout layout = reflect_layout({ _shader_variants.fullscreen_vert, _shader_variants.present_frag });
+
+    _present_pass.descriptor_set_layout = _layouts->set_layout(layout.sets.at(0));
+    _present_pass.pipeline_layout       = _layouts->pipeline_layout(layout);
+    _present_pass.pipeline              = build_present_pipeline();
+}
+
+VkPipeline Simulation::build_present_pipeline()
+{
+    std::vector<uint32_t> vertCode = _shaders.get_spirv(_shader_variants.fullscreen_vert);
+    std::vector<uint32_t> fragCode = _shaders.get_spirv(_shader_variants.present_frag);
+
+    if( _layouts->pipeline_layout(reflect_layout({ _shader_variants.fullscreen_vert, _shader_variants.present_frag })) != _present_pass.pipeline_layout )
+        throw std::runtime_error("Descriptor bindings of present shaders have changed - restart is required :( \n");
+
+    VkShaderModule vertShaderModule = creates_shader_module(vertCode);
+    VkShaderModule fragShaderModule = creates_shader_module(fragCode);
+
+    /* Surface may offer only _SRGB formats - fragment shader leaves sRGB encoding to the swap chain image then. */
+    VkFormat format = _swap_chain.swap_chain_image_format;
+    VkBool32 srgbTarget = (format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_A8B8G8R8_SRGB_PACK32) ? VK_TRUE : VK_FALSE;
+
+    VkSpecializationMapEntry specializationEntry = { 0, 0, sizeof(srgbTarget) };
+
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount    = 1;
+    specializationInfo.pMapEntries      = &specializationEntry;
+    specializationInfo.dataSize         = sizeof(srgbTarget);
+    specializationInfo.pData            = &srgbTarget;
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {};
+    shaderStages[0].sType   = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage   = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module  = vertShaderModule;
+    shaderStages[0].pName   = "main";
+    shaderStages[1].sType   = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage   = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module  = fragShaderModule;
+    shaderStages[1].pName   = "main";
+    shaderStages[1].pSpecializationInfo = &specializationInfo;
+
+    /* Fullscreen triangle is generated from vertex index - no vertex input. */
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType     = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology  = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkViewport viewport = {};
+    viewport.width      = static_cast<float>(_swap_chain.swap_chain_extent.width);
+    viewport.height     = static_cast<float>(_swap_chain.swap_chain_extent.height);
+    viewport.maxDepth   = 1.0f;
+
+    VkRect2D scissor    = {};
+    scissor.extent      = _swap_chain.swap_chain_extent;
+
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports    = &viewport;
+    viewportState.scissorCount  = 1;
+    viewportState.pScissors     = &scissor;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType        = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode  = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth    = 1.f;
+    rasterizer.cullMode     = VK_CULL_MODE_NONE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType                 = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask = 
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType             = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount   = 1;
+    colorBlending.pAttachments      = &colorBlendAttachment;
+
+    /* No depth attachment - depth state is omitted */
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType      = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages    = shaderStages.data();
+    pipelineInfo.pVertexInputState      = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState    = &inputAssembly;
+    pipelineInfo.pViewportState         = &viewportState;
+    pipelineInfo.pRasterizationState    = &rasterizer;
+    pipelineInfo.pMultisampleState      = &multisampling;
+    pipelineInfo.pColorBlendState       = &colorBlending;
+    pipelineInfo.layout                 = _present_pass.pipeline_layout;
+    pipelineInfo.renderPass             = _present_pass.render_pass;
+    pipelineInfo.subpass                = 0;
+    pipelineInfo.basePipelineIndex      = -1;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipelineInfo, nullptr, &pipeline);
+
     vkDestroyShaderModule(_device, fragShaderModule, nullptr);
     vkDestroyShaderModule(_device, vertShaderModule, nullptr);
-    vkDestroyShaderModule(_device, vertShaderStageInfo.module, nullptr);
+
+    if( result != VK_SUCCESS )
+        throw std::runtime_error("Failed to create Graphics Pipeline- present pass! :( \n");
+
+    return pipeline;
 }
 
 void Simulation::create_scene_framebuffer()
 {
-    _scene_pass.framebuffers.resize(_swap_chain.swap_chain_images.size());
+    /* Scene attachments are images of render graph - shared by all swap chain images. With MSAA single sampled color
+    *  and velocity are the resolve attachments.
+    */
+    std::vector<VkImageView> attachments = { _scene_pass.color.image_view, _scene_pass.depth.image_view, _scene_pass.velocity.image_view };
+    if( _msaa.color.image_view != VK_NULL_HANDLE )
+        attachments = { _msaa.color.image_view, _scene_pass.depth.image_view, _msaa.velocity.image_view,
+                        _scene_pass.color.image_view, _scene_pass.velocity.image_view };
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass  = _scene_pass.render_pass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments    = attachments.data();
+    framebufferInfo.width           = _swap_chain.swap_chain_extent.width;
+    framebufferInfo.height          = _swap_chain.swap_chain_extent.height;
+    framebufferInfo.layers          = 1;
+
+    if(vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_scene_pass.framebuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create framebuffer :( \n");
+
+    /* Present pass draws into swap chain image - separate framebuffer for each one. */
+    _present_pass.framebuffers.resize(_swap_chain.swap_chain_images.size());
 
     for(size_t i=0; i< _swap_chain.swap_chain_image_views.size(); i++)
     {
-        std::array<VkImageView, 2> attachments = { _swap_chain.swap_chain_image_views[i], _scene_pass.depth.image_view };
+        framebufferInfo.renderPass      = _present_pass.render_pass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments    = &_swap_chain.swap_chain_image_views[i];
 
-        VkFramebufferCreateInfo framebufferInfo = {};
-        framebufferInfo.sType   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass  = _scene_pass.render_pass;
-        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferInfo.pAttachments    = attachments.data();
-        framebufferInfo.width           = _swap_chain.swap_chain_extent.width;
-        framebufferInfo.height          = _swap_chain.swap_chain_extent.height;
-        framebufferInfo.layers          = 1;
- 
-        if(vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_scene_pass.framebuffers[i]) != VK_SUCCESS)
-            throw std::runtime_error("Failed to create framebuffer :( \n");
+        if(vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_present_pass.framebuffers[i]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create present framebuffer :( \n");
     }
+
+    /* Depth pre-pass writes depth attachment only - shared by all swap chain images. */
+    framebufferInfo = {};
+    framebufferInfo.sType   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass      = _depth_prepass.render_pass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments    = &_scene_pass.depth.image_view;
+    framebufferInfo.width           = _swap_chain.swap_chain_extent.width;
+    framebufferInfo.height          = _swap_chain.swap_chain_extent.height;
+    framebufferInfo.layers          = 1;
+
+    if(vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_depth_prepass.framebuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create depth pre-pass framebuffer :( \n");
 }
 
 void Simulation::create_offscreen_framebuffer()
@@ -628,8 +1331,8 @@ void Simulation::create_offscreen_render_pass()
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; /* Store values of depth attachment for further use. */
     depthAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED; /* Initial layout is not important. */
-    depthAttachment.finalLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthAttachment.initialLayout   = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; /* Transitioned by render graph */
+    depthAttachment.finalLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference depthReference = {};
     depthReference.attachment = 0;
@@ -640,31 +1343,10 @@ void Simulation::create_offscreen_render_pass()
     subpass.colorAttachmentCount = 0;                   /* No color attachment needed */
     subpass.pDepthStencilAttachment = &depthReference;
 
-    /* Use subpass dependencies for layout transitions. */
-    std::array<VkSubpassDependency, 2> dependencies;
-
-    dependencies[0].srcSubpass      = VK_SUBPASS_EXTERNAL;
-    dependencies[0].dstSubpass      = 0;
-    dependencies[0].srcStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependencies[0].dstStageMask    = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependencies[0].srcAccessMask   = VK_ACCESS_SHADER_READ_BIT;
-    dependencies[0].dstAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-    dependencies[1].srcSubpass      = 0;
-    dependencies[1].dstSubpass      = VK_SUBPASS_EXTERNAL;
-    dependencies[1].srcStageMask    = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    dependencies[1].dstStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependencies[1].srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[1].dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
     VkRenderPassCreateInfo renderPassCreateInfo = {};
     renderPassCreateInfo.sType  = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassCreateInfo.attachmentCount    = 1;
     renderPassCreateInfo.pAttachments       = &depthAttachment;
-    renderPassCreateInfo.dependencyCount    = static_cast<uint32_t>(dependencies.size());
-    renderPassCreateInfo.pDependencies      = dependencies.data();
     renderPassCreateInfo.subpassCount       = 1;
     renderPassCreateInfo.pSubpasses         = &subpass;
 
@@ -679,10 +1361,19 @@ void Simulation::create_command_pool()
     VkCommandPoolCreateInfo poolInfo = {};
     poolInfo.sType  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex   = queueFamilyIndices.graphicsFamily.value();    // Commands for drawing- graphics queue
-    poolInfo.flags  = 0;
+    poolInfo.flags  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;     // Command buffers are re-recorded individually after shader reload
 
     if( vkCreateCommandPool(_device, &poolInfo, nullptr, &_command_pool) != VK_SUCCESS )
         throw std::runtime_error("Failed to create command pool :( \n");
+
+    _compute_command_pool = _command_pool;
+    if( !_device_support.async_compute )
+        return;
+
+    poolInfo.queueFamilyIndex   = _queues.compute_family;   // Commands of culling and depth pyramid - async compute queue
+
+    if( vkCreateCommandPool(_device, &poolInfo, nullptr, &_compute_command_pool) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create command pool :( \n");
 }
 
 void Simulation::create_depth_texture_sampler()
@@ -724,7 +1415,112 @@ void Simulation::create_depth_texture_sampler()
         throw std::runtime_error("Failed to create offscreen texture sampler! :( \n");
 }
 
+void Simulation::create_bindless_textures()
+{
+    if( !_bindless.enabled )
+        return;
+
+    for( const char* path : MATERIAL_TEXTURE_PATHS )
+        _bindless.textures.push_back(load_texture(path));
+
+    /* One sampler is shared by every material texture. */
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter       = VK_FILTER_LINEAR;
+    samplerInfo.minFilter       = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU    = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV    = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW    = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable    = VK_TRUE;
+    samplerInfo.maxAnisotropy       = 16.f;
+    samplerInfo.borderColor         = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.mipmapMode  = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.maxLod      = 0.f;
+
+    if( vkCreateSampler(_device, &samplerInfo, nullptr, &_bindless.sampler) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create material texture sampler! :( \n");
+
+    /* The only set of update-after-bind layout lives as long as the textures - it gets its own pool created with matching flag. */
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _bindless.texture_count };
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType  = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount  = 1;
+    poolInfo.pPoolSizes     = &poolSize;
+    poolInfo.maxSets        = 1;
+    poolInfo.flags          = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+
+    if( vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_bindless.descriptor_pool) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create bindless descriptor pool. :( \n");
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool        = _bindless.descriptor_pool;
+    allocInfo.descriptorSetCount    = 1;
+    allocInfo.pSetLayouts           = &_bindless.descriptor_set_layout;
+
+    if( vkAllocateDescriptorSets(_device, &allocInfo, &_bindless.descriptor_set) != VK_SUCCESS )
+        throw std::runtime_error("Failed to allocate bindless descriptor set. :( \n");
+
+    /* Texture of material i is written into element i of the array. */
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    for( const auto& texture : _bindless.textures )
+        imageInfos.push_back({ _bindless.sampler, texture.image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet  = _bindless.descriptor_set;
+    descriptorWrite.dstBinding      = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+    descriptorWrite.pImageInfo      = imageInfos.data();
+
+    vkUpdateDescriptorSets(_device, 1, &descriptorWrite, 0, nullptr);
+}
+
 void Simulation::load_model()
+{
+    /* Deduplicated geometry, meshlets and LOD chain are cached in binary form - OBJ is parsed and simplified only if cache is missing or out of date. */
+    std::vector<MeshLod> lods;
+    if( !read_mesh_cache(MODEL_CACHE_PATH, MODEL_PATH, _vertices, _indices, _meshlets, lods) )
+    {
+        load_obj_model();
+
+        lods.resize(MESH_MAX_LODS);
+        lods.resize(build_mesh_lods(_vertices, _indices, _meshlets, 0, static_cast<uint32_t>(_indices.size()), lods.data()));
+        write_mesh_cache(MODEL_CACHE_PATH, MODEL_PATH, _vertices, _indices, _meshlets, lods);
+    }
+
+    /* Loaded model is the first mesh. Bounding sphere is placed in the center of model bounding box. */
+    glm::vec3 minPos = _vertices[0].pos;
+    glm::vec3 maxPos = _vertices[0].pos;
+    for( const auto& vertex : _vertices )
+    {
+        minPos = glm::min(minPos, vertex.pos);
+        maxPos = glm::max(maxPos, vertex.pos);
+    }
+
+    glm::vec3 center = 0.5f * (minPos + maxPos);
+    float radius = 0.f;
+    for( const auto& vertex : _vertices )
+        radius = std::max(radius, glm::length(vertex.pos - center));
+
+    MeshInfo model = {};
+    model.vertex_offset     = 0;
+    model.lod_count         = static_cast<uint32_t>(lods.size());
+    model.bounding_sphere   = glm::vec4(center, radius);
+    std::copy(lods.begin(), lods.end(), model.lods);
+    _meshes.push_back(model);
+
+    /* Floor has to be big enough to hold whole grid of objects. */
+    float gridHalfExtent = 0.5f * (SCENE_OBJECT_GRID - 1) * SCENE_OBJECT_SPACING * radius + radius;
+
+    /* Floor is placed under the lowest point of the model. */
+    add_quad_under_model(minPos.y, _vertices.size(), std::max(7.f, gridHalfExtent));
+}
+
+void Simulation::load_obj_model()
 {
     /* Vertex attributes */
     tinyobj::attrib_t attrib;
@@ -786,14 +1582,102 @@ void Simulation::load_model()
             _indices.push_back(uniqueVertices[vertex]);
         }
     }
+}
 
-    /* Find minimum Y coordinate value of unordered_map object containing Vertex values. */
-    auto minElement = *std::min_element(uniqueVertices.begin(), uniqueVertices.end(),
-        [](const auto& l, const auto& r) { return l.first.pos.y < r.first.pos.y; }
-    );
-    float minY = (minElement.first.pos.y);
+void Simulation::build_scene_objects()
+{
+    /* Floor - second mesh - is a single object placed at origin. Model is repeated in a grid above it.
+    *  Materials alternate between neighbouring objects - they are read per object, so objects of all materials share draws.
+    */
+    _instances.add(1, glm::vec3(0.f));
+
+    float spacing = SCENE_OBJECT_SPACING * _meshes[0].bounding_sphere.w;
+    float offset  = 0.5f * (SCENE_OBJECT_GRID - 1) * spacing;
+
+    for( int x = 0; x < SCENE_OBJECT_GRID; x++ )
+    {
+        for( int z = 0; z < SCENE_OBJECT_GRID; z++ )
+        {
+            glm::vec3 position = glm::vec3(x * spacing - offset, 0.f, z * spacing - offset);
+            uint32_t id = _instances.add(0, position);
+            _instances.set_material(id, static_cast<uint32_t>(x + z + 1) % MATERIAL_COUNT);
+        }
+    }
+
+    /* Every mesh reserves room for all of its objects inside visible instance list of each view. */
+    for( uint32_t id = 0; id < _instances.size(); id++ )
+        _meshes[_instances.mesh_index(id)].instance_count++;
+
+    uint32_t firstInstance      = 0;
+    uint32_t meshletObjectCount = 0;
+    for( auto& mesh : _meshes )
+    {
+        mesh.first_instance = firstInstance;
+        mesh.instanced      = mesh.instance_count >= INSTANCING_MIN_INSTANCES;
+        firstInstance      += mesh.instance_count;
+
+        if( !mesh.instanced )
+            meshletObjectCount += mesh.instance_count;
+    }
+
+    _cull_uniform_buf_obj.object_count          = _instances.size();
+    _cull_uniform_buf_obj.mesh_count            = static_cast<uint32_t>(_meshes.size());
+    _cull_uniform_buf_obj.meshlet_object_count  = meshletObjectCount;
+
+    /* Meshlet culling dispatches enough chunks for the not instanced mesh with most meshlets - full resolution level has the most. */
+    uint32_t chunkCount = 1;
+    for( const auto& mesh : _meshes )
+    {
+        if( !mesh.instanced )
+            chunkCount = std::max(chunkCount, (mesh.lods[0].meshlet_count + MESHLET_GROUP_SIZE - 1) / MESHLET_GROUP_SIZE);
+    }
+
+    _cull_uniform_buf_obj.meshlet_chunk_count   = chunkCount;
+    _cull_uniform_buf_obj.output_index_offset   = static_cast<uint32_t>(_indices.size());
+    _cull_uniform_buf_obj.output_index_capacity = MESHLET_OUTPUT_INDICES;
+}
+
+void Simulation::build_scene_lights()
+{
+    /* Lights are scattered over the floor, a little above it - fixed seed keeps the scene the same between runs.
+    *  Every other light is a spot light pointing down, range is a few model sizes, so each light touches only some clusters.
+    */
+    const glm::vec4& floor = _meshes[1].bounding_sphere;
+    float floorHalfExtent  = floor.w / glm::root_two<float>();
+    float modelRadius      = _meshes[0].bounding_sphere.w;
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    _lights.sources.resize(MAX_LIGHTS);
+
+    for( uint32_t i = 0; i < MAX_LIGHTS; i++ )
+    {
+        Light_Data& light = _lights.sources[i];
+
+        glm::vec3 position  = glm::vec3((2.f * unit(random) - 1.f) * floorHalfExtent,
+                                        floor.y + (0.2f + 1.3f * unit(random)) * modelRadius,
+                                        (2.f * unit(random) - 1.f) * floorHalfExtent);
+        float range         = (1.f + 2.f * unit(random)) * modelRadius;
+        float hue           = unit(random);
+        glm::vec3 color     = 1.f + glm::cos(glm::two_pi<float>() * (hue + glm::vec3(0.f, 1.f / 3.f, 2.f / 3.f)));
+
+        light.position  = glm::vec4(position, range);
+
+        if( i % 2 == 0 )
+        {
+            light.color     = glm::vec4(color, -1.f);
+            light.direction = glm::vec4(0.f, -1.f, 0.f, -1.f);
+            continue;
+        }
 
-    add_quad_under_model(minY, _vertices.size(), 7.f);
+        /* Spot light - cone of 25 to 40 degrees, tilted away from straight down. */
+        float outerAngle    = glm::radians(25.f + 15.f * unit(random));
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(random) - 0.5f, -1.f, unit(random) - 0.5f));
+
+        light.color     = glm::vec4(color, std::cos(0.8f * outerAngle));
+        light.direction = glm::vec4(direction, std::cos(outerAngle));
+    }
 }
 
 void Simulation::add_quad_under_model(float minY, int count, float quad_coord)
@@ -821,6 +1705,17 @@ void Simulation::add_quad_under_model(float minY, int count, float quad_coord)
     vert.texCoord   = { 0.f, 1.f };
     _vertices.push_back(vert);
 
+    /* Floor is stored as separate mesh. Two triangles need no levels of detail. */
+    MeshInfo floor = {};
+    floor.vertex_offset         = 0;
+    floor.lods[0].first_index   = static_cast<uint32_t>(_indices.size());
+    floor.lods[0].index_count   = 6;
+    floor.lods[0].first_meshlet = static_cast<uint32_t>(_meshlets.size());
+    floor.lods[0].meshlet_count = 1;
+    floor.lod_count             = 1;
+    floor.bounding_sphere       = glm::vec4(0.f, minY, 0.f, quad_coord * glm::root_two<float>());
+    _meshes.push_back(floor);
+
     _indices.push_back(count + 0); /* v1 */
     _indices.push_back(count + 1); /* v2 */
     _indices.push_back(count + 2); /* v3 */
@@ -828,43 +1723,425 @@ void Simulation::add_quad_under_model(float minY, int count, float quad_coord)
     _indices.push_back(count + 0); /* v1 */
     _indices.push_back(count + 2); /* v3 */
     _indices.push_back(count + 3); /* v4 */
+
+    build_meshlets(_vertices, _indices, floor.lods[0].first_index, floor.lods[0].index_count, _meshlets);
+}
+
+/* Largest power of two which is not greater than given value. */
+static uint32_t previous_pow2(uint32_t value)
+{
+    uint32_t result = 1;
+    while( result * 2 <= value )
+        result *= 2;
+
+    return result;
+}
+
+void Simulation::create_render_graph()
+{
+    /* Culling and depth pyramid run on the compute queue - overlapping scene rendering of the previous frame. */
+    _render_graph = std::make_unique<RenderGraph>(_device, _physical_device, _queues.graphics_family,
+        _device_support.async_compute ? _queues.compute_family : VK_QUEUE_FAMILY_IGNORED);
+
+    /* TRANSIENT IMAGES - contents are produced and consumed within a frame. Views are created by create_depth_resources(). */
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType     = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.depth  = 1;
+    imageInfo.mipLevels     = 1;
+    imageInfo.arrayLayers   = 1;
+    imageInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+
+    /* Depth map - offscreen */
+    imageInfo.format        = DEPTH_FORMAT;
+    imageInfo.usage         = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.extent.width  = _windowWidth;
+    imageInfo.extent.height = _windowHeight;
+    _graph_resources.shadow_map = _render_graph->create_image("shadow_map", imageInfo, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    /* Scene attachments - multisampled with MSAA. Depth is reduced into Hi-Z pyramid. Single sampled color and velocity are read
+    *  by temporal anti-aliasing and present pass. Multisampled color and velocity are only resolved - after depth pre-pass they live
+    *  within the single shading pass and are transient, without it the late scene pass loads what the early one stored.
+    */
+    bool multisampled = _scene_permutation.samples != VK_SAMPLE_COUNT_1_BIT;
+
+    imageInfo.extent.width  = _swap_chain.swap_chain_extent.width;
+    imageInfo.extent.height = _swap_chain.swap_chain_extent.height;
+    imageInfo.samples       = _scene_permutation.samples;
+    _graph_resources.scene_depth = _render_graph->create_image("scene_depth", imageInfo, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    if( multisampled )
+    {
+        imageInfo.usage     = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if( _scene_permutation.depth_prepass )
+            imageInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+        imageInfo.format    = SCENE_COLOR_FORMAT;
+        _graph_resources.scene_color_ms = _render_graph->create_image("scene_color_ms", imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+        imageInfo.format    = VELOCITY_FORMAT;
+        _graph_resources.velocity_ms    = _render_graph->create_image("velocity_ms", imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    imageInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+
+    imageInfo.usage         = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.format        = SCENE_COLOR_FORMAT;
+    _graph_resources.scene_color    = _render_graph->create_image("scene_color", imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+    imageInfo.format        = VELOCITY_FORMAT;
+    _graph_resources.velocity       = _render_graph->create_image("velocity", imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    /* Temporal anti-aliasing output - copied into history for the next frame */
+    if( _taa.enabled )
+    {
+        imageInfo.format    = TAA_HISTORY_FORMAT;
+        imageInfo.usage     = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        _graph_resources.taa_output = _render_graph->create_image("taa_output", imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    /* Base level of depth pyramid is the previous power of two of the screen size, so every next level halves exactly. */
+    _hiz.extent.width   = previous_pow2(_swap_chain.swap_chain_extent.width);
+    _hiz.extent.height  = previous_pow2(_swap_chain.swap_chain_extent.height);
+
+    _hiz.levels = 1;
+    while( (std::max(_hiz.extent.width, _hiz.extent.height) >> _hiz.levels) > 0 )
+        _hiz.levels++;
+
+    imageInfo.format        = VK_FORMAT_R32_SFLOAT;
+    imageInfo.usage         = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.extent.width  = _hiz.extent.width;
+    imageInfo.extent.height = _hiz.extent.height;
+    imageInfo.mipLevels     = _hiz.levels;
+    _graph_resources.hiz = _render_graph->create_image("hiz", imageInfo, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    /* Acquire semaphore is waited for at color output stage - the first layout transition has to start there. */
+    _graph_resources.swap_chain = _render_graph->import_image("swap_chain", _swap_chain.swap_chain_images, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+        { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED },
+        { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+
+    /* History of temporal anti-aliasing persists between frames - it is left sampled by present pass of the previous frame. */
+    if( _taa.enabled )
+        _graph_resources.taa_history = _render_graph->import_image("taa_history", { _taa.history.image }, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+            { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+            { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+
+    /* BUFFERS - written by culling. Host written buffers (uniforms, objects) are visible to every submission, they are not tracked. */
+    const uint32_t perImage = RenderGraph::BUFFER_PER_IMAGE;
+    _graph_resources.cull_counts        = _render_graph->import_buffer("cull_counts", perImage);
+    _graph_resources.object_draws       = _render_graph->import_buffer("object_draws", perImage);
+    _graph_resources.instance_draws     = _render_graph->import_buffer("instance_draws", perImage);
+    _graph_resources.instance_lists     = _render_graph->import_buffer("instance_lists", perImage);
+    _graph_resources.meshlet_draws      = _render_graph->import_buffer("meshlet_draws", perImage);
+    _graph_resources.meshlet_indices    = _render_graph->import_buffer("meshlet_indices", perImage);
+    _graph_resources.visibility         = _render_graph->import_buffer("visibility", RenderGraph::BUFFER_EXPORTED);    /* Read by early culling of the next frame */
+    _graph_resources.cull_stats         = _render_graph->import_buffer("cull_stats", perImage | RenderGraph::BUFFER_EXPORTED,
+                                                                        { VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT });
+    _graph_resources.light_grid         = _render_graph->import_buffer("light_grid", perImage);
+    _graph_resources.light_indices      = _render_graph->import_buffer("light_indices", perImage);
+    _graph_resources.exposure           = _render_graph->import_buffer("exposure", RenderGraph::BUFFER_EXPORTED);      /* Adapted by the next frame */
+
+    const Resource_Access transferRead      = { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT };
+    const Resource_Access transferWrite     = { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT };
+    const Resource_Access computeRead       = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+    const Resource_Access computeWrite      = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT };
+    const Resource_Access computeAtomic     = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+    const Resource_Access indirectRead      = { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT };
+    const Resource_Access indexRead         = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT };
+    const Resource_Access vertexRead        = { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+    const Resource_Access fragmentRead      = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+    const Resource_Access depthAttachment   = { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+    const Resource_Access shadowSampled     = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+    const Resource_Access depthSampled      = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+    const Resource_Access pyramidRead       = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+    const Resource_Access pyramidWrite      = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+    const Resource_Access colorClear        = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    const Resource_Access colorLoad         = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    const Resource_Access computeSampled    = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    const Resource_Access fragmentSampled   = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    const Resource_Access storageWrite      = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+    const Resource_Access copySource        = { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+    const Resource_Access copyDestination   = { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+
+    /* Color and velocity written by scene passes - with MSAA multisampled images are drawn into and resolved into single sampled ones, which are overwritten. */
+    auto writeColor = [&](RenderGraph::Pass& pass, const Resource_Access& access) -> RenderGraph::Pass& {
+        if( !multisampled )
+            return pass.write(_graph_resources.scene_color, access)
+                       .write(_graph_resources.velocity,    access);
+
+        return pass.write(_graph_resources.scene_color_ms,  access)
+                   .write(_graph_resources.velocity_ms,     access)
+                   .write(_graph_resources.scene_color,     colorClear)
+                   .write(_graph_resources.velocity,        colorClear);
+    };
+
+    /* Culling outputs consumed by draws of every render pass */
+    auto readDraws = [&](RenderGraph::Pass& pass) -> RenderGraph::Pass& {
+        return pass.read(_graph_resources.instance_draws,   indirectRead)
+                   .read(_graph_resources.meshlet_draws,    indirectRead)
+                   .read(_graph_resources.cull_counts,      indirectRead)
+                   .read(_graph_resources.meshlet_indices,  indexRead)
+                   .read(_graph_resources.instance_lists,   vertexRead);
+    };
+
+    /* Light clusters consumed by fragment shader of every pass shading the scene */
+    auto readLights = [&](RenderGraph::Pass& pass) -> RenderGraph::Pass& {
+        return pass.read(_graph_resources.light_grid,       fragmentRead)
+                   .read(_graph_resources.light_indices,    fragmentRead);
+    };
+
+    /* Culling of both phases - object lists are expanded into meshlet draws. */
+    auto addCulling = [&](cull_phase phase) {
+        const char* cullName    = (phase == CULL_PHASE_EARLY) ? "cull_early" : "cull_late";
+        const char* meshletName = (phase == CULL_PHASE_EARLY) ? "meshlet_early" : "meshlet_late";
+
+        auto& cullPass = _render_graph->add_pass(cullName, [this, phase](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            record_culling(commandBuffer, imageIndex, phase);
+        }, GRAPH_QUEUE_COMPUTE);
+        cullPass.write(_graph_resources.cull_counts,    computeAtomic)
+                .write(_graph_resources.instance_draws, computeAtomic)
+                .write(_graph_resources.instance_lists, computeWrite)
+                .write(_graph_resources.object_draws,   computeWrite);
+
+        /* Early phase draws objects visible in previous frame, late phase tests the rest against depth pyramid. */
+        if( phase == CULL_PHASE_EARLY )
+            cullPass.read(_graph_resources.visibility, computeRead);
+        else
+            cullPass.read(_graph_resources.hiz, pyramidRead).write(_graph_resources.visibility, computeAtomic);
+
+        _render_graph->add_pass(meshletName, [this, phase](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            record_meshlet_culling(commandBuffer, imageIndex, phase);
+        }, GRAPH_QUEUE_COMPUTE)
+            .read(_graph_resources.object_draws,        computeRead)
+            .read(_graph_resources.instance_lists,      computeRead)
+            .write(_graph_resources.cull_counts,        computeAtomic)
+            .write(_graph_resources.meshlet_indices,    computeWrite)
+            .write(_graph_resources.meshlet_draws,      computeWrite);
+    };
+
+    _render_graph->add_pass("cull_reset", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        record_cull_reset(commandBuffer, imageIndex);
+    }, GRAPH_QUEUE_COMPUTE)
+        .write(_graph_resources.cull_counts,    transferWrite)
+        .write(_graph_resources.meshlet_draws,  transferWrite)
+        .write(_graph_resources.instance_draws, transferWrite);
+
+    addCulling(CULL_PHASE_EARLY);
+
+    /* Lights are assigned to clusters of camera frustum - independent of culling, both run before any scene pass. */
+    _render_graph->add_pass("light_reset", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        record_light_reset(commandBuffer, imageIndex);
+    }, GRAPH_QUEUE_COMPUTE)
+        .write(_graph_resources.light_grid, transferWrite);
+
+    _render_graph->add_pass("light_clusters", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        record_light_clustering(commandBuffer, imageIndex);
+    }, GRAPH_QUEUE_COMPUTE)
+        .write(_graph_resources.light_grid,     computeAtomic)
+        .write(_graph_resources.light_indices,  computeWrite);
+
+    /* Shadow map rendered from light's POV */
+    readDraws(_render_graph->add_pass("shadow", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        record_shadow_pass(commandBuffer, imageIndex);
+    }))
+        .write(_graph_resources.shadow_map, depthAttachment);
+
+    /* Objects visible in previous frame - they are the occluders for the rest of the scene. With depth pre-pass only their depth is drawn. */
+    bool depthPrepass = _scene_permutation.depth_prepass;
+
+    if( depthPrepass )
+    {
+        readDraws(_render_graph->add_pass("prepass_early", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            record_depth_prepass(commandBuffer, imageIndex, CULL_PHASE_EARLY);
+        }))
+            .write(_graph_resources.scene_depth,    depthAttachment);
+    }
+    else
+    {
+        writeColor(readLights(readDraws(_render_graph->add_pass("scene_early", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            record_scene_pass(commandBuffer, imageIndex, CULL_PHASE_EARLY);
+        }))), colorClear)
+            .read(_graph_resources.shadow_map,      shadowSampled)
+            .write(_graph_resources.scene_depth,    depthAttachment);
+    }
+
+    /* Every level of depth pyramid is reduced from the previous one - level 0 from depth of early pass. */
+    for( uint32_t level = 0; level < _hiz.levels; level++ )
+    {
+        auto& pass = _render_graph->add_pass("hiz_" + std::to_string(level), [this, level](VkCommandBuffer commandBuffer, uint32_t) {
+            record_hiz_build(commandBuffer, level);
+        }, GRAPH_QUEUE_COMPUTE);
+
+        if( level == 0 )
+            pass.read(_graph_resources.scene_depth, depthSampled);
+        else
+            pass.read(_graph_resources.hiz, pyramidRead, level - 1, 1);
+
+        pass.write(_graph_resources.hiz, pyramidWrite, level, 1);
+    }
+
+    addCulling(CULL_PHASE_LATE);
+
+    /* Objects which became visible in this frame */
+    if( depthPrepass )
+    {
+        readDraws(_render_graph->add_pass("prepass_late", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            record_depth_prepass(commandBuffer, imageIndex, CULL_PHASE_LATE);
+        }))
+            .write(_graph_resources.scene_depth,    depthAttachment);
+
+        /* Objects of both phases are shaded against complete depth buffer. It is only tested, but discarding it at the end of the pass is a write too. */
+        writeColor(readLights(readDraws(_render_graph->add_pass("scene", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            record_scene_pass(commandBuffer, imageIndex, CULL_PHASE_EARLY);
+        }))), colorClear)
+            .read(_graph_resources.shadow_map,      shadowSampled)
+            .write(_graph_resources.scene_depth,    depthAttachment);
+    }
+    else
+    {
+        writeColor(readLights(readDraws(_render_graph->add_pass("scene_late", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            record_scene_pass(commandBuffer, imageIndex, CULL_PHASE_LATE);
+        }))), colorLoad)
+            .read(_graph_resources.shadow_map,      shadowSampled)
+            .write(_graph_resources.scene_depth,    depthAttachment);
+    }
+
+    /* All counters are final after late phase - copied to host visible memory. */
+    _render_graph->add_pass("stats_copy", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        record_stats_copy(commandBuffer, imageIndex);
+    })
+        .read(_graph_resources.cull_counts, transferRead)
+        .write(_graph_resources.cull_stats, transferWrite);
+
+    /* Temporal anti-aliasing - history is reprojected by velocity and blended with this frame, the result is the next history. */
+    if( _taa.enabled )
+    {
+        _render_graph->add_pass("taa", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            record_taa(commandBuffer, imageIndex);
+        })
+            .read(_graph_resources.scene_color, computeSampled)
+            .read(_graph_resources.velocity,    computeSampled)
+            .read(_graph_resources.taa_history, computeSampled)
+            .write(_graph_resources.taa_output, storageWrite);
+
+        _render_graph->add_pass("taa_history", [this](VkCommandBuffer commandBuffer, uint32_t) {
+            record_taa_history_copy(commandBuffer);
+        })
+            .read(_graph_resources.taa_output,  copySource)
+            .write(_graph_resources.taa_history, copyDestination);
+    }
+
+    /* Exposure is measured on scene color of this frame - histogram is the same with or without TAA, which only moves it in time. */
+    _render_graph->add_pass("exposure", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        record_exposure(commandBuffer, imageIndex);
+    })
+        .read(_graph_resources.scene_color, computeSampled)
+        .write(_graph_resources.exposure,   computeAtomic);
+
+    /* The only writer of swap chain image - tonemaps TAA history, or scene color without TAA. */
+    _render_graph->add_pass("present", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        record_present_pass(commandBuffer, imageIndex);
+    })
+        .read(_taa.enabled ? _graph_resources.taa_history : _graph_resources.scene_color, fragmentSampled)
+        .read(_graph_resources.exposure, fragmentRead)
+        .write(_graph_resources.swap_chain, colorClear);
+
+    _render_graph->compile();
+
+    const RenderGraph::Stats& stats = _render_graph->stats();
+    std::cout << "Render graph: " << stats.passes << " passes (" << stats.culled_passes << " culled), "
+              << stats.barrier_batches << " barrier batches, " << stats.image_barriers << " image barriers, "
+              << stats.transient_memory / 1024 << " KB of transient memory (" << stats.transient_memory_unaliased / 1024 << " KB without aliasing, "
+              << stats.lazy_memory / 1024 << " KB lazily allocated), "
+              << stats.segments << " queue segments, " << stats.ownership_barriers << " ownership transfer barriers\n";
 }
 
 void Simulation::create_depth_resources()
 {
-    /* Create vkImage object with given properties */
-    create_image(_swap_chain.swap_chain_extent.width,
-            _swap_chain.swap_chain_extent.height,
-            DEPTH_FORMAT,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            _scene_pass.depth.image,
-            _scene_pass.depth.memory
-        );
-    
-    /* Crate Image view bound to previously created depth image */
+    /* Images and their memory belong to render graph - only views are created here. */
+    _scene_pass.depth.image     = _render_graph->image(_graph_resources.scene_depth);
+    _scene_pass.depth.memory    = VK_NULL_HANDLE;
     _scene_pass.depth.image_view = create_image_view(_scene_pass.depth.image, 
         DEPTH_FORMAT, 
         VK_IMAGE_ASPECT_DEPTH_BIT
     );
 
-    /* Create Image for depth map. Offscreen */
-    create_image(_windowWidth, 
-        _windowHeight, 
-        DEPTH_FORMAT, 
-        VK_IMAGE_TILING_OPTIMAL, 
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        _offscreen_pass.depth.image,
-        _offscreen_pass.depth.memory
-    );
+    /* Color and velocity - drawn by scene pass, read by temporal anti-aliasing and present pass */
+    _scene_pass.color.image         = _render_graph->image(_graph_resources.scene_color);
+    _scene_pass.color.memory        = VK_NULL_HANDLE;
+    _scene_pass.color.image_view    = create_image_view(_scene_pass.color.image, SCENE_COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    _scene_pass.velocity.image      = _render_graph->image(_graph_resources.velocity);
+    _scene_pass.velocity.memory     = VK_NULL_HANDLE;
+    _scene_pass.velocity.image_view = create_image_view(_scene_pass.velocity.image, VELOCITY_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    /* Multisampled color and velocity - resolved into the single sampled ones by scene pass */
+    _msaa.color     = {};
+    _msaa.velocity  = {};
+    if( _scene_permutation.samples != VK_SAMPLE_COUNT_1_BIT )
+    {
+        _msaa.color.image       = _render_graph->image(_graph_resources.scene_color_ms);
+        _msaa.color.memory      = VK_NULL_HANDLE;
+        _msaa.color.image_view  = create_image_view(_msaa.color.image,
+            SCENE_COLOR_FORMAT,
+            VK_IMAGE_ASPECT_COLOR_BIT
+        );
+
+        _msaa.velocity.image        = _render_graph->image(_graph_resources.velocity_ms);
+        _msaa.velocity.memory       = VK_NULL_HANDLE;
+        _msaa.velocity.image_view   = create_image_view(_msaa.velocity.image, VELOCITY_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    /* Output of temporal anti-aliasing - storage image written by taa.comp */
+    _taa.output = {};
+    if( _taa.enabled )
+    {
+        _taa.output.image       = _render_graph->image(_graph_resources.taa_output);
+        _taa.output.memory      = VK_NULL_HANDLE;
+        _taa.output.image_view  = create_image_view(_taa.output.image, TAA_HISTORY_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
 
-    /* Crate Image View for crated depth image. Offscreen */
+    /* Offscreen */
+    _offscreen_pass.depth.image     = _render_graph->image(_graph_resources.shadow_map);
+    _offscreen_pass.depth.memory    = VK_NULL_HANDLE;
     _offscreen_pass.depth.image_view = create_image_view(_offscreen_pass.depth.image,
         DEPTH_FORMAT,
         VK_IMAGE_ASPECT_DEPTH_BIT
     );
+
+    create_hiz_resources();
+}
+
+void Simulation::create_hiz_resources()
+{
+    _hiz.image  = _render_graph->image(_graph_resources.hiz);
+    _hiz.view   = create_image_view(_hiz.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, _hiz.levels);
+
+    _hiz.mip_views.resize(_hiz.levels);
+    for( uint32_t i = 0; i < _hiz.levels; i++ )
+        _hiz.mip_views[i] = create_image_view(_hiz.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+}
+
+void Simulation::create_taa_history()
+{
+    /* History of the previous swap chain is not reprojected into a new one - accumulation starts over. */
+    _taa.history    = {};
+    _taa.frame      = 0;
+
+    if( !_taa.enabled )
+        return;
+
+    /* Owned by the application - its contents have to survive until the next frame, render graph discards its own images. */
+    create_image(_swap_chain.swap_chain_extent.width, _swap_chain.swap_chain_extent.height, TAA_HISTORY_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _taa.history.image, _taa.history.memory);
+    _taa.history.image_view = create_image_view(_taa.history.image, TAA_HISTORY_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    /* Render graph expects history in the layout the previous frame left it in. */
+    transition_image_layout(_taa.history.image, TAA_HISTORY_FORMAT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 
 void Simulation::create_vertex_buffer()
@@ -934,8 +2211,9 @@ void Simulation::create_index_buffer()
     vkUnmapMemory(_device, stagingBufferMemory);
 
     /* Create buffer to hold indices data on GPU. */
+    /* Indices are also read by meshlet culling shader and copied into per-image index buffers. */
     create_buffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         _index_buffer,
         _index_buffer_memory);
@@ -948,6 +2226,223 @@ void Simulation::create_index_buffer()
     vkFreeMemory(_device, stagingBufferMemory, nullptr);
 }
 
+void Simulation::create_object_buffer()
+{
+    /* Nothing was visible before first frame - all objects are drawn by late phase of occlusion culling. */
+    std::vector<uint32_t> visibility(_instances.size(), 0);
+    create_device_local_buffer(visibility.data(),
+        static_cast<uint64_t>(sizeof(visibility[0])) * visibility.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        _cull.visibility_buffer,
+        _cull.visibility_buf_memory);
+
+    /* Instanced draw of every level of every mesh in every view with zero instances - culling shader increments instance count.
+    *  Draws of meshes handled by meshlet culling draw nothing, their instance counts only allocate list entries.
+    */
+    std::vector<VkDrawIndexedIndirectCommand> draws;
+    for( uint32_t view = 0; view < CULL_VIEW_COUNT; view++ )
+    {
+        for( const auto& mesh : _meshes )
+        {
+            for( uint32_t lod = 0; lod < MESH_MAX_LODS; lod++ )
+            {
+                VkDrawIndexedIndirectCommand draw = {};
+                draw.indexCount     = (mesh.instanced && lod < mesh.lod_count) ? mesh.lods[lod].index_count : 0;
+                draw.instanceCount  = 0;
+                draw.firstIndex     = mesh.lods[lod].first_index;
+                draw.vertexOffset   = mesh.vertex_offset;
+                draw.firstInstance  = (view * _instances.size() + mesh.first_instance) * MESH_MAX_LODS + lod * mesh.instance_count;
+                draws.push_back(draw);
+            }
+        }
+    }
+
+    create_device_local_buffer(draws.data(),
+        static_cast<uint64_t>(sizeof(draws[0])) * draws.size(),
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        _instancing.template_buffer,
+        _instancing.template_buf_memory);
+}
+
+void Simulation::create_mesh_buffer()
+{
+    std::vector<MeshData> meshes;
+    for( const auto& mesh : _meshes )
+    {
+        MeshData data = {};
+        data.bounding_sphere    = mesh.bounding_sphere;
+        data.vertex_offset      = mesh.vertex_offset;
+        data.lod_count          = mesh.lod_count;
+        data.instance_base      = mesh.first_instance * MESH_MAX_LODS;
+        data.instance_count     = mesh.instance_count;
+        data.instanced          = mesh.instanced ? 1 : 0;
+        std::copy(std::begin(mesh.lods), std::end(mesh.lods), data.lods);
+        meshes.push_back(data);
+    }
+
+    create_device_local_buffer(meshes.data(),
+        static_cast<uint64_t>(sizeof(meshes[0])) * meshes.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        _mesh_buffer,
+        _mesh_buffer_memory);
+}
+
+void Simulation::create_meshlet_buffer()
+{
+    create_device_local_buffer(_meshlets.data(),
+        static_cast<uint64_t>(sizeof(_meshlets[0])) * _meshlets.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        _meshlet.buffer,
+        _meshlet.buffer_memory);
+}
+
+void Simulation::create_culling_pipeline()
+{
+    /* Bindings: objects (0), frustum planes (1), output draw commands (2), output draw counts (3),
+    *  depth pyramid (4), visibility from previous frame (5), visible instance list (6), instanced draw commands (7), meshes (8).
+    *  Culling phase is passed as push constant - same pipeline is dispatched before and after depth pyramid is built.
+    */
+    ShaderLayout layout = reflect_layout({ _shader_variants.cull_comp });
+
+    _cull.descriptor_set_layout  = _layouts->set_layout(layout.sets.at(0));
+    _cull.pipeline_layout        = _layouts->pipeline_layout(layout);
+
+    _cull.pipeline = build_compute_pipeline(_shader_variants.cull_comp, _cull.pipeline_layout);
+}
+
+void Simulation::create_meshlet_pipeline()
+{
+    /* Bindings: objects (0), cull data (1), object draw commands (2), counters (3), meshlets (4),
+    *  static indices (5), per-image index buffer (6), output meshlet draw commands (7), visible instance list (8), meshes (9).
+    *  First processed view is passed as push constant - workgroup Z index is added to it.
+    */
+    ShaderLayout layout = reflect_layout({ _shader_variants.meshlet_comp });
+
+    _meshlet.descriptor_set_layout  = _layouts->set_layout(layout.sets.at(0));
+    _meshlet.pipeline_layout        = _layouts->pipeline_layout(layout);
+
+    _meshlet.pipeline = build_compute_pipeline(_shader_variants.meshlet_comp, _meshlet.pipeline_layout);
+}
+
+void Simulation::create_light_cluster_pipeline()
+{
+    /* Bindings: cluster data (0), lights (1), cluster grid (2), light index list (3). Workgroup index selects the cluster. */
+    ShaderLayout layout = reflect_layout({ _shader_variants.cluster_comp });
+
+    _lights.descriptor_set_layout   = _layouts->set_layout(layout.sets.at(0));
+    _lights.pipeline_layout         = _layouts->pipeline_layout(layout);
+
+    _lights.pipeline = build_compute_pipeline(_shader_variants.cluster_comp, _lights.pipeline_layout);
+}
+
+void Simulation::create_hiz_pipeline()
+{
+    /* Pyramid is read with texelFetch/textureLod - no filtering, every level addressable. */
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter    = VK_FILTER_NEAREST;
+    samplerInfo.minFilter    = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor  = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.minLod       = 0.f;
+    samplerInfo.maxLod       = VK_LOD_CLAMP_NONE;
+
+    if( vkCreateSampler(_device, &samplerInfo, nullptr, &_hiz.sampler) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create depth pyramid sampler! :( \n");
+
+    /* Bindings: source level (0), destination level (1). Source and destination level sizes are push constants. */
+    ShaderLayout layout = reflect_layout({ _shader_variants.hiz_comp });
+
+    _hiz.descriptor_set_layout  = _layouts->set_layout(layout.sets.at(0));
+    _hiz.pipeline_layout        = _layouts->pipeline_layout(layout);
+
+    _hiz.pipeline = build_compute_pipeline(_shader_variants.hiz_comp, _hiz.pipeline_layout);
+
+    /* Multisampled depth is bound to the same combined image sampler binding - layout is shared. */
+    _hiz.resolve_pipeline = build_compute_pipeline(_shader_variants.hiz_resolve_comp, _hiz.pipeline_layout);
+}
+
+void Simulation::create_taa_pipeline()
+{
+    /* History is sampled between texels where pixels moved - bilinear filtering, clamped at screen edges. Present pass samples with it too. */
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter    = VK_FILTER_LINEAR;
+    samplerInfo.minFilter    = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor  = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    samplerInfo.minLod       = 0.f;
+    samplerInfo.maxLod       = 0.f;
+
+    if( vkCreateSampler(_device, &samplerInfo, nullptr, &_taa.sampler) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create TAA sampler! :( \n");
+
+    /* Bindings: TAA data (0), scene color (1), velocity (2), history (3), output (4). */
+    ShaderLayout layout = reflect_layout({ _shader_variants.taa_comp });
+
+    _taa.descriptor_set_layout  = _layouts->set_layout(layout.sets.at(0));
+    _taa.pipeline_layout        = _layouts->pipeline_layout(layout);
+
+    _taa.pipeline = build_compute_pipeline(_shader_variants.taa_comp, _taa.pipeline_layout);
+}
+
+void Simulation::create_exposure_pipeline()
+{
+    /* Histogram starts empty and exposure neutral - it adapts within the first second. */
+    std::vector<uint32_t> initialData(EXPOSURE_GROUP_SIZE * EXPOSURE_GROUP_SIZE + 4, 0);
+    float initialExposure = 1.f;
+    memcpy(&initialData[EXPOSURE_GROUP_SIZE * EXPOSURE_GROUP_SIZE + 1], &initialExposure, sizeof(initialExposure));
+
+    create_device_local_buffer(initialData.data(),
+        sizeof(initialData[0]) * initialData.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        _exposure.buffer,
+        _exposure.buffer_memory);
+
+    /* Bindings: exposure data (0), scene color (1), histogram and exposure (2). */
+    ShaderLayout layout = reflect_layout({ _shader_variants.exposure_comp });
+
+    _exposure.descriptor_set_layout = _layouts->set_layout(layout.sets.at(0));
+    _exposure.pipeline_layout       = _layouts->pipeline_layout(layout);
+
+    _exposure.pipeline = build_compute_pipeline(_shader_variants.exposure_comp, _exposure.pipeline_layout);
+}
+
+VkPipeline Simulation::build_compute_pipeline(const ShaderVariant& variant, VkPipelineLayout layout)
+{
+    std::vector<uint32_t> code = _shaders.get_spirv(variant);
+
+    /* Pipeline layouts are created once - edited shader has to keep the interface it was created from. */
+    if( _layouts->pipeline_layout(reflect_spirv(code).layout) != layout )
+        throw std::runtime_error("Descriptor bindings of " + variant.path + " have changed - restart is required :( \n");
+
+    VkShaderModule compShaderModule = creates_shader_module(code);
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType    = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module   = compShaderModule;
+    pipelineInfo.stage.pName    = "main";
+    pipelineInfo.layout         = layout;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateComputePipelines(_device, _pipeline_cache, 1, &pipelineInfo, nullptr, &pipeline);
+
+    vkDestroyShaderModule(_device, compShaderModule, nullptr);
+
+    if( result != VK_SUCCESS )
+        throw std::runtime_error("Failed to create compute pipeline of " + variant.path + " :( \n");
+
+    return pipeline;
+}
+
 void Simulation::create_uniform_buffers()
 {
     VkDeviceSize bufferSize = sizeof(_scene_uniform_buf_obj);
@@ -984,69 +2479,237 @@ void Simulation::create_uniform_buffers()
     _offscreen_buffer.descriptor.offset     = 0;
     _offscreen_buffer.descriptor.buffer     = _offscreen_buffer.buffer;
     _offscreen_buffer.descriptor.range      = VK_WHOLE_SIZE; 
-}
 
-void Simulation::create_descriptor_pool()
-{
-    /* Provide information about descriptors type of our descriptor sets and how many of them. 
-    *  This structure is referenced in by the main VkDescriptorPoolCreateInfo structure. 
-    */
-    std::array<VkDescriptorPoolSize, 2> poolSize = {};
-    poolSize[0].type    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;    /* Which descriptors types this pool is going to contain. */
-    poolSize[0].descriptorCount     = static_cast<uint32_t>(_swap_chain.swap_chain_images.size() + 1);  
-    poolSize[1].type    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSize[1].descriptorCount     = static_cast<uint32_t>(_swap_chain.swap_chain_images.size() + 1);
+    /* Culling resources - every swap chain image gets own frustum planes and output draw commands. */
+    size_t imageCount = _swap_chain.swap_chain_images.size();
+    _cull.uniform_buffers.resize(imageCount);
+    _cull.uniform_buf_memory.resize(imageCount);
+    _cull.draw_buffers.resize(imageCount);
+    _cull.draw_buf_memory.resize(imageCount);
+    _cull.count_buffers.resize(imageCount);
+    _cull.count_buf_memory.resize(imageCount);
+    _cull.stats_buffers.resize(imageCount);
+    _cull.stats_buf_memory.resize(imageCount);
+    _meshlet.index_buffers.resize(imageCount);
+    _meshlet.index_buf_memory.resize(imageCount);
+    _meshlet.draw_buffers.resize(imageCount);
+    _meshlet.draw_buf_memory.resize(imageCount);
+    _instancing.object_buffers.resize(imageCount);
+    _instancing.object_buf_memory.resize(imageCount);
+    _instancing.object_data.resize(imageCount);
+    _instancing.list_buffers.resize(imageCount);
+    _instancing.list_buf_memory.resize(imageCount);
+    _instancing.draw_buffers.resize(imageCount);
+    _instancing.draw_buf_memory.resize(imageCount);
+    _lights.uniform_buffers.resize(imageCount);
+    _lights.uniform_buf_memory.resize(imageCount);
+    _lights.light_buffers.resize(imageCount);
+    _lights.light_buf_memory.resize(imageCount);
+    _lights.light_data.resize(imageCount);
+    _lights.grid_buffers.resize(imageCount);
+    _lights.grid_buf_memory.resize(imageCount);
+    _lights.index_buffers.resize(imageCount);
+    _lights.index_buf_memory.resize(imageCount);
+
+    /* Empty object draw lists still need valid buffers. */
+    uint64_t objectCount        = _instances.size();
+    uint64_t meshletObjectCount = std::max(_cull_uniform_buf_obj.meshlet_object_count, 1u);
+
+    VkDeviceSize staticIndicesSize = static_cast<uint64_t>(sizeof(_indices[0])) * _indices.size();
+
+    for( size_t i = 0; i < imageCount; i++ )
+    {
+        create_buffer(sizeof(_cull_uniform_buf_obj),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _cull.uniform_buffers[i],
+            _cull.uniform_buf_memory[i]
+        );
 
+        /* Worst case- every object is visible in every view. */
+        create_buffer(static_cast<uint64_t>(sizeof(Object_Draw)) * meshletObjectCount * CULL_VIEW_COUNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _cull.draw_buffers[i],
+            _cull.draw_buf_memory[i]
+        );
 
-    /* Allocate one pool which can contain up to swap images count descriptors sets. */
-    VkDescriptorPoolCreateInfo poolInfo = {};
-    poolInfo.sType  = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount  = static_cast<uint32_t>(poolSize.size());
-    poolInfo.pPoolSizes     = poolSize.data();
-    poolInfo.maxSets        = static_cast<uint32_t>(_swap_chain.swap_chain_images.size() + 1);
-    poolInfo.flags          = 0; /* Default Value */
+        create_buffer(sizeof(Cull_Counters),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _cull.count_buffers[i],
+            _cull.count_buf_memory[i]
+        );
 
-    if(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptor_pool) != VK_SUCCESS )
-        throw std::runtime_error("Failed to create descriptor pool. :( \n");
-}
+        create_buffer(sizeof(Cull_Counters),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _cull.stats_buffers[i],
+            _cull.stats_buf_memory[i]
+        );
 
-void Simulation::create_descriptor_sets()
-{
-    /* We will create one descriptor set for each swap chain image- all with the same layout. */
-    std::vector<VkDescriptorSetLayout> layouts(_swap_chain.swap_chain_images.size(), _descriptor_set_layout);
+        /* Static part is copied once, compacted region is rewritten every frame. */
+        create_buffer(staticIndicesSize + sizeof(uint32_t) * static_cast<uint64_t>(MESHLET_OUTPUT_INDICES),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _meshlet.index_buffers[i],
+            _meshlet.index_buf_memory[i]
+        );
+        copy_buffer(_index_buffer, _meshlet.index_buffers[i], staticIndicesSize);
 
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool        = _descriptor_pool;
-    allocInfo.descriptorSetCount    = static_cast<uint32_t>(_swap_chain.swap_chain_images.size());
-    allocInfo.pSetLayouts           = layouts.data();
+        /* Worst case- every chunk of every object is drawn in every view. */
+        create_buffer(static_cast<uint64_t>(sizeof(VkDrawIndexedIndirectCommand)) * meshletObjectCount * _cull_uniform_buf_obj.meshlet_chunk_count * CULL_VIEW_COUNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _meshlet.draw_buffers[i],
+            _meshlet.draw_buf_memory[i]
+        );
 
-    /* Allocate every descriptor set */
-    _descriptor_sets.scene.resize(_swap_chain.swap_chain_images.size());
-    if(vkAllocateDescriptorSets(_device, &allocInfo, _descriptor_sets.scene.data()) != VK_SUCCESS )
-        throw std::runtime_error("Failed to allocate descriptor sets. :( \n");
+        /* Objects change every frame - written directly by CPU and read by GPU from host visible memory. */
+        create_buffer(static_cast<uint64_t>(sizeof(ObjectData)) * objectCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _instancing.object_buffers[i],
+            _instancing.object_buf_memory[i]
+        );
 
-    /* Configure each descriptor. */
-    for( size_t i = 0; i<_swap_chain.swap_chain_images.size(); i++)
-    {
-        /* Specify UBO information */
-        VkDescriptorBufferInfo bufferInfo = {};
-        bufferInfo.buffer   = _scene_uniform_buffers[i];
-        bufferInfo.offset   = 0;
-        bufferInfo.range    = VK_WHOLE_SIZE;  /* If Updating whole buffer - we can use VK_WHOLE_SIZE */
-    
-        /* Specify Sampler information */
-        VkDescriptorImageInfo imageInfo {};
-        imageInfo.imageLayout   = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-        imageInfo.imageView     = _offscreen_pass.depth.image_view;
-        imageInfo.sampler       = _offscreen_pass.depth_sampler;
+        void* objectData;
+        vkMapMemory(_device, _instancing.object_buf_memory[i], 0, VK_WHOLE_SIZE, 0, &objectData);
+        _instancing.object_data[i] = static_cast<ObjectData*>(objectData);
 
-        std::array<VkWriteDescriptorSet, 2> descriptorWrite = {};
-        /* Descriptor set for buffer object. */
-        descriptorWrite[0].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite[0].dstSet  = _descriptor_sets.scene[i];
-        descriptorWrite[0].dstBinding      = 0;    /* Destination binding in shader */
-        descriptorWrite[0].dstArrayElement = 0;    /* Descriptors set can be an arrays, so we have to provide element to update. */
+        /* Every level of a mesh reserves room for all of its objects. */
+        create_buffer(sizeof(uint32_t) * objectCount * MESH_MAX_LODS * CULL_VIEW_COUNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _instancing.list_buffers[i],
+            _instancing.list_buf_memory[i]
+        );
+
+        create_buffer(static_cast<uint64_t>(sizeof(VkDrawIndexedIndirectCommand)) * _meshes.size() * MESH_MAX_LODS * CULL_VIEW_COUNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _instancing.draw_buffers[i],
+            _instancing.draw_buf_memory[i]
+        );
+
+        create_buffer(sizeof(_cluster_uniform_buf_obj),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _lights.uniform_buffers[i],
+            _lights.uniform_buf_memory[i]
+        );
+
+        /* Lights move every frame - written directly by CPU like objects. */
+        create_buffer(static_cast<uint64_t>(sizeof(Light_Data)) * MAX_LIGHTS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _lights.light_buffers[i],
+            _lights.light_buf_memory[i]
+        );
+
+        void* lightData;
+        vkMapMemory(_device, _lights.light_buf_memory[i], 0, VK_WHOLE_SIZE, 0, &lightData);
+        _lights.light_data[i] = static_cast<Light_Data*>(lightData);
+
+        /* Allocation counter padded to alignment of cluster ranges, followed by offset and count of every cluster. */
+        create_buffer(sizeof(uint32_t) * 2 * (1 + CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _lights.grid_buffers[i],
+            _lights.grid_buf_memory[i]
+        );
+
+        create_buffer(sizeof(uint32_t) * CLUSTER_AVERAGE_LIGHTS * CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _lights.index_buffers[i],
+            _lights.index_buf_memory[i]
+        );
+
+        /* Image may be acquired before it was ever rendered - start with empty statistics. */
+        void* data;
+        vkMapMemory(_device, _cull.stats_buf_memory[i], 0, VK_WHOLE_SIZE, 0, &data);
+        memset(data, 0, sizeof(Cull_Counters));
+        vkUnmapMemory(_device, _cull.stats_buf_memory[i]);
+    }
+
+    /* Temporal anti-aliasing - history weight changes after the first frame, so every image has own buffer. */
+    _taa.uniform_buffers.resize(imageCount);
+    _taa.uniform_buf_memory.resize(imageCount);
+
+    for( size_t i = 0; i < imageCount; i++ )
+    {
+        create_buffer(sizeof(_taa_uniform_buf_obj),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _taa.uniform_buffers[i],
+            _taa.uniform_buf_memory[i]
+        );
+    }
+
+    /* Auto exposure - adaptation rate follows frame time, so every image has own buffer. */
+    _exposure.uniform_buffers.resize(imageCount);
+    _exposure.uniform_buf_memory.resize(imageCount);
+
+    for( size_t i = 0; i < imageCount; i++ )
+    {
+        create_buffer(sizeof(_exposure_uniform_buf_obj),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _exposure.uniform_buffers[i],
+            _exposure.uniform_buf_memory[i]
+        );
+    }
+
+    /* New object buffers are filled by the first flush of every image. */
+    _instances.set_copy_count(static_cast<uint32_t>(imageCount));
+}
+
+void Simulation::create_descriptor_sets()
+{
+    /* We will create one descriptor set for each swap chain image- all with the same layout.
+    *  Sets are allocated by the allocator together with writing their descriptors - dstSet of writes is filled by it.
+    */
+    _descriptor_sets.scene.resize(_swap_chain.swap_chain_images.size());
+
+    /* Configure each descriptor. */
+    for( size_t i = 0; i<_swap_chain.swap_chain_images.size(); i++)
+    {
+        /* Specify UBO information */
+        VkDescriptorBufferInfo bufferInfo = {};
+        bufferInfo.buffer   = _scene_uniform_buffers[i];
+        bufferInfo.offset   = 0;
+        bufferInfo.range    = VK_WHOLE_SIZE;  /* If Updating whole buffer - we can use VK_WHOLE_SIZE */
+    
+        /* Specify Sampler information */
+        VkDescriptorImageInfo imageInfo {};
+        imageInfo.imageLayout   = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        imageInfo.imageView     = _offscreen_pass.depth.image_view;
+        imageInfo.sampler       = _offscreen_pass.depth_sampler;
+
+        /* Specify object storage buffer information */
+        VkDescriptorBufferInfo objectInfo = {};
+        objectInfo.buffer   = _instancing.object_buffers[i];
+        objectInfo.offset   = 0;
+        objectInfo.range    = VK_WHOLE_SIZE;
+
+        /* Specify visible instance list information */
+        VkDescriptorBufferInfo instanceInfo = {};
+        instanceInfo.buffer = _instancing.list_buffers[i];
+        instanceInfo.offset = 0;
+        instanceInfo.range  = VK_WHOLE_SIZE;
+
+        /* Specify light cluster information - lights, cluster grid and light index list */
+        std::array<VkDescriptorBufferInfo, 3> lightInfos = {};
+        lightInfos[0].buffer = _lights.light_buffers[i];
+        lightInfos[1].buffer = _lights.grid_buffers[i];
+        lightInfos[2].buffer = _lights.index_buffers[i];
+
+        std::array<VkWriteDescriptorSet, 7> descriptorWrite = {};
+        /* Descriptor set for buffer object. */
+        descriptorWrite[0].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite[0].dstBinding      = 0;    /* Destination binding in shader */
+        descriptorWrite[0].dstArrayElement = 0;    /* Descriptors set can be an arrays, so we have to provide element to update. */
         
         descriptorWrite[0].descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         descriptorWrite[0].descriptorCount = 1;
@@ -1057,7 +2720,6 @@ void Simulation::create_descriptor_sets()
 
         /* Descriptor set for texture sampler image info. */
         descriptorWrite[1].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite[1].dstSet  = _descriptor_sets.scene[i];
         descriptorWrite[1].dstBinding      = 1;    /* Destination binding in shader */
         descriptorWrite[1].dstArrayElement = 0;    /* Descriptors set can be an arrays, so we have to provide element to update. */
         
@@ -1068,192 +2730,430 @@ void Simulation::create_descriptor_sets()
         descriptorWrite[1].pImageInfo      = &imageInfo;       /* Array with the descriptors count structs - image samplers */
         descriptorWrite[1].pTexelBufferView = nullptr;         /* Optional */
 
-        vkUpdateDescriptorSets(_device, 
+        /* Descriptor set for object storage buffer. */
+        descriptorWrite[2].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite[2].dstBinding      = 2;
+        descriptorWrite[2].dstArrayElement = 0;
+        descriptorWrite[2].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite[2].descriptorCount = 1;
+        descriptorWrite[2].pBufferInfo     = &objectInfo;
+
+        /* Descriptor set for visible instance list. */
+        descriptorWrite[3].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite[3].dstBinding      = 3;
+        descriptorWrite[3].dstArrayElement = 0;
+        descriptorWrite[3].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite[3].descriptorCount = 1;
+        descriptorWrite[3].pBufferInfo     = &instanceInfo;
+
+        /* Descriptor sets for light clusters - bindings 4 to 6. */
+        for( uint32_t light = 0; light < lightInfos.size(); light++ )
+        {
+            lightInfos[light].offset = 0;
+            lightInfos[light].range  = VK_WHOLE_SIZE;
+
+            descriptorWrite[4 + light].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite[4 + light].dstBinding      = 4 + light;
+            descriptorWrite[4 + light].dstArrayElement = 0;
+            descriptorWrite[4 + light].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrite[4 + light].descriptorCount = 1;
+            descriptorWrite[4 + light].pBufferInfo     = &lightInfos[light];
+        }
+
+        _descriptor_sets.scene[i] = _descriptors->cached_set(_descriptor_set_layout, 
             static_cast<uint32_t>(descriptorWrite.size()),
-            descriptorWrite.data(), 
-            0, 
-            nullptr
+            descriptorWrite.data()
         );
     }
 
 
 
-    /* Configure descriptors for offscreen rendering. */
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &_descriptor_set_layout;
-    if(vkAllocateDescriptorSets(_device, &allocInfo, &_descriptor_sets.offscreen) != VK_SUCCESS )
-        throw std::runtime_error("Failed to allocate descriptor sets. :( \n");
+    /* Configure descriptors for offscreen rendering - objects and instance lists differ for every swap chain image.
+    *  Depth pre-pass sets differ only by uniform buffer - the scene one, whose layout its vertex shader declares.
+    */
+    _descriptor_sets.offscreen.resize(_swap_chain.swap_chain_images.size());
+    _descriptor_sets.prepass.resize(_swap_chain.swap_chain_images.size());
 
-    std::array<VkWriteDescriptorSet, 1> writeDescriptorSets = {};
-    
-    /* Specify UBO information */
-    VkDescriptorBufferInfo uboOffscreen = {};
-    uboOffscreen.buffer   = _offscreen_buffer.buffer;
-    uboOffscreen.offset   = 0;
-    uboOffscreen.range    = sizeof(UBOOffscreenVS);  /* If Updating whole buffer - we can use VK_WHOLE_SIZE */
-    
-    writeDescriptorSets = {};
-    /* Descriptor set for buffer object. */
-    writeDescriptorSets[0].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescriptorSets[0].dstSet  = _descriptor_sets.offscreen;
-    writeDescriptorSets[0].dstBinding      = 0;    /* Destination binding in shader */
-    writeDescriptorSets[0].dstArrayElement = 0;    /* Descriptors set can be an arrays, so we have to provide element to update. */
+    for( size_t i = 0; i<_swap_chain.swap_chain_images.size(); i++)
+    {
+        std::array<VkWriteDescriptorSet, 3> writeDescriptorSets = {};
+
+        /* Specify object storage buffer information */
+        VkDescriptorBufferInfo objectInfo = {};
+        objectInfo.buffer   = _instancing.object_buffers[i];
+        objectInfo.offset   = 0;
+        objectInfo.range    = VK_WHOLE_SIZE;
+
+        /* Specify visible instance list information */
+        VkDescriptorBufferInfo instanceInfo = {};
+        instanceInfo.buffer = _instancing.list_buffers[i];
+        instanceInfo.offset = 0;
+        instanceInfo.range  = VK_WHOLE_SIZE;
+
+        /* Descriptor set for buffer object. */
+        writeDescriptorSets[0].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[0].dstBinding      = 0;    /* Destination binding in shader */
+        writeDescriptorSets[0].dstArrayElement = 0;    /* Descriptors set can be an arrays, so we have to provide element to update. */
         
-    writeDescriptorSets[0].descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    writeDescriptorSets[0].descriptorCount = 1;
+        writeDescriptorSets[0].descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writeDescriptorSets[0].descriptorCount = 1;
+
+        writeDescriptorSets[0].pBufferInfo     = &_offscreen_buffer.descriptor;      /* Array with the descriptors count structs. */
+        writeDescriptorSets[0].pImageInfo      = nullptr;          /* Optional */
+        writeDescriptorSets[0].pTexelBufferView = nullptr;         /* Optional */
+
+        /* Descriptor set for object storage buffer. */
+        writeDescriptorSets[1].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[1].dstBinding      = 2;
+        writeDescriptorSets[1].dstArrayElement = 0;
+        writeDescriptorSets[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSets[1].descriptorCount = 1;
+        writeDescriptorSets[1].pBufferInfo     = &objectInfo;
+
+        /* Descriptor set for visible instance list. */
+        writeDescriptorSets[2].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[2].dstBinding      = 3;
+        writeDescriptorSets[2].dstArrayElement = 0;
+        writeDescriptorSets[2].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSets[2].descriptorCount = 1;
+        writeDescriptorSets[2].pBufferInfo     = &instanceInfo;
+
+        _descriptor_sets.offscreen[i] = _descriptors->cached_set(_descriptor_set_layout, 
+            static_cast<uint32_t>(writeDescriptorSets.size()),
+            writeDescriptorSets.data()
+        );
 
-    writeDescriptorSets[0].pBufferInfo     = &_offscreen_buffer.descriptor;      /* Array with the descriptors count structs. */
-    writeDescriptorSets[0].pImageInfo      = nullptr;          /* Optional */
-    writeDescriptorSets[0].pTexelBufferView = nullptr;         /* Optional */
+        VkDescriptorBufferInfo prepassInfo = {};
+        prepassInfo.buffer  = _scene_uniform_buffers[i];
+        prepassInfo.offset  = 0;
+        prepassInfo.range   = VK_WHOLE_SIZE;
 
-    vkUpdateDescriptorSets(_device, 
-        static_cast<uint32_t>(writeDescriptorSets.size()),
-        writeDescriptorSets.data(), 
-        0, 
-        nullptr
-    );
+        writeDescriptorSets[0].pBufferInfo     = &prepassInfo;
+
+        _descriptor_sets.prepass[i] = _descriptors->cached_set(_descriptor_set_layout, 
+            static_cast<uint32_t>(writeDescriptorSets.size()),
+            writeDescriptorSets.data()
+        );
+    }
+
+    /* Configure descriptors for culling compute shader - one set for each swap chain image. */
+    _cull.descriptor_sets.resize(_swap_chain.swap_chain_images.size());
+
+    /* Pyramid stays in general layout - it is written and sampled by compute shaders only. */
+    VkDescriptorImageInfo pyramidInfo = {};
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    pyramidInfo.imageView   = _hiz.view;
+    pyramidInfo.sampler     = _hiz.sampler;
+
+    for( size_t i = 0; i < _swap_chain.swap_chain_images.size(); i++ )
+    {
+        std::array<VkDescriptorBufferInfo, 9> bufferInfos = {};
+        bufferInfos[0].buffer = _instancing.object_buffers[i];
+        bufferInfos[1].buffer = _cull.uniform_buffers[i];
+        bufferInfos[2].buffer = _cull.draw_buffers[i];
+        bufferInfos[3].buffer = _cull.count_buffers[i];
+        bufferInfos[5].buffer = _cull.visibility_buffer;
+        bufferInfos[6].buffer = _instancing.list_buffers[i];
+        bufferInfos[7].buffer = _instancing.draw_buffers[i];
+        bufferInfos[8].buffer = _mesh_buffer;
+
+        std::array<VkWriteDescriptorSet, 9> cullWrites = {};
+        for( uint32_t binding = 0; binding < cullWrites.size(); binding++ )
+        {
+            bufferInfos[binding].offset = 0;
+            bufferInfos[binding].range  = VK_WHOLE_SIZE;
+
+            cullWrites[binding].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            cullWrites[binding].dstBinding      = binding;
+            cullWrites[binding].dstArrayElement = 0;
+            cullWrites[binding].descriptorType  = (binding == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            cullWrites[binding].descriptorCount = 1;
+            cullWrites[binding].pBufferInfo     = &bufferInfos[binding];
+        }
+
+        cullWrites[4].descriptorType    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        cullWrites[4].pBufferInfo       = nullptr;
+        cullWrites[4].pImageInfo        = &pyramidInfo;
+
+        _cull.descriptor_sets[i] = _descriptors->cached_set(_cull.descriptor_set_layout, static_cast<uint32_t>(cullWrites.size()), cullWrites.data());
+    }
+
+    /* Configure descriptors for meshlet culling - one set for each swap chain image. */
+    _meshlet.descriptor_sets.resize(_swap_chain.swap_chain_images.size());
+
+    for( size_t i = 0; i < _swap_chain.swap_chain_images.size(); i++ )
+    {
+        std::array<VkDescriptorBufferInfo, 10> bufferInfos = {};
+        bufferInfos[0].buffer = _instancing.object_buffers[i];
+        bufferInfos[1].buffer = _cull.uniform_buffers[i];
+        bufferInfos[2].buffer = _cull.draw_buffers[i];
+        bufferInfos[3].buffer = _cull.count_buffers[i];
+        bufferInfos[4].buffer = _meshlet.buffer;
+        bufferInfos[5].buffer = _index_buffer;
+        bufferInfos[6].buffer = _meshlet.index_buffers[i];
+        bufferInfos[7].buffer = _meshlet.draw_buffers[i];
+        bufferInfos[8].buffer = _instancing.list_buffers[i];
+        bufferInfos[9].buffer = _mesh_buffer;
+
+        std::array<VkWriteDescriptorSet, 10> meshletWrites = {};
+        for( uint32_t binding = 0; binding < meshletWrites.size(); binding++ )
+        {
+            bufferInfos[binding].offset = 0;
+            bufferInfos[binding].range  = VK_WHOLE_SIZE;
+
+            meshletWrites[binding].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            meshletWrites[binding].dstBinding      = binding;
+            meshletWrites[binding].dstArrayElement = 0;
+            meshletWrites[binding].descriptorType  = (binding == 1) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            meshletWrites[binding].descriptorCount = 1;
+            meshletWrites[binding].pBufferInfo     = &bufferInfos[binding];
+        }
+
+        _meshlet.descriptor_sets[i] = _descriptors->cached_set(_meshlet.descriptor_set_layout, static_cast<uint32_t>(meshletWrites.size()), meshletWrites.data());
+    }
+
+    /* Configure descriptors for light clustering - one set for each swap chain image. */
+    _lights.descriptor_sets.resize(_swap_chain.swap_chain_images.size());
+
+    for( size_t i = 0; i < _swap_chain.swap_chain_images.size(); i++ )
+    {
+        std::array<VkDescriptorBufferInfo, 4> bufferInfos = {};
+        bufferInfos[0].buffer = _lights.uniform_buffers[i];
+        bufferInfos[1].buffer = _lights.light_buffers[i];
+        bufferInfos[2].buffer = _lights.grid_buffers[i];
+        bufferInfos[3].buffer = _lights.index_buffers[i];
+
+        std::array<VkWriteDescriptorSet, 4> clusterWrites = {};
+        for( uint32_t binding = 0; binding < clusterWrites.size(); binding++ )
+        {
+            bufferInfos[binding].offset = 0;
+            bufferInfos[binding].range  = VK_WHOLE_SIZE;
+
+            clusterWrites[binding].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            clusterWrites[binding].dstBinding      = binding;
+            clusterWrites[binding].dstArrayElement = 0;
+            clusterWrites[binding].descriptorType  = (binding == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            clusterWrites[binding].descriptorCount = 1;
+            clusterWrites[binding].pBufferInfo     = &bufferInfos[binding];
+        }
+
+        _lights.descriptor_sets[i] = _descriptors->cached_set(_lights.descriptor_set_layout, static_cast<uint32_t>(clusterWrites.size()), clusterWrites.data());
+    }
+
+    /* Configure descriptors for depth pyramid reduction - one set for each level. */
+    _hiz.descriptor_sets.resize(_hiz.levels);
+
+    for( uint32_t level = 0; level < _hiz.levels; level++ )
+    {
+        /* First level is reduced from scene depth, every next one from the previous level. */
+        VkDescriptorImageInfo srcInfo = {};
+        srcInfo.sampler     = _hiz.sampler;
+        srcInfo.imageView   = (level == 0) ? _scene_pass.depth.image_view : _hiz.mip_views[level - 1];
+        srcInfo.imageLayout = (level == 0) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo dstInfo = {};
+        dstInfo.imageView   = _hiz.mip_views[level];
+        dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> hizWrites = {};
+        hizWrites[0].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        hizWrites[0].dstBinding      = 0;
+        hizWrites[0].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        hizWrites[0].descriptorCount = 1;
+        hizWrites[0].pImageInfo      = &srcInfo;
+
+        hizWrites[1].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        hizWrites[1].dstBinding      = 1;
+        hizWrites[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        hizWrites[1].descriptorCount = 1;
+        hizWrites[1].pImageInfo      = &dstInfo;
+
+        _hiz.descriptor_sets[level] = _descriptors->cached_set(_hiz.descriptor_set_layout, static_cast<uint32_t>(hizWrites.size()), hizWrites.data());
+    }
+
+    /* Configure descriptors for temporal anti-aliasing - one set for each swap chain image, they differ by uniform buffer. */
+    _taa.descriptor_sets.clear();
+
+    if( _taa.enabled )
+    {
+        _taa.descriptor_sets.resize(_swap_chain.swap_chain_images.size());
+
+        /* Scene color, velocity and history are sampled, output is written as storage image. */
+        std::array<VkDescriptorImageInfo, 4> imageInfos = {};
+        imageInfos[0] = { _taa.sampler, _scene_pass.color.image_view,       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        imageInfos[1] = { _taa.sampler, _scene_pass.velocity.image_view,    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        imageInfos[2] = { _taa.sampler, _taa.history.image_view,            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        imageInfos[3] = { VK_NULL_HANDLE, _taa.output.image_view,           VK_IMAGE_LAYOUT_GENERAL };
+
+        for( size_t i = 0; i < _swap_chain.swap_chain_images.size(); i++ )
+        {
+            VkDescriptorBufferInfo bufferInfo = {};
+            bufferInfo.buffer   = _taa.uniform_buffers[i];
+            bufferInfo.offset   = 0;
+            bufferInfo.range    = VK_WHOLE_SIZE;
+
+            std::array<VkWriteDescriptorSet, 5> taaWrites = {};
+            for( uint32_t binding = 0; binding < taaWrites.size(); binding++ )
+            {
+                taaWrites[binding].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                taaWrites[binding].dstBinding      = binding;
+                taaWrites[binding].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                taaWrites[binding].descriptorCount = 1;
+                taaWrites[binding].pImageInfo      = (binding > 0) ? &imageInfos[binding - 1] : nullptr;
+            }
+
+            taaWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            taaWrites[0].pBufferInfo    = &bufferInfo;
+            taaWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+            _taa.descriptor_sets[i] = _descriptors->cached_set(_taa.descriptor_set_layout, static_cast<uint32_t>(taaWrites.size()), taaWrites.data());
+        }
+    }
+
+    /* Configure descriptors for auto exposure - one set for each swap chain image, they differ by uniform buffer. */
+    _exposure.descriptor_sets.resize(_swap_chain.swap_chain_images.size());
+
+    VkDescriptorImageInfo sceneColorInfo = { _taa.sampler, _scene_pass.color.image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+    VkDescriptorBufferInfo exposureInfo = {};
+    exposureInfo.buffer = _exposure.buffer;
+    exposureInfo.offset = 0;
+    exposureInfo.range  = VK_WHOLE_SIZE;
+
+    for( size_t i = 0; i < _swap_chain.swap_chain_images.size(); i++ )
+    {
+        VkDescriptorBufferInfo bufferInfo = {};
+        bufferInfo.buffer   = _exposure.uniform_buffers[i];
+        bufferInfo.offset   = 0;
+        bufferInfo.range    = VK_WHOLE_SIZE;
+
+        std::array<VkWriteDescriptorSet, 3> exposureWrites = {};
+        for( uint32_t binding = 0; binding < exposureWrites.size(); binding++ )
+        {
+            exposureWrites[binding].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            exposureWrites[binding].dstBinding      = binding;
+            exposureWrites[binding].descriptorCount = 1;
+        }
+
+        exposureWrites[0].descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        exposureWrites[0].pBufferInfo       = &bufferInfo;
+        exposureWrites[1].descriptorType    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        exposureWrites[1].pImageInfo        = &sceneColorInfo;
+        exposureWrites[2].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        exposureWrites[2].pBufferInfo       = &exposureInfo;
+
+        _exposure.descriptor_sets[i] = _descriptors->cached_set(_exposure.descriptor_set_layout, static_cast<uint32_t>(exposureWrites.size()), exposureWrites.data());
+    }
+
+    /* Configure descriptors for present pass - TAA history, or scene color without TAA, and exposure. Shared by all swap chain images. */
+    VkDescriptorImageInfo frameInfo = {};
+    frameInfo.sampler       = _taa.sampler;
+    frameInfo.imageView     = _taa.enabled ? _taa.history.image_view : _scene_pass.color.image_view;
+    frameInfo.imageLayout   = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    std::array<VkWriteDescriptorSet, 2> presentWrites = {};
+    presentWrites[0].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    presentWrites[0].dstBinding      = 0;
+    presentWrites[0].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    presentWrites[0].descriptorCount = 1;
+    presentWrites[0].pImageInfo      = &frameInfo;
+
+    presentWrites[1].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    presentWrites[1].dstBinding      = 1;
+    presentWrites[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    presentWrites[1].descriptorCount = 1;
+    presentWrites[1].pBufferInfo     = &exposureInfo;
+
+    _present_pass.descriptor_set = _descriptors->cached_set(_present_pass.descriptor_set_layout, static_cast<uint32_t>(presentWrites.size()), presentWrites.data());
 }
 
 void Simulation::create_command_buffers()
 {
-    // Allocate and record commands for each swap chain image.
-    _command_buffers.resize(_scene_pass.framebuffers.size());
+    // Allocate and record commands for each swap chain image - one command buffer for each segment of render graph.
+    _command_buffers.resize(_swap_chain.swap_chain_images.size());
 
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool           = _command_pool;
     allocInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;  //Can be submitted to a queue for execution, but cannot be called from other command buffers.
-    allocInfo.commandBufferCount    = static_cast<uint32_t>(_command_buffers.size());
-    
-    if( vkAllocateCommandBuffers(_device, &allocInfo, _command_buffers.data()) != VK_SUCCESS)
-        throw std::runtime_error("Failed to allocate command buffers. :( \n");
+    allocInfo.commandBufferCount    = 1;
 
-     /* Clear values - specify clear operation.
-     * Order of clear values should be same as attachments.
-     */
-     std::array<VkClearValue, 2> clearValues;
+    for( auto& commandBuffers : _command_buffers )
+    {
+        commandBuffers.resize(_render_graph->segment_count());
+
+        for( uint32_t segment = 0; segment < commandBuffers.size(); segment++ )
+        {
+            allocInfo.commandPool = (_render_graph->segment_queue(segment) == GRAPH_QUEUE_COMPUTE) ? _compute_command_pool : _command_pool;
+
+            if( vkAllocateCommandBuffers(_device, &allocInfo, &commandBuffers[segment]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate command buffers. :( \n");
+        }
+    }
+
+    /* Timestamps of segments - written by the command buffers, read back by update_gpu_timing(). */
+    _gpu_timing.query_pools.assign(_command_buffers.size(), VK_NULL_HANDLE);
+    _gpu_timing.submitted.assign(_command_buffers.size(), false);
+    _gpu_timing.scales.assign(_command_buffers.size(), _resolution.scale);
+    _gpu_timing.graphics_intervals.clear();
+
+    if( _device_support.timestamp_period != 0.f )
+    {
+        VkQueryPoolCreateInfo queryPoolInfo = {};
+        queryPoolInfo.sType         = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType     = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount    = 2 * _render_graph->segment_count();
+
+        for( auto& queryPool : _gpu_timing.query_pools )
+        {
+            if( vkCreateQueryPool(_device, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS )
+                throw std::runtime_error("Failed to create query pool. :( \n");
+        }
+    }
+
+    _hot_reload.recorded_generation.assign(_command_buffers.size(), _hot_reload.generation);
+    _resolution.recorded_scales.assign(_command_buffers.size(), _resolution.scale);
+
+    for( uint32_t i = 0; i < _command_buffers.size(); i++ )
+        record_command_buffer(i);
+}
+
+void Simulation::record_command_buffer(uint32_t imageIndex)
+{
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = 0;                    // Optional
+    beginInfo.pInheritanceInfo  = nullptr;  // Optional
 
-    // Starting command buffer recording
-    for( size_t i = 0; i<_command_buffers.size(); i++)
+    /* Image is not in flight - frame sets bound by its previous recording can be released. */
+    _descriptors->begin_frame(imageIndex);
+
+    /* Viewports, render areas and dispatch sizes below are recorded for current resolution scale. */
+    _resolution.recorded_scales[imageIndex] = _resolution.scale;
+
+    VkQueryPool queryPool = _gpu_timing.query_pools[imageIndex];
+
+    for( uint32_t segment = 0; segment < _command_buffers[imageIndex].size(); segment++ )
     {
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = 0;                    // Optional
-        beginInfo.pInheritanceInfo  = nullptr;  // Optional
+        VkCommandBuffer commandBuffer = _command_buffers[imageIndex][segment];
 
         /* If the command buffer was already recorded once, then a call to vkBeginCommandBuffer will implicitly reset it. */
-        if( vkBeginCommandBuffer( _command_buffers[i], &beginInfo) != VK_SUCCESS)
+        if( vkBeginCommandBuffer( commandBuffer, &beginInfo) != VK_SUCCESS)
             throw std::runtime_error("Failed to begin recording command buffer. :( \n");
 
-        /*
-            First render pass: Generate shadow map by rendering the scene from light's POV
-        */
+        if( queryPool != VK_NULL_HANDLE )
         {
-            clearValues[0].depthStencil = {1.f, 0};
-
-            VkRenderPassBeginInfo renderPassInfo {};
-            renderPassInfo.sType    = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderPassInfo.renderPass   = _offscreen_pass.render_pass;
-            renderPassInfo.framebuffer  = _offscreen_pass.frameBuffer;
-            renderPassInfo.renderArea.extent.width      = _windowWidth;
-            renderPassInfo.renderArea.extent.height     = _windowHeight;
-            renderPassInfo.renderArea.offset            = {0, 0};
-            renderPassInfo.clearValueCount              = 1;
-            renderPassInfo.pClearValues                 = clearValues.data();
-
-            vkCmdBeginRenderPass(_command_buffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-            vkCmdBindPipeline(_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.offscreen);
-
-            VkViewport viewport {};
-            viewport.width  = static_cast<float>(_windowWidth);
-            viewport.height = static_cast<float>(_windowHeight);
-            viewport.minDepth = 0.f;
-            viewport.maxDepth = 1.f;
-            vkCmdSetViewport(_command_buffers[i], 0, 1, &viewport);
-
-            VkRect2D scissor {};
-            scissor.extent.height   = _windowWidth;
-            scissor.extent.width    = _windowHeight;
-            scissor.offset.x    = 0;
-            scissor.offset.y    = 0;
-            vkCmdSetScissor(_command_buffers[i], 0, 1, &scissor);
-
-            /* Set depth bias. Avoiding artifacts. */
-            vkCmdSetDepthBias(_command_buffers[i], 1.25f, 0, 1.75f);
-
-            vkCmdBindDescriptorSets(_command_buffers[i], 
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                _pipeline_layouts.offscreen,
-                0,
-                1,
-                &_descriptor_sets.offscreen,
-                0,
-                nullptr
-            );
-
-            VkBuffer vertexBuffers[] = {_vertex_buffer};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(_command_buffers[i], 0, 1, vertexBuffers, offsets);
-            vkCmdBindIndexBuffer(_command_buffers[i], _index_buffer, 0, VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(_command_buffers[i], static_cast<uint32_t>(_indices.size()), 1, 0, 0, 0);
-
-            vkCmdEndRenderPass(_command_buffers[i]);
+            vkCmdResetQueryPool(commandBuffer, queryPool, 2 * segment, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * segment);
         }
 
+        /* Culling, shadow pass, early scene pass, depth pyramid, late culling and late scene pass - passes of this segment with barriers between them. */
+        _render_graph->execute(commandBuffer, imageIndex, segment);
 
+        if( queryPool != VK_NULL_HANDLE )
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * segment + 1);
 
-        /*
-            Second render pass: Generate scene with applied shadows by using generated previously shadow map.
-        */
-        {
-            VkRenderPassBeginInfo renderPassInfo = {};
-            renderPassInfo.sType    = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderPassInfo.renderPass   = _scene_pass.render_pass;
-            renderPassInfo.framebuffer  = _scene_pass.framebuffers[i];
-            
-            /* Define size of render area */
-            renderPassInfo.renderArea.offset    = {0,0};
-            renderPassInfo.renderArea.extent    = _swap_chain.swap_chain_extent;
-            
-           
-            clearValues[0].color = {0.f, 0.f, 0.f, 1.f};
-            clearValues[1].depthStencil = {1.f, 0}; 
-            renderPassInfo.clearValueCount  = static_cast<uint32_t>(clearValues.size());
-            renderPassInfo.pClearValues     = clearValues.data();
-            
-            /* RECORDING */
-            vkCmdBeginRenderPass(_command_buffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-            
-            vkCmdBindPipeline(_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.scene);
-
-            /* Binding vertex buffer */
-            VkBuffer vertexBuffers[] = {_vertex_buffer};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(_command_buffers[i], 0, 1, vertexBuffers, offsets);
-
-            /* Binding index buffer */
-            vkCmdBindIndexBuffer(_command_buffers[i], _index_buffer, 0, VK_INDEX_TYPE_UINT32);
-
-            /* Bind descriptor sets- to update uniform data. */
-            vkCmdBindDescriptorSets(_command_buffers[i], 
-                VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                _pipeline_layouts.scene, 
-                0, 
-                1, 
-                &_descriptor_sets.scene[i], 
-                0, 
-                nullptr);
-
-            /* Draw command by using indexes of vertices. */
-            vkCmdDrawIndexed(_command_buffers[i], static_cast<uint32_t>(_indices.size()), 1, 0, 0, 0);
-
-            /* END RECORDING */
-            vkCmdEndRenderPass(_command_buffers[i]);
-
-            if( vkEndCommandBuffer( _command_buffers[i]) != VK_SUCCESS )
-                throw std::runtime_error("Failed to record command buffer! :( \n");
-        }
+        if( vkEndCommandBuffer( commandBuffer) != VK_SUCCESS )
+            throw std::runtime_error("Failed to record command buffer! :( \n");
     }
 }
 
@@ -1281,6 +3181,44 @@ void Simulation::create_sync_objects()
             throw std::runtime_error("Failed to create semaphores :( \n");
         }
     }
+
+    /* Queues of passes do not change when render graph is rebuilt with the swap chain - neither does the number of segments. */
+    _sync_obj.segment_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    for( auto& semaphores : _sync_obj.segment_semaphores )
+    {
+        semaphores.resize(_render_graph->segment_count() - 1);
+
+        for( auto& semaphore : semaphores )
+        {
+            if( vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS )
+                throw std::runtime_error("Failed to create semaphores :( \n");
+        }
+    }
+}
+
+void Simulation::create_frame_capture()
+{
+    _capture.pending_slots.fill(FrameCapture::NO_SLOT);
+
+    if( !_swap_chain.transfer_source || !FrameCapture::supports(_swap_chain.swap_chain_image_format) )
+    {
+        std::cout << "Swap chain images cannot be captured - screenshots are disabled.\n";
+        _capture.sequence_enabled = false;
+        return;
+    }
+
+    _capture.capture = std::make_unique<FrameCapture>(_device, _physical_device, _swap_chain.swap_chain_extent,
+        _swap_chain.swap_chain_image_format, CAPTURE_DIR);
+
+    /* One for each frame in flight slot - recorded only for frames which are captured. */
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool           = _command_pool;
+    allocInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount    = static_cast<uint32_t>(_capture.command_buffers.size());
+
+    if( vkAllocateCommandBuffers(_device, &allocInfo, _capture.command_buffers.data()) != VK_SUCCESS )
+        throw std::runtime_error("Failed to allocate command buffers. :( \n");
 }
 
 void Simulation::create_surface()
@@ -1310,6 +3248,10 @@ QueueFamilyIndices Simulation::find_queue_families(VkPhysicalDevice device)
             indices.graphicsFamily = i;
         }
 
+        /* Dedicated compute family - its queue runs in parallel with the graphics one on most hardware. */
+        if( (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.computeFamily.has_value() )
+            indices.computeFamily = i;
+
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentSupport);
 
@@ -1372,6 +3314,18 @@ VkFormat Simulation::find_depth_format()
                 );
 }
 
+/* Highest sample count supported by scene pass which does not exceed requested count (and MSAA_MAX_SAMPLES) */
+VkSampleCountFlagBits Simulation::msaa_sample_count(uint32_t samples)
+{
+    for( uint32_t count = std::min(samples, static_cast<uint32_t>(MSAA_MAX_SAMPLES)); count > 1; count /= 2 )
+    {
+        if( _device_support.msaa_sample_counts & count )
+            return static_cast<VkSampleCountFlagBits>(count);
+    }
+
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
 SwapChainSupportDetails Simulation::query_swap_chain_support(VkPhysicalDevice device)
 {
     SwapChainSupportDetails details;
@@ -1413,11 +3367,14 @@ VkSurfaceFormatKHR Simulation::choose_swap_surface_format(const std::vector<VkSu
     return availableFormats[0];
 }
 
+/* Requested mode if surface supports it - FIFO otherwise, which every surface supports.
+*  FIFO waits for vertical blank, MAILBOX replaces the queued image by a newer one, IMMEDIATE presents at once and may tear.
+*/
 VkPresentModeKHR Simulation::choose_swap_present_mode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
     for( const auto& availablePresentMode : availablePresentModes )
     {
-        if( availablePresentMode == VK_PRESENT_MODE_FIFO_KHR )
+        if( availablePresentMode == _frame_pacing.requested_present_mode )
             return availablePresentMode;
     }
 
@@ -1453,12 +3410,30 @@ VkExtent2D Simulation::choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabi
     }
 }
 
-VkShaderModule Simulation::creates_shader_module(const std::vector<char>& code)
+/* Part of scene attachments rendered this frame - top-left corner of swap chain sized images. */
+VkExtent2D Simulation::render_extent() const
+{
+    return {
+        std::max(static_cast<uint32_t>(_swap_chain.swap_chain_extent.width * _resolution.scale + 0.5f), 1u),
+        std::max(static_cast<uint32_t>(_swap_chain.swap_chain_extent.height * _resolution.scale + 0.5f), 1u)
+    };
+}
+
+/* Part of shadow map rendered this frame - scaled with the scene. */
+VkExtent2D Simulation::shadow_extent() const
+{
+    return {
+        std::max(static_cast<uint32_t>(_windowWidth * _resolution.scale + 0.5f), 1u),
+        std::max(static_cast<uint32_t>(_windowHeight * _resolution.scale + 0.5f), 1u)
+    };
+}
+
+VkShaderModule Simulation::creates_shader_module(const std::vector<uint32_t>& code)
 {
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.codeSize = code.size() * sizeof(uint32_t);
+    createInfo.pCode = code.data();
 
     VkShaderModule shaderModule;
     if( vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS )
@@ -1477,6 +3452,15 @@ void Simulation::create_buffer(VkDeviceSize deviceSize, VkBufferUsageFlags usage
     bufferInfo.flags    = 0;                                    /* No additional parameters */
     bufferInfo.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
 
+    /* Buffers are used by passes of both queues - concurrent sharing spares ownership transfers of every buffer. */
+    uint32_t queueFamilies[] = { _queues.graphics_family, _queues.compute_family };
+    if( _device_support.async_compute )
+    {
+        bufferInfo.sharingMode              = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount    = 2;
+        bufferInfo.pQueueFamilyIndices      = queueFamilies;
+    }
+
     if(vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS )
         throw std::runtime_error("Failed to create vertex buffer. :( \n");
 
@@ -1495,7 +3479,38 @@ void Simulation::create_buffer(VkDeviceSize deviceSize, VkBufferUsageFlags usage
     vkBindBufferMemory(_device, buffer, bufferMemory, 0);
 }
 
-void Simulation::create_image(uint32_t width, uint32_t height, VkFormat imageFormat, VkImageTiling imgTiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags imgMemoryProperties, VkImage & image, VkDeviceMemory & imgMemory)
+void Simulation::create_device_local_buffer(const void* srcData, VkDeviceSize deviceSize, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
+    /* Temporary host buffer to copy data from CPU to GPU */
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+
+    create_buffer(deviceSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer,
+        stagingBufferMemory);
+
+    void* data;
+    if( vkMapMemory(_device, stagingBufferMemory, 0, deviceSize, 0, &data) != VK_SUCCESS )
+        throw std::runtime_error("Failed to map staging buffer. :( \n");
+
+    memcpy(data, srcData, (size_t)deviceSize);
+    vkUnmapMemory(_device, stagingBufferMemory);
+
+    create_buffer(deviceSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        buffer,
+        bufferMemory);
+
+    copy_buffer(stagingBuffer, buffer, deviceSize);
+
+    vkDestroyBuffer(_device, stagingBuffer, nullptr);
+    vkFreeMemory(_device, stagingBufferMemory, nullptr);
+}
+
+void Simulation::create_image(uint32_t width, uint32_t height, VkFormat imageFormat, VkImageTiling imgTiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags imgMemoryProperties, VkImage & image, VkDeviceMemory & imgMemory, uint32_t mipLevels)
 {
     /* Create object to hold image data. */
     VkImageCreateInfo imageInfo = {};
@@ -1504,7 +3519,7 @@ void Simulation::create_image(uint32_t width, uint32_t height, VkFormat imageFor
     imageInfo.extent.width  = static_cast<uint32_t>(width);
     imageInfo.extent.height = static_cast<uint32_t>(height);
     imageInfo.extent.depth  = 1;
-    imageInfo.mipLevels     = 1;
+    imageInfo.mipLevels     = mipLevels;
     imageInfo.arrayLayers   = 1;
     imageInfo.format        = imageFormat;
     imageInfo.tiling        = imgTiling;
@@ -1537,7 +3552,7 @@ void Simulation::create_image(uint32_t width, uint32_t height, VkFormat imageFor
     vkBindImageMemory(_device, image, imgMemory, 0);
 }
 
-VkImageView Simulation::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView Simulation::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel, uint32_t levelCount)
 {
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType  = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1545,8 +3560,8 @@ VkImageView Simulation::create_image_view(VkImage image, VkFormat format, VkImag
     viewInfo.viewType   = VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format     = format;
     viewInfo.subresourceRange.aspectMask        = aspectFlags;
-    viewInfo.subresourceRange.baseMipLevel      = 0;
-    viewInfo.subresourceRange.levelCount        = 1;
+    viewInfo.subresourceRange.baseMipLevel      = baseMipLevel;
+    viewInfo.subresourceRange.levelCount        = levelCount;
     viewInfo.subresourceRange.baseArrayLayer    = 0;
     viewInfo.subresourceRange.layerCount        = 1;
 
@@ -1602,19 +3617,68 @@ void Simulation::copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t w
     end_single_time_commands(commandBuffer);
 }
 
+Simulation::FrameBufferAttachment Simulation::load_texture(const std::string& path)
+{
+    int texWidth;
+    int texHeight;
+    int texChannels;
+
+    stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if( pixels == nullptr )
+        throw std::runtime_error("Failed to load texture image " + path + " :( \n");
+
+    VkDeviceSize imageSize = static_cast<VkDeviceSize>(texWidth) * texHeight * 4;
+
+    /* Pixels are copied into device local image through host visible staging buffer. */
+    VkBuffer        stagingBuffer;
+    VkDeviceMemory  stagingBufferMemory;
+    create_buffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(_device, stagingBufferMemory, 0, imageSize, 0, &data);
+    memcpy(data, pixels, static_cast<size_t>(imageSize));
+    vkUnmapMemory(_device, stagingBufferMemory);
+
+    stbi_image_free(pixels);
+
+    FrameBufferAttachment texture;
+    create_image(static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight),
+        VK_FORMAT_R8G8B8A8_SRGB,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        texture.image,
+        texture.memory);
+
+    transition_image_layout(texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    copy_buffer_to_image(stagingBuffer, texture.image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+    transition_image_layout(texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    vkDestroyBuffer(_device, stagingBuffer, nullptr);
+    vkFreeMemory(_device, stagingBufferMemory, nullptr);
+
+    texture.image_view = create_image_view(texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    return texture;
+}
+
 void Simulation::update_variables(uint32_t imageIndex)
 {
     /* Update Time information */
     update_DT();
 
-    /* Update mouse move variables */
-    update_mouse_input();
+    /* Benchmark measures a fixed view - camera and LOD bias are not controlled by user. */
+    if( !_benchmark.enabled )
+    {
+        /* Update mouse move variables */
+        update_mouse_input();
 
-    /* According to mouse offset values update camera pitch/yaw/roll */
-    _camera.updateMouseInput(_time.dt, _mouse_input.mouse_offset_X, _mouse_input.mouse_offset_Y);
+        /* According to mouse offset values update camera pitch/yaw/roll */
+        _camera.updateMouseInput(_time.dt, _mouse_input.mouse_offset_X, _mouse_input.mouse_offset_Y);
 
-    /* Check keyboard input. */
-    update_keyboard_input();
+        /* Check keyboard input. */
+        update_keyboard_input();
+    }
 
     /* Update light position */
     update_light();
@@ -1624,6 +3688,21 @@ void Simulation::update_variables(uint32_t imageIndex)
 
     /* With information about current image we can update its uniform buffer. */
     update_scene_uniform_buf(imageIndex);
+
+    /* History weight of this frame - camera matrices of this frame become the previous ones. */
+    update_taa_uniform_buf(imageIndex);
+
+    /* Adaptation of exposure made by this frame. */
+    update_exposure_uniform_buf(imageIndex);
+
+    /* Frustum planes are extracted from matrices calculated above. */
+    update_cull_uniform_buf(imageIndex);
+
+    /* Lights and camera matrices their clusters are built with. */
+    update_lights(imageIndex);
+
+    /* Upload objects modified since this image was rendered last time. */
+    update_instances(imageIndex);
 }
 
 void Simulation::update_DT()
@@ -1633,24 +3712,71 @@ void Simulation::update_DT()
     _time.lastTime = _time.currTime;
 }
 
-void Simulation::update_scene_uniform_buf(uint32_t currentImage)
+/* Element of Halton low discrepancy sequence - radical inverse of index in given base, in [0; 1). */
+static float halton(uint32_t index, uint32_t base)
 {
-    /* Update variables inside uniform buffer */
-    glm::mat4 modelMat  = glm::mat4(1.f);
+    float result    = 0.f;
+    float fraction  = 1.f;
+
+    while( index > 0 )
+    {
+        fraction    /= base;
+        result      += fraction * (index % base);
+        index       /= base;
+    }
+
+    return result;
+}
+
+void Simulation::update_scene_uniform_buf(uint32_t currentImage)
+{
+    /* Update variables inside uniform buffer */
     glm::mat4 viewMat   = _camera.getViewMatrix();
     glm::mat4 projMat   = glm::perspective(glm::radians(_light.light_FOV),
                         _swap_chain.swap_chain_extent.width / static_cast<float>(_swap_chain.swap_chain_extent.height),
-                        0.1f,
-                        50.f);
+                        CAMERA_NEAR,
+                        CAMERA_FAR);
     /* GLM was originally designed for OpenGL, it is important to revert scaling factor of Y axis. */
     projMat[1][1] *= -1;
 
-    _scene_uniform_buf_obj.modelMat     = modelMat;
-    _scene_uniform_buf_obj.viewProjMat  = projMat * viewMat;
+    /* Clusters are built in view space - their corners are unprojected by inverse projection. */
+    _cluster_uniform_buf_obj.view       = viewMat;
+    _cluster_uniform_buf_obj.inv_proj   = glm::inverse(projMat);
+
+    /* Temporal anti-aliasing - projection is shifted by a subpixel offset from Halton (2, 3) sequence, so every frame samples
+    *  another position inside the pixel. Offset is in NDC - one rendered pixel spans 2 / extent.
+    */
+    VkExtent2D renderExtent = render_extent();
+    glm::vec2 jitter = glm::vec2(0.f);
+    if( _taa.enabled )
+    {
+        uint32_t phase = _taa.frame % TAA_JITTER_PHASES + 1;
+        jitter = glm::vec2(halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f) * 2.f
+               / glm::vec2(renderExtent.width, renderExtent.height);
+    }
+
+    _scene_uniform_buf_obj.viewProjMat  = glm::translate(glm::mat4(1.f), glm::vec3(jitter, 0.f)) * projMat * viewMat;
+
+    /* The first frame of history has no previous one - no motion. */
+    bool firstFrame = (_taa.frame == 0);
+    _scene_uniform_buf_obj.prevViewProjMat  = firstFrame ? _scene_uniform_buf_obj.viewProjMat : _taa.prev_view_proj;
+    _scene_uniform_buf_obj.jitter           = glm::vec4(jitter, firstFrame ? jitter : _taa.prev_jitter);
+
+    /* Shadow samples are rotated by golden angle every frame - consecutive frames cover the filter disk evenly. */
+    _scene_uniform_buf_obj.temporalParams   = glm::vec4(std::fmod(_taa.frame * 2.39996323f, glm::radians(360.f)), 0.f, 0.f, 0.f);
 
     _scene_uniform_buf_obj.cameraPos    = glm::vec4(_camera.getPosition(), 1.f);
-    _scene_uniform_buf_obj.DepthMVP     = _offscreen_uniform_buf_obj.proj * _offscreen_uniform_buf_obj.view * _offscreen_uniform_buf_obj.model;
+
+    /* Shadow map is drawn into its part scaled by dynamic resolution - light space NDC is squeezed into the same part before lookup. */
+    VkExtent2D shadowExtent = shadow_extent();
+    glm::vec2 shadowScale   = glm::vec2(shadowExtent.width / static_cast<float>(_windowWidth), shadowExtent.height / static_cast<float>(_windowHeight));
+    glm::mat4 shadowRegion  = glm::translate(glm::mat4(1.f), glm::vec3(shadowScale - 1.f, 0.f)) * glm::scale(glm::mat4(1.f), glm::vec3(shadowScale, 1.f));
+    _scene_uniform_buf_obj.DepthMVP     = shadowRegion * _offscreen_uniform_buf_obj.proj * _offscreen_uniform_buf_obj.view;
     _scene_uniform_buf_obj.lightPos     = glm::vec4(_light.light_pos, 1.f);
+    _scene_uniform_buf_obj.clusterParams = glm::vec4(renderExtent.width / static_cast<float>(CLUSTER_GRID_X),
+                                                     renderExtent.height / static_cast<float>(CLUSTER_GRID_Y),
+                                                     CAMERA_NEAR,
+                                                     CAMERA_FAR);
 
     /* With providing this information, we can now map memory of the uniform buffer. */
     void* data;
@@ -1664,214 +3790,1440 @@ void Simulation::update_scene_uniform_buf(uint32_t currentImage)
     vkUnmapMemory(_device, _scene_uniform_buf_memory[currentImage]);
 }
 
-void Simulation::update_offscreen_uniform_buf()
+void Simulation::update_taa_uniform_buf(uint32_t currentImage)
+{
+    /* History does not exist before the first frame - it is replaced by the current frame. */
+    VkExtent2D renderExtent = render_extent();
+    _taa_uniform_buf_obj.texel_size     = glm::vec2(1.f / _swap_chain.swap_chain_extent.width, 1.f / _swap_chain.swap_chain_extent.height);
+    _taa_uniform_buf_obj.history_weight = (_taa.frame == 0) ? 0.f : TAA_HISTORY_WEIGHT;
+    _taa_uniform_buf_obj.pad            = 0.f;
+    _taa_uniform_buf_obj.render_size    = glm::vec2(renderExtent.width, renderExtent.height);
+    _taa_uniform_buf_obj.history_scale  = _taa.history_scale;
+
+    void* data;
+    vkMapMemory(_device, _taa.uniform_buf_memory[currentImage], 0, VK_WHOLE_SIZE, 0, &data);
+    memcpy(data, &_taa_uniform_buf_obj, sizeof(_taa_uniform_buf_obj));
+    vkUnmapMemory(_device, _taa.uniform_buf_memory[currentImage]);
+
+    /* Velocity of the next frame is measured against this one. */
+    _taa.prev_view_proj = _scene_uniform_buf_obj.viewProjMat;
+    _taa.prev_jitter    = glm::vec2(_scene_uniform_buf_obj.jitter);
+    _taa.history_scale  = _taa_uniform_buf_obj.render_size * _taa_uniform_buf_obj.texel_size;
+    _taa.frame++;
+}
+
+void Simulation::update_exposure_uniform_buf(uint32_t currentImage)
+{
+    /* Exponential adaptation - the same speed regardless of frame rate. */
+    VkExtent2D renderExtent = render_extent();
+    _exposure_uniform_buf_obj.render_size   = glm::ivec2(renderExtent.width, renderExtent.height);
+    _exposure_uniform_buf_obj.min_log_lum   = EXPOSURE_MIN_LOG_LUM;
+    _exposure_uniform_buf_obj.log_lum_range = EXPOSURE_LOG_LUM_RANGE;
+    _exposure_uniform_buf_obj.adapt_rate    = 1.f - std::exp(-_time.dt * EXPOSURE_ADAPT_SPEED);
+    _exposure_uniform_buf_obj.key           = EXPOSURE_KEY;
+    _exposure_uniform_buf_obj.min_exposure  = EXPOSURE_MIN;
+    _exposure_uniform_buf_obj.max_exposure  = EXPOSURE_MAX;
+
+    void* data;
+    vkMapMemory(_device, _exposure.uniform_buf_memory[currentImage], 0, VK_WHOLE_SIZE, 0, &data);
+    memcpy(data, &_exposure_uniform_buf_obj, sizeof(_exposure_uniform_buf_obj));
+    vkUnmapMemory(_device, _exposure.uniform_buf_memory[currentImage]);
+}
+
+void Simulation::update_offscreen_uniform_buf()
+{
+    // Matrix from light's point of view
+    _offscreen_uniform_buf_obj.proj = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 0.1f, 50.f);
+
+    /* GLM was originally designed for OpenGL, it is important to revert scaling factor of Y axis. */
+    _offscreen_uniform_buf_obj.proj[1][1] *= -1;
+    _offscreen_uniform_buf_obj.view = glm::lookAt(_light.light_pos, glm::vec3(0.0f, 0.f, 0.f), glm::vec3(0, 1, 0));
+
+    void* data;
+    vkMapMemory( _device,
+        _offscreen_buffer.memory,
+        0,
+        VK_WHOLE_SIZE,
+        0, 
+        &data);
+    memcpy(data, &_offscreen_uniform_buf_obj, sizeof(_offscreen_uniform_buf_obj));
+    vkUnmapMemory(_device, _offscreen_buffer.memory);
+}
+
+void Simulation::update_lights(uint32_t imageIndex)
+{
+    /* All lights orbit the scene center - spot directions turn with them. */
+    _lights.angle = std::fmod(_lights.angle + _time.dt * LIGHT_ORBIT_SPEED, glm::two_pi<float>());
+    glm::mat4 rotation = glm::rotate(glm::mat4(1.f), _lights.angle, glm::vec3(0.f, 1.f, 0.f));
+
+    Light_Data* lights = _lights.light_data[imageIndex];
+    for( uint32_t i = 0; i < _lights.count; i++ )
+    {
+        const Light_Data& source = _lights.sources[i];
+
+        lights[i].position  = glm::vec4(glm::vec3(rotation * glm::vec4(glm::vec3(source.position), 1.f)), source.position.w);
+        lights[i].color     = source.color;
+        lights[i].direction = glm::vec4(glm::vec3(rotation * glm::vec4(glm::vec3(source.direction), 0.f)), source.direction.w);
+    }
+
+    _cluster_uniform_buf_obj.z_near         = CAMERA_NEAR;
+    _cluster_uniform_buf_obj.z_far          = CAMERA_FAR;
+    _cluster_uniform_buf_obj.light_count    = _lights.count;
+    _cluster_uniform_buf_obj.index_capacity = CLUSTER_AVERAGE_LIGHTS * CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+    void* data;
+    vkMapMemory(_device, _lights.uniform_buf_memory[imageIndex], 0, VK_WHOLE_SIZE, 0, &data);
+    memcpy(data, &_cluster_uniform_buf_obj, sizeof(_cluster_uniform_buf_obj));
+    vkUnmapMemory(_device, _lights.uniform_buf_memory[imageIndex]);
+}
+
+/* Extract six frustum planes (left, right, bottom, top, near, far) from view-projection matrix.
+*  Planes are normalized, so distance of a point from the plane is dot(plane.xyz, point) + plane.w.
+*  Near plane corresponds to depth range [0;1] used by Vulkan.
+*/
+static void extract_frustum_planes(const glm::mat4& viewProj, glm::vec4* planes)
+{
+    glm::vec4 row0 = glm::vec4(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+    glm::vec4 row1 = glm::vec4(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+    glm::vec4 row2 = glm::vec4(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+    glm::vec4 row3 = glm::vec4(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row2;
+    planes[5] = row3 - row2;
+
+    for( int i = 0; i < 6; i++ )
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+void Simulation::update_cull_uniform_buf(uint32_t currentImage)
+{
+    extract_frustum_planes(_scene_uniform_buf_obj.viewProjMat, &_cull_uniform_buf_obj.frustum_planes[CULL_VIEW_SCENE * 6]);
+    extract_frustum_planes(_offscreen_uniform_buf_obj.proj * _offscreen_uniform_buf_obj.view, &_cull_uniform_buf_obj.frustum_planes[CULL_VIEW_SHADOW * 6]);
+    extract_frustum_planes(_scene_uniform_buf_obj.viewProjMat, &_cull_uniform_buf_obj.frustum_planes[CULL_VIEW_SCENE_LATE * 6]);
+
+    /* Late phase projects bounding spheres with the same camera that rendered the depth pyramid. */
+    _cull_uniform_buf_obj.view_proj         = _scene_uniform_buf_obj.viewProjMat;
+    _cull_uniform_buf_obj.camera_pos        = _scene_uniform_buf_obj.cameraPos;
+    _cull_uniform_buf_obj.pyramid_size      = glm::vec2(_hiz.extent.width, _hiz.extent.height);
+    _cull_uniform_buf_obj.pyramid_levels    = _hiz.levels;
+
+    /* Same field of view as scene projection - see update_scene_uniform_buf. */
+    _cull_uniform_buf_obj.lod_scale                     = 0.5f * render_extent().height / std::tan(0.5f * glm::radians(_light.light_FOV));
+    _cull_uniform_buf_obj.lod_error_threshold           = LOD_ERROR_PIXELS * std::exp2(_lod.bias);
+    _cull_uniform_buf_obj.shadow_lod_error_threshold    = _cull_uniform_buf_obj.lod_error_threshold * SHADOW_LOD_ERROR_SCALE;
+
+    void* data;
+    vkMapMemory(_device,
+        _cull.uniform_buf_memory[currentImage],
+        0,
+        VK_WHOLE_SIZE,
+        0,
+        &data );
+    memcpy(data, &_cull_uniform_buf_obj, sizeof(_cull_uniform_buf_obj));
+    vkUnmapMemory(_device, _cull.uniform_buf_memory[currentImage]);
+}
+
+static const char* present_mode_name(VkPresentModeKHR mode)
+{
+    switch( mode )
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:   return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:      return "FIFO";
+    default:                            return "other";
+    }
+}
+
+void Simulation::update_stats(uint32_t imageIndex)
+{
+    /* Counters written by the last frame rendered into this image - its fence has already been waited on. */
+    void* data;
+    vkMapMemory(_device, _cull.stats_buf_memory[imageIndex], 0, VK_WHOLE_SIZE, 0, &data);
+    memcpy(&_stats.counters, data, sizeof(_stats.counters));
+    vkUnmapMemory(_device, _cull.stats_buf_memory[imageIndex]);
+
+    update_gpu_timing(imageIndex);
+
+    _stats.frames++;
+    _stats.elapsed += _time.dt;
+    if( _stats.elapsed < 1.f )
+        return;
+
+    const Cull_Counters& counters = _stats.counters;
+    uint32_t objectCount    = _instances.size();
+    uint32_t frustumCulled  = objectCount - counters.visible_count - counters.occluded_count;
+
+    std::ostringstream title;
+    title << _windowName
+        << " | " << static_cast<uint32_t>(_stats.frames / _stats.elapsed) << " FPS"
+        << " | objects: "       << objectCount
+        << " visible: "         << counters.visible_count
+        << " occluded: "        << counters.occluded_count
+        << " frustum culled: "  << frustumCulled
+        << " | drawn: "         << counters.object_draw_count[CULL_VIEW_SCENE] << " early + " << counters.object_draw_count[CULL_VIEW_SCENE_LATE] << " late"
+        << " | meshlets culled: " << counters.meshlet_culled_count << "/" << counters.meshlet_count
+        << " triangles: "       << counters.triangle_count
+        << " | shadow casters: " << counters.object_draw_count[CULL_VIEW_SHADOW]
+        << " triangles: "       << counters.shadow_triangle_count
+        << " | LOD bias: "      << _lod.bias
+        << " | depth pre-pass: " << (_scene_permutation.depth_prepass ? "on" : "off")
+        << " | lights: "        << _lights.count
+        << " | MSAA: "          << _scene_permutation.samples << "x" << (_scene_permutation.min_sample_shading > 0.f ? " sample shading" : "")
+        << " | TAA: "           << (_taa.enabled ? "on" : "off")
+        << " | resolution: "    << static_cast<uint32_t>(_resolution.scale * 100.f + 0.5f) << "%" << (_resolution.enabled ? "" : " (fixed)")
+        << " | present: "       << present_mode_name(_swap_chain.present_mode)
+        << " limiter: "         << (_frame_pacing.limiter_enabled ? std::to_string(FRAME_LIMIT_FPS) + " FPS" : "off");
+
+    if( _capture.sequence_enabled )
+        title << " | capturing: " << _capture.captured << " frames, " << _capture.dropped << " dropped";
+
+    /* Average of frames measured in this period */
+    if( _stats.latency_frames > 0 )
+        title << " | latency: " << static_cast<float>(_stats.latency_time / _stats.latency_frames) << " ms"
+              << (_device_support.display_timing ? " (display)" : " (GPU)");
+
+    /* Average per frame - overlapped time is the part of compute work hidden behind graphics work. */
+    if( _stats.timed_frames > 0 )
+    {
+        title << " | GPU graphics: " << static_cast<float>(_stats.graphics_time / _stats.timed_frames) << " ms"
+              << " compute: "       << static_cast<float>(_stats.compute_time / _stats.timed_frames) << " ms"
+              << " overlapped: "    << static_cast<float>(_stats.overlapped_time / _stats.timed_frames) << " ms";
+    }
+    glfwSetWindowTitle(_window, title.str().c_str());
+
+    _stats.frames   = 0;
+    _stats.elapsed  = 0.f;
+    _stats.timed_frames     = 0;
+    _stats.graphics_time    = 0.0;
+    _stats.compute_time     = 0.0;
+    _stats.overlapped_time  = 0.0;
+    _stats.latency_frames   = 0;
+    _stats.latency_time     = 0.0;
+}
+
+void Simulation::update_gpu_timing(uint32_t imageIndex)
+{
+    if( _gpu_timing.query_pools[imageIndex] == VK_NULL_HANDLE || !_gpu_timing.submitted[imageIndex] )
+        return;
+
+    /* Queries of the last frame rendered into this image - its fence has already been waited on. */
+    uint32_t segmentCount = _render_graph->segment_count();
+    std::vector<uint64_t> timestamps(2 * segmentCount);
+
+    if( vkGetQueryPoolResults(_device, _gpu_timing.query_pools[imageIndex], 0, 2 * segmentCount, timestamps.size() * sizeof(uint64_t),
+            timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS )
+    {
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> graphicsIntervals;
+    std::vector<std::pair<uint64_t, uint64_t>> computeIntervals;
+
+    for( uint32_t segment = 0; segment < segmentCount; segment++ )
+    {
+        auto& intervals = (_render_graph->segment_queue(segment) == GRAPH_QUEUE_COMPUTE) ? computeIntervals : graphicsIntervals;
+        intervals.push_back({ timestamps[2 * segment], timestamps[2 * segment + 1] });
+    }
+
+    /* Segments of one queue never overlap each other - compute segments are intersected with graphics ones of this and of the previous frame. */
+    uint64_t graphicsTicks = 0, computeTicks = 0, overlappedTicks = 0;
+
+    for( const auto& interval : graphicsIntervals )
+        graphicsTicks += interval.second - interval.first;
+
+    for( const auto& interval : computeIntervals )
+    {
+        computeTicks += interval.second - interval.first;
+
+        for( const auto* frameIntervals : { &graphicsIntervals, &_gpu_timing.graphics_intervals } )
+        {
+            for( const auto& graphics : *frameIntervals )
+            {
+                uint64_t begin  = std::max(interval.first, graphics.first);
+                uint64_t end    = std::min(interval.second, graphics.second);
+                overlappedTicks += (end > begin) ? end - begin : 0;
+            }
+        }
+    }
+
+    double msPerTick = _device_support.timestamp_period / 1e6;
+    _stats.timed_frames++;
+    _stats.graphics_time    += graphicsTicks * msPerTick;
+    _stats.compute_time     += computeTicks * msPerTick;
+    _stats.overlapped_time  += overlappedTicks * msPerTick;
+
+    /* Resolution is scaled by time the GPU was busy with the frame - gaps between segments (CPU submission, waiting for
+    *  swap chain image) do not depend on it. Segments of both queues are merged, so async compute overlap is counted once.
+    */
+    std::vector<std::pair<uint64_t, uint64_t>> frameIntervals = graphicsIntervals;
+    frameIntervals.insert(frameIntervals.end(), computeIntervals.begin(), computeIntervals.end());
+    std::sort(frameIntervals.begin(), frameIntervals.end());
+
+    uint64_t busyTicks = 0, busyEnd = 0;
+    for( const auto& interval : frameIntervals )
+    {
+        uint64_t begin  = std::max(interval.first, busyEnd);
+        busyTicks       += (interval.second > begin) ? interval.second - begin : 0;
+        busyEnd         = std::max(busyEnd, interval.second);
+    }
+
+    _gpu_timing.graphics_intervals = graphicsIntervals;
+
+    /* Frames rendered with another scale do not tell anything about the current one. */
+    if( _gpu_timing.scales[imageIndex] == _resolution.scale )
+        update_resolution_scale(busyTicks * msPerTick);
+}
+
+/* Latency of finished frames - from input sampling to the moment frame reached the display (present times of display timing,
+*  in the monotonic clock domain steady_clock uses) or to GPU completion seen by fence wait. The latter is an upper bound when
+*  the fence was signalled before the wait.
+*/
+void Simulation::update_latency()
+{
+    using clock = std::chrono::steady_clock;
+
+    if( !_device_support.display_timing )
+    {
+        if( _frame_pacing.slot_pending[_currentFrame] )
+        {
+            clock::time_point input = _frame_pacing.input_times[_frame_pacing.slot_present_ids[_currentFrame] % LATENCY_HISTORY];
+            add_latency_sample(std::chrono::duration<double, std::milli>(clock::now() - input).count());
+            _frame_pacing.slot_pending[_currentFrame] = false;
+        }
+        return;
+    }
+
+    uint32_t count = 0;
+    _vkGetPastPresentationTiming(_device, _swap_chain.swap_chain, &count, nullptr);
+    if( count == 0 )
+        return;
+
+    std::vector<VkPastPresentationTimingGOOGLE> timings(count);
+    if( _vkGetPastPresentationTiming(_device, _swap_chain.swap_chain, &count, timings.data()) < VK_SUCCESS )
+        return;
+
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        /* Input time of older frames was overwritten already */
+        if( _frame_pacing.present_id - timings[i].presentID > LATENCY_HISTORY )
+            continue;
+
+        clock::time_point input = _frame_pacing.input_times[timings[i].presentID % LATENCY_HISTORY];
+        double latency = (static_cast<double>(timings[i].actualPresentTime) - std::chrono::duration<double, std::nano>(input.time_since_epoch()).count()) / 1e6;
+        add_latency_sample(latency);
+    }
+}
+
+void Simulation::add_latency_sample(double latency)
+{
+    _stats.latency_frames++;
+    _stats.latency_time += latency;
+
+    if( _benchmark.enabled && _benchmark.frames > BENCHMARK_WARMUP_FRAMES )
+    {
+        _benchmark.latency_frames++;
+        _benchmark.latency_time += latency;
+        _benchmark.latency_max  = std::max(_benchmark.latency_max, latency);
+    }
+}
+
+/* Dynamic resolution controller - GPU time grows with the number of pixels, so scale (of both dimensions) needed to fit
+*  the budget is the current one times square root of budget / time. Average of DRS_SAMPLE_FRAMES frames is used, scale
+*  is rounded down to DRS_SCALE_STEP and raised only with headroom left, so it settles instead of oscillating around the budget.
+*/
+void Simulation::update_resolution_scale(double frameTime)
+{
+    if( !_resolution.enabled )
+        return;
+
+    _resolution.samples++;
+    _resolution.frame_time += frameTime;
+    if( _resolution.samples < DRS_SAMPLE_FRAMES )
+        return;
+
+    double average = _resolution.frame_time / _resolution.samples;
+    _resolution.samples     = 0;
+    _resolution.frame_time  = 0.0;
+
+    float target = _resolution.scale * static_cast<float>(std::sqrt(DRS_FRAME_BUDGET_MS / std::max(average, 0.001)));
+    target = std::floor(target / DRS_SCALE_STEP + 0.001f) * DRS_SCALE_STEP;
+    target = std::max(DRS_MIN_SCALE, std::min(target, 1.f));
+
+    if( target < _resolution.scale || (target > _resolution.scale && average < DRS_FRAME_BUDGET_MS * DRS_INCREASE_THRESHOLD) )
+        _resolution.scale = target;
+}
+
+void Simulation::update_instances(uint32_t imageIndex)
+{
+    /* Animation spins every object of instanced meshes - the whole store is rewritten, other objects stay untouched. */
+    if( _instancing.animate )
+    {
+        for( uint32_t id = 0; id < _instances.size(); id++ )
+        {
+            if( _meshes[_instances.mesh_index(id)].instanced )
+                _instances.set_rotation(id, _instances.rotation(id) + INSTANCE_ROTATION_SPEED * _time.dt);
+        }
+    }
+
+    /* Previous frame rendered into this image has finished - its object buffer can be overwritten. */
+    _instances.flush(imageIndex, _meshes, _instancing.object_data[imageIndex]);
+}
+
+void Simulation::update_benchmark()
+{
+    /* Counters of the frame are read from the image rendered last time - warm up frames let them catch up with new bias. */
+    _benchmark.frames++;
+    if( _benchmark.frames <= BENCHMARK_WARMUP_FRAMES )
+        return;
+
+    _benchmark.elapsed          += _time.dt;
+    _benchmark.triangles        += _stats.counters.triangle_count;
+    _benchmark.shadow_triangles += _stats.counters.shadow_triangle_count;
+
+    if( _benchmark.frames < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES )
+        return;
+
+    std::cout << "LOD bias " << _lod.bias
+        << " | frame time: "        << 1000.f * _benchmark.elapsed / BENCHMARK_FRAMES << " ms"
+        << " | scene triangles: "   << _benchmark.triangles / BENCHMARK_FRAMES
+        << " | shadow triangles: "  << _benchmark.shadow_triangles / BENCHMARK_FRAMES;
+
+    /* End-to-end latency - input sampling to display, or to GPU completion without display timing. */
+    if( _benchmark.latency_frames > 0 )
+        std::cout << " | latency: " << _benchmark.latency_time / _benchmark.latency_frames << " ms avg, " << _benchmark.latency_max << " ms max"
+                  << (_device_support.display_timing ? " (display)" : " (GPU)");
+
+    /* Frames dropped by capture are missing from the sequence - readback buffers were waiting for the writing thread. */
+    if( _capture.sequence_enabled )
+        std::cout << " | captured: " << _capture.captured << " frames, " << _capture.dropped << " dropped";
+    std::cout << "\n";
+
+    _benchmark.step++;
+    _benchmark.frames           = 0;
+    _benchmark.elapsed          = 0.f;
+    _benchmark.triangles        = 0;
+    _benchmark.shadow_triangles = 0;
+    _benchmark.latency_frames   = 0;
+    _benchmark.latency_time     = 0.0;
+    _benchmark.latency_max      = 0.0;
+
+    if( _benchmark.step == sizeof(BENCHMARK_LOD_BIASES) / sizeof(BENCHMARK_LOD_BIASES[0]) )
+    {
+        glfwSetWindowShouldClose(_window, GLFW_TRUE);
+        return;
+    }
+
+    _lod.bias = BENCHMARK_LOD_BIASES[_benchmark.step];
+}
+
+void Simulation::update_keyboard_input()
+{
+    // Application
+    if( glfwGetKey( _window, GLFW_KEY_ESCAPE ) == GLFW_PRESS )
+    {
+        glfwSetWindowShouldClose(_window, GLFW_TRUE);
+    }
+
+    // Camera
+    if( glfwGetKey( _window, GLFW_KEY_W ) == GLFW_PRESS )
+    {
+        _camera.move(_time.dt, FORWARD);
+    }
+
+    if( glfwGetKey( _window, GLFW_KEY_S ) == GLFW_PRESS )
+    {
+        _camera.move(_time.dt, BACKWARD);
+    }
+
+    if( glfwGetKey( _window, GLFW_KEY_A ) == GLFW_PRESS )
+    {
+        _camera.move(_time.dt, LEFT);
+    }
+
+    if( glfwGetKey( _window, GLFW_KEY_D ) == GLFW_PRESS )
+    {
+        _camera.move(_time.dt, RIGTH);
+    }
+
+    if( glfwGetKey( _window, GLFW_KEY_SPACE ) == GLFW_PRESS )
+    {
+        _camera.move(_time.dt, UPWARD);
+    }
+
+    if( glfwGetKey( _window, GLFW_KEY_C ) == GLFW_PRESS )
+    {
+        _camera.move(_time.dt, DOWNWARD);
+    }
+
+    if( glfwGetKey( _window, GLFW_KEY_L ) == GLFW_PRESS )
+    {
+        _light.move_light = !_light.move_light;
+    }
+
+    if( glfwGetKey( _window, GLFW_KEY_R ) == GLFW_PRESS )
+    {
+        _instancing.animate = !_instancing.animate;
+    }
+
+    // Level of detail
+    if( glfwGetKey( _window, GLFW_KEY_EQUAL ) == GLFW_PRESS )
+    {
+        _lod.bias = std::min(_lod.bias + _time.dt, 6.f);
+    }
+
+    if( glfwGetKey( _window, GLFW_KEY_MINUS ) == GLFW_PRESS )
+    {
+        _lod.bias = std::max(_lod.bias - _time.dt, -2.f);
+    }
+
+    // Scene permutation - lighting model (1-3) and shadow filter radius (F1-F4)
+    Scene_Permutation permutation = _scene_permutation;
+
+    for( int model = LIGHTING_PHONG; model <= LIGHTING_LAMBERT; model++ )
+    {
+        if( glfwGetKey( _window, GLFW_KEY_1 + model ) == GLFW_PRESS )
+            permutation.lighting_model = model;
+    }
+
+    for( int radius = 0; radius <= SHADOW_FILTER_MAX_RADIUS; radius++ )
+    {
+        if( glfwGetKey( _window, GLFW_KEY_F1 + radius ) == GLFW_PRESS )
+            permutation.shadow_filter_radius = radius;
+    }
+
+    if( glfwGetKey( _window, GLFW_KEY_V ) == GLFW_PRESS )
+    {
+        permutation.vertex_colors = glfwGetKey( _window, GLFW_KEY_LEFT_SHIFT ) == GLFW_PRESS ? VK_FALSE : VK_TRUE;
+    }
+
+    // Sample shading - N toggles it once per key press, device has to support it
+    bool shadingKey = glfwGetKey( _window, GLFW_KEY_N ) == GLFW_PRESS;
+    if( shadingKey && !_msaa.shading_key_down && _device_support.sample_rate_shading )
+        permutation.min_sample_shading = (permutation.min_sample_shading > 0.f) ? 0.f : MSAA_MIN_SAMPLE_SHADING;
+    _msaa.shading_key_down = shadingKey;
+
+    if( permutation != _scene_permutation )
+        select_scene_permutation(permutation);
+
+    // Depth pre-pass - changes passes of render graph, toggled once per key press
+    bool prepassKey = glfwGetKey( _window, GLFW_KEY_P ) == GLFW_PRESS;
+    if( prepassKey && !_depth_prepass.key_down )
+        _depth_prepass.toggle_requested = true;
+    _depth_prepass.key_down = prepassKey;
+
+    // MSAA - M selects the next sample count supported by device, after the highest one multisampling is disabled
+    bool msaaKey = glfwGetKey( _window, GLFW_KEY_M ) == GLFW_PRESS;
+    if( msaaKey && !_msaa.key_down )
+    {
+        VkSampleCountFlagBits next = msaa_sample_count(_msaa.requested_samples * 2);
+        _msaa.requested_samples = (next == _msaa.requested_samples) ? VK_SAMPLE_COUNT_1_BIT : next;
+    }
+    _msaa.key_down = msaaKey;
+
+    // Temporal anti-aliasing - adds or removes passes of render graph and temporal shadow filter, toggled once per key press
+    bool taaKey = glfwGetKey( _window, GLFW_KEY_T ) == GLFW_PRESS;
+    if( taaKey && !_taa.key_down )
+        _taa.toggle_requested = true;
+    _taa.key_down = taaKey;
+
+    // Dynamic resolution - full resolution while disabled, toggled once per key press
+    bool resolutionKey = glfwGetKey( _window, GLFW_KEY_U ) == GLFW_PRESS;
+    if( resolutionKey && !_resolution.key_down )
+    {
+        _resolution.enabled     = !_resolution.enabled;
+        _resolution.scale       = 1.f;
+        _resolution.samples     = 0;
+        _resolution.frame_time  = 0.0;
+    }
+    _resolution.key_down = resolutionKey;
+
+    // Present mode - F selects the next mode (FIFO, MAILBOX, IMMEDIATE) supported by the surface, applied by swap chain recreation
+    bool presentKey = glfwGetKey( _window, GLFW_KEY_F ) == GLFW_PRESS;
+    if( presentKey && !_frame_pacing.present_key_down )
+    {
+        const VkPresentModeKHR modes[] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+        const uint32_t modeCount = static_cast<uint32_t>(std::size(modes));
+
+        uint32_t current = static_cast<uint32_t>(std::find(modes, modes + modeCount, _swap_chain.present_mode) - modes);
+        for( uint32_t i = 1; i <= modeCount; i++ )
+        {
+            VkPresentModeKHR next = modes[(current + i) % modeCount];
+            if( std::find(_swap_chain.present_modes.begin(), _swap_chain.present_modes.end(), next) != _swap_chain.present_modes.end() )
+            {
+                _frame_pacing.requested_present_mode = next;
+                break;
+            }
+        }
+    }
+    _frame_pacing.present_key_down = presentKey;
+
+    // Frame limiter - toggled once per key press
+    bool limiterKey = glfwGetKey( _window, GLFW_KEY_K ) == GLFW_PRESS;
+    if( limiterKey && !_frame_pacing.limiter_key_down )
+        _frame_pacing.limiter_enabled = !_frame_pacing.limiter_enabled;
+    _frame_pacing.limiter_key_down = limiterKey;
+
+    // Frame capture - F12 saves a screenshot, F10 starts and stops capture of frame sequence, once per key press
+    bool screenshotKey = glfwGetKey( _window, GLFW_KEY_F12 ) == GLFW_PRESS;
+    if( screenshotKey && !_capture.screenshot_key_down && _capture.capture )
+        _capture.screenshot_requested = true;
+    _capture.screenshot_key_down = screenshotKey;
+
+    bool sequenceKey = glfwGetKey( _window, GLFW_KEY_F10 ) == GLFW_PRESS;
+    if( sequenceKey && !_capture.sequence_key_down && _capture.capture )
+    {
+        _capture.sequence_enabled = !_capture.sequence_enabled;
+        _capture.sequence_frame   = 0;
+
+        if( !_capture.sequence_enabled )
+            std::cout << "Frame sequence: " << _capture.captured << " frames captured, " << _capture.dropped << " dropped.\n";
+
+        _capture.captured   = 0;
+        _capture.dropped    = 0;
+    }
+    _capture.sequence_key_down = sequenceKey;
+
+    // Clustered lights - ]/[ double/halve number of lights, once per key press
+    bool moreLights  = glfwGetKey( _window, GLFW_KEY_RIGHT_BRACKET ) == GLFW_PRESS;
+    bool fewerLights = glfwGetKey( _window, GLFW_KEY_LEFT_BRACKET ) == GLFW_PRESS;
+
+    if( !_lights.key_down && moreLights )
+        _lights.count = std::min(std::max(_lights.count * 2, 1u), static_cast<uint32_t>(MAX_LIGHTS));
+    if( !_lights.key_down && fewerLights )
+        _lights.count /= 2;
+    _lights.key_down = moreLights || fewerLights;
+
+}
+
+void Simulation::update_mouse_input()
+{
+    glfwGetCursorPos(_window, &_mouse_input.mouse_X, &_mouse_input.mouse_Y);
+
+    if(_mouse_input.firstMouse)
+    {
+        _mouse_input.last_mouse_X = _mouse_input.mouse_X;
+        _mouse_input.last_mouse_Y = _mouse_input.mouse_Y;
+        _mouse_input.firstMouse = false;
+    }
+
+    /* Calculate mouse move offset */
+    _mouse_input.mouse_offset_X  = _mouse_input.mouse_X - _mouse_input.last_mouse_X;
+    _mouse_input.mouse_offset_Y  = _mouse_input.mouse_Y - _mouse_input.last_mouse_Y;
+
+    /* Set last X and Y values. */
+    _mouse_input.last_mouse_X    = _mouse_input.mouse_X;
+    _mouse_input.last_mouse_Y    = _mouse_input.mouse_Y;
+}
+
+void Simulation::update_light()
+{
+    if( _light.move_light )
+    {
+        _light.angle += _time.dt * 0.7f;
+
+        if (_light.angle > glm::two_pi<float>()) 
+            _light.angle -= glm::two_pi<float>();
+
+        float new_x = std::cosf(_light.angle) * 7.f;
+        float new_z = std::sinf(_light.angle) * 7.f;
+
+        _light.light_pos.x = new_x;
+        _light.light_pos.z = new_z;
+    }
+}
+
+void Simulation::transition_image_layout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    VkCommandBuffer commandBuffer = began_single_time_commands();
+
+    /* Use VkImageMemoryBarrier to ensure that write to the buffer completes before reading from it. 
+    *  It is equivalent to VkBufferMemoryBarrier for buffers.
+    */
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType   = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout   = oldLayout;    /* It is possible to use VK_IMAGE_LAYOUT_UNDEFINED */
+    barrier.newLayout   = newLayout;
+
+    /* If we are using Image Barrier to transfer queue family ownership then these two fields have to be specified.
+    *  If we are not using those- we have to set it to FAMILU_IGNORED (it is not default value).
+    */
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+    /* Specify an image to be affected and specific part of this image (if mipmapping included). */
+    bool depth = format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D16_UNORM_S8_UINT ||
+                 format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+    bool stencil = format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+
+    barrier.image   = image;
+    barrier.subresourceRange.aspectMask     = depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.aspectMask    |= stencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0;
+    barrier.subresourceRange.baseMipLevel   = 0;
+    barrier.subresourceRange.levelCount     = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = VK_REMAINING_ARRAY_LAYERS;
+
+    /* Specify type of operations that involve the resource must happen before and after the barrier.
+    *  Every layout implies stages and accesses which use it - the same mapping render graph uses. E.g.:
+    *   Undefined -> transfer destination           Transfer writes do not have to wait for anything.
+    *   Transfer destination -> shader reading      Shader reads should wait on transfer writes.
+    */
+    Resource_Access source      = RenderGraph::layout_access(oldLayout);
+    Resource_Access destination = RenderGraph::layout_access(newLayout);
+
+    barrier.srcAccessMask   = source.access;
+    barrier.dstAccessMask   = destination.access;
+
+    vkCmdPipelineBarrier( commandBuffer,
+        source.stages,          /* Specifies in which pipeline stage the operations should occur that should happen before the barrier.  */ 
+        destination.stages,     /* Specifies the pipeline stage in which operations will wait on the barrier. */
+        0,
+        0, nullptr,     /* Memory Barriers          */
+        0, nullptr,     /* Buffer Memory Barriers   */
+        1, &barrier     /* Image Memory Barriers    */
+        );
+
+    end_single_time_commands(commandBuffer);
+}
+
+VkCommandBuffer Simulation::began_single_time_commands()
+{
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool           = _command_pool;
+    allocInfo.commandBufferCount    = 1;
+
+    /* Allocate command buffer according to allocation structure */
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(_device, &allocInfo, &commandBuffer);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo  = nullptr;
+
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    return commandBuffer;
+}
+
+void Simulation::end_single_time_commands(VkCommandBuffer commandBuffer)
+{
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType    = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &commandBuffer;
+
+    vkQueueSubmit(_queues.graphics_queue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(_queues.graphics_queue);
+    
+    vkFreeCommandBuffers(_device, _command_pool, 1, &commandBuffer);
+}
+
+void Simulation::record_cull_reset(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    /* Reset draw counters. Without indirect count support whole command list is drawn, so unused commands have to be zeroed. */
+    vkCmdFillBuffer(commandBuffer, _cull.count_buffers[imageIndex], 0, VK_WHOLE_SIZE, 0);
+    if( !_device_support.draw_indirect_count )
+        vkCmdFillBuffer(commandBuffer, _meshlet.draw_buffers[imageIndex], 0, VK_WHOLE_SIZE, 0);
+
+    /* Instanced draws start with zero instances. */
+    VkBufferCopy templateRegion = {};
+    templateRegion.size = static_cast<uint64_t>(sizeof(VkDrawIndexedIndirectCommand)) * _meshes.size() * MESH_MAX_LODS * CULL_VIEW_COUNT;
+    vkCmdCopyBuffer(commandBuffer, _instancing.template_buffer, _instancing.draw_buffers[imageIndex], 1, &templateRegion);
+}
+
+void Simulation::record_culling(VkCommandBuffer commandBuffer, size_t imageIndex, cull_phase phase)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cull.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        _cull.pipeline_layout,
+        0,
+        1,
+        &_cull.descriptor_sets[imageIndex],
+        0,
+        nullptr);
+
+    uint32_t phaseValue = static_cast<uint32_t>(phase);
+    vkCmdPushConstants(commandBuffer, _cull.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phaseValue), &phaseValue);
+
+    /* X - objects, Y - views. Number of dispatched groups does not depend on camera, so command buffer can be recorded once.
+    *  Early phase handles camera and light views, late phase only the camera one.
+    */
+    uint32_t viewCount  = (phase == CULL_PHASE_EARLY) ? CULL_VIEW_SCENE_LATE : 1;
+    uint32_t groupCount = (_instances.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+    vkCmdDispatch(commandBuffer, groupCount, viewCount, 1);
+}
+
+void Simulation::record_meshlet_culling(VkCommandBuffer commandBuffer, size_t imageIndex, cull_phase phase)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _meshlet.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        _meshlet.pipeline_layout,
+        0,
+        1,
+        &_meshlet.descriptor_sets[imageIndex],
+        0,
+        nullptr);
+
+    uint32_t firstView = (phase == CULL_PHASE_EARLY) ? CULL_VIEW_SCENE : CULL_VIEW_SCENE_LATE;
+    vkCmdPushConstants(commandBuffer, _meshlet.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(firstView), &firstView);
+
+    /* X - object draw slots, Y - chunks of meshlets, Z - views. Groups without object or chunk exit immediately. */
+    uint32_t viewCount = (phase == CULL_PHASE_EARLY) ? CULL_VIEW_SCENE_LATE : 1;
+    if( _cull_uniform_buf_obj.meshlet_object_count > 0 )
+        vkCmdDispatch(commandBuffer, _cull_uniform_buf_obj.meshlet_object_count, _cull_uniform_buf_obj.meshlet_chunk_count, viewCount);
+}
+
+void Simulation::record_hiz_build(VkCommandBuffer commandBuffer, uint32_t level)
+{
+    bool multisampledSource = (level == 0) && _scene_permutation.samples != VK_SAMPLE_COUNT_1_BIT;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, multisampledSource ? _hiz.resolve_pipeline : _hiz.pipeline);
+
+    /* Source size, destination size - matches 'Params' push constant block inside hiz.comp. Level 0 is reduced from the rendered part
+    *  of scene depth, so the pyramid always covers the whole view whatever the resolution scale.
+    */
+    VkExtent2D renderExtent = render_extent();
+    int32_t params[4] = {
+        static_cast<int32_t>((level == 0) ? renderExtent.width  : std::max(_hiz.extent.width  >> (level - 1), 1u)),
+        static_cast<int32_t>((level == 0) ? renderExtent.height : std::max(_hiz.extent.height >> (level - 1), 1u)),
+        static_cast<int32_t>(std::max(_hiz.extent.width  >> level, 1u)),
+        static_cast<int32_t>(std::max(_hiz.extent.height >> level, 1u))
+    };
+
+    vkCmdBindDescriptorSets(commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        _hiz.pipeline_layout,
+        0,
+        1,
+        &_hiz.descriptor_sets[level],
+        0,
+        nullptr);
+    vkCmdPushConstants(commandBuffer, _hiz.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), params);
+
+    vkCmdDispatch(commandBuffer,
+        (params[2] + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+        (params[3] + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+        1);
+}
+
+void Simulation::record_light_reset(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    /* Only allocation counter of index list - every cluster range is rewritten by clustering. */
+    vkCmdFillBuffer(commandBuffer, _lights.grid_buffers[imageIndex], 0, sizeof(uint32_t), 0);
+}
+
+void Simulation::record_light_clustering(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _lights.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        _lights.pipeline_layout,
+        0,
+        1,
+        &_lights.descriptor_sets[imageIndex],
+        0,
+        nullptr);
+
+    /* One workgroup per cluster - number of lights is read from uniform buffer, so command buffer does not depend on it. */
+    vkCmdDispatch(commandBuffer, CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z);
+}
+
+/* Generate shadow map by rendering the scene from light's POV */
+void Simulation::record_shadow_pass(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    VkClearValue clearValue;
+    clearValue.depthStencil = {1.f, 0};
+
+    VkRenderPassBeginInfo renderPassInfo {};
+    renderPassInfo.sType    = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass   = _offscreen_pass.render_pass;
+    renderPassInfo.framebuffer  = _offscreen_pass.frameBuffer;
+
+    /* Whole map is cleared, but only its part scaled by dynamic resolution is drawn - filter taps crossing its border read no occluders. */
+    renderPassInfo.renderArea.extent.width      = _windowWidth;
+    renderPassInfo.renderArea.extent.height     = _windowHeight;
+    renderPassInfo.renderArea.offset            = {0, 0};
+    renderPassInfo.clearValueCount              = 1;
+    renderPassInfo.pClearValues                 = &clearValue;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.offscreen);
+
+    VkExtent2D shadowExtent = shadow_extent();
+
+    VkViewport viewport {};
+    viewport.width  = static_cast<float>(shadowExtent.width);
+    viewport.height = static_cast<float>(shadowExtent.height);
+    viewport.minDepth = 0.f;
+    viewport.maxDepth = 1.f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor {};
+    scissor.extent      = shadowExtent;
+    scissor.offset.x    = 0;
+    scissor.offset.y    = 0;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    /* Set depth bias. Avoiding artifacts. */
+    vkCmdSetDepthBias(commandBuffer, 1.25f, 0, 1.75f);
+
+    vkCmdBindDescriptorSets(commandBuffer, 
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        _pipeline_layouts.offscreen,
+        0,
+        1,
+        &_descriptor_sets.offscreen[imageIndex],
+        0,
+        nullptr
+    );
+
+    VkBuffer vertexBuffers[] = {_vertex_buffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, _meshlet.index_buffers[imageIndex], 0, VK_INDEX_TYPE_UINT32);
+    record_indirect_draws(commandBuffer, imageIndex, CULL_VIEW_SHADOW);
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+/* Depth of the scene from camera's POV - drawn by offscreen pipeline without depth bias. Early pass clears depth,
+*  late pass adds objects which passed Hi-Z test.
+*/
+void Simulation::record_depth_prepass(VkCommandBuffer commandBuffer, size_t imageIndex, cull_phase phase)
+{
+    VkClearValue clearValue;
+    clearValue.depthStencil = {1.f, 0};
+
+    VkRenderPassBeginInfo renderPassInfo {};
+    renderPassInfo.sType    = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass   = (phase == CULL_PHASE_EARLY) ? _depth_prepass.render_pass : _depth_prepass.late_render_pass;
+    renderPassInfo.framebuffer  = _depth_prepass.framebuffer;
+    renderPassInfo.renderArea.offset    = {0, 0};
+    renderPassInfo.renderArea.extent    = render_extent();
+    renderPassInfo.clearValueCount      = (phase == CULL_PHASE_EARLY) ? 1 : 0;
+    renderPassInfo.pClearValues         = &clearValue;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.prepass);
+
+    VkViewport viewport {};
+    viewport.width  = static_cast<float>(renderPassInfo.renderArea.extent.width);
+    viewport.height = static_cast<float>(renderPassInfo.renderArea.extent.height);
+    viewport.minDepth = 0.f;
+    viewport.maxDepth = 1.f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor {};
+    scissor.offset  = {0, 0};
+    scissor.extent  = renderPassInfo.renderArea.extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    /* Bias is disabled by the pipeline - dynamic state is set only because it is part of offscreen state. */
+    vkCmdSetDepthBias(commandBuffer, 0.f, 0.f, 0.f);
+
+    vkCmdBindDescriptorSets(commandBuffer, 
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        _pipeline_layouts.offscreen,
+        0,
+        1,
+        &_descriptor_sets.prepass[imageIndex],
+        0,
+        nullptr
+    );
+
+    VkBuffer vertexBuffers[] = {_vertex_buffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, _meshlet.index_buffers[imageIndex], 0, VK_INDEX_TYPE_UINT32);
+    record_indirect_draws(commandBuffer, imageIndex, (phase == CULL_PHASE_EARLY) ? CULL_VIEW_SCENE : CULL_VIEW_SCENE_LATE);
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+/* Generate scene with applied shadows. Early pass clears attachments and draws last frame occluders,
+*  late pass continues drawing into the same attachments - objects which passed Hi-Z test.
+*  After depth pre-pass there is a single pass (recorded as early one) which clears color only and draws objects of both phases.
+*/
+void Simulation::record_scene_pass(VkCommandBuffer commandBuffer, size_t imageIndex, cull_phase phase)
+{
+    /* Clear values - specify clear operation.
+    * Order of clear values should be same as attachments.
+    */
+    std::array<VkClearValue, 3> clearValues;
+    clearValues[0].color = {0.f, 0.f, 0.f, 1.f};
+    clearValues[1].depthStencil = {1.f, 0}; 
+    clearValues[2].color = {0.f, 0.f, 0.f, 0.f};    /* No motion where nothing is drawn */
+
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType    = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass   = (phase == CULL_PHASE_EARLY) ? _scene_pass.render_pass : _scene_pass.late_render_pass;
+    if( _scene_permutation.depth_prepass )
+        renderPassInfo.renderPass   = _scene_pass.shading_render_pass;
+    renderPassInfo.framebuffer  = _scene_pass.framebuffer;
+    
+    /* Define size of render area - part of attachments selected by dynamic resolution, resolves are limited to it as well. */
+    renderPassInfo.renderArea.offset    = {0,0};
+    renderPassInfo.renderArea.extent    = render_extent();
+    
+    if( phase == CULL_PHASE_EARLY )
+    {
+        renderPassInfo.clearValueCount  = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues     = clearValues.data();
+    }
+    
+    /* RECORDING */
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelines.scene);
+
+    VkViewport viewport {};
+    viewport.width  = static_cast<float>(renderPassInfo.renderArea.extent.width);
+    viewport.height = static_cast<float>(renderPassInfo.renderArea.extent.height);
+    viewport.minDepth = 0.f;
+    viewport.maxDepth = 1.f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor {};
+    scissor.offset  = {0, 0};
+    scissor.extent  = renderPassInfo.renderArea.extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    /* Binding vertex buffer */
+    VkBuffer vertexBuffers[] = {_vertex_buffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+    /* Binding index buffer */
+    vkCmdBindIndexBuffer(commandBuffer, _meshlet.index_buffers[imageIndex], 0, VK_INDEX_TYPE_UINT32);
+
+    /* Bind descriptor sets- to update uniform data. Set 1 holds textures of all materials. */
+    std::array<VkDescriptorSet, 2> sceneSets = { _descriptor_sets.scene[imageIndex], _bindless.descriptor_set };
+    vkCmdBindDescriptorSets(commandBuffer, 
+        VK_PIPELINE_BIND_POINT_GRAPHICS, 
+        _pipeline_layouts.scene, 
+        0, 
+        _bindless.enabled ? 2 : 1, 
+        sceneSets.data(), 
+        0, 
+        nullptr);
+
+    record_indirect_draws(commandBuffer, imageIndex, (phase == CULL_PHASE_EARLY) ? CULL_VIEW_SCENE : CULL_VIEW_SCENE_LATE);
+
+    if( _scene_permutation.depth_prepass )
+        record_indirect_draws(commandBuffer, imageIndex, CULL_VIEW_SCENE_LATE);
+
+    /* END RECORDING */
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void Simulation::record_stats_copy(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    VkBufferCopy copyRegion = {};
+    copyRegion.size = sizeof(Cull_Counters);
+    vkCmdCopyBuffer(commandBuffer, _cull.count_buffers[imageIndex], _cull.stats_buffers[imageIndex], 1, &copyRegion);
+}
+
+void Simulation::record_taa(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _taa.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _taa.pipeline_layout, 0, 1, &_taa.descriptor_sets[imageIndex], 0, nullptr);
+
+    /* One invocation for every rendered pixel */
+    VkExtent2D renderExtent = render_extent();
+    vkCmdDispatch(commandBuffer,
+        (renderExtent.width + TAA_GROUP_SIZE - 1) / TAA_GROUP_SIZE,
+        (renderExtent.height + TAA_GROUP_SIZE - 1) / TAA_GROUP_SIZE,
+        1);
+}
+
+void Simulation::record_taa_history_copy(VkCommandBuffer commandBuffer)
+{
+    /* Output becomes history of the next frame - storage and sampled image are separate, output is transient. */
+    VkImageCopy region = {};
+    region.srcSubresource   = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.dstSubresource   = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.extent           = { render_extent().width, render_extent().height, 1 };
+
+    vkCmdCopyImage(commandBuffer,
+        _taa.output.image,  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        _taa.history.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &region);
+}
+
+void Simulation::record_exposure(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _exposure.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _exposure.pipeline_layout, 0, 1, &_exposure.descriptor_sets[imageIndex], 0, nullptr);
+
+    /* Every invocation bins a block of rendered pixels - the last group to finish computes exposure. */
+    const uint32_t groupPixels = EXPOSURE_GROUP_SIZE * EXPOSURE_PIXELS_PER_THREAD;
+    VkExtent2D renderExtent = render_extent();
+    vkCmdDispatch(commandBuffer,
+        (renderExtent.width + groupPixels - 1) / groupPixels,
+        (renderExtent.height + groupPixels - 1) / groupPixels,
+        1);
+}
+
+void Simulation::record_present_pass(VkCommandBuffer commandBuffer, size_t imageIndex)
+{
+    /* Every pixel is drawn by the fullscreen triangle - nothing is cleared. */
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType    = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass   = _present_pass.render_pass;
+    renderPassInfo.framebuffer  = _present_pass.framebuffers[imageIndex];
+    renderPassInfo.renderArea.offset    = {0,0};
+    renderPassInfo.renderArea.extent    = _swap_chain.swap_chain_extent;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _present_pass.pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _present_pass.pipeline_layout, 0, 1, &_present_pass.descriptor_set, 0, nullptr);
+
+    /* Rendered part of the frame in UV, texel size, sharpness - matches 'Params' push constant block inside present.frag.
+    *  Frame image has swap chain size, so only the scaled part is upscaled to the whole swap chain image.
+    */
+    VkExtent2D renderExtent = render_extent();
+    float params[5] = {
+        static_cast<float>(renderExtent.width) / _swap_chain.swap_chain_extent.width,
+        static_cast<float>(renderExtent.height) / _swap_chain.swap_chain_extent.height,
+        1.f / _swap_chain.swap_chain_extent.width,
+        1.f / _swap_chain.swap_chain_extent.height,
+        DRS_SHARPNESS
+    };
+    vkCmdPushConstants(commandBuffer, _present_pass.pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(params), params);
+
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+VkCommandBuffer Simulation::record_frame_capture(uint32_t imageIndex)
+{
+    if( !_capture.capture )
+        return VK_NULL_HANDLE;
+
+    /* Sequence frames are numbered by captures - files follow each other without gaps unless frames were dropped. */
+    std::string name;
+    capture_format fileFormat = CAPTURE_SEQUENCE_FORMAT;
+
+    if( _capture.screenshot_requested )
+    {
+        char time[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(time, sizeof(time), "%Y%m%d_%H%M%S", std::localtime(&now));
+
+        name        = "screenshot_" + std::string(time) + "_" + std::to_string(_capture.screenshots++);
+        fileFormat  = CAPTURE_SCREENSHOT_FORMAT;
+        _capture.screenshot_requested = false;
+    }
+    else if( _capture.sequence_enabled && _capture.sequence_frame++ % _capture.sequence_interval == 0 )
+    {
+        char index[16];
+        std::snprintf(index, sizeof(index), "%06u", (_capture.sequence_frame - 1) / _capture.sequence_interval);
+        name = "frame_" + std::string(index);
+    }
+    else
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    /* Command buffer of this frame in flight slot was executed - its fence was waited for. */
+    VkCommandBuffer commandBuffer = _capture.command_buffers[_currentFrame];
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if( vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS )
+        throw std::runtime_error("Failed to begin recording command buffer! :( \n");
+
+    uint32_t slot = _capture.capture->record(commandBuffer, _swap_chain.swap_chain_images[imageIndex], name, fileFormat);
+
+    if( vkEndCommandBuffer(commandBuffer) != VK_SUCCESS )
+        throw std::runtime_error("Failed to record command buffer! :( \n");
+
+    /* All readback buffers wait for the writing thread - frame is dropped rather than waited for. */
+    if( slot == FrameCapture::NO_SLOT )
+    {
+        _capture.dropped++;
+        return VK_NULL_HANDLE;
+    }
+
+    _capture.pending_slots[_currentFrame] = slot;
+    _capture.captured++;
+
+    return commandBuffer;
+}
+
+void Simulation::finish_frame_capture(uint32_t frame)
 {
-    // Matrix from light's point of view
-    _offscreen_uniform_buf_obj.proj = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 0.1f, 50.f);
-
-    /* GLM was originally designed for OpenGL, it is important to revert scaling factor of Y axis. */
-    _offscreen_uniform_buf_obj.proj[1][1] *= -1;
-    _offscreen_uniform_buf_obj.view = glm::lookAt(_light.light_pos, glm::vec3(0.0f, 0.f, 0.f), glm::vec3(0, 1, 0));
-    _offscreen_uniform_buf_obj.model = glm::mat4(1.0f);
+    if( _capture.pending_slots[frame] == FrameCapture::NO_SLOT )
+        return;
 
-    void* data;
-    vkMapMemory( _device,
-        _offscreen_buffer.memory,
-        0,
-        VK_WHOLE_SIZE,
-        0, 
-        &data);
-    memcpy(data, &_offscreen_uniform_buf_obj, sizeof(_offscreen_uniform_buf_obj));
-    vkUnmapMemory(_device, _offscreen_buffer.memory);
+    _capture.capture->complete(_capture.pending_slots[frame]);
+    _capture.pending_slots[frame] = FrameCapture::NO_SLOT;
 }
 
-void Simulation::update_keyboard_input()
+void Simulation::record_indirect_draws(VkCommandBuffer commandBuffer, size_t imageIndex, cull_view view)
 {
-    // Application
-    if( glfwGetKey( _window, GLFW_KEY_ESCAPE ) == GLFW_PRESS )
-    {
-        glfwSetWindowShouldClose(_window, GLFW_TRUE);
-    }
+    uint32_t        stride       = sizeof(VkDrawIndexedIndirectCommand);
+    uint32_t        batchSize    = std::max(_device_support.max_draw_indirect_count, 1u);
 
-    // Camera
-    if( glfwGetKey( _window, GLFW_KEY_W ) == GLFW_PRESS )
+    /* Instanced meshes - one draw per level of each mesh, instance count written by culling shader. Other meshes have zero index count. */
+    uint32_t        instancedDrawCount  = static_cast<uint32_t>(_meshes.size()) * MESH_MAX_LODS;
+    VkDeviceSize    instancedOffset     = static_cast<VkDeviceSize>(view) * instancedDrawCount * stride;
+    for( uint32_t first = 0; first < instancedDrawCount; first += batchSize )
     {
-        _camera.move(_time.dt, FORWARD);
+        vkCmdDrawIndexedIndirect(commandBuffer,
+            _instancing.draw_buffers[imageIndex],
+            instancedOffset + static_cast<VkDeviceSize>(first) * stride,
+            std::min(batchSize, instancedDrawCount - first),
+            stride);
     }
 
-    if( glfwGetKey( _window, GLFW_KEY_S ) == GLFW_PRESS )
-    {
-        _camera.move(_time.dt, BACKWARD);
-    }
+    /* Every view has room for a draw of each meshlet chunk of each not instanced object. */
+    uint32_t        maxDrawCount = _cull_uniform_buf_obj.meshlet_object_count * _cull_uniform_buf_obj.meshlet_chunk_count;
+    if( maxDrawCount == 0 )
+        return;
 
-    if( glfwGetKey( _window, GLFW_KEY_A ) == GLFW_PRESS )
-    {
-        _camera.move(_time.dt, LEFT);
-    }
+    VkDeviceSize    drawOffset   = static_cast<VkDeviceSize>(view) * maxDrawCount * stride;
 
-    if( glfwGetKey( _window, GLFW_KEY_D ) == GLFW_PRESS )
+    if( _device_support.draw_indirect_count )
     {
-        _camera.move(_time.dt, RIGTH);
+        /* Number of draws is taken from counter written by meshlet culling shader. */
+        _vkCmdDrawIndexedIndirectCount(commandBuffer,
+            _meshlet.draw_buffers[imageIndex],
+            drawOffset,
+            _cull.count_buffers[imageIndex],
+            offsetof(Cull_Counters, cluster_draw_count) + sizeof(uint32_t) * view,
+            maxDrawCount,
+            stride);
+        return;
     }
 
-    if( glfwGetKey( _window, GLFW_KEY_SPACE ) == GLFW_PRESS )
+    /* Fallback - draw whole list, commands of culled objects are zeroed. Split if device limits single draw count. */
+    for( uint32_t first = 0; first < maxDrawCount; first += batchSize )
     {
-        _camera.move(_time.dt, UPWARD);
+        vkCmdDrawIndexedIndirect(commandBuffer,
+            _meshlet.draw_buffers[imageIndex],
+            drawOffset + static_cast<VkDeviceSize>(first) * stride,
+            std::min(batchSize, maxDrawCount - first),
+            stride);
     }
+}
 
-    if( glfwGetKey( _window, GLFW_KEY_C ) == GLFW_PRESS )
+void Simulation::update_hot_reload(uint32_t imageIndex)
+{
+    for( const auto& fileName : _hot_reload.watcher->poll_changes() )
+        _hot_reload.pending_mask |= reload_mask(fileName);
+
+    bool jobRunning = _hot_reload.job.valid();
+
+    if( jobRunning && _hot_reload.job.wait_for(std::chrono::seconds(0)) == std::future_status::ready )
     {
-        _camera.move(_time.dt, DOWNWARD);
+        apply_pipeline_reload();
+        jobRunning = false;
     }
 
-    if( glfwGetKey( _window, GLFW_KEY_L ) == GLFW_PRESS )
+    /* Changes made while job was running are picked up by the next one. */
+    if( !jobRunning && _hot_reload.pending_mask != 0 )
+        start_pipeline_reload();
+
+    /* Image is not in flight anymore (its fence was waited on) - its commands can be recorded again with current pipelines.
+    *  Resolution scale changed by dynamic resolution is picked up the same way.
+    */
+    if( _hot_reload.recorded_generation[imageIndex] != _hot_reload.generation || _resolution.recorded_scales[imageIndex] != _resolution.scale )
     {
-        _light.move_light = !_light.move_light;
+        record_command_buffer(imageIndex);
+        _hot_reload.recorded_generation[imageIndex] = _hot_reload.generation;
     }
 
+    /* Pipeline retired at generation G is unused once every command buffer is recorded with generation G or newer. */
+    uint64_t oldestGeneration = *std::min_element(_hot_reload.recorded_generation.begin(), _hot_reload.recorded_generation.end());
+    destroy_retired_pipelines(oldestGeneration);
 }
 
-void Simulation::update_mouse_input()
+uint32_t Simulation::reload_mask(const std::string& fileName) const
 {
-    glfwGetCursorPos(_window, &_mouse_input.mouse_X, &_mouse_input.mouse_Y);
-
-    if(_mouse_input.firstMouse)
+    auto matches = [&fileName](const ShaderVariant& variant)
     {
-        _mouse_input.last_mouse_X = _mouse_input.mouse_X;
-        _mouse_input.last_mouse_Y = _mouse_input.mouse_Y;
-        _mouse_input.firstMouse = false;
-    }
-
-    /* Calculate mouse move offset */
-    _mouse_input.mouse_offset_X  = _mouse_input.mouse_X - _mouse_input.last_mouse_X;
-    _mouse_input.mouse_offset_Y  = _mouse_input.mouse_Y - _mouse_input.last_mouse_Y;
+        return std::filesystem::path(variant.path).filename().string() == fileName;
+    };
 
-    /* Set last X and Y values. */
-    _mouse_input.last_mouse_X    = _mouse_input.mouse_X;
-    _mouse_input.last_mouse_Y    = _mouse_input.mouse_Y;
+    uint32_t mask = 0;
+
+    if( matches(_shader_variants.scene_vert) || matches(_shader_variants.scene_frag) || matches(_shader_variants.offscreen_vert) ||
+        matches(_shader_variants.prepass_vert) )
+        mask |= RELOAD_PIPELINE_GRAPHICS;
+    if( matches(_shader_variants.cull_comp) )
+        mask |= RELOAD_PIPELINE_CULL;
+    if( matches(_shader_variants.hiz_comp) )
+        mask |= RELOAD_PIPELINE_HIZ;
+    if( matches(_shader_variants.meshlet_comp) )
+        mask |= RELOAD_PIPELINE_MESHLET;
+    if( matches(_shader_variants.cluster_comp) )
+        mask |= RELOAD_PIPELINE_CLUSTER;
+    if( matches(_shader_variants.taa_comp) || matches(_shader_variants.fullscreen_vert) || matches(_shader_variants.present_frag) ||
+        matches(_shader_variants.exposure_comp) )
+        mask |= RELOAD_PIPELINE_POST;
+
+    return mask;
 }
 
-void Simulation::update_light()
+void Simulation::start_pipeline_reload()
 {
-    if( _light.move_light )
+    uint32_t mask = _hot_reload.pending_mask;
+    _hot_reload.pending_mask = 0;
+
+    /* Job touches only objects not modified while it runs - layouts, render passes, shader manager and thread-safe pipeline cache.
+    *  Swap chain recreation finishes the job before destroying any of them.
+    */
+    _hot_reload.job = std::async(std::launch::async, [this, mask, permutation = _scene_permutation]()
     {
-        _light.angle += _time.dt * 0.7f;
+        Reloaded_Pipelines reloaded;
+        reloaded.mask = mask;
+        reloaded.permutation = permutation;
 
-        if (_light.angle > glm::two_pi<float>()) 
-            _light.angle -= glm::two_pi<float>();
+        try
+        {
+            if( mask & RELOAD_PIPELINE_GRAPHICS )
+                build_graphics_pipelines(permutation, reloaded.scene, &reloaded.offscreen, &reloaded.prepass);
+            if( mask & RELOAD_PIPELINE_CULL )
+                reloaded.cull = build_compute_pipeline(_shader_variants.cull_comp, _cull.pipeline_layout);
+            if( mask & RELOAD_PIPELINE_HIZ )
+            {
+                reloaded.hiz            = build_compute_pipeline(_shader_variants.hiz_comp, _hiz.pipeline_layout);
+                reloaded.hiz_resolve    = build_compute_pipeline(_shader_variants.hiz_resolve_comp, _hiz.pipeline_layout);
+            }
+            if( mask & RELOAD_PIPELINE_MESHLET )
+                reloaded.meshlet = build_compute_pipeline(_shader_variants.meshlet_comp, _meshlet.pipeline_layout);
+            if( mask & RELOAD_PIPELINE_CLUSTER )
+                reloaded.cluster = build_compute_pipeline(_shader_variants.cluster_comp, _lights.pipeline_layout);
+            if( mask & RELOAD_PIPELINE_POST )
+            {
+                reloaded.taa        = build_compute_pipeline(_shader_variants.taa_comp, _taa.pipeline_layout);
+                reloaded.present    = build_present_pipeline();
+                reloaded.exposure   = build_compute_pipeline(_shader_variants.exposure_comp, _exposure.pipeline_layout);
+            }
+        }
+        catch( ... )
+        {
+            /* Pipelines built before the failure are not used - previous ones stay active. */
+            for( VkPipeline pipeline : { reloaded.scene, reloaded.offscreen, reloaded.prepass, reloaded.cull, reloaded.hiz, reloaded.hiz_resolve,
+                                         reloaded.meshlet, reloaded.cluster, reloaded.taa, reloaded.present, reloaded.exposure } )
+                vkDestroyPipeline(_device, pipeline, nullptr);
 
-        float new_x = std::cosf(_light.angle) * 7.f;
-        float new_z = std::sinf(_light.angle) * 7.f;
+            throw;
+        }
 
-        _light.light_pos.x = new_x;
-        _light.light_pos.z = new_z;
-    }
+        return reloaded;
+    });
 }
 
-void Simulation::transition_image_layout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
+void Simulation::apply_pipeline_reload()
 {
-    VkCommandBuffer commandBuffer = began_single_time_commands();
-
-    /* Use VkImageMemoryBarrier to ensure that write to the buffer completes before reading from it. 
-    *  It is equivalent to VkBufferMemoryBarrier for buffers.
-    */
-    VkImageMemoryBarrier barrier = {};
-    barrier.sType   = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout   = oldLayout;    /* It is possible to use VK_IMAGE_LAYOUT_UNDEFINED */
-    barrier.newLayout   = newLayout;
+    Reloaded_Pipelines reloaded;
 
-    /* If we are using Image Barrier to transfer queue family ownership then these two fields have to be specified.
-    *  If we are not using those- we have to set it to FAMILU_IGNORED (it is not default value).
-    */
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    try
+    {
+        reloaded = _hot_reload.job.get();
+    }
+    catch( const std::exception& error )
+    {
+        /* Broken shader must not end the application - it is reported and the previous pipelines keep running. */
+        std::cerr << "Shader reload failed - previous pipelines are kept: " << error.what();
+        return;
+    }
 
-    /* Specify an image to be affected and specific part of this image (if mipmapping included). */
-    barrier.image   = image;
-    barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel   = 0;
-    barrier.subresourceRange.levelCount     = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount     = 1;
+    uint64_t generation = _hot_reload.generation + 1;
 
-    /* Specify type of operations that involve the resource must happen before and after the barrier. 
-    *  We need to handle two transitions:
-    *   Undefined -> transfer destination           Transfer writes do not have to wait for anything.
-    *   Transfer destination -> shader reading      Shader reads should wait on transfer writes, especially in the fragment shader.
-    */
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
+    auto swap = [this, generation](VkPipeline& current, VkPipeline replacement)
+    {
+        _hot_reload.retired.push_back({ current, generation });
+        current = replacement;
+    };
 
-    if( oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && 
-        newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+    if( (reloaded.mask & RELOAD_PIPELINE_GRAPHICS) && reloaded.permutation != _scene_permutation )
     {
-        barrier.srcAccessMask   = 0;
-        barrier.dstAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        /* Permutation was selected while job was running - selection stays, its pipelines are built by the next job.
+        *  Result of this one was never recorded, it is destroyed right away.
+        */
+        for( VkPipeline pipeline : { reloaded.scene, reloaded.offscreen, reloaded.prepass } )
+            vkDestroyPipeline(_device, pipeline, nullptr);
 
-        sourceStage         = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage    = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        _hot_reload.pending_mask |= RELOAD_PIPELINE_GRAPHICS;
     }
-    else if( oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-        newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+    else if( reloaded.mask & RELOAD_PIPELINE_GRAPHICS )
     {
-        barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;     /* Transfer write must occur in the pipeline transfer stage. */
-        barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+        /* Pipelines of all scene permutations are built from old sources - other ones are rebuilt when selected again. */
+        for( const auto& permutation : _pipelines.scene_permutations )
+            _hot_reload.retired.push_back({ permutation.second, generation });
+
+        _pipelines.scene_permutations.clear();
+        _pipelines.scene_permutations[reloaded.permutation] = reloaded.scene;
 
-        sourceStage         = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;    /* Image will be read inside fragment shader */
+        _pipelines.scene = reloaded.scene;
+
+        swap(_pipelines.offscreen, reloaded.offscreen);
+        swap(_pipelines.prepass, reloaded.prepass);
     }
-    else
+    if( reloaded.mask & RELOAD_PIPELINE_CULL )
+        swap(_cull.pipeline, reloaded.cull);
+    if( reloaded.mask & RELOAD_PIPELINE_HIZ )
+    {
+        swap(_hiz.pipeline, reloaded.hiz);
+        swap(_hiz.resolve_pipeline, reloaded.hiz_resolve);
+    }
+    if( reloaded.mask & RELOAD_PIPELINE_MESHLET )
+        swap(_meshlet.pipeline, reloaded.meshlet);
+    if( reloaded.mask & RELOAD_PIPELINE_CLUSTER )
+        swap(_lights.pipeline, reloaded.cluster);
+    if( reloaded.mask & RELOAD_PIPELINE_POST )
     {
-        throw std::runtime_error("Unsupported layout transition! :( \n");
+        swap(_taa.pipeline, reloaded.taa);
+        swap(_present_pass.pipeline, reloaded.present);
+        swap(_exposure.pipeline, reloaded.exposure);
     }
 
-    vkCmdPipelineBarrier( commandBuffer,
-        sourceStage,            /* Specifies in which pipeline stage the operations should occur that should happen before the barrier.  */ 
-        destinationStage,       /* Specifies the pipeline stage in which operations will wait on the barrier. */
-        0,
-        0, nullptr,     /* Memory Barriers          */
-        0, nullptr,     /* Buffer Memory Barriers   */
-        1, &barrier     /* Image Memory Barriers    */
-        );
+    _hot_reload.generation = generation;
 
-    end_single_time_commands(commandBuffer);
+    std::cout << "Shaders reloaded.\n";
 }
 
-VkCommandBuffer Simulation::began_single_time_commands()
+void Simulation::finish_pipeline_reload()
 {
-    VkCommandBufferAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool           = _command_pool;
-    allocInfo.commandBufferCount    = 1;
-
-    /* Allocate command buffer according to allocation structure */
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(_device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    beginInfo.pInheritanceInfo  = nullptr;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    /* Device is idle - running job is awaited and all retired pipelines are released. */
+    if( _hot_reload.job.valid() )
+        apply_pipeline_reload();
 
-    return commandBuffer;
+    destroy_retired_pipelines(UINT64_MAX);
 }
 
-void Simulation::end_single_time_commands(VkCommandBuffer commandBuffer)
+void Simulation::destroy_retired_pipelines(uint64_t generation)
 {
-    vkEndCommandBuffer(commandBuffer);
+    auto retired = std::remove_if(_hot_reload.retired.begin(), _hot_reload.retired.end(), [this, generation](const Retired_Pipeline& pipeline)
+    {
+        if( pipeline.generation > generation )
+            return false;
 
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType    = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount   = 1;
-    submitInfo.pCommandBuffers      = &commandBuffer;
+        vkDestroyPipeline(_device, pipeline.pipeline, nullptr);
+        return true;
+    });
 
-    vkQueueSubmit(_queues.graphics_queue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(_queues.graphics_queue);
-    
-    vkFreeCommandBuffers(_device, _command_pool, 1, &commandBuffer);
+    _hot_reload.retired.erase(retired, _hot_reload.retired.end());
 }
 
 void Simulation::recreate_swap_chain()
@@ -1891,35 +5243,110 @@ void Simulation::recreate_swap_chain()
 
     vkDeviceWaitIdle(_device);
 
+    /* Job may use scene render pass which is recreated below. */
+    finish_pipeline_reload();
+
+    /* Pipelines and render graph below are created with or without depth pre-pass - finished job could not revert the toggle. */
+    if( _depth_prepass.toggle_requested )
+    {
+        _scene_permutation.depth_prepass    = !_scene_permutation.depth_prepass;
+        _depth_prepass.toggle_requested     = false;
+    }
+
+    /* Render passes, pipelines and attachments below are created with requested sample count. */
+    _scene_permutation.samples = _msaa.requested_samples;
+
+    /* Render graph is built with or without TAA passes, scene pipeline with the matching shadow filter. */
+    if( _taa.toggle_requested )
+    {
+        _taa.enabled                        = !_taa.enabled;
+        _scene_permutation.temporal_shadows = _taa.enabled ? VK_TRUE : VK_FALSE;
+        _taa.toggle_requested               = false;
+    }
+
     cleanup_swap_chain();
 
     create_swap_chain();
     create_image_views();
     create_scene_render_pass();
+    create_present_render_pass();
     create_graphics_pipeline();
+    create_present_pipeline();
+    create_taa_history();
+    create_render_graph();
     create_depth_resources();
     create_scene_framebuffer();
+    create_offscreen_framebuffer();
     create_uniform_buffers();
-    create_descriptor_pool();
     create_descriptor_sets();
     create_command_buffers();
+    create_frame_capture();
 }
 
 void Simulation::cleanup_swap_chain()
 {
-    /* Destroy depth resources */
+    /* Device is idle - copies of frames still in flight are finished, their files are written before capture is destroyed. */
+    if( _capture.capture )
+    {
+        for( uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++ )
+            finish_frame_capture(frame);
+
+        _capture.capture.reset();
+        vkFreeCommandBuffers(_device, _command_pool, static_cast<uint32_t>(_capture.command_buffers.size()), _capture.command_buffers.data());
+    }
+
+    /* Destroy depth resources - images belong to render graph */
     vkDestroyImageView(_device, _scene_pass.depth.image_view, nullptr);
-    vkDestroyImage(_device, _scene_pass.depth.image, nullptr);
-    vkFreeMemory(_device, _scene_pass.depth.memory, nullptr);
+    vkDestroyImageView(_device, _scene_pass.color.image_view, nullptr);
+    vkDestroyImageView(_device, _scene_pass.velocity.image_view, nullptr);
+    vkDestroyImageView(_device, _msaa.color.image_view, nullptr);
+    vkDestroyImageView(_device, _msaa.velocity.image_view, nullptr);
+    vkDestroyImageView(_device, _taa.output.image_view, nullptr);
+    vkDestroyImageView(_device, _offscreen_pass.depth.image_view, nullptr);
+    vkDestroyFramebuffer(_device, _offscreen_pass.frameBuffer, nullptr);
 
-    for( size_t i = 0; i < _scene_pass.framebuffers.size(); i++ )
-        vkDestroyFramebuffer(_device, _scene_pass.framebuffers[i], nullptr);
+    /* History is sized by swap chain - owned by the application */
+    vkDestroyImageView(_device, _taa.history.image_view, nullptr);
+    vkDestroyImage(_device, _taa.history.image, nullptr);
+    vkFreeMemory(_device, _taa.history.memory, nullptr);
 
-    vkFreeCommandBuffers(_device, _command_pool, static_cast<uint32_t>(_command_buffers.size()), _command_buffers.data());
+    vkDestroyFramebuffer(_device, _scene_pass.framebuffer, nullptr);
+    vkDestroyFramebuffer(_device, _depth_prepass.framebuffer, nullptr);
+    for( size_t i = 0; i < _present_pass.framebuffers.size(); i++ )
+        vkDestroyFramebuffer(_device, _present_pass.framebuffers[i], nullptr);
 
-    vkDestroyPipeline(_device, _pipelines.scene, nullptr);
-    vkDestroyPipelineLayout(_device, _pipeline_layouts.scene, nullptr);
+    for( const auto& commandBuffers : _command_buffers )
+    {
+        for( uint32_t segment = 0; segment < commandBuffers.size(); segment++ )
+        {
+            VkCommandPool pool = (_render_graph->segment_queue(segment) == GRAPH_QUEUE_COMPUTE) ? _compute_command_pool : _command_pool;
+            vkFreeCommandBuffers(_device, pool, 1, &commandBuffers[segment]);
+        }
+    }
+
+    for( VkQueryPool queryPool : _gpu_timing.query_pools )
+        vkDestroyQueryPool(_device, queryPool, nullptr);
+
+    for( const auto& permutation : _pipelines.scene_permutations )
+        vkDestroyPipeline(_device, permutation.second, nullptr);
+    _pipelines.scene_permutations.clear();
+
+    vkDestroyPipeline(_device, _pipelines.offscreen, nullptr);
+    vkDestroyPipeline(_device, _pipelines.prepass, nullptr);
     vkDestroyRenderPass(_device, _scene_pass.render_pass, nullptr);
+    vkDestroyRenderPass(_device, _scene_pass.late_render_pass, nullptr);
+    vkDestroyRenderPass(_device, _scene_pass.shading_render_pass, nullptr);
+    vkDestroyRenderPass(_device, _depth_prepass.render_pass, nullptr);
+    vkDestroyRenderPass(_device, _depth_prepass.late_render_pass, nullptr);
+    vkDestroyPipeline(_device, _present_pass.pipeline, nullptr);
+    vkDestroyRenderPass(_device, _present_pass.render_pass, nullptr);
+
+    /* Destroy depth pyramid */
+    for( size_t i = 0; i < _hiz.mip_views.size(); i++ )
+        vkDestroyImageView(_device, _hiz.mip_views[i], nullptr);
+    vkDestroyImageView(_device, _hiz.view, nullptr);
+
+    _render_graph.reset();
 
     for( size_t i = 0; i < _swap_chain.swap_chain_image_views.size(); i++ )
         vkDestroyImageView(_device, _swap_chain.swap_chain_image_views[i], nullptr);
@@ -1930,9 +5357,41 @@ void Simulation::cleanup_swap_chain()
     {
         vkDestroyBuffer(_device, _scene_uniform_buffers[i], nullptr);
         vkFreeMemory(_device, _scene_uniform_buf_memory[i], nullptr);
+
+        vkDestroyBuffer(_device, _cull.uniform_buffers[i], nullptr);
+        vkFreeMemory(_device, _cull.uniform_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _cull.draw_buffers[i], nullptr);
+        vkFreeMemory(_device, _cull.draw_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _cull.count_buffers[i], nullptr);
+        vkFreeMemory(_device, _cull.count_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _cull.stats_buffers[i], nullptr);
+        vkFreeMemory(_device, _cull.stats_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _meshlet.index_buffers[i], nullptr);
+        vkFreeMemory(_device, _meshlet.index_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _meshlet.draw_buffers[i], nullptr);
+        vkFreeMemory(_device, _meshlet.draw_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _instancing.object_buffers[i], nullptr);
+        vkFreeMemory(_device, _instancing.object_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _instancing.list_buffers[i], nullptr);
+        vkFreeMemory(_device, _instancing.list_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _instancing.draw_buffers[i], nullptr);
+        vkFreeMemory(_device, _instancing.draw_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _lights.uniform_buffers[i], nullptr);
+        vkFreeMemory(_device, _lights.uniform_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _lights.light_buffers[i], nullptr);
+        vkFreeMemory(_device, _lights.light_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _lights.grid_buffers[i], nullptr);
+        vkFreeMemory(_device, _lights.grid_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _lights.index_buffers[i], nullptr);
+        vkFreeMemory(_device, _lights.index_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _taa.uniform_buffers[i], nullptr);
+        vkFreeMemory(_device, _taa.uniform_buf_memory[i], nullptr);
+        vkDestroyBuffer(_device, _exposure.uniform_buffers[i], nullptr);
+        vkFreeMemory(_device, _exposure.uniform_buf_memory[i], nullptr);
     }
 
-    vkDestroyDescriptorPool(_device, _descriptor_pool, nullptr);
+    /* Sets reference destroyed buffers and images - their pools are reused by new sets. */
+    _descriptors->reset();
 }
 
 void Simulation::init_GLFW()
@@ -2015,7 +5474,10 @@ bool Simulation::is_device_suitable(VkPhysicalDevice device)
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-    return indices.isComplete() && extensionSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+    /* GPU-driven rendering requires multiple indirect draws per command and object index passed as first instance. */
+    bool indirectDrawAdequate = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+
+    return indices.isComplete() && extensionSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy && indirectDrawAdequate;
 }
 
 void Simulation::draw_frame()
@@ -2023,6 +5485,10 @@ void Simulation::draw_frame()
     // Wait for previous frame to be finished. 
     vkWaitForFences(_device, 1, &_sync_obj.in_flight_fences[_currentFrame], VK_TRUE, UINT64_MAX);
 
+    /* Frame which used this slot is finished - its latency can be measured and its capture written. */
+    update_latency();
+    finish_frame_capture(_currentFrame);
+
     /*
     *  Perform operations:
     *   Acquire an image from the swap chain.
@@ -2056,34 +5522,90 @@ void Simulation::draw_frame()
 
     // Mark the image as now being in use by current frame
     _sync_obj.images_in_flight[imageIndex] = _sync_obj.in_flight_fences[_currentFrame];
-    
+
+    /* Frame limiter holds the frame back before input is sampled - waiting after sampling would only add latency. */
+    wait_frame_limit();
+
+    /* Input is sampled as late as possible - after every wait for GPU, swap chain and limiter, right before it is used. */
+    glfwPollEvents();
+
+    uint32_t presentId = _frame_pacing.present_id++;
+    _frame_pacing.input_times[presentId % LATENCY_HISTORY]  = std::chrono::steady_clock::now();
+    _frame_pacing.slot_present_ids[_currentFrame]           = presentId;
+    _frame_pacing.slot_pending[_currentFrame]               = true;
+
     /* Update Input and Variables */
     update_variables(imageIndex);
 
-    /* Submit the command buffer */
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    
-    VkSemaphore waitSemaphores[] = { _sync_obj._image_available_semaphores[_currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount   = 1;
-    submitInfo.pWaitSemaphores      = waitSemaphores;
-    submitInfo.pWaitDstStageMask    = waitStages;
+    /* Swap in reloaded pipelines and bring command buffer of this image up to date */
+    update_hot_reload(imageIndex);
 
-    /* Which command buffer to actually submit for execution */
-    submitInfo.commandBufferCount   = 1;
-    submitInfo.pCommandBuffers      = &_command_buffers[imageIndex];
+    /* Culling results of the previous frame rendered into this image */
+    update_stats(imageIndex);
+
+    if( _benchmark.enabled )
+        update_benchmark();
 
-    /* Which semaphore to signal once the command buffer finished execution */
+    /* Submit command buffers - one for each segment of render graph, to the queue of the segment. */
     VkSemaphore signalSemaphores[]  = { _sync_obj._render_finished_semaphores[_currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores    = signalSemaphores;
 
     //Reset fence to be 'unsignaled'.
     vkResetFences(_device, 1, &_sync_obj.in_flight_fences[_currentFrame]);
 
-    if( vkQueueSubmit(_queues.graphics_queue, 1, &submitInfo, _sync_obj.in_flight_fences[_currentFrame]) != VK_SUCCESS )
-        throw std::runtime_error("Failed to submit draw command buffer! :(\n");
+    uint32_t segmentCount = _render_graph->segment_count();
+    bool imageAcquireWaited = false;
+
+    /* Copy of captured frame follows the last segment - it is a graphics one, the present pass is. */
+    VkCommandBuffer captureCommands = record_frame_capture(imageIndex);
+
+    for( uint32_t segment = 0; segment < segmentCount; segment++ )
+    {
+        bool computeSegment = _render_graph->segment_queue(segment) == GRAPH_QUEUE_COMPUTE;
+        bool lastSegment    = segment + 1 == segmentCount;
+
+        /* Swap chain image is rendered by graphics segments - the first one waits until it is acquired.
+        *  Every segment waits for the previous one, which ran on the other queue - including all work submitted to that queue before it.
+        */
+        std::vector<VkSemaphore>            waitSemaphores;
+        std::vector<VkPipelineStageFlags>   waitStages;
+
+        if( !computeSegment && !imageAcquireWaited )
+        {
+            waitSemaphores.push_back(_sync_obj._image_available_semaphores[_currentFrame]);
+            waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            imageAcquireWaited = true;
+        }
+
+        if( segment > 0 )
+        {
+            waitSemaphores.push_back(_sync_obj.segment_semaphores[_currentFrame][segment - 1]);
+            waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        }
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount   = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores      = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask    = waitStages.data();
+
+        /* Which command buffer to actually submit for execution */
+        VkCommandBuffer commandBuffers[] = { _command_buffers[imageIndex][segment], captureCommands };
+        submitInfo.commandBufferCount   = (lastSegment && captureCommands != VK_NULL_HANDLE) ? 2 : 1;
+        submitInfo.pCommandBuffers      = commandBuffers;
+
+        /* Which semaphore to signal once the command buffer finished execution - the last segment finishes the frame. */
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores    = lastSegment ? signalSemaphores : &_sync_obj.segment_semaphores[_currentFrame][segment];
+
+        VkQueue queue = computeSegment ? _queues.compute_queue : _queues.graphics_queue;
+        VkFence fence = lastSegment ? _sync_obj.in_flight_fences[_currentFrame] : VK_NULL_HANDLE;
+
+        if( vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS )
+            throw std::runtime_error("Failed to submit draw command buffer! :(\n");
+    }
+
+    _gpu_timing.submitted[imageIndex]   = true;
+    _gpu_timing.scales[imageIndex]      = _resolution.scale;
 
     /* Presentation - submit the result back to the swap chain */
     VkPresentInfoKHR presentInfo = {};
@@ -2100,9 +5622,24 @@ void Simulation::draw_frame()
     // Can specify array of VkResult values to check for every individual swap chain if presentation was successful.
     presentInfo.pResults = nullptr; //Optional.
 
+    /* Id of the frame is reported back with its actual present time - no desired time, frame is presented as soon as possible. */
+    VkPresentTimeGOOGLE presentTime = {};
+    presentTime.presentID           = presentId;
+    presentTime.desiredPresentTime  = 0;
+
+    VkPresentTimesInfoGOOGLE presentTimesInfo = {};
+    presentTimesInfo.sType          = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+    presentTimesInfo.swapchainCount = 1;
+    presentTimesInfo.pTimes         = &presentTime;
+
+    if( _device_support.display_timing )
+        presentInfo.pNext = &presentTimesInfo;
+
     VkResult presentResult = vkQueuePresentKHR(_queues.present_queue, &presentInfo);
 
-    if( result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || _framebufferResized )
+    if( result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || _framebufferResized || _depth_prepass.toggle_requested ||
+        _msaa.requested_samples != _scene_permutation.samples || _taa.toggle_requested ||
+        _frame_pacing.requested_present_mode != _swap_chain.present_mode )
     {
         _framebufferResized = false;
         recreate_swap_chain();
@@ -2112,17 +5649,53 @@ void Simulation::draw_frame()
         throw std::runtime_error("Failed to present swap chain image! :(\n");
     }
 
-    vkQueueWaitIdle(_queues.present_queue);
-
     // Proceed to next frame counter
     _currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
+/* Sleeps until the next frame of FRAME_LIMIT_FPS is due. Sleep may overshoot by a scheduler tick, so it is done in 1 ms slices only
+*  while remaining time is longer than the worst overshoot seen - the rest is spun, which keeps frames evenly spaced.
+*/
+void Simulation::wait_frame_limit()
+{
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point now = clock::now();
+    if( !_frame_pacing.limiter_enabled )
+    {
+        _frame_pacing.deadline = now;
+        return;
+    }
+
+    auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / FRAME_LIMIT_FPS));
+    _frame_pacing.deadline += period;
+
+    /* Frame is late already - schedule starts again from now instead of hurrying through the missed frames. */
+    if( _frame_pacing.deadline < now )
+    {
+        _frame_pacing.deadline = now;
+        return;
+    }
+
+    const std::chrono::duration<double> slice(0.001);
+    while( std::chrono::duration<double>(_frame_pacing.deadline - clock::now()).count() > slice.count() + _frame_pacing.sleep_error )
+    {
+        clock::time_point start = clock::now();
+        std::this_thread::sleep_for(slice);
+
+        double overshoot = std::chrono::duration<double>(clock::now() - start).count() - slice.count();
+        _frame_pacing.sleep_error = std::max(_frame_pacing.sleep_error * 0.99, overshoot);
+    }
+
+    while( clock::now() < _frame_pacing.deadline )
+        ;
+}
+
 void Simulation::main_loop()
 {
+    /* Events are polled by draw_frame - right before input is used. */
     while(!glfwWindowShouldClose(_window)) 
     {
-        glfwPollEvents();
         draw_frame();
     }
 
@@ -2131,24 +5704,55 @@ void Simulation::main_loop()
 
 void Simulation::cleanup()
 {
-    cleanup_swap_chain();
+    finish_pipeline_reload();
+    _hot_reload.watcher.reset();
 
-    vkDestroyPipeline(_device, _pipelines.offscreen, nullptr);
-    vkDestroyPipelineLayout(_device, _pipeline_layouts.offscreen, nullptr);
+    cleanup_swap_chain();
 
     vkFreeMemory(_device, _offscreen_buffer.memory, nullptr);
     vkDestroyBuffer(_device, _offscreen_buffer.buffer, nullptr);
 
-    vkDestroyFramebuffer(_device, _offscreen_pass.frameBuffer, nullptr);
     vkDestroyRenderPass(_device, _offscreen_pass.render_pass, nullptr);
 
     vkDestroySampler(_device, _offscreen_pass.depth_sampler, nullptr);
-    vkDestroyImageView(_device, _offscreen_pass.depth.image_view, nullptr);
-    vkDestroyImage(_device, _offscreen_pass.depth.image, nullptr);
-    vkFreeMemory(_device, _offscreen_pass.depth.memory, nullptr);
 
-    /* Destroy descriptor set layout which is bounding all of the descriptors. */
-    vkDestroyDescriptorSetLayout(_device, _descriptor_set_layout, nullptr);
+
+    /* Destroy material textures - their set is freed with its pool, layout belongs to layout cache. */
+    for( const auto& texture : _bindless.textures )
+    {
+        vkDestroyImageView(_device, texture.image_view, nullptr);
+        vkDestroyImage(_device, texture.image, nullptr);
+        vkFreeMemory(_device, texture.memory, nullptr);
+    }
+    vkDestroySampler(_device, _bindless.sampler, nullptr);
+    vkDestroyDescriptorPool(_device, _bindless.descriptor_pool, nullptr);
+
+    /* Destroy GPU culling pipeline and per-object data */
+    vkDestroyPipeline(_device, _cull.pipeline, nullptr);
+
+    vkDestroyPipeline(_device, _meshlet.pipeline, nullptr);
+    vkDestroyBuffer(_device, _meshlet.buffer, nullptr);
+    vkFreeMemory(_device, _meshlet.buffer_memory, nullptr);
+
+    vkDestroyPipeline(_device, _hiz.pipeline, nullptr);
+    vkDestroyPipeline(_device, _hiz.resolve_pipeline, nullptr);
+    vkDestroySampler(_device, _hiz.sampler, nullptr);
+
+    vkDestroyPipeline(_device, _taa.pipeline, nullptr);
+    vkDestroySampler(_device, _taa.sampler, nullptr);
+
+    vkDestroyPipeline(_device, _exposure.pipeline, nullptr);
+    vkDestroyBuffer(_device, _exposure.buffer, nullptr);
+    vkFreeMemory(_device, _exposure.buffer_memory, nullptr);
+
+    vkDestroyPipeline(_device, _lights.pipeline, nullptr);
+
+    vkDestroyBuffer(_device, _mesh_buffer, nullptr);
+    vkFreeMemory(_device, _mesh_buffer_memory, nullptr);
+    vkDestroyBuffer(_device, _instancing.template_buffer, nullptr);
+    vkFreeMemory(_device, _instancing.template_buf_memory, nullptr);
+    vkDestroyBuffer(_device, _cull.visibility_buffer, nullptr);
+    vkFreeMemory(_device, _cull.visibility_buf_memory, nullptr);
 
     /* Destroy Index Buffer and allocated to it memory */
     vkDestroyBuffer(_device, _index_buffer, nullptr);
@@ -2163,10 +5767,22 @@ void Simulation::cleanup()
         vkDestroySemaphore(_device, _sync_obj._image_available_semaphores[i], nullptr);
         vkDestroySemaphore(_device, _sync_obj._render_finished_semaphores[i], nullptr);
         vkDestroyFence(_device, _sync_obj.in_flight_fences[i], nullptr);
+
+        for( VkSemaphore semaphore : _sync_obj.segment_semaphores[i] )
+            vkDestroySemaphore(_device, semaphore, nullptr);
     }
 
+    if( _compute_command_pool != _command_pool )
+        vkDestroyCommandPool(_device, _compute_command_pool, nullptr);
     vkDestroyCommandPool(_device, _command_pool, nullptr);
 
+    save_pipeline_cache();
+    vkDestroyPipelineCache(_device, _pipeline_cache, nullptr);
+
+    /* Destroys every descriptor pool, descriptor set layout and pipeline layout. */
+    _descriptors.reset();
+    _layouts.reset();
+
     vkDestroyDevice(_device, nullptr);
 
     vkDestroySurfaceKHR(_instance, _surface, nullptr);
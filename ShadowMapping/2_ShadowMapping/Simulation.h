@@ -1,6 +1,22 @@
 #pragma once
 
 #include "libs.h"
+#include "Mesh.h"
+#include "InstanceStore.h"
+#include "ShaderManager.h"
+#include "FileWatcher.h"
+#include "LayoutCache.h"
+#include "DescriptorAllocator.h"
+#include "RenderGraph.h"
+#include "FrameCapture.h"
+
+#include <ctime>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <thread>
+#include <tuple>
 
 struct QueueFamilyIndices
 {
@@ -9,6 +25,9 @@ struct QueueFamilyIndices
     /* Ability to present on surface */
     std::optional<uint32_t> presentFamily;
 
+    /* Compute without graphics - work submitted to it overlaps graphics queue (async compute). Optional. */
+    std::optional<uint32_t> computeFamily;
+
     bool isComplete()
     {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -22,88 +41,65 @@ struct SwapChainSupportDetails
     std::vector<VkPresentModeKHR> presentModes;
 };
 
-struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 color;
-    glm::vec2 texCoord;
-    glm::vec3 normal;
-
-    static VkVertexInputBindingDescription getBindingDescription() 
-    {
-        /* Structure describing data rate */
-        VkVertexInputBindingDescription bindingDescription = {};
-        bindingDescription.binding      = 0;                            /* Specifies the index of binding in the array of bindings. */
-        bindingDescription.stride       = sizeof(Vertex);               /* Number of bytes from one entry to next one. */
-        bindingDescription.inputRate    = VK_VERTEX_INPUT_RATE_VERTEX;  /* RATE_VERTEX means: move to next data entry after each vertex. */
+/* Views against which objects are culled. Every view gets its own list of indirect draw commands. */
+enum cull_view
+{
+    CULL_VIEW_SCENE = 0,    /* Camera frustum   - scene render pass, objects visible in previous frame */
+    CULL_VIEW_SHADOW,       /* Light frustum    - offscreen (shadow map) render pass */
+    CULL_VIEW_SCENE_LATE,   /* Camera frustum   - late scene render pass, objects which passed Hi-Z test and were not drawn yet */
+    CULL_VIEW_COUNT,
+};
 
-        return bindingDescription;
-    }
-    
-    /* An attribute description struct describes how to extract a vertex attribute from a chunk of vertex data. 
-    *  Thats why we have here 2 structures- one description for position, one description for color.
-    *  Corresponding formats of data:
-    *       float: VK_FORMAT_R32_SFLOAT
-    *       vec2: VK_FORMAT_R32G32_SFLOAT
-    *       vec3: VK_FORMAT_R32G32B32_SFLOAT
-    *       vec4: VK_FORMAT_R32G32B32A32_SFLOAT
-    *       ivec2: VK_FORMAT_R32G32_SINT
-    *       uvec4: VK_FORMAT_R32G32B32A32_UINT
-    *       double: VK_FORMAT_R64_SFLOAT
-    */
-    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() 
-    {
-        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = {};
+/* Two-phase occlusion culling. Early phase runs before rendering, late phase after depth pyramid is built. */
+enum cull_phase
+{
+    CULL_PHASE_EARLY = 0,
+    CULL_PHASE_LATE,
+};
 
-        /* Description of pos attribute */
-        attributeDescriptions[0].binding    = 0;
-        attributeDescriptions[0].location   = 0;  /* References to location inside Vertex Shader - 0 for position. */
-        attributeDescriptions[0].format     = VK_FORMAT_R32G32B32_SFLOAT;  /* Format of vertex position data - vec3 */
-        attributeDescriptions[0].offset     = offsetof(Vertex, pos);
-        
-        /* Description of color attribute */
-        attributeDescriptions[1].binding    = 0;
-        attributeDescriptions[1].location   = 1;
-        attributeDescriptions[1].format     = VK_FORMAT_R32G32B32_SFLOAT;   /* vec3 format */
-        attributeDescriptions[1].offset     = offsetof(Vertex, color);
-
-        /* Description of Texture coordinate attribute */
-        attributeDescriptions[2].binding    = 0;
-        attributeDescriptions[2].location   = 2;
-        attributeDescriptions[2].format     = VK_FORMAT_R32G32_SFLOAT;      /* vec2 format */
-        attributeDescriptions[2].offset     = offsetof(Vertex, texCoord);
-
-        /* Description of normal vector attribute */
-        attributeDescriptions[3].binding    = 0;
-        attributeDescriptions[3].location   = 3;
-        attributeDescriptions[3].format     = VK_FORMAT_R32G32B32_SFLOAT;      /* vec3 format */
-        attributeDescriptions[3].offset     = offsetof(Vertex, normal);
-
-        return attributeDescriptions;
-    }
+/* Lighting model of scene fragment shader - value of LIGHTING_MODEL specialization constant. */
+enum lighting_model
+{
+    LIGHTING_PHONG = 0,
+    LIGHTING_BLINN_PHONG,
+    LIGHTING_LAMBERT,   /* Diffuse only */
+};
 
-    /* Override == operator to specify equality comparison. */
-    bool operator==(const Vertex& other) const 
+/* Scene shader permutation - specialization constants of shader.vert and shader.frag and fixed state of scene pipeline.
+*  Every permutation is a separate pipeline. Members are passed as specialization data directly, each one has to stay 4 bytes wide.
+*/
+struct Scene_Permutation
+{
+    int32_t     shadow_filter_radius    = SHADOW_FILTER_RADIUS;     /* constant_id 0 */
+    int32_t     lighting_model          = LIGHTING_PHONG;           /* constant_id 1 */
+    float       ambient                 = AMBIENT_LIGHT;            /* constant_id 2 */
+    VkBool32    vertex_colors           = VK_TRUE;                  /* constant_id 3 */
+    VkBool32    depth_prepass           = VK_FALSE;                 /* Depth test EQUAL without writes - depth is laid down by pre-pass */
+    VkSampleCountFlagBits samples       = VK_SAMPLE_COUNT_1_BIT;    /* Rasterization samples - has to match scene render pass */
+    float       min_sample_shading      = 0.f;                      /* Fraction of samples shaded separately - 0 shades once per pixel */
+    VkBool32    temporal_shadows        = VK_FALSE;                 /* constant_id 4 - rotated shadow samples converged by TAA */
+
+    auto key() const
     {
-        return (pos == other.pos) && 
-            (color      == other.color) && 
-            (texCoord   == other.texCoord) && 
-            (normal     == other.normal);
+        return std::tie(shadow_filter_radius, lighting_model, ambient, vertex_colors, depth_prepass, samples, min_sample_shading,
+            temporal_shadows);
     }
+
+    bool operator<(const Scene_Permutation& other) const    { return key() < other.key(); }
+    bool operator==(const Scene_Permutation& other) const   { return key() == other.key(); }
+    bool operator!=(const Scene_Permutation& other) const   { return key() != other.key(); }
 };
 
-/* Hash calculation function for unordered map. */
-namespace std {
-    template<> struct hash<Vertex>
-    {
-        size_t operator()(Vertex const& vertex) const noexcept
-        {
-            return ((hash<glm::vec3>()(vertex.pos) ^ 
-                    (hash<glm::vec3>()(vertex.color) << 1 )) >> 1) ^
-                    (hash<glm::vec2>()(vertex.texCoord) << 1) ^
-                    (hash<glm::vec3>()(vertex.normal) << 1);
-        }
-    };
-}
+/* Pipelines rebuilt after their shader sources are modified. */
+enum reload_pipeline
+{
+    RELOAD_PIPELINE_GRAPHICS    = 1 << 0,   /* Scene and offscreen pipelines */
+    RELOAD_PIPELINE_CULL        = 1 << 1,
+    RELOAD_PIPELINE_HIZ         = 1 << 2,
+    RELOAD_PIPELINE_MESHLET     = 1 << 3,
+    RELOAD_PIPELINE_CLUSTER     = 1 << 4,
+    RELOAD_PIPELINE_POST        = 1 << 5,   /* Temporal anti-aliasing, auto exposure and present pipelines */
+};
 
 
 class Simulation
@@ -122,6 +118,11 @@ public:
 
     void run();
 
+    /* Renders the scene with every LOD bias of BENCHMARK_LOD_BIASES and prints frame time and triangle counts.
+    *  With non-zero capture interval every interval-th frame is written into CAPTURE_DIR.
+    */
+    void run_benchmark(uint32_t captureInterval = 0);
+
 private:
     /* Delta Time variables */
     struct Time_Count {
@@ -169,6 +170,33 @@ private:
     VkPhysicalDevice    _physical_device = VK_NULL_HANDLE;
     VkDevice            _device          = nullptr;
 
+    /* Optional device capabilities - detected while creating logical device. */
+    struct Device_Support {
+        bool        draw_indirect_count     = false;
+        uint32_t    max_draw_indirect_count = 1;
+
+        /* Bindless textures - sampled image array indexed non-uniformly and updated after bind (VK_EXT_descriptor_indexing). */
+        bool        descriptor_indexing     = false;
+        uint32_t    max_bindless_textures   = 0;
+
+        /* Separate compute queue family - culling and depth pyramid run on its queue. */
+        bool        async_compute           = false;
+
+        /* Nanoseconds per timestamp tick - 0 if graphics and compute queues cannot write timestamps. */
+        float       timestamp_period        = 0.f;
+
+        /* Sample counts of scene pass - supported by color and depth attachments and by sampled depth (read by Hi-Z reduction). */
+        VkSampleCountFlags  msaa_sample_counts  = VK_SAMPLE_COUNT_1_BIT;
+        bool        sample_rate_shading     = false;
+
+        /* Actual present times (VK_GOOGLE_display_timing) - latency is measured up to the frame reaching the display. */
+        bool        display_timing          = false;
+    } _device_support;
+
+    /* Extension entry points - loaded only if corresponding extension is enabled. */
+    PFN_vkCmdDrawIndexedIndirectCountKHR    _vkCmdDrawIndexedIndirectCount = nullptr;
+    PFN_vkGetPastPresentationTimingGOOGLE   _vkGetPastPresentationTiming = nullptr;
+
     /* Current used frame */
     size_t _currentFrame = 0;
 
@@ -176,6 +204,10 @@ private:
     struct Queues {
         VkQueue graphics_queue;
         VkQueue present_queue;
+        VkQueue compute_queue;      /* Graphics queue without async compute */
+
+        uint32_t graphics_family;
+        uint32_t compute_family;
     } _queues;
     
     /* Swap chain */
@@ -183,6 +215,9 @@ private:
         VkSwapchainKHR  swap_chain {};
         VkFormat        swap_chain_image_format {};
         VkExtent2D      swap_chain_extent {};
+        VkPresentModeKHR                present_mode = VK_PRESENT_MODE_FIFO_KHR;
+        std::vector<VkPresentModeKHR>   present_modes {};   /* Supported by the surface */
+        bool                            transfer_source = false;    /* Images can be copied from - required by frame capture */
 
         /* Swap chain image handles */
         std::vector<VkImage> swap_chain_images {};
@@ -191,11 +226,111 @@ private:
         std::vector<VkImageView> swap_chain_image_views {};
     } _swap_chain;
 
-    /* Descriptor pool to hold descriptors set. */
-    VkDescriptorPool        _descriptor_pool;
+    /* GLSL sources compiled at runtime - SPIR-V is cached in SHADER_CACHE_DIR. */
+    ShaderManager           _shaders { SHADER_CACHE_DIR };
+
+    /* Shader variants of all pipelines. Constants shared with host code are passed as defines. */
+    struct {
+        ShaderVariant   scene_vert;
+        ShaderVariant   scene_frag;
+        ShaderVariant   offscreen_vert;
+        ShaderVariant   prepass_vert;
+        ShaderVariant   cull_comp;
+        ShaderVariant   hiz_comp;
+        ShaderVariant   hiz_resolve_comp;   /* hiz.comp reading multisampled scene depth */
+        ShaderVariant   meshlet_comp;
+        ShaderVariant   cluster_comp;
+        ShaderVariant   taa_comp;
+        ShaderVariant   fullscreen_vert;
+        ShaderVariant   present_frag;
+        ShaderVariant   exposure_comp;
+    } _shader_variants;
+
+    /* Descriptor set and pipeline layouts reflected from SPIR-V - pipelines with the same interface share one layout. */
+    std::unique_ptr<LayoutCache>    _layouts {};
+
+    /* Shared by all pipeline creations - including ones of background reload. Persisted in PIPELINE_CACHE_PATH. */
+    VkPipelineCache         _pipeline_cache = VK_NULL_HANDLE;
+
+    /* Pipelines built by reload job - only ones selected by mask are valid. */
+    struct Reloaded_Pipelines {
+        uint32_t    mask        = 0;
+        Scene_Permutation permutation {};   /* Permutation of scene pipeline */
+        VkPipeline  scene       = VK_NULL_HANDLE;
+        VkPipeline  offscreen   = VK_NULL_HANDLE;
+        VkPipeline  prepass     = VK_NULL_HANDLE;
+        VkPipeline  cull        = VK_NULL_HANDLE;
+        VkPipeline  hiz         = VK_NULL_HANDLE;
+        VkPipeline  hiz_resolve = VK_NULL_HANDLE;
+        VkPipeline  meshlet     = VK_NULL_HANDLE;
+        VkPipeline  cluster     = VK_NULL_HANDLE;
+        VkPipeline  taa         = VK_NULL_HANDLE;
+        VkPipeline  present     = VK_NULL_HANDLE;
+        VkPipeline  exposure    = VK_NULL_HANDLE;
+    };
+
+    /* Replaced pipeline - still referenced by command buffers recorded before given generation. */
+    struct Retired_Pipeline {
+        VkPipeline  pipeline;
+        uint64_t    generation;
+    };
+
+    /* Shader hot reload - modified sources are compiled and their pipelines built on a background thread.
+    *  New pipelines are swapped in between frames, each command buffer is re-recorded once its image is free again.
+    */
+    struct {
+        std::unique_ptr<FileWatcher>        watcher {};
+        uint32_t                            pending_mask = 0;   /* reload_pipeline flags waiting for next job */
+        std::future<Reloaded_Pipelines>     job {};
+
+        /* Incremented by every swap - command buffers recorded with older generation reference retired pipelines. */
+        uint64_t                            generation = 0;
+        std::vector<uint64_t>               recorded_generation {};     /* Per swap chain image */
+        std::vector<Retired_Pipeline>       retired {};
+    } _hot_reload;
+
+    /* Descriptor sets of every pipeline - pools are chained as needed and reset in bulk when swap chain is recreated. */
+    std::unique_ptr<DescriptorAllocator>    _descriptors {};
     /* Descriptors Layout - all of the descriptors are combined into single descriptor set layout. */
     VkDescriptorSetLayout   _descriptor_set_layout;
 
+    /* Frame render graph - passes declare buffers and images they use, barriers between them are derived by the graph.
+    *  Owns depth attachments and depth pyramid - their memory is aliased when lifetimes allow it. Rebuilt with swap chain.
+    */
+    std::unique_ptr<RenderGraph>    _render_graph {};
+
+    struct {
+        RenderGraph::Resource   shadow_map;
+        RenderGraph::Resource   scene_depth;
+        RenderGraph::Resource   scene_color;    /* Single sampled color and velocity - resolve targets with MSAA */
+        RenderGraph::Resource   velocity;
+        RenderGraph::Resource   scene_color_ms; /* Multisampled color and velocity - created only with MSAA */
+        RenderGraph::Resource   velocity_ms;
+        RenderGraph::Resource   hiz;
+        RenderGraph::Resource   swap_chain;
+
+        /* Temporal anti-aliasing - output of this frame is copied into history, which is kept for the next one. */
+        RenderGraph::Resource   taa_output;
+        RenderGraph::Resource   taa_history;
+
+        /* Auto exposure - histogram and exposure persist between frames, exposure is read by present pass. */
+        RenderGraph::Resource   exposure;
+
+        /* Culling outputs - per swap chain image buffers share one resource, each command buffer uses its own ones. */
+        RenderGraph::Resource   cull_counts;
+        RenderGraph::Resource   object_draws;
+        RenderGraph::Resource   instance_draws;
+        RenderGraph::Resource   instance_lists;
+        RenderGraph::Resource   meshlet_draws;
+        RenderGraph::Resource   meshlet_indices;
+        RenderGraph::Resource   visibility;
+        RenderGraph::Resource   cull_stats;
+
+        /* Light clusters - per swap chain image, written by clustering and read by scene passes. */
+        RenderGraph::Resource   light_grid;
+        RenderGraph::Resource   light_indices;
+    } _graph_resources {};
+
     struct FrameBufferAttachment {
         VkImage         image;
         VkDeviceMemory  memory;
@@ -211,12 +346,18 @@ private:
     } _offscreen_pass;
 
     struct ScenePass {
-        /* Separate framebuffer for each swapchain image. */
-        std::vector<VkFramebuffer>  framebuffers {};
+        /* Scene is rendered into images of render graph - present pass copies it into swap chain image. */
+        VkFramebuffer               framebuffer {};
 
         /* Depth testing requires three resources- image, memory and image view. */
         FrameBufferAttachment       depth {};
+        FrameBufferAttachment       color {};       /* Images owned by render graph */
+        FrameBufferAttachment       velocity {};
         VkRenderPass                render_pass {};
+        /* Continues rendering into the same attachments after occlusion test of remaining objects. */
+        VkRenderPass                late_render_pass {};
+        /* Shades after depth pre-pass - clears color only, depth is kept from the pre-pass. */
+        VkRenderPass                shading_render_pass {};
         VkSampler                   depth_sampler {};
         VkDescriptorImageInfo       descriptor {};
     } _scene_pass;
@@ -229,20 +370,192 @@ private:
     struct {
         /* Offscreen rendering pipeline */
         VkPipeline offscreen;
-        /* Main graphics pipeline */
+        /* Depth pre-pass - offscreen state with prepass.vert, without depth bias, with sample count of scene pass */
+        VkPipeline prepass;
+        /* Main graphics pipeline - the one of selected scene permutation */
         VkPipeline scene;
+        /* Scene pipelines of every permutation selected so far - created on first use through pipeline cache */
+        std::map<Scene_Permutation, VkPipeline> scene_permutations {};
     } _pipelines;
 
-    struct {
-        VkDescriptorSet                 offscreen {};
+    /* Selected scene permutation - changed by keyboard */
+    Scene_Permutation       _scene_permutation;
+
+    /* Depth pre-pass - scene depth is laid down by the position only pre-pass pipeline first and scene pipeline shades only
+    *  fragments whose depth equals it. Every visible fragment is shaded once, however much overdraw the scene has.
+    *  Enabled by depth_prepass of selected scene permutation, toggled by keyboard - render graph is rebuilt with or without it.
+    */
+    struct {
+        VkRenderPass                render_pass = VK_NULL_HANDLE;       /* Clears depth - early phase */
+        VkRenderPass                late_render_pass = VK_NULL_HANDLE;  /* Keeps depth - late phase */
+        VkFramebuffer               framebuffer = VK_NULL_HANDLE;
+
+        bool                        toggle_requested = false;   /* Applied by swap chain recreation */
+        bool                        key_down = false;
+    } _depth_prepass;
+
+    /* Multisampled scene rendering - scene pass renders color, velocity and depth with samples of selected permutation and resolves
+    *  color and velocity into single sampled images at the end of the subpass. Multisampled color never leaves the pass with depth pre-pass,
+    *  so it is a transient attachment in lazily allocated memory where device has such. Sample count is changed by keyboard -
+    *  render passes, pipelines and render graph are recreated with it.
+    */
+    struct {
+        FrameBufferAttachment       color {};           /* Images owned by render graph, null views without MSAA */
+        FrameBufferAttachment       velocity {};
+        VkSampleCountFlagBits       requested_samples = VK_SAMPLE_COUNT_1_BIT;     /* Applied by swap chain recreation */
+        bool                        key_down = false;
+        bool                        shading_key_down = false;
+    } _msaa;
+
+    /* Temporal anti-aliasing - projection is jittered by a subpixel offset every frame, taa.comp reprojects history of previous
+    *  frames by velocity written by scene pass and blends this frame into it. Shadows are filtered by few samples rotated every
+    *  frame (temporal_shadows of scene permutation), accumulated by the history. Toggled by keyboard with swap chain recreation.
+    */
+    struct {
+        bool                            enabled = true;
+        bool                            toggle_requested = false;
+        bool                            key_down = false;
+
+        FrameBufferAttachment           history {};     /* Persistent between frames - created only with TAA */
+        FrameBufferAttachment           output {};      /* Image owned by render graph */
+        VkSampler                       sampler = VK_NULL_HANDLE;   /* Bilinear, clamped - also used by present pass */
+
+        VkDescriptorSetLayout           descriptor_set_layout;
+        VkPipelineLayout                pipeline_layout;
+        VkPipeline                      pipeline = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet>    descriptor_sets {};
+
+        /* Per swap chain image - history weight and texel size */
+        std::vector<VkBuffer>           uniform_buffers {};
+        std::vector<VkDeviceMemory>     uniform_buf_memory {};
+
+        /* Frames since history was created - the first one has no history and no motion */
+        uint32_t                        frame = 0;
+        glm::mat4                       prev_view_proj { 1.f };
+        glm::vec2                       prev_jitter { 0.f };
+        glm::vec2                       history_scale { 1.f };  /* Part of history image written by previous frame */
+    } _taa;
+
+    /* Present pass - the only writer of swap chain image, draws the frame into it by a fullscreen triangle. */
+    struct {
+        VkRenderPass                    render_pass = VK_NULL_HANDLE;
+        std::vector<VkFramebuffer>      framebuffers {};    /* One for each swap chain image */
+        VkDescriptorSetLayout           descriptor_set_layout;
+        VkPipelineLayout                pipeline_layout;
+        VkPipeline                      pipeline = VK_NULL_HANDLE;
+        VkDescriptorSet                 descriptor_set = VK_NULL_HANDLE;
+    } _present_pass;
+
+    /* Auto exposure - exposure.comp builds luminance histogram of scene color and adapts exposure to it in one dispatch.
+    *  Present pass multiplies HDR color by the exposure and tonemaps it. Buffer outlives swap chain, so adaptation continues.
+    */
+    struct {
+        VkBuffer                        buffer = VK_NULL_HANDLE;   /* Histogram, group counter and exposure */
+        VkDeviceMemory                  buffer_memory = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayout           descriptor_set_layout;
+        VkPipelineLayout                pipeline_layout;
+        VkPipeline                      pipeline = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet>    descriptor_sets {};
+
+        /* Per swap chain image - adaptation rate depends on frame time */
+        std::vector<VkBuffer>           uniform_buffers {};
+        std::vector<VkDeviceMemory>     uniform_buf_memory {};
+    } _exposure;
+
+    /* Dynamic resolution - scene passes render into the top-left part of their attachments and shadow pass into the same part of
+    *  the shadow map, both sized by 'scale'. Scale follows GPU time of frames rendered with it, present pass upscales the rendered
+    *  part to the whole swap chain image. Command buffers recorded with another scale are recorded again before submission.
+    */
+    struct {
+        bool                            enabled = true;
+        bool                            key_down = false;
+        float                           scale = 1.f;
+        std::vector<float>              recorded_scales {};     /* Per swap chain image - scale its command buffers were recorded with */
+
+        /* Frames measured at current scale and their GPU time in milliseconds - reset whenever scale changes */
+        uint32_t                        samples = 0;
+        double                          frame_time = 0.0;
+    } _resolution;
+
+    /* Frame pacing - present mode is selected at runtime, frame limiter holds frames back to FRAME_LIMIT_FPS. Input is sampled
+    *  as late as possible and latency is measured from it to presentation (with display timing) or to GPU completion otherwise.
+    */
+    struct {
+        VkPresentModeKHR                requested_present_mode = PRESENT_MODE;     /* Applied by swap chain recreation */
+        bool                            present_key_down = false;
+
+        bool                            limiter_enabled = false;
+        bool                            limiter_key_down = false;
+        std::chrono::steady_clock::time_point   deadline {};
+        double                          sleep_error = 0.002;    /* Oversleep of a 1 ms sleep - in seconds, decays slowly */
+
+        /* Input sampling time of the last LATENCY_HISTORY frames - indexed by present id */
+        uint32_t                        present_id = 0;
+        std::array<std::chrono::steady_clock::time_point, LATENCY_HISTORY> input_times {};
+
+        /* Present id of the frame every frame in flight slot was used for - measured once its fence is signalled */
+        std::array<uint32_t, MAX_FRAMES_IN_FLIGHT>  slot_present_ids {};
+        std::array<bool, MAX_FRAMES_IN_FLIGHT>      slot_pending {};
+    } _frame_pacing;
+
+    /* Frame capture - swap chain image is copied by a command buffer submitted after the frame's last one. Copy is handed over
+    *  to the writing thread once fence of its frame in flight slot is waited for. Screenshot is taken by keyboard, sequences
+    *  capture every interval-th frame. Recreated with swap chain, null if swap chain images cannot be copied.
+    */
+    struct {
+        std::unique_ptr<FrameCapture>   capture {};
+        std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT>   command_buffers {};
+        std::array<uint32_t, MAX_FRAMES_IN_FLIGHT>          pending_slots {};  /* Slot written by every frame in flight slot */
+
+        bool                            screenshot_requested = false;
+        bool                            screenshot_key_down = false;
+        uint32_t                        screenshots = 0;
+
+        bool                            sequence_enabled = false;
+        bool                            sequence_key_down = false;
+        uint32_t                        sequence_interval = CAPTURE_SEQUENCE_INTERVAL;
+        uint32_t                        sequence_frame = 0;     /* Frames rendered since sequence started */
+        uint32_t                        captured = 0;
+        uint32_t                        dropped = 0;
+    } _capture;
+
+    struct {
+        std::vector<VkDescriptorSet>    offscreen {};
         std::vector<VkDescriptorSet>    scene {};
+        std::vector<VkDescriptorSet>    prepass {};
     } _descriptor_sets;
 
+    /* Bindless materials - textures of all materials in one update-after-bind array (set 1 of scene pipeline), selected
+    *  by material index of the object. Objects of different materials share a draw and nothing is bound per material.
+    *  Used only if device supports descriptor indexing - scene is drawn with vertex colors otherwise.
+    */
+    struct {
+        bool                                enabled = false;
+        uint32_t                            texture_count = 0;  /* Length of array declared by shader.frag */
+        std::vector<FrameBufferAttachment>  textures {};
+        VkSampler                           sampler = VK_NULL_HANDLE;
+        VkDescriptorPool                    descriptor_pool = VK_NULL_HANDLE;
+        VkDescriptorSetLayout               descriptor_set_layout = VK_NULL_HANDLE;
+        VkDescriptorSet                     descriptor_set = VK_NULL_HANDLE;
+    } _bindless;
+
     /* Command Pool- to store commands */
     VkCommandPool _command_pool;
+    VkCommandPool _compute_command_pool;    /* Command buffers of compute queue - the graphics pool without async compute */
 
-    /* Command Buffers- to record commands */
-    std::vector<VkCommandBuffer> _command_buffers;
+    /* Command Buffers- to record commands. Every swap chain image has one for each segment of render graph. */
+    std::vector<std::vector<VkCommandBuffer>> _command_buffers;
+
+    /* GPU time of render graph segments - timestamps at the beginning and end of every segment. */
+    struct {
+        std::vector<VkQueryPool>    query_pools {};     /* Per swap chain image - two queries for each segment */
+        std::vector<bool>           submitted {};       /* Queries of the image were written at least once */
+        std::vector<float>          scales {};          /* Resolution scale of the frame the queries belong to */
+
+        /* Segments of the previously read frame - compute work of the next frame overlaps its graphics tail. */
+        std::vector<std::pair<uint64_t, uint64_t>>  graphics_intervals {};
+    } _gpu_timing;
 
     struct Sync_Objects {
         /* Semaphore- signals that an image has been acquired and is ready for rendering. */
@@ -251,6 +564,9 @@ private:
         /* Semaphore- signals that rendering has finished and presentation can happen. */
         std::vector<VkSemaphore> _render_finished_semaphores;
 
+        /* Semaphores between segments of render graph - segment i signals [i] which is waited for by segment i + 1. */
+        std::vector<std::vector<VkSemaphore>> segment_semaphores;
+
         /* CPU-GPU synchronization fences */
         std::vector<VkFence> in_flight_fences;
         std::vector<VkFence> images_in_flight;
@@ -265,11 +581,222 @@ private:
     VkBuffer        _index_buffer;               /* Index data for corresponding vertex buffer. */
     VkDeviceMemory  _index_buffer_memory;
 
+    /* Meshes stored inside vertex/index buffers and objects (mesh instances) placed in the scene. */
+    std::vector<MeshInfo>   _meshes;
+    InstanceStore           _instances;
+
+    /* Storage buffer holding MeshData of every mesh - levels of detail selected by culling shader. */
+    VkBuffer        _mesh_buffer;
+    VkDeviceMemory  _mesh_buffer_memory;
+
+    /* Meshlets of all meshes - ranges are referenced by MeshInfo. */
+    std::vector<Meshlet>    _meshlets;
+
+    /* Hardware instancing - objects of frequently used meshes are drawn by one indirect draw per view and mesh.
+    *  Culling writes ids of visible objects into per-view instance lists, vertex shaders fetch ObjectData through them.
+    */
+    struct {
+        bool                            animate = false;
+
+        /* Per swap chain image: ObjectData of every object - persistently mapped, updated from _instances. */
+        std::vector<VkBuffer>           object_buffers {};
+        std::vector<VkDeviceMemory>     object_buf_memory {};
+        std::vector<ObjectData*>        object_data {};
+
+        /* Per swap chain image: visible object ids - every view holds range of each mesh. */
+        std::vector<VkBuffer>           list_buffers {};
+        std::vector<VkDeviceMemory>     list_buf_memory {};
+
+        /* Per swap chain image: instanced draw of every mesh in every view - reset from template before culling. */
+        std::vector<VkBuffer>           draw_buffers {};
+        std::vector<VkDeviceMemory>     draw_buf_memory {};
+        VkBuffer                        template_buffer;
+        VkDeviceMemory                  template_buf_memory;
+    } _instancing;
+
+    /* GPU-driven rendering: compute shader culls objects and writes indirect draw commands. */
+    struct {
+        VkDescriptorSetLayout           descriptor_set_layout;
+        VkPipelineLayout                pipeline_layout;
+        VkPipeline                      pipeline;
+        std::vector<VkDescriptorSet>    descriptor_sets {};
+
+        /* Per swap chain image resources: frustum planes, generated draw commands and their counts. */
+        std::vector<VkBuffer>           uniform_buffers {};
+        std::vector<VkDeviceMemory>     uniform_buf_memory {};
+        std::vector<VkBuffer>           draw_buffers {};
+        std::vector<VkDeviceMemory>     draw_buf_memory {};
+        std::vector<VkBuffer>           count_buffers {};
+        std::vector<VkDeviceMemory>     count_buf_memory {};
+
+        /* Host visible copy of counters - read back for statistics. */
+        std::vector<VkBuffer>           stats_buffers {};
+        std::vector<VkDeviceMemory>     stats_buf_memory {};
+
+        /* Visibility of every object in previous frame - persistent between frames. */
+        VkBuffer                        visibility_buffer;
+        VkDeviceMemory                  visibility_buf_memory;
+    } _cull;
+
+    /* Meshlet culling - drawn geometry comes from per-image index buffers holding compacted indices of surviving meshlets. */
+    struct {
+        VkBuffer                        buffer;         /* All meshlets */
+        VkDeviceMemory                  buffer_memory;
+
+        VkDescriptorSetLayout           descriptor_set_layout;
+        VkPipelineLayout                pipeline_layout;
+        VkPipeline                      pipeline;
+        std::vector<VkDescriptorSet>    descriptor_sets {};
+
+        /* Static indices followed by MESHLET_OUTPUT_INDICES region for compacted ones. */
+        std::vector<VkBuffer>           index_buffers {};
+        std::vector<VkDeviceMemory>     index_buf_memory {};
+
+        /* One draw command for every chunk of MESHLET_GROUP_SIZE meshlets with surviving triangles - consumed by render passes. */
+        std::vector<VkBuffer>           draw_buffers {};
+        std::vector<VkDeviceMemory>     draw_buf_memory {};
+    } _meshlet;
+
+    /* Layout has to match 'CullData' uniform block inside cull.comp and meshlet.comp */
+    struct {
+        glm::vec4   frustum_planes[CULL_VIEW_COUNT * 6];
+        glm::mat4   view_proj;          /* Camera view-projection - projects bounding spheres onto depth pyramid */
+        glm::vec4   camera_pos;         /* Eye position for meshlet normal cone test */
+        glm::vec2   pyramid_size;
+        uint32_t    pyramid_levels;
+        uint32_t    object_count;
+        uint32_t    meshlet_chunk_count;    /* Most chunks of MESHLET_GROUP_SIZE meshlets in a single mesh */
+        uint32_t    output_index_offset;    /* First index of compacted region - number of static indices */
+        uint32_t    output_index_capacity;
+        uint32_t    mesh_count;
+        uint32_t    meshlet_object_count;   /* Objects of meshes which are not instanced - size of per-view object draw lists */
+        float       lod_scale;              /* Pixels covered by unit length at unit distance from camera */
+        float       lod_error_threshold;    /* Largest screen-space error of selected level - in pixels */
+        float       shadow_lod_error_threshold;
+    } _cull_uniform_buf_obj;
+
+    /* Layout has to match 'ObjectDraw' structure inside cull.comp and meshlet.comp */
+    struct Object_Draw {
+        uint32_t    list_index;     /* Entry of visible instance list holding object id */
+        uint32_t    lod;
+    };
+
+    /* Layout has to match 'DrawCounts' storage buffer inside cull.comp and meshlet.comp */
+    struct Cull_Counters {
+        uint32_t    draw_count[CULL_VIEW_COUNT];        /* Objects of not instanced meshes - input of meshlet culling */
+        uint32_t    cluster_draw_count[CULL_VIEW_COUNT];/* Meshlet chunks - drawn by render passes */
+        uint32_t    visible_count;      /* Objects which passed both frustum and Hi-Z test */
+        uint32_t    occluded_count;     /* Objects inside camera frustum rejected by Hi-Z test */
+        uint32_t    meshlet_count;      /* Meshlets of objects drawn by scene passes */
+        uint32_t    meshlet_culled_count;   /* Meshlets of objects drawn by scene passes rejected by cone or frustum test */
+        uint32_t    triangle_count;     /* Triangles submitted to scene passes */
+        uint32_t    output_index_count; /* Allocation counter of compacted index region */
+        uint32_t    object_draw_count[CULL_VIEW_COUNT]; /* All objects drawn in the view */
+        uint32_t    shadow_triangle_count;  /* Triangles submitted to shadow pass */
+    };
+
+    /* Layout has to match 'LightData' structure inside cluster.comp and shader.frag */
+    struct Light_Data {
+        glm::vec4   position;       /* xyz - world space position, w - range */
+        glm::vec4   color;          /* rgb - color scaled by intensity, w - cosine of inner cone angle */
+        glm::vec4   direction;      /* xyz - spot direction, w - cosine of outer cone angle; -1 for point lights */
+    };
+
+    /* Clustered forward lighting - point and spot lights on top of the shadow casting one. Lights are assigned to clusters
+    *  (CLUSTER_GRID_X x Y screen tiles, CLUSTER_GRID_Z depth slices) by cluster.comp, scene fragment shader iterates
+    *  only the lights of its cluster - cost of a fragment depends on lights nearby, not on number of lights in the scene.
+    */
+    struct {
+        std::vector<Light_Data>         sources {};     /* MAX_LIGHTS lights at their initial positions */
+        uint32_t                        count = INITIAL_LIGHTS;    /* Lights in use - changed by keyboard */
+        float                           angle = 0.f;    /* Rotation of all lights around the scene */
+        bool                            key_down = false;
+
+        VkDescriptorSetLayout           descriptor_set_layout;
+        VkPipelineLayout                pipeline_layout;
+        VkPipeline                      pipeline;
+        std::vector<VkDescriptorSet>    descriptor_sets {};
+
+        /* Per swap chain image: clustering parameters and lights - written by CPU every frame, lights are persistently mapped. */
+        std::vector<VkBuffer>           uniform_buffers {};
+        std::vector<VkDeviceMemory>     uniform_buf_memory {};
+        std::vector<VkBuffer>           light_buffers {};
+        std::vector<VkDeviceMemory>     light_buf_memory {};
+        std::vector<Light_Data*>        light_data {};
+
+        /* Per swap chain image: offset and count of every cluster and the compact list of light indices they point into. */
+        std::vector<VkBuffer>           grid_buffers {};
+        std::vector<VkDeviceMemory>     grid_buf_memory {};
+        std::vector<VkBuffer>           index_buffers {};
+        std::vector<VkDeviceMemory>     index_buf_memory {};
+    } _lights;
+
+    /* Layout has to match 'ClusterData' uniform block inside cluster.comp */
+    struct {
+        glm::mat4   view;
+        glm::mat4   inv_proj;       /* Unprojects corners of clusters into view space */
+        float       z_near;
+        float       z_far;
+        uint32_t    light_count;
+        uint32_t    index_capacity;
+    } _cluster_uniform_buf_obj;
+
+    /* Level of detail selection - bias scales allowed screen-space error by 2^bias. */
+    struct Lod_Settings {
+        float       bias        = 0.f;
+    } _lod;
+
+    /* Benchmark mode - every LOD bias is measured for BENCHMARK_FRAMES frames. */
+    struct Benchmark {
+        bool        enabled     = false;
+        uint32_t    step        = 0;
+        uint32_t    frames      = 0;
+        float       elapsed     = 0.f;
+        uint64_t    triangles   = 0;
+        uint64_t    shadow_triangles = 0;
+        uint32_t    latency_frames = 0;
+        double      latency_time = 0.0;
+        double      latency_max = 0.0;
+    } _benchmark;
+
+    /* Hierarchical depth (Hi-Z) pyramid built from scene depth - conservative occluder depth for each screen region. */
+    struct {
+        VkImage                         image;              /* Owned by render graph */
+        VkImageView                     view;               /* All mip levels - sampled by culling shader */
+        std::vector<VkImageView>        mip_views {};       /* Single mip level - written by reduction shader */
+        VkExtent2D                      extent {};
+        uint32_t                        levels = 0;
+
+        VkSampler                       sampler;
+        VkDescriptorSetLayout           descriptor_set_layout;
+        VkPipelineLayout                pipeline_layout;
+        VkPipeline                      pipeline;
+        VkPipeline                      resolve_pipeline;   /* Level 0 from multisampled depth - farthest of all samples */
+        std::vector<VkDescriptorSet>    descriptor_sets {}; /* One for each mip level */
+    } _hiz;
+
+    /* Frame statistics - presented in window title once per second. */
+    struct Frame_Stats {
+        uint32_t    frames      = 0;
+        float       elapsed     = 0.f;
+        Cull_Counters counters  {};
+
+        /* GPU busy time of both queues and time both of them were busy - in milliseconds, summed over timed frames. */
+        uint32_t    timed_frames    = 0;
+        double      graphics_time   = 0.0;
+        double      compute_time    = 0.0;
+        double      overlapped_time = 0.0;
+
+        /* Input to present (or GPU completion) latency of measured frames - in milliseconds */
+        uint32_t    latency_frames  = 0;
+        double      latency_time    = 0.0;
+    } _stats;
+
     /* Uniform Buffers - they'll be update after every frame so every image in swapchain will have own uniform buffer. */
     std::vector<VkBuffer>       _scene_uniform_buffers;
     std::vector<VkDeviceMemory> _scene_uniform_buf_memory;
 
-    struct {
+    struct {
         VkBuffer                buffer = VK_NULL_HANDLE;
         VkDeviceMemory          memory = VK_NULL_HANDLE;
         VkDescriptorBufferInfo  descriptor;
@@ -279,25 +806,54 @@ private:
         VkMemoryPropertyFlags   memory_property_flags {};
     } _offscreen_buffer;
 
+    /* Model matrices are taken from object storage buffer, so uniform buffers hold only view dependent data. */
     struct UBOOffscreenVS {
-        glm::mat4 model;
         glm::mat4 view;
         glm::mat4 proj;
     } _offscreen_uniform_buf_obj;
 
-    struct {
-        glm::mat4 modelMat;
+    struct {
         glm::mat4 viewProjMat;
 
         /* Camera position */
         glm::vec4 cameraPos;
         
-        /* Model-View-Projection matrix from lights POV */
+        /* View-Projection matrix from lights POV */
         glm::mat4 DepthMVP;
 
         glm::vec4 lightPos;
+
+        /* xy - size of cluster tile in pixels, z - near plane, w - far plane */
+        glm::vec4 clusterParams;
+
+        /* Temporal anti-aliasing - jittered view-projection of previous frame, jitter of this (xy) and previous (zw) frame in NDC */
+        glm::mat4 prevViewProjMat;
+        glm::vec4 jitter;
+
+        /* x - rotation of temporal shadow samples */
+        glm::vec4 temporalParams;
     } _scene_uniform_buf_obj;
 
+    /* Layout has to match 'TaaData' uniform block inside taa.comp */
+    struct {
+        glm::vec2   texel_size;
+        float       history_weight;
+        float       pad;
+        glm::vec2   render_size;        /* Pixels rendered by this frame */
+        glm::vec2   history_scale;      /* Part of history image written by previous frame - in UV */
+    } _taa_uniform_buf_obj;
+
+    /* Layout has to match 'ExposureData' uniform block inside exposure.comp */
+    struct {
+        glm::ivec2  render_size;
+        float       min_log_lum;
+        float       log_lum_range;
+        float       adapt_rate;
+        float       key;
+        float       min_exposure;
+        float       max_exposure;
+    } _exposure_uniform_buf_obj;
+
 #ifdef NDEBUG
     const bool enableValidationLayers = true;
 #else
@@ -306,6 +862,7 @@ private:
 
     /* Initialize Vulkan API */
     void init_vulkan();
+    void compile_shaders();
     void create_instance();
     void create_surface();
     void pick_physical_device();
@@ -314,21 +871,38 @@ private:
     void create_swap_chain();
     void create_image_views();
     void create_scene_render_pass();
+    void create_present_render_pass();
     void create_offscreen_render_pass();
     void create_descriptor_set_layout();
     void create_graphics_pipeline();
+    void create_present_pipeline();
+    void create_pipeline_cache();
+    void create_taa_history();
+    void create_render_graph();
     void create_depth_resources();
     void create_depth_texture_sampler();
+    void create_bindless_textures();
     void create_scene_framebuffer();
     void create_offscreen_framebuffer();
     void create_command_pool();
     void create_vertex_buffer();
     void create_index_buffer();
+    void create_object_buffer();
+    void create_mesh_buffer();
+    void create_culling_pipeline();
+    void create_hiz_pipeline();
+    void create_meshlet_buffer();
+    void create_meshlet_pipeline();
+    void create_light_cluster_pipeline();
+    void create_taa_pipeline();
+    void create_exposure_pipeline();
+    void create_hiz_resources();
     void create_uniform_buffers();
-    void create_descriptor_pool();
     void create_descriptor_sets();
     void create_command_buffers();
+    void record_command_buffer(uint32_t imageIndex);
     void create_sync_objects();
+    void create_frame_capture();
 
     /* Initialize GLFW */
     void init_GLFW();
@@ -336,28 +910,49 @@ private:
 
     /* Load model using tiny_obj_loader library */
     void load_model();
+    void load_obj_model();
+
+    /* Place loaded meshes in the scene as objects */
+    void build_scene_objects();
+    void build_scene_lights();
 
     /* Auxiliary Functions */
     bool                    check_validatio_layer_support();
     bool                    is_device_suitable( VkPhysicalDevice device );
+    bool                    is_device_extension_available( VkPhysicalDevice device, const char* extensionName );
 
     QueueFamilyIndices      find_queue_families(VkPhysicalDevice device);
     uint32_t                find_memory_type(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     VkFormat                find_supported_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     VkFormat                find_depth_format();
+    VkSampleCountFlagBits   msaa_sample_count(uint32_t samples);
     SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice device);
     VkSurfaceFormatKHR      choose_swap_surface_format( const std::vector<VkSurfaceFormatKHR>& availableFormats );
     VkPresentModeKHR        choose_swap_present_mode( const std::vector<VkPresentModeKHR>& availablePresentModes );
     VkExtent2D              choose_swap_extent( const VkSurfaceCapabilitiesKHR& capabilities );
-
-    VkShaderModule          creates_shader_module( const std::vector<char>& code );
+    VkExtent2D              render_extent() const;
+    VkExtent2D              shadow_extent() const;
+
+    VkShaderModule          creates_shader_module( const std::vector<uint32_t>& code );
+    void                    build_graphics_pipelines(const Scene_Permutation& permutation, VkPipeline& scenePipeline, VkPipeline* offscreenPipeline = nullptr,
+                                VkPipeline* prepassPipeline = nullptr);
+    VkPipeline              scene_pipeline(const Scene_Permutation& permutation);
+    void                    select_scene_permutation(const Scene_Permutation& permutation);
+    VkPipeline              build_compute_pipeline(const ShaderVariant& variant, VkPipelineLayout layout);
+    VkPipeline              build_present_pipeline();
+    ShaderLayout            reflect_layout(const std::vector<ShaderVariant>& variants);
+    ShaderLayout            graphics_layout();
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes(const ShaderReflection& vertexShader);
+    void                    save_pipeline_cache();
     void                    create_buffer(VkDeviceSize deviceSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+    void                    create_device_local_buffer(const void* srcData, VkDeviceSize deviceSize, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
     void                    create_image(uint32_t width, uint32_t height, VkFormat imageFormat, VkImageTiling imgTiling, VkImageUsageFlags imgFlags, 
-                                VkMemoryPropertyFlags imgMemoryProperties, VkImage& image, VkDeviceMemory& imgMemory);
-    VkImageView             create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+                                VkMemoryPropertyFlags imgMemoryProperties, VkImage& image, VkDeviceMemory& imgMemory, uint32_t mipLevels = 1);
+    VkImageView             create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
 
     void                    copy_buffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
     void                    copy_buffer_to_image( VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+    FrameBufferAttachment   load_texture(const std::string& path);
 
     void                    add_quad_under_model(float minY, int count, float quad_coord);
 
@@ -365,9 +960,21 @@ private:
     void                    update_DT();
     void                    update_scene_uniform_buf(uint32_t currentImage);
     void                    update_offscreen_uniform_buf();
+    void                    update_cull_uniform_buf(uint32_t currentImage);
+    void                    update_taa_uniform_buf(uint32_t currentImage);
+    void                    update_exposure_uniform_buf(uint32_t currentImage);
+    void                    update_stats(uint32_t imageIndex);
+    void                    update_gpu_timing(uint32_t imageIndex);
+    void                    update_resolution_scale(double frameTime);
+    void                    update_latency();
+    void                    add_latency_sample(double latency);
+    void                    wait_frame_limit();
+    void                    update_instances(uint32_t imageIndex);
+    void                    update_benchmark();
     void                    update_keyboard_input();
     void                    update_mouse_input();
     void                    update_light();
+    void                    update_lights(uint32_t imageIndex);
 
     void                    transition_image_layout(VkImage image, VkFormat format,
                                 VkImageLayout oldLayout, VkImageLayout newLayout);
@@ -375,6 +982,32 @@ private:
     VkCommandBuffer         began_single_time_commands();
     void                    end_single_time_commands(VkCommandBuffer commandBuffer);
 
+    void                    record_cull_reset(VkCommandBuffer commandBuffer, size_t imageIndex);
+    void                    record_culling(VkCommandBuffer commandBuffer, size_t imageIndex, cull_phase phase);
+    void                    record_meshlet_culling(VkCommandBuffer commandBuffer, size_t imageIndex, cull_phase phase);
+    void                    record_hiz_build(VkCommandBuffer commandBuffer, uint32_t level);
+    void                    record_light_reset(VkCommandBuffer commandBuffer, size_t imageIndex);
+    void                    record_light_clustering(VkCommandBuffer commandBuffer, size_t imageIndex);
+    void                    record_shadow_pass(VkCommandBuffer commandBuffer, size_t imageIndex);
+    void                    record_depth_prepass(VkCommandBuffer commandBuffer, size_t imageIndex, cull_phase phase);
+    void                    record_scene_pass(VkCommandBuffer commandBuffer, size_t imageIndex, cull_phase phase);
+    void                    record_stats_copy(VkCommandBuffer commandBuffer, size_t imageIndex);
+    void                    record_taa(VkCommandBuffer commandBuffer, size_t imageIndex);
+    void                    record_taa_history_copy(VkCommandBuffer commandBuffer);
+    void                    record_exposure(VkCommandBuffer commandBuffer, size_t imageIndex);
+    void                    record_present_pass(VkCommandBuffer commandBuffer, size_t imageIndex);
+    VkCommandBuffer         record_frame_capture(uint32_t imageIndex);
+    void                    finish_frame_capture(uint32_t frame);
+    void                    record_indirect_draws(VkCommandBuffer commandBuffer, size_t imageIndex, cull_view view);
+
+    /* Shader hot reload */
+    void                    update_hot_reload(uint32_t imageIndex);
+    uint32_t                reload_mask(const std::string& fileName) const;
+    void                    start_pipeline_reload();
+    void                    apply_pipeline_reload();
+    void                    finish_pipeline_reload();
+    void                    destroy_retired_pipelines(uint64_t generation);
+
     void recreate_swap_chain();
     void cleanup_swap_chain();
 
@@ -385,25 +1018,3 @@ private:
     void cleanup();
 };
 
-static std::vector<char> read_file( const std::string& filename )
-{
-    /* 
-     * ate - Start reading from the end of file
-     * binary - read the file as binary file (avoid text transformations)
-     */
-    std::ifstream file(filename, std::ios::ate | std::ios::binary );
-
-    if( !file.is_open() )
-        throw new std::runtime_error("Failed to open file!");
-
-    size_t fileSize = (size_t) file.tellg();    /* Current position in the stream */
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);  /* Move back to the first position */
-    file.read( buffer.data(), fileSize);
-
-    file.close();
-
-    return buffer;
-}
-
@@ -14,7 +14,9 @@
 #include <optional>
 #include <cstdint>
 #include <fstream>
+#include <sstream>
 #include <chrono>
+#include <random>
 
 #include <vector>
 #include <set>
@@ -34,6 +36,137 @@
 #define DEPTH_FORMAT VK_FORMAT_D16_UNORM
 #define MAX_FRAMES_IN_FLIGHT    2
 #define MODEL_PATH              "Models/bunny.obj"
-#define VERT_SHADER             "shaders/vert.spv"
-#define FRAG_SHADER             "shaders/frag.spv"
-#define OFFSCREEN_VERT_SHADER   "shaders/offscreen_vert.spv"
\ No newline at end of file
+#define MODEL_CACHE_PATH        "Models/bunny.mesh"
+/* Watched for modified sources - affected pipelines are rebuilt while running. */
+#define SHADER_DIR              "shaders"
+#define VERT_SHADER             "shaders/shader.vert"
+#define FRAG_SHADER             "shaders/shader.frag"
+#define OFFSCREEN_VERT_SHADER   "shaders/offscreen.vert"
+#define PREPASS_VERT_SHADER     "shaders/prepass.vert"
+#define CULL_COMP_SHADER        "shaders/cull.comp"
+#define HIZ_COMP_SHADER         "shaders/hiz.comp"
+#define MESHLET_COMP_SHADER     "shaders/meshlet.comp"
+#define CLUSTER_COMP_SHADER     "shaders/cluster.comp"
+#define TAA_COMP_SHADER         "shaders/taa.comp"
+#define FULLSCREEN_VERT_SHADER  "shaders/fullscreen.vert"
+#define PRESENT_FRAG_SHADER     "shaders/present.frag"
+#define EXPOSURE_COMP_SHADER    "shaders/exposure.comp"
+/* Compiled SPIR-V - named by hash of source, defines and compile options. Safe to delete. */
+#define SHADER_CACHE_DIR        "shaders/cache"
+/* Driver pipeline cache - saved on exit, speeds up pipeline creation of next run and of shader reloads. */
+#define PIPELINE_CACHE_PATH     "shaders/cache/pipelines.bin"
+
+/* Scene is built from SCENE_OBJECT_GRID x SCENE_OBJECT_GRID copies of loaded model. */
+#define SCENE_OBJECT_GRID       1
+/* Distance between neighbouring objects of the grid - in multiples of model bounding sphere radius. */
+#define SCENE_OBJECT_SPACING    3.f
+/* Local workgroup size of culling compute shader - passed to cull.comp as define */
+#define CULL_GROUP_SIZE         64
+/* Local workgroup size (X and Y) of depth pyramid reduction shader - passed to hiz.comp as define */
+#define HIZ_GROUP_SIZE          8
+
+/* Meshlet limits - vertex limit keeps post-transform cache hits high, triangle limit fits meshlet into mesh shader friendly size. */
+#define MESHLET_MAX_VERTICES    64
+#define MESHLET_MAX_TRIANGLES   124
+/* Meshlets culled by one workgroup of meshlet.comp - passed to meshlet.comp as define */
+#define MESHLET_GROUP_SIZE      64
+/* Capacity of per-image index buffer region receiving compacted indices. Chunks not fitting are drawn uncompacted. */
+#define MESHLET_OUTPUT_INDICES  (4 * 1024 * 1024)
+/* Levels of detail generated for every loaded mesh - each one has about half of triangles of the previous one. */
+#define MESH_MAX_LODS           6
+/* Simplification stops at levels with fewer triangles. */
+#define MESH_LOD_MIN_TRIANGLES  64
+/* Largest screen-space error of selected level - in pixels. Doubled with every step of LOD bias. */
+#define LOD_ERROR_PIXELS        1.f
+/* Shadow pass tolerates larger error - shadow map texels cover more than a pixel and shadow edges are filtered. */
+#define SHADOW_LOD_ERROR_SCALE  4.f
+/* Frames measured for every LOD bias by --benchmark, preceded by warm up frames letting culling results settle. */
+#define BENCHMARK_FRAMES        300
+#define BENCHMARK_WARMUP_FRAMES 30
+/* Meshes used by at least this many objects are drawn by one instanced draw per view - per-object meshlet culling would cost more than it saves. */
+#define INSTANCING_MIN_INSTANCES    32
+/* Rotation speed of animated instances - radians per second. */
+#define INSTANCE_ROTATION_SPEED     1.f
+/* Initial scene permutation - passed to shader.frag as specialization constants. Filter radius r samples (2r+1)x(2r+1) texels. */
+#define SHADOW_FILTER_RADIUS        1
+#define SHADOW_FILTER_MAX_RADIUS    3
+#define AMBIENT_LIGHT               0.2f
+/* Material textures - material index of an object selects one of them. Used only by bindless rendering. */
+#define MATERIAL_TEXTURES           { "Textures/texture.jpg", "Textures/chalet.jpg" }
+/* Length of bindless texture array (clamped to device limits) - passed to shader.frag as define */
+#define MAX_BINDLESS_TEXTURES       1024
+/* Camera clip planes - light clusters are sliced between them. */
+#define CAMERA_NEAR                 0.1f
+#define CAMERA_FAR                  50.f
+/* Clustered lighting - camera frustum is split into X x Y screen tiles and Z exponential depth slices. Passed to cluster.comp and shader.frag as defines. */
+#define CLUSTER_GRID_X              16
+#define CLUSTER_GRID_Y              9
+#define CLUSTER_GRID_Z              24
+/* Lights tested at once by one workgroup of cluster.comp - every workgroup processes one cluster. */
+#define CLUSTER_GROUP_SIZE          64
+/* Lights of a single cluster - further ones are dropped. */
+#define CLUSTER_MAX_LIGHTS          128
+/* Capacity of compact light index list - average number of lights per cluster. */
+#define CLUSTER_AVERAGE_LIGHTS      32
+/* Point and spot lights placed over the scene - MAX_LIGHTS are generated, count in use is changed by keyboard. */
+#define MAX_LIGHTS                  1024
+#define INITIAL_LIGHTS              64
+/* Rotation speed of lights around the scene - radians per second. */
+#define LIGHT_ORBIT_SPEED           0.3f
+/* Multisampling of scene pass - initial sample count is clamped to counts supported by device, keyboard selects up to MSAA_MAX_SAMPLES. */
+#define MSAA_SAMPLES                1
+#define MSAA_MAX_SAMPLES            8
+/* Fraction of samples shaded separately when sample shading is enabled - 1 shades every sample. */
+#define MSAA_MIN_SAMPLE_SHADING     1.f
+/* Resolved scene color and screen-space velocity - read by temporal anti-aliasing and present pass. Color is HDR, present pass tonemaps it. */
+#define SCENE_COLOR_FORMAT          VK_FORMAT_R16G16B16A16_SFLOAT
+#define VELOCITY_FORMAT             VK_FORMAT_R16G16_SFLOAT
+/* Temporal anti-aliasing - history keeps HDR colors of scene, so small blend weights are not rounded away. */
+#define TAA_HISTORY_FORMAT          VK_FORMAT_R16G16B16A16_SFLOAT
+/* Local workgroup size (X and Y) of taa.comp - passed as define */
+#define TAA_GROUP_SIZE              8
+/* Subpixel jitter follows this many points of Halton (2, 3) sequence. */
+#define TAA_JITTER_PHASES           8
+/* Weight of history in the blend - about 1 / (1 - weight) frames contribute to a pixel. */
+#define TAA_HISTORY_WEIGHT          0.9f
+/* Shadow samples per fragment with TAA - rotated every frame, passed to shader.frag as define. */
+#define TEMPORAL_SHADOW_TAPS        4
+/* Dynamic resolution - scene and shadow map are rendered into a part of their images, scaled to keep GPU frame time within budget. */
+#define DRS_FRAME_BUDGET_MS         8.3f
+#define DRS_MIN_SCALE               0.5f
+/* Scale changes in steps of this size - every change records command buffers again. */
+#define DRS_SCALE_STEP              0.05f
+/* Frames measured at current scale before it is changed again - averaged, so noise of single frames does not move the scale. */
+#define DRS_SAMPLE_FRAMES           8
+/* Scale grows only if frame time is below this part of budget - keeps resolution from oscillating around it. */
+#define DRS_INCREASE_THRESHOLD      0.85f
+/* Contrast adaptive sharpening of the upscale in present pass - 0 is the softest, 1 the sharpest. */
+#define DRS_SHARPNESS               0.5f
+/* Present mode the swap chain is created with - keyboard cycles through modes supported by the surface. */
+#define PRESENT_MODE                VK_PRESENT_MODE_FIFO_KHR
+/* Frame rate of frame limiter (toggled by keyboard) - it sleeps while far from the deadline and spins the rest. */
+#define FRAME_LIMIT_FPS             60
+/* Presented frames remembered for latency measurement - present times are reported a few frames after presentation. */
+#define LATENCY_HISTORY             16
+/* Auto exposure - local workgroup size (X and Y) of exposure.comp, its square is the number of histogram bins. Passed as define. */
+#define EXPOSURE_GROUP_SIZE         16
+/* Every invocation of exposure.comp bins a block of this many pixels squared - passed as define. */
+#define EXPOSURE_PIXELS_PER_THREAD  4
+/* Luminance covered by the histogram - log2 of the darkest non-black bin and range up to the brightest one. */
+#define EXPOSURE_MIN_LOG_LUM        -8.f
+#define EXPOSURE_LOG_LUM_RANGE      12.f
+/* Average luminance of the frame is exposed to middle grey. */
+#define EXPOSURE_KEY                0.18f
+/* Speed of eye adaptation - about 1 / speed seconds to get most of the way to a new exposure. */
+#define EXPOSURE_ADAPT_SPEED        1.5f
+#define EXPOSURE_MIN                0.05f
+#define EXPOSURE_MAX                8.f
+/* Frame capture - screenshots and frame sequences are written into this directory by a worker thread. */
+#define CAPTURE_DIR                 "captures"
+/* Readback buffers frames are copied into - frame is dropped if all of them are waiting for their files to be written. */
+#define CAPTURE_RING_SIZE           6
+/* Frame sequence captures every CAPTURE_SEQUENCE_INTERVAL-th frame - benchmark takes the interval from command line. */
+#define CAPTURE_SEQUENCE_INTERVAL   1
+#define CAPTURE_SCREENSHOT_FORMAT   CAPTURE_FORMAT_PNG
+/* Raw files are written without compression - sequences keep up with the frame rate. */
+#define CAPTURE_SEQUENCE_FORMAT     CAPTURE_FORMAT_RAW
\ No newline at end of file
@@ -5,7 +5,18 @@ int main(int argc, char* argv[])
     try
     {
         std::unique_ptr<Simulation> app = std::make_unique<Simulation>(1024, 768, "Shadow Mapping - Vulkan");
-        app->run();
+
+        /* --benchmark [--capture N] - with capture every N-th frame of the benchmark is written into CAPTURE_DIR. */
+        if( argc > 1 && std::string(argv[1]) == "--benchmark" )
+        {
+            uint32_t captureInterval = 0;
+            if( argc > 2 && std::string(argv[2]) == "--capture" )
+                captureInterval = (argc > 3) ? static_cast<uint32_t>(std::max(std::stoi(argv[3]), 1)) : CAPTURE_SEQUENCE_INTERVAL;
+
+            app->run_benchmark(captureInterval);
+        }
+        else
+            app->run();
     } 
     catch ( const std::exception& ex)
     {
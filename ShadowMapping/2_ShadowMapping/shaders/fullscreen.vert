@@ -0,0 +1,10 @@
+#version 450
+
+/* Fullscreen triangle - three vertices generated from vertex index cover the whole screen, no vertex buffer is bound. */
+layout( location=0 ) out vec2 outUv;
+
+void main()
+{
+    outUv       = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(outUv * 2.0 - 1.0, 0.0, 1.0);
+}
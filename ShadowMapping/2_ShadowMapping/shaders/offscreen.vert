@@ -4,12 +4,29 @@ layout( location=0 ) in vec3 inPosition;
 
 layout (binding = 0) uniform UBO 
 {
-    mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint meshIndex;
+    uint materialIndex;
+    uint pad[2];
+};
+
+/* Per-object data - indexed by entry of visible instance list. */
+layout( std430, binding=2 ) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+/* Ids of visible objects written by culling shader - instance index of indirect draw points to the list. */
+layout( std430, binding=3 ) readonly buffer VisibleInstances {
+    uint visibleInstances[];
+};
  
 void main()
 {
-	gl_Position =  ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+	gl_Position =  ubo.proj * ubo.view * objects[visibleInstances[gl_InstanceIndex]].model * vec4(inPosition, 1.0);
 }
\ No newline at end of file
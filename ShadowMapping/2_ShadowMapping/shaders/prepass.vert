@@ -0,0 +1,53 @@
+#version 450
+
+/* Depth pre-pass of the scene - declares the scene uniform block and computes gl_Position with exactly the expression
+*  of shader.vert, so the depth it writes passes the equality test of the scene pass.
+*/
+layout( binding=0 ) uniform UniformBufferObject {
+    mat4 viewProjMat;
+
+    vec4 cameraPos;
+
+    /* View-Projection matrix from lights POV */
+    mat4 DepthMVP;
+
+    /* Light Position */
+    vec4 lightPos;
+
+    /* Read by fragment shader only */
+    vec4 clusterParams;
+
+    /* Jittered view-projection of previous frame - positions are reprojected by it for velocity */
+    mat4 prevViewProjMat;
+} ubo;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint meshIndex;
+    uint materialIndex;
+    uint pad[2];
+    mat4 prevModel;
+};
+
+/* Per-object data - indexed by entry of visible instance list. */
+layout( std430, binding=2 ) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+/* Ids of visible objects written by culling shader - instance index of indirect draw points to the list. */
+layout( std430, binding=3 ) readonly buffer VisibleInstances {
+    uint visibleInstances[];
+};
+
+layout( location=0 ) in vec3 inPosition;
+
+invariant gl_Position;
+
+void main()
+{
+    ObjectData object = objects[visibleInstances[gl_InstanceIndex]];
+    mat4 modelMat = object.model;
+
+    gl_Position = ubo.viewProjMat * modelMat * vec4(inPosition, 1.0);
+}
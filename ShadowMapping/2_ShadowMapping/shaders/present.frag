@@ -0,0 +1,78 @@
+#version 450
+
+/* Final pass - tonemaps and upscales the HDR frame (TAA history, or scene color without TAA) into swap chain image. Only the
+*  top-left part of the frame image is rendered with dynamic resolution - it is sampled bilinearly and sharpened by contrast
+*  adaptive sharpening, which restores detail softened by upscaling and by temporal accumulation.
+*/
+layout( binding=0 ) uniform sampler2D frame;
+
+/* Written by exposure.comp of this frame - EXPOSURE_BINS is passed as define. */
+layout( std430, binding=1 ) readonly buffer Exposure {
+    uint    histogram[EXPOSURE_BINS];
+    uint    groupCount;
+    float   exposure;
+    float   averageLuminance;
+    float   pad;
+};
+
+/* Set by Simulation::record_present_pass */
+layout( push_constant ) uniform Params {
+    vec2    uvScale;        /* Rendered part of the frame image */
+    vec2    texelSize;
+    float   sharpness;      /* 0 - softest, 1 - sharpest */
+} params;
+
+/* Set by Simulation::build_present_pipeline - swap chain of _SRGB format encodes written color itself. */
+layout( constant_id = 0 ) const bool SRGB_TARGET = false;
+
+layout( location=0 ) in vec2 inUv;
+
+layout( location=0 ) out vec4 outColor;
+
+/* ACES filmic curve fitted by Krzysztof Narkowicz - highlights roll off smoothly instead of being clipped. */
+vec3 tonemap(vec3 color)
+{
+    return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+/* Sharpening works on encoded color - UNORM swap chain gets it as it is, _SRGB one is given linear color back. */
+vec3 linearToSrgb(vec3 color)
+{
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, color));
+}
+
+vec3 srgbToLinear(vec3 color)
+{
+    return mix(color / 12.92, pow((color + 0.055) / 1.055, vec3(2.4)), step(0.04045, color));
+}
+
+/* Bilinear filter must not reach texels outside of the rendered part - they are left from frames of larger scale.
+*  Samples are exposed, tonemapped and encoded before sharpening - it works on contrast as it is displayed.
+*/
+vec3 fetch(vec2 uv)
+{
+    vec3 hdr = textureLod(frame, clamp(uv, 0.5 * params.texelSize, params.uvScale - 0.5 * params.texelSize), 0.0).rgb;
+    return linearToSrgb(tonemap(hdr * exposure));
+}
+
+void main()
+{
+    vec2 uv = inUv * params.uvScale;
+
+    vec3 center = fetch(uv);
+    vec3 north  = fetch(uv - vec2(0.0, params.texelSize.y));
+    vec3 south  = fetch(uv + vec2(0.0, params.texelSize.y));
+    vec3 west   = fetch(uv - vec2(params.texelSize.x, 0.0));
+    vec3 east   = fetch(uv + vec2(params.texelSize.x, 0.0));
+
+    /* Sharpening is weaker where contrast of neighbourhood is high already - edges do not ring, flat areas stay flat. */
+    vec3 minColor   = min(center, min(min(north, south), min(west, east)));
+    vec3 maxColor   = max(center, max(max(north, south), max(west, east)));
+    vec3 amount     = sqrt(clamp(min(minColor, 1.0 - maxColor) / max(maxColor, 0.0001), 0.0, 1.0));
+    vec3 weight     = -amount / mix(8.0, 5.0, params.sharpness);
+
+    vec3 color = (center + (north + south + west + east) * weight) / (1.0 + 4.0 * weight);
+
+    color = clamp(color, 0.0, 1.0);
+    outColor = vec4(SRGB_TARGET ? srgbToLinear(color) : color, 1.0);
+}
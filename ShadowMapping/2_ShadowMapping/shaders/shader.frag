@@ -2,9 +2,59 @@
 #version 450
 //#extension GL_ARB_separate_shader_objects : enable
 
+/* BINDLESS_TEXTURES and BINDLESS_TEXTURE_COUNT are passed as defines - array is declared only if device supports descriptor indexing. */
+#if BINDLESS_TEXTURES
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 /* Input Data - descriptors, global for all vertex */
+layout( binding=0 ) uniform UniformBufferObject {
+    mat4 viewProjMat;
+    vec4 cameraPos;
+    mat4 DepthMVP;
+    vec4 lightPos;
+
+    /* xy - size of cluster tile in pixels, z - near plane, w - far plane */
+    vec4 clusterParams;
+
+    mat4 prevViewProjMat;
+
+    /* Subpixel offset of projection in NDC - xy of this frame, zw of previous frame */
+    vec4 jitter;
+
+    /* x - rotation of temporal shadow samples in this frame (radians) */
+    vec4 temporalParams;
+} ubo;
+
 layout( binding=1 ) uniform sampler2D shadowMapTex;
 
+/* Layout has to match 'Light_Data' inside Simulation.h */
+struct LightData {
+    vec4 position;      /* w - range */
+    vec4 color;         /* w - cosine of inner cone angle */
+    vec4 direction;     /* w - cosine of outer cone angle, -1 for point lights */
+};
+
+/* Lights assigned to clusters by cluster.comp - CLUSTER_GRID_X/Y/Z are passed as defines. */
+layout( std430, binding=4 ) readonly buffer Lights {
+    LightData lights[];
+};
+
+layout( std430, binding=5 ) readonly buffer LightGrid {
+    uint indexCount;
+    uint pad;
+    uvec2 ranges[];     /* Offset into light index list and number of lights of every cluster */
+};
+
+layout( std430, binding=6 ) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+#if BINDLESS_TEXTURES
+/* Textures of all materials - entries not used by any material are left unwritten. */
+layout( set=1, binding=0 ) uniform sampler2D materialTextures[BINDLESS_TEXTURE_COUNT];
+#endif
+
 /* Input Variables */
 layout (location = 0) in vec4 vertexPosition;
 layout (location = 1) in vec4 vertexNormal;
@@ -12,11 +62,27 @@ layout (location = 2) in vec4 fragColor;
 layout (location = 3) in vec4 fragCameraPos;
 layout (location = 4) in vec4 PosLightSpace;
 layout (location = 5) in vec4 lightPos;
+layout (location = 6) in vec2 fragTexCoord;
+layout (location = 7) flat in uint fragMaterial;
+layout (location = 8) in vec4 currClipPos;
+layout (location = 9) in vec4 prevClipPos;
 
 /* Output Variables */
 layout( location=0 ) out vec4 outColor;
+layout( location=1 ) out vec2 outVelocity;
+
+/* Specialization constants - set per pipeline from Scene_Permutation, values below are only defaults.
+*  Compiler sees them as constants, so filter loops are unrolled and branches of unused lighting models removed.
+*/
+layout( constant_id = 0 ) const int     SHADOW_FILTER_RADIUS = 1;  /* PCF kernel of (2r+1)x(2r+1) texels */
+layout( constant_id = 1 ) const int     LIGHTING_MODEL = 0;
+layout( constant_id = 2 ) const float   AMBIENT = 0.2;
+layout( constant_id = 4 ) const bool    TEMPORAL_SHADOWS = false;  /* Few rotated samples, accumulated by temporal anti-aliasing */
 
-#define AMBIENT 0.2
+/* Values of LIGHTING_MODEL - has to match 'lighting_model' enum of host code */
+const int LIGHTING_PHONG        = 0;
+const int LIGHTING_BLINN_PHONG  = 1;
+const int LIGHTING_LAMBERT      = 2;
 
 /* Calculate diffuse component based on light position and vertex position */
 vec3 calculateDiffuse( vec3 vs_normal, vec3 lightPos0, vec3 vs_position )
@@ -30,10 +96,25 @@ vec3 calculateDiffuse( vec3 vs_normal, vec3 lightPos0, vec3 vs_position )
 /* Calculate specular component based on light, camera and vertex position. */
 vec3 calculateSpecular( vec3 cameraPosition, vec3 vs_position, vec3 vs_normal, vec3 lightPos0 )
 {
-    vec3 lightToPosDirVec = normalize(vs_position - lightPos0);
-    vec3 reflectDirVec  = normalize( reflect(lightToPosDirVec, normalize(vs_normal)));
+    /* Diffuse only */
+    if( LIGHTING_MODEL == LIGHTING_LAMBERT )
+        return vec3(0.0);
+
     vec3 posToViewDirVec = normalize(cameraPosition - vs_position);
-    float  SpecularConstant = pow( max( dot( posToViewDirVec, reflectDirVec), 0), 32);
+    float  SpecularConstant;
+
+    if( LIGHTING_MODEL == LIGHTING_BLINN_PHONG )
+    {
+        /* Half vector between light and view direction - exponent is higher to keep highlight of similar size. */
+        vec3 halfwayDirVec = normalize(normalize(lightPos0 - vs_position) + posToViewDirVec);
+        SpecularConstant = pow( max( dot( normalize(vs_normal), halfwayDirVec), 0), 128);
+    }
+    else
+    {
+        vec3 lightToPosDirVec = normalize(vs_position - lightPos0);
+        vec3 reflectDirVec  = normalize( reflect(lightToPosDirVec, normalize(vs_normal)));
+        SpecularConstant = pow( max( dot( posToViewDirVec, reflectDirVec), 0), 32);
+    }
 
     return vec3(1.0) * SpecularConstant;
 }
@@ -49,9 +130,9 @@ float shadowCalc(vec4 shadowCoord)
         {
             //shadow = 1.0;
             vec2 texelSize = 1.0 / textureSize(shadowMapTex, 0);
-            for(int x = -1; x <= 1; ++x)
+            for(int x = -SHADOW_FILTER_RADIUS; x <= SHADOW_FILTER_RADIUS; ++x)
             {
-                for(int y = -1; y <= 1; ++y)
+                for(int y = -SHADOW_FILTER_RADIUS; y <= SHADOW_FILTER_RADIUS; ++y)
                 {
                     float pcfDepth = texture(shadowMapTex, shadowCoord.xy + vec2(x, y) * texelSize).r; 
                     shadow += shadowCoord.z > pcfDepth ? 1.0 : 0.0;
@@ -59,11 +140,79 @@ float shadowCalc(vec4 shadowCoord)
             }
         }
     }
-    shadow /= 9.0;
+    shadow /= float((2 * SHADOW_FILTER_RADIUS + 1) * (2 * SHADOW_FILTER_RADIUS + 1));
 
     return shadow;
 }
 
+/* Temporal shadow filter - TEMPORAL_SHADOW_TAPS (passed as define) samples of a disk covering the PCF kernel. The disk is rotated
+*  by per-pixel noise and by another angle every frame, so a single frame is noisy and temporal anti-aliasing accumulates
+*  the samples of many frames into a filter as wide as the PCF one.
+*/
+float temporalShadowCalc(vec4 shadowCoord)
+{
+    if( shadowCoord.z <= -1.0 || shadowCoord.z >= 1.0 || shadowCoord.w <= 0.0 )
+        return 0.0;
+
+    vec2 texelSize  = 1.0 / textureSize(shadowMapTex, 0);
+    float radius    = SHADOW_FILTER_RADIUS + 0.5;
+
+    /* Interleaved gradient noise - neighbouring pixels get unrelated rotations */
+    float noise     = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    float rotation  = 6.2831853 * noise + ubo.temporalParams.x;
+
+    float shadow = 0.0;
+    for( int i = 0; i < TEMPORAL_SHADOW_TAPS; i++ )
+    {
+        /* Vogel disk - samples on golden angle spiral cover the disk uniformly */
+        float r     = sqrt((float(i) + 0.5) / TEMPORAL_SHADOW_TAPS);
+        float theta = float(i) * 2.3999632 + rotation;
+        vec2 offset = vec2(cos(theta), sin(theta)) * r * radius;
+
+        float pcfDepth = texture(shadowMapTex, shadowCoord.xy + offset * texelSize).r;
+        shadow += shadowCoord.z > pcfDepth ? 1.0 : 0.0;
+    }
+
+    return shadow / TEMPORAL_SHADOW_TAPS;
+}
+
+/* Sum of lights of the cluster fragment lies in - cost depends on lights around the fragment, not on all lights of the scene. */
+vec3 clusteredLighting( vec3 vs_normal, vec3 vs_position )
+{
+    float zNear = ubo.clusterParams.z;
+    float zFar  = ubo.clusterParams.w;
+
+    /* Linear view depth from window depth, slices are distributed exponentially like in cluster.comp */
+    float viewDepth = zNear * zFar / (zFar - gl_FragCoord.z * (zFar - zNear));
+    uint slice      = uint(clamp(log(viewDepth / zNear) / log(zFar / zNear) * CLUSTER_GRID_Z, 0.0, CLUSTER_GRID_Z - 1.0));
+    uvec2 tile      = min(uvec2(gl_FragCoord.xy / ubo.clusterParams.xy), uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+
+    uvec2 range = ranges[(slice * CLUSTER_GRID_Y + tile.y) * CLUSTER_GRID_X + tile.x];
+
+    vec3 lighting = vec3(0.0);
+    for( uint i = 0; i < range.y; i++ )
+    {
+        LightData light = lights[lightIndices[range.x + i]];
+
+        vec3 toLight    = light.position.xyz - vs_position;
+        float dist      = length(toLight);
+
+        /* Windowed inverse square falloff - reaches zero at light range, so the light can be skipped outside of it. */
+        float window        = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+        float attenuation   = window * window / (dist * dist + 1.0);
+
+        if( light.direction.w > -1.0 )
+            attenuation *= smoothstep(light.direction.w, light.color.w, dot(-toLight / dist, light.direction.xyz));
+
+        vec3 diffuse    = calculateDiffuse( vs_normal, light.position.xyz, vs_position );
+        vec3 specular   = calculateSpecular( fragCameraPos.xyz, vs_position, vs_normal, light.position.xyz );
+
+        lighting += (diffuse + specular) * light.color.rgb * attenuation;
+    }
+
+    return lighting;
+}
+
 void main()
 {
     /* Ambient light component */
@@ -75,9 +224,23 @@ void main()
     /* Diffuse light component */
     vec3 diffuse = calculateDiffuse( vertexNormal.xyz, lightPos.xyz, vertexPosition.xyz );
 
+    /* Lights of the cluster - they do not cast shadows */
+    vec3 clustered = clusteredLighting( normalize(vertexNormal.xyz), vertexPosition.xyz );
+
     /* Calculate shadow */
-    float shadow = shadowCalc(PosLightSpace/PosLightSpace.w);
+    float shadow = TEMPORAL_SHADOWS ? temporalShadowCalc(PosLightSpace/PosLightSpace.w) : shadowCalc(PosLightSpace/PosLightSpace.w);
+
+    /* Material differs between objects of the same draw - index is not uniform across invocations. */
+    vec3 albedo = fragColor.xyz;
+#if BINDLESS_TEXTURES
+    albedo *= texture(materialTextures[nonuniformEXT(fragMaterial)], fragTexCoord).rgb;
+#endif
 
     /* Out color combined with light components */
-    outColor = vec4((ambient + (1.0 - shadow) * (diffuse + specular) ) * fragColor.xyz, 1.0);
+    outColor = vec4((ambient + (1.0 - shadow) * (diffuse + specular) + clustered ) * albedo, 1.0);
+
+    /* Screen-space motion since previous frame in UV units - jitter of both frames is removed, so still camera gives zero velocity. */
+    vec2 currNdc    = currClipPos.xy / currClipPos.w - ubo.jitter.xy;
+    vec2 prevNdc    = prevClipPos.xy / prevClipPos.w - ubo.jitter.zw;
+    outVelocity     = 0.5 * (currNdc - prevNdc);
 }
\ No newline at end of file
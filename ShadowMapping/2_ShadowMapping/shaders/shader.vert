@@ -4,18 +4,42 @@
 
 /* Input Data - descriptors, global for all vertex */
 layout( binding=0 ) uniform UniformBufferObject {
-    mat4 modelMat;
     mat4 viewProjMat;
 
     vec4 cameraPos;
-
-    /* Model-View-Projection matrix from lights POV */
+
+    /* View-Projection matrix from lights POV */
     mat4 DepthMVP;
 
     /* Light Position */
     vec4 lightPos;
+
+    /* Read by fragment shader only */
+    vec4 clusterParams;
+
+    /* Jittered view-projection of previous frame - positions are reprojected by it for velocity */
+    mat4 prevViewProjMat;
 } ubo;
 
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint meshIndex;
+    uint materialIndex;
+    uint pad[2];
+    mat4 prevModel;
+};
+
+/* Per-object data - indexed by entry of visible instance list. */
+layout( std430, binding=2 ) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+/* Ids of visible objects written by culling shader - instance index of indirect draw points to the list. */
+layout( std430, binding=3 ) readonly buffer VisibleInstances {
+    uint visibleInstances[];
+};
+
 /* Input Data - vertex attributes specified per-vertex */
 layout( location=0 ) in vec3 inPosition;
 layout( location=1 ) in vec3 inColor;
@@ -29,6 +53,16 @@ layout (location = 2) out vec4 fragColor;
 layout (location = 3) out vec4 fragCameraPos;
 layout (location = 4) out vec4 PosLightSpace;
 layout (location = 5) out vec4 lightPos;
+layout (location = 6) out vec2 fragTexCoord;
+layout (location = 7) flat out uint fragMaterial;
+layout (location = 8) out vec4 currClipPos;
+layout (location = 9) out vec4 prevClipPos;
+
+/* Depth written by depth pre-pass (prepass.vert) is tested for equality - both have to compute position the same way. */
+invariant gl_Position;
+
+/* Specialization constant - set per pipeline from Scene_Permutation. Without vertex colors the attribute is not read at all. */
+layout( constant_id = 3 ) const bool VERTEX_COLORS = true;
 
 const mat4 biasMat = mat4( 
     0.5, 0.0, 0.0, 0.0,
@@ -39,18 +73,31 @@ const mat4 biasMat = mat4(
 
 void main() 
 {
-    gl_Position = ubo.viewProjMat * ubo.modelMat * vec4(inPosition, 1.0);
+    ObjectData object = objects[visibleInstances[gl_InstanceIndex]];
+    mat4 modelMat = object.model;
+
+    gl_Position = ubo.viewProjMat * modelMat * vec4(inPosition, 1.0);
 
     /* Vertex position and normal in world coordinates */
-    vertexPosition  = vec4(ubo.modelMat * vec4(inPosition, 1.0));
-    vertexNormal    = vec4(ubo.modelMat * vec4(inNormal, 1.0));
-    fragColor       = vec4(inColor, 1.0);
+    vertexPosition  = vec4(modelMat * vec4(inPosition, 1.0));
+    vertexNormal    = vec4(modelMat * vec4(inNormal, 0.0));
+    fragColor       = VERTEX_COLORS ? vec4(inColor, 1.0) : vec4(1.0);
 
     fragCameraPos   = ubo.cameraPos;
 
     /* Light space Matrix */
-    PosLightSpace = biasMat * ubo.DepthMVP * ubo.modelMat * vec4(inPosition, 1.0);
+    PosLightSpace = biasMat * ubo.DepthMVP * modelMat * vec4(inPosition, 1.0);
 
-    /* Light Position */
+    /* Light Position */
     lightPos = ubo.lightPos;
+
+    /* Material texture is selected per object - fragment shader indexes bindless texture array with it. */
+    fragTexCoord    = inTexCoord;
+    fragMaterial    = object.materialIndex;
+
+    /* Clip positions in this and previous frame - fragment shader writes their screen-space difference as velocity.
+    *  Previous position is taken from model matrix of the previous frame, so animated objects carry their own motion.
+    */
+    currClipPos     = gl_Position;
+    prevClipPos     = ubo.prevViewProjMat * object.prevModel * vec4(inPosition, 1.0);
 }
\ No newline at end of file
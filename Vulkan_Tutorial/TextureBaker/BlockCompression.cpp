@@ -0,0 +1,508 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+/* Endpoint refinement passes - every pass refits endpoints to indices chosen by the previous one. */
+#define BC_REFINE_ITERATIONS    3
+
+/* Interpolation weights of BC7 4-bit indices - in 1/64 units. */
+static const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/* Texels of one block. Loops below always run over all 4 channels and 16 texels - fixed trip counts let compiler vectorize them,
+*  unused channels are zeroed so they do not contribute to the error.
+*/
+struct Block
+{
+    float texels[16][4];
+};
+
+static Block loadBlock(const uint8_t* texels, int channels)
+{
+    Block block = {};
+    for( int i = 0; i < 16; i++ )
+        for( int c = 0; c < channels; c++ )
+            block.texels[i][c] = texels[i * 4 + c];
+
+    return block;
+}
+
+static float distanceSquared(const float a[4], const float b[4])
+{
+    float sum = 0.f;
+    for( int c = 0; c < 4; c++ )
+        sum += (a[c] - b[c]) * (a[c] - b[c]);
+
+    return sum;
+}
+
+/* Endpoints are the extreme projections of texels on principal axis of their covariance. */
+static void principalEndpoints(const Block& block, float lo[4], float hi[4])
+{
+    float mean[4] = {};
+    for( int i = 0; i < 16; i++ )
+        for( int c = 0; c < 4; c++ )
+            mean[c] += block.texels[i][c] / 16.f;
+
+    float covariance[4][4] = {};
+    for( int i = 0; i < 16; i++ )
+        for( int a = 0; a < 4; a++ )
+            for( int b = 0; b < 4; b++ )
+                covariance[a][b] += (block.texels[i][a] - mean[a]) * (block.texels[i][b] - mean[b]);
+
+    /* Power iteration starts from the row of the channel with the largest variance - never orthogonal to principal axis. */
+    int dominant = 0;
+    for( int c = 1; c < 4; c++ )
+        if( covariance[c][c] > covariance[dominant][dominant] )
+            dominant = c;
+
+    float axis[4];
+    std::memcpy(axis, covariance[dominant], sizeof(axis));
+
+    for( int iteration = 0; iteration < 8; iteration++ )
+    {
+        float next[4] = {};
+        for( int a = 0; a < 4; a++ )
+            for( int b = 0; b < 4; b++ )
+                next[a] += covariance[a][b] * axis[b];
+
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+        if( length < 1e-6f )
+            break;
+
+        for( int c = 0; c < 4; c++ )
+            axis[c] = next[c] / length;
+    }
+
+    float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+
+    /* Uniform block - both endpoints are the mean color. */
+    if( axisLength < 1e-6f )
+    {
+        std::memcpy(lo, mean, sizeof(mean));
+        std::memcpy(hi, mean, sizeof(mean));
+        return;
+    }
+
+    float minT = FLT_MAX;
+    float maxT = -FLT_MAX;
+    for( int i = 0; i < 16; i++ )
+    {
+        float t = 0.f;
+        for( int c = 0; c < 4; c++ )
+            t += (block.texels[i][c] - mean[c]) * axis[c] / axisLength;
+
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+
+    for( int c = 0; c < 4; c++ )
+    {
+        lo[c] = std::clamp(mean[c] + minT * axis[c] / axisLength, 0.f, 255.f);
+        hi[c] = std::clamp(mean[c] + maxT * axis[c] / axisLength, 0.f, 255.f);
+    }
+}
+
+/* Least squares endpoints for fixed interpolation weights of texels - weight 0 selects e0, 1 selects e1.
+*  Returns false if the system is singular (all texels use the same weight) and endpoints are left untouched.
+*/
+static bool refitEndpoints(const Block& block, const float weights[16], float e0[4], float e1[4])
+{
+    float a = 0.f, b = 0.f, c = 0.f;
+    float rhs0[4] = {};
+    float rhs1[4] = {};
+
+    for( int i = 0; i < 16; i++ )
+    {
+        float t = weights[i];
+        a += (1.f - t) * (1.f - t);
+        b += (1.f - t) * t;
+        c += t * t;
+
+        for( int ch = 0; ch < 4; ch++ )
+        {
+            rhs0[ch] += (1.f - t) * block.texels[i][ch];
+            rhs1[ch] += t * block.texels[i][ch];
+        }
+    }
+
+    float determinant = a * c - b * b;
+    if( std::fabs(determinant) < 1e-6f )
+        return false;
+
+    for( int ch = 0; ch < 4; ch++ )
+    {
+        e0[ch] = std::clamp((c * rhs0[ch] - b * rhs1[ch]) / determinant, 0.f, 255.f);
+        e1[ch] = std::clamp((a * rhs1[ch] - b * rhs0[ch]) / determinant, 0.f, 255.f);
+    }
+
+    return true;
+}
+
+// ------------------------------------ BC1
+
+static uint16_t packColor565(const float color[4])
+{
+    uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.f / 255.f));
+    uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.f / 255.f));
+    uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.f / 255.f));
+
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor565(uint16_t packed, float color[4])
+{
+    uint32_t r = (packed >> 11) & 31;
+    uint32_t g = (packed >> 5) & 63;
+    uint32_t b = packed & 31;
+
+    /* Bit replication - same expansion as hardware decoders. */
+    color[0] = static_cast<float>((r << 3) | (r >> 2));
+    color[1] = static_cast<float>((g << 2) | (g >> 4));
+    color[2] = static_cast<float>((b << 3) | (b >> 2));
+    color[3] = 0.f;
+}
+
+/* Picks nearest of four palette colors for every texel. Returns squared error, weights receive position of chosen color between endpoints. */
+static float fitBC1Indices(const Block& block, uint16_t c0, uint16_t c1, uint32_t& indices, float weights[16])
+{
+    /* Index order of 4-color mode: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1 */
+    static const float paletteWeights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+    float e0[4], e1[4];
+    unpackColor565(c0, e0);
+    unpackColor565(c1, e1);
+
+    float palette[4][4];
+    for( int p = 0; p < 4; p++ )
+        for( int c = 0; c < 4; c++ )
+            palette[p][c] = e0[c] + (e1[c] - e0[c]) * paletteWeights[p];
+
+    float error = 0.f;
+    indices = 0;
+
+    for( int i = 0; i < 16; i++ )
+    {
+        int     best            = 0;
+        float   bestDistance    = distanceSquared(block.texels[i], palette[0]);
+
+        for( int p = 1; p < 4; p++ )
+        {
+            float distance = distanceSquared(block.texels[i], palette[p]);
+            if( distance < bestDistance )
+            {
+                best            = p;
+                bestDistance    = distance;
+            }
+        }
+
+        indices     |= static_cast<uint32_t>(best) << (2 * i);
+        weights[i]  = paletteWeights[best];
+        error       += bestDistance;
+    }
+
+    return error;
+}
+
+void encodeBC1(const uint8_t* texels, uint8_t* block)
+{
+    Block source = loadBlock(texels, 3);
+
+    float hi[4], lo[4];
+    principalEndpoints(source, lo, hi);
+
+    uint16_t    bestC0      = 0;
+    uint16_t    bestC1      = 0;
+    uint32_t    bestIndices = 0;
+    float       bestError   = FLT_MAX;
+
+    for( int iteration = 0; iteration < BC_REFINE_ITERATIONS; iteration++ )
+    {
+        uint16_t c0 = packColor565(hi);
+        uint16_t c1 = packColor565(lo);
+
+        /* c0 > c1 selects 4-color mode. Equal endpoints fall into 3-color mode, where index 0 still means c0. */
+        if( c0 < c1 )
+        {
+            std::swap(c0, c1);
+            std::swap(hi, lo);
+        }
+
+        uint32_t    indices;
+        float       weights[16];
+        float       error = fitBC1Indices(source, c0, c1, indices, weights);
+
+        if( error >= bestError )
+            break;
+
+        bestC0      = c0;
+        bestC1      = c1;
+        bestIndices = indices;
+        bestError   = error;
+
+        if( c0 == c1 || !refitEndpoints(source, weights, hi, lo) )
+            break;
+    }
+
+    block[0] = static_cast<uint8_t>(bestC0 & 0xFF);
+    block[1] = static_cast<uint8_t>(bestC0 >> 8);
+    block[2] = static_cast<uint8_t>(bestC1 & 0xFF);
+    block[3] = static_cast<uint8_t>(bestC1 >> 8);
+    for( int b = 0; b < 4; b++ )
+        block[4 + b] = static_cast<uint8_t>(bestIndices >> (8 * b));
+}
+
+// ------------------------------------ BC4 / BC5
+
+/* Single channel block - 8-value mode with endpoints at channel extremes. */
+static void encodeBC4Channel(const uint8_t* texels, int channel, uint8_t* block)
+{
+    uint8_t maxValue = 0;
+    uint8_t minValue = 255;
+    for( int i = 0; i < 16; i++ )
+    {
+        maxValue = std::max(maxValue, texels[i * 4 + channel]);
+        minValue = std::min(minValue, texels[i * 4 + channel]);
+    }
+
+    /* a0 > a1 selects 8-value mode: a0, a1 and six values in between. Equal endpoints decode every index 0 to a0. */
+    block[0] = maxValue;
+    block[1] = minValue;
+
+    uint64_t indices = 0;
+
+    if( maxValue > minValue )
+    {
+        int values[8];
+        values[0] = maxValue;
+        values[1] = minValue;
+        for( int v = 2; v < 8; v++ )
+            values[v] = ((8 - v) * maxValue + (v - 1) * minValue) / 7;
+
+        for( int i = 0; i < 16; i++ )
+        {
+            int texel           = texels[i * 4 + channel];
+            int best            = 0;
+            int bestDistance    = std::abs(texel - values[0]);
+
+            for( int v = 1; v < 8; v++ )
+            {
+                int distance = std::abs(texel - values[v]);
+                if( distance < bestDistance )
+                {
+                    best            = v;
+                    bestDistance    = distance;
+                }
+            }
+
+            indices |= static_cast<uint64_t>(best) << (3 * i);
+        }
+    }
+
+    for( int b = 0; b < 6; b++ )
+        block[2 + b] = static_cast<uint8_t>(indices >> (8 * b));
+}
+
+void encodeBC5(const uint8_t* texels, uint8_t* block)
+{
+    encodeBC4Channel(texels, 0, block);
+    encodeBC4Channel(texels, 1, block + 8);
+}
+
+// ------------------------------------ BC7
+
+/* Endpoint of mode 6 - 7 bits per channel and p-bit shared by all channels, appended as the lowest bit. */
+struct BC7Endpoint
+{
+    uint8_t channels[4];
+    uint8_t pBit;
+};
+
+/* Chooses p-bit with smaller quantization error. */
+static BC7Endpoint quantizeBC7Endpoint(const float color[4])
+{
+    BC7Endpoint best        = {};
+    float       bestError   = FLT_MAX;
+
+    for( uint8_t pBit = 0; pBit < 2; pBit++ )
+    {
+        BC7Endpoint endpoint = {};
+        endpoint.pBit = pBit;
+
+        float error = 0.f;
+        for( int c = 0; c < 4; c++ )
+        {
+            int quantized = std::clamp(static_cast<int>(std::lround((color[c] - pBit) / 2.f)), 0, 127);
+            endpoint.channels[c] = static_cast<uint8_t>(quantized);
+
+            float decoded = static_cast<float>(quantized * 2 + pBit);
+            error += (decoded - color[c]) * (decoded - color[c]);
+        }
+
+        if( error < bestError )
+        {
+            best        = endpoint;
+            bestError   = error;
+        }
+    }
+
+    return best;
+}
+
+static float fitBC7Indices(const Block& block, const BC7Endpoint& q0, const BC7Endpoint& q1, uint8_t indices[16], float weights[16])
+{
+    float palette[16][4];
+    for( int p = 0; p < 16; p++ )
+    {
+        for( int c = 0; c < 4; c++ )
+        {
+            int e0 = q0.channels[c] * 2 + q0.pBit;
+            int e1 = q1.channels[c] * 2 + q1.pBit;
+            palette[p][c] = static_cast<float>(((64 - BC7_WEIGHTS4[p]) * e0 + BC7_WEIGHTS4[p] * e1 + 32) >> 6);
+        }
+    }
+
+    float error = 0.f;
+
+    for( int i = 0; i < 16; i++ )
+    {
+        int     best            = 0;
+        float   bestDistance    = distanceSquared(block.texels[i], palette[0]);
+
+        for( int p = 1; p < 16; p++ )
+        {
+            float distance = distanceSquared(block.texels[i], palette[p]);
+            if( distance < bestDistance )
+            {
+                best            = p;
+                bestDistance    = distance;
+            }
+        }
+
+        indices[i]  = static_cast<uint8_t>(best);
+        weights[i]  = BC7_WEIGHTS4[best] / 64.f;
+        error       += bestDistance;
+    }
+
+    return error;
+}
+
+/* Writes bit fields from the least significant bit of the block upwards. */
+struct BitWriter
+{
+    uint8_t*    block;
+    uint32_t    position;
+
+    void write(uint32_t value, uint32_t bitCount)
+    {
+        for( uint32_t bit = 0; bit < bitCount; bit++, position++ )
+            block[position >> 3] |= static_cast<uint8_t>(((value >> bit) & 1) << (position & 7));
+    }
+};
+
+void encodeBC7(const uint8_t* texels, uint8_t* block)
+{
+    Block source = loadBlock(texels, 4);
+
+    float lo[4], hi[4];
+    principalEndpoints(source, lo, hi);
+
+    BC7Endpoint bestQ0          = {};
+    BC7Endpoint bestQ1          = {};
+    uint8_t     bestIndices[16] = {};
+    float       bestError       = FLT_MAX;
+
+    for( int iteration = 0; iteration < BC_REFINE_ITERATIONS; iteration++ )
+    {
+        BC7Endpoint q0 = quantizeBC7Endpoint(lo);
+        BC7Endpoint q1 = quantizeBC7Endpoint(hi);
+
+        uint8_t indices[16];
+        float   weights[16];
+        float   error = fitBC7Indices(source, q0, q1, indices, weights);
+
+        if( error >= bestError )
+            break;
+
+        bestQ0      = q0;
+        bestQ1      = q1;
+        bestError   = error;
+        std::memcpy(bestIndices, indices, sizeof(indices));
+
+        if( !refitEndpoints(source, weights, lo, hi) )
+            break;
+    }
+
+    /* Most significant bit of the first index is implicit zero - swap endpoints if it is set. Weight table is symmetric, so index i becomes 15 - i. */
+    if( bestIndices[0] >= 8 )
+    {
+        std::swap(bestQ0, bestQ1);
+        for( int i = 0; i < 16; i++ )
+            bestIndices[i] = static_cast<uint8_t>(15 - bestIndices[i]);
+    }
+
+    std::memset(block, 0, 16);
+    BitWriter writer = { block, 0 };
+
+    /* Mode 6 - six zero bits followed by one */
+    writer.write(1 << 6, 7);
+
+    for( int c = 0; c < 4; c++ )
+    {
+        writer.write(bestQ0.channels[c], 7);
+        writer.write(bestQ1.channels[c], 7);
+    }
+
+    writer.write(bestQ0.pBit, 1);
+    writer.write(bestQ1.pBit, 1);
+
+    writer.write(bestIndices[0], 3);
+    for( int i = 1; i < 16; i++ )
+        writer.write(bestIndices[i], 4);
+}
+
+// ------------------------------------
+
+void encodeBlockRows(DdsFormat format, const uint8_t* pixels, uint32_t width, uint32_t height,
+    uint32_t firstBlockRow, uint32_t blockRowCount, uint8_t* dst)
+{
+    uint32_t blocksX    = (width + 3) / 4;
+    uint32_t blockSize  = ddsBlockSize(format);
+
+    for( uint32_t blockY = firstBlockRow; blockY < firstBlockRow + blockRowCount; blockY++ )
+    {
+        for( uint32_t blockX = 0; blockX < blocksX; blockX++ )
+        {
+            /* Gather texels, clamping coordinates of partial blocks to the image. */
+            uint8_t texels[16 * 4];
+            for( uint32_t y = 0; y < 4; y++ )
+            {
+                for( uint32_t x = 0; x < 4; x++ )
+                {
+                    uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+                    uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+                    std::memcpy(&texels[(y * 4 + x) * 4], &pixels[(sourceY * width + sourceX) * 4], 4);
+                }
+            }
+
+            uint8_t* block = dst + (static_cast<size_t>(blockY) * blocksX + blockX) * blockSize;
+
+            switch( format )
+            {
+            case DDS_FORMAT_BC1_UNORM:
+            case DDS_FORMAT_BC1_UNORM_SRGB:
+                encodeBC1(texels, block);
+                break;
+            case DDS_FORMAT_BC5_UNORM:
+                encodeBC5(texels, block);
+                break;
+            default:
+                encodeBC7(texels, block);
+                break;
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+#include "DdsFile.h"
+
+/* Encoders of a single 4x4 block. Input is 16 RGBA8 texels in row order.
+*  Every encoder fits endpoints to principal axis of the block and refines them by least squares.
+*   BC1 - RGB, 8 bytes per block (4-color mode only, alpha is dropped).
+*   BC5 - RG as two independent BC4 channels, 16 bytes per block. Intended for normal maps.
+*   BC7 - RGBA, 16 bytes per block. Mode 6 only - single subset with 4-bit indices.
+*/
+void    encodeBC1(const uint8_t* texels, uint8_t* block);
+void    encodeBC5(const uint8_t* texels, uint8_t* block);
+void    encodeBC7(const uint8_t* texels, uint8_t* block);
+
+/* Encodes rows of blocks [firstBlockRow; firstBlockRow + blockRowCount) of RGBA8 image into dst - whole level output.
+*  Size of the image does not have to be a multiple of 4, edge texels are replicated into partial blocks.
+*/
+void    encodeBlockRows(DdsFormat format, const uint8_t* pixels, uint32_t width, uint32_t height,
+            uint32_t firstBlockRow, uint32_t blockRowCount, uint8_t* dst);
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+
+#include "BlockCompression.h"
+#include "DdsFile.h"
+
+/* Block rows encoded by one job - small enough to balance threads on the last levels. */
+#define BLOCK_ROWS_PER_JOB  8
+
+struct BakeOptions
+{
+    std::string inputPath;
+    std::string outputPath;
+    DdsFormat   format      = DDS_FORMAT_BC7_UNORM_SRGB;
+    bool        linear      = false;
+    uint32_t    threadCount = 0;
+};
+
+struct MipLevel
+{
+    uint32_t                width;
+    uint32_t                height;
+    std::vector<uint8_t>    pixels;     /* RGBA8 */
+    size_t                  outputOffset;
+};
+
+static void printUsage()
+{
+    std::cout << "Usage: TextureBaker <input image> <output.dds> [--format bc7|bc1|bc5] [--linear] [--threads N]\n"
+              << "  --format    BC7 (default) for color textures, BC1 for opaque color textures, BC5 for normal maps\n"
+              << "  --linear    Source holds linear data - no sRGB format and no sRGB aware filtering (implied by BC5)\n"
+              << "  --threads   Number of encoding threads - all hardware threads by default\n";
+}
+
+static BakeOptions parseArguments(int argc, char* argv[])
+{
+    if( argc < 3 )
+        throw std::runtime_error("Missing input or output path :( \n");
+
+    BakeOptions options;
+    options.inputPath   = argv[1];
+    options.outputPath  = argv[2];
+
+    std::string formatName = "bc7";
+
+    for( int i = 3; i < argc; i++ )
+    {
+        std::string argument = argv[i];
+
+        if( argument == "--format" && i + 1 < argc )
+            formatName = argv[++i];
+        else if( argument == "--linear" )
+            options.linear = true;
+        else if( argument == "--threads" && i + 1 < argc )
+            options.threadCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else
+            throw std::runtime_error("Unknown argument: " + argument + " :( \n");
+    }
+
+    if( formatName == "bc7" )
+        options.format = options.linear ? DDS_FORMAT_BC7_UNORM : DDS_FORMAT_BC7_UNORM_SRGB;
+    else if( formatName == "bc1" )
+        options.format = options.linear ? DDS_FORMAT_BC1_UNORM : DDS_FORMAT_BC1_UNORM_SRGB;
+    else if( formatName == "bc5" )
+    {
+        options.format = DDS_FORMAT_BC5_UNORM;
+        options.linear = true;
+    }
+    else
+        throw std::runtime_error("Unknown format: " + formatName + " :( \n");
+
+    if( options.threadCount == 0 )
+        options.threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    return options;
+}
+
+/* Full chain down to 1x1 level - every level is filtered from the previous one. */
+static std::vector<MipLevel> buildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, bool linear)
+{
+    uint32_t levelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+
+    std::vector<MipLevel> levels(levelCount);
+    levels[0].width     = width;
+    levels[0].height    = height;
+    levels[0].pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+    for( uint32_t level = 1; level < levelCount; level++ )
+    {
+        const MipLevel& previous = levels[level - 1];
+        MipLevel&       current  = levels[level];
+
+        current.width   = std::max(previous.width / 2, 1u);
+        current.height  = std::max(previous.height / 2, 1u);
+        current.pixels.resize(static_cast<size_t>(current.width) * current.height * 4);
+
+        /* Color data is averaged in linear space, alpha is channel 3. */
+        int result = linear ?
+            stbir_resize_uint8(previous.pixels.data(), previous.width, previous.height, 0,
+                current.pixels.data(), current.width, current.height, 0, 4) :
+            stbir_resize_uint8_srgb(previous.pixels.data(), previous.width, previous.height, 0,
+                current.pixels.data(), current.width, current.height, 0, 4, 3, 0);
+
+        if( !result )
+            throw std::runtime_error("Failed to generate mip level :( \n");
+    }
+
+    return levels;
+}
+
+/* Jobs cover block rows of all levels - small levels are encoded in parallel with rows of the large ones. */
+static void encodeLevels(const BakeOptions& options, const std::vector<MipLevel>& levels, std::vector<uint8_t>& output)
+{
+    struct Job
+    {
+        uint32_t level;
+        uint32_t firstBlockRow;
+        uint32_t blockRowCount;
+    };
+
+    std::vector<Job> jobs;
+    for( uint32_t level = 0; level < levels.size(); level++ )
+    {
+        uint32_t blockRows = (levels[level].height + 3) / 4;
+        for( uint32_t row = 0; row < blockRows; row += BLOCK_ROWS_PER_JOB )
+            jobs.push_back({ level, row, std::min<uint32_t>(BLOCK_ROWS_PER_JOB, blockRows - row) });
+    }
+
+    std::atomic<size_t> nextJob(0);
+
+    auto worker = [&]()
+    {
+        for( size_t jobIndex = nextJob++; jobIndex < jobs.size(); jobIndex = nextJob++ )
+        {
+            const Job&      job     = jobs[jobIndex];
+            const MipLevel& level   = levels[job.level];
+
+            encodeBlockRows(options.format, level.pixels.data(), level.width, level.height,
+                job.firstBlockRow, job.blockRowCount, output.data() + level.outputOffset);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for( uint32_t i = 1; i < options.threadCount; i++ )
+        threads.emplace_back(worker);
+
+    worker();
+
+    for( auto& thread : threads )
+        thread.join();
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        BakeOptions options = parseArguments(argc, argv);
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        int width       = 0;
+        int height      = 0;
+        int channels    = 0;
+        stbi_uc* pixels = stbi_load(options.inputPath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+        if( !pixels )
+            throw std::runtime_error("Failed to load image: " + options.inputPath + " :( \n");
+
+        std::vector<MipLevel> levels = buildMipChain(pixels, width, height, options.linear);
+        stbi_image_free(pixels);
+
+        DdsImage image;
+        image.format    = options.format;
+        image.width     = static_cast<uint32_t>(width);
+        image.height    = static_cast<uint32_t>(height);
+        image.mipLevels = static_cast<uint32_t>(levels.size());
+
+        size_t uncompressedSize = 0;
+        size_t compressedSize   = 0;
+        for( auto& level : levels )
+        {
+            level.outputOffset  = compressedSize;
+            compressedSize      += ddsLevelSize(options.format, level.width, level.height);
+            uncompressedSize    += level.pixels.size();
+        }
+
+        image.data.resize(compressedSize);
+        encodeLevels(options, levels, image.data);
+
+        writeDds(options.outputPath, image);
+
+        float seconds = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+        std::cout << options.outputPath << ": " << width << "x" << height
+                  << ", " << image.mipLevels << " levels, "
+                  << uncompressedSize / 1024 << " KiB RGBA8 -> " << compressedSize / 1024 << " KiB"
+                  << " (" << static_cast<float>(uncompressedSize) / compressedSize << "x)"
+                  << " in " << seconds << " s on " << options.threadCount << " threads\n";
+    }
+    catch( const std::exception& ex )
+    {
+        std::cerr << ex.what() << std::endl;
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
\ No newline at end of file
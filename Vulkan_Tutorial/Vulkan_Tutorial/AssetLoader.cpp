@@ -0,0 +1,344 @@
+#include "AssetLoader.h"
+#include "DdsFile.h"
+
+/* Image Loader */
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+/* CPU mipmap generation - used when format does not support linear blit */
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+
+/* Size of RGBA levels packed one after another - layout expected by copyBufferToImage. */
+static VkDeviceSize mipChainSize(int width, int height, uint32_t mipLevels)
+{
+    VkDeviceSize size = 0;
+
+    for( uint32_t level = 0; level < mipLevels; level++ )
+    {
+        size   += static_cast<VkDeviceSize>(width) * height * 4;
+        width   = std::max(width / 2, 1);
+        height  = std::max(height / 2, 1);
+    }
+
+    return size;
+}
+
+/* Writes the chain straight into mapped staging memory - every level is resized from the previous one at its offset. */
+static void buildMipChain(const uint8_t* pixels, int width, int height, uint32_t mipLevels, uint8_t* chain)
+{
+    memcpy(chain, pixels, static_cast<size_t>(width) * height * 4);
+    uint8_t* level = chain;
+
+    for( uint32_t i = 1; i < mipLevels; i++ )
+    {
+        int nextWidth   = std::max(width / 2, 1);
+        int nextHeight  = std::max(height / 2, 1);
+
+        uint8_t* nextLevel = level + static_cast<size_t>(width) * height * 4;
+
+        /* Texture is sRGB - filtering has to happen in linear space. Alpha is channel 3. */
+        if( !stbir_resize_uint8_srgb(level, width, height, 0,
+                nextLevel, nextWidth, nextHeight, 0,
+                4, 3, 0) )
+            throw std::runtime_error("Failed to generate texture mip level :( \n");
+
+        level   = nextLevel;
+        width   = nextWidth;
+        height  = nextHeight;
+    }
+}
+
+AssetLoader::AssetLoader(VkPhysicalDevice physicalDevice, VkDevice device, bool textureCompressionBC)
+    : physicalDevice(physicalDevice), device(device), textureCompressionBC(textureCompressionBC)
+{
+    /* Main thread keeps initializing Vulkan objects meanwhile - one hardware thread is left for it. */
+    uint32_t workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    for( uint32_t i = 0; i < workerCount; i++ )
+        this->workers.emplace_back(&AssetLoader::workerLoop, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->jobAvailable.notify_all();
+
+    for( auto& worker : this->workers )
+        worker.join();
+
+    for( uint32_t textureId = 0; textureId < this->textures.size(); textureId++ )
+        this->releaseStaging(textureId);
+}
+
+uint32_t AssetLoader::requestTexture(const std::string& path, const std::string& compressedPath, bool streamed)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->textures.push_back(std::make_unique<TextureAsset>());
+
+    TextureAsset* texture = this->textures.back().get();
+    texture->path = path;
+
+    this->jobs.push_back([this, texture, compressedPath, streamed]()
+    {
+        std::exception_ptr error;
+        try
+        {
+            this->decodeTexture(*texture, compressedPath, streamed);
+        }
+        catch( ... )
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            texture->error = error;
+            texture->ready = true;
+        }
+        this->textureDecoded.notify_all();
+    });
+
+    lock.unlock();
+    this->jobAvailable.notify_one();
+
+    return static_cast<uint32_t>(this->textures.size() - 1);
+}
+
+TextureAsset& AssetLoader::wait(uint32_t textureId)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    TextureAsset& texture = *this->textures[textureId];
+    this->textureDecoded.wait(lock, [&texture]() { return texture.ready; });
+
+    if( texture.error )
+        std::rethrow_exception(texture.error);
+
+    return texture;
+}
+
+void AssetLoader::releaseStaging(uint32_t textureId)
+{
+    TextureAsset& texture = *this->textures[textureId];
+
+    if( texture.stagingMemory != VK_NULL_HANDLE )
+    {
+        vkUnmapMemory(this->device, texture.stagingMemory);
+        vkFreeMemory(this->device, texture.stagingMemory, nullptr);
+        texture.stagingMemory = VK_NULL_HANDLE;
+    }
+
+    if( texture.stagingBuffer != VK_NULL_HANDLE )
+    {
+        vkDestroyBuffer(this->device, texture.stagingBuffer, nullptr);
+        texture.stagingBuffer = VK_NULL_HANDLE;
+    }
+}
+
+void AssetLoader::workerLoop()
+{
+    for( ;; )
+    {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->jobAvailable.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+
+            /* Queued jobs are finished before stopping. */
+            if( this->jobs.empty() )
+                return;
+
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+void AssetLoader::decodeTexture(TextureAsset& texture, const std::string& compressedPath, bool streamed)
+{
+    /* Baked texture already holds the whole mip chain. */
+    if( this->decodeCompressedTexture(texture, compressedPath, streamed) )
+        return;
+
+    this->decodeImage(texture, streamed);
+}
+
+bool AssetLoader::decodeCompressedTexture(TextureAsset& texture, const std::string& compressedPath, bool streamed)
+{
+    std::ifstream file(compressedPath, std::ios::binary);
+    if( !file.is_open() )
+        return false;
+
+    DdsImage image;
+    size_t dataSize = readDdsHeader(file, compressedPath, image);
+
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    switch( image.format )
+    {
+    case DDS_FORMAT_BC1_UNORM:      format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;    break;
+    case DDS_FORMAT_BC1_UNORM_SRGB: format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;     break;
+    case DDS_FORMAT_BC5_UNORM:      format = VK_FORMAT_BC5_UNORM_BLOCK;         break;
+    case DDS_FORMAT_BC7_UNORM:      format = VK_FORMAT_BC7_UNORM_BLOCK;         break;
+    case DDS_FORMAT_BC7_UNORM_SRGB: format = VK_FORMAT_BC7_SRGB_BLOCK;          break;
+    default:                                                                    break;
+    }
+
+    /* Devices without BC support (mostly mobile ones) get uncompressed source texture. */
+    if( !this->textureCompressionBC || !this->isSampledFormatSupported(format, image.mipLevels) )
+    {
+        std::cout << "BC textures are not supported - loading " << texture.path << " instead." << std::endl;
+        return false;
+    }
+
+    texture.format          = format;
+    texture.width           = image.width;
+    texture.height          = image.height;
+    texture.mipLevels       = image.mipLevels;
+    texture.uploadedLevels  = image.mipLevels;
+
+    /* Levels are already in upload layout - read them straight into staging memory. */
+    void* data = this->allocateLevels(texture, dataSize, streamed);
+    file.read(static_cast<char*>(data), dataSize);
+
+    if( !file )
+        throw std::runtime_error("Truncated DDS file: " + compressedPath + " :( \n");
+
+    return true;
+}
+
+void AssetLoader::decodeImage(TextureAsset& texture, bool streamed)
+{
+    /* Local Variables */
+    int texWidth    = 0;
+    int texHeight   = 0;
+    int texChannels = 0;
+
+    /* stb_image allocates decoded image itself - it is copied into staging memory once, still on the worker thread. */
+    stbi_uc* pixels = stbi_load(texture.path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+    if(!pixels)
+        throw std::runtime_error("Failed to load texture file: " + texture.path + " :( \n");
+
+    /* Every level halves the larger dimension until 1x1 level is reached. */
+    texture.format      = VK_FORMAT_R8G8B8A8_SRGB;
+    texture.width       = static_cast<uint32_t>(texWidth);
+    texture.height      = static_cast<uint32_t>(texHeight);
+    texture.mipLevels   = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+
+    /* Levels are blitted on GPU whenever texture format can be linearly filtered by blit.
+    *  Otherwise whole chain is built on CPU and uploaded together with the base level.
+    */
+    if( !streamed && this->isLinearBlitSupported(texture.format) )
+    {
+        VkDeviceSize imageSize = static_cast<VkDeviceSize>(texWidth) * texHeight * 4;   /* 4 bytes per pixel- RGBA values */
+
+        texture.uploadedLevels = 1;
+        memcpy(this->createStagingBuffer(texture, imageSize), pixels, static_cast<size_t>(imageSize));
+    }
+    else
+    {
+        VkDeviceSize chainSize = mipChainSize(texWidth, texHeight, texture.mipLevels);
+
+        texture.uploadedLevels = texture.mipLevels;
+        buildMipChain(pixels, texWidth, texHeight, texture.mipLevels, static_cast<uint8_t*>(this->allocateLevels(texture, chainSize, streamed)));
+    }
+
+    /* Free stbi image data */
+    stbi_image_free(pixels);
+}
+
+void* AssetLoader::allocateLevels(TextureAsset& texture, VkDeviceSize size, bool streamed)
+{
+    if( !streamed )
+        return this->createStagingBuffer(texture, size);
+
+    texture.levels.resize(static_cast<size_t>(size));
+    return texture.levels.data();
+}
+
+void* AssetLoader::createStagingBuffer(TextureAsset& texture, VkDeviceSize size)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType        = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size         = size;
+    bufferInfo.usage        = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
+
+    if( vkCreateBuffer(this->device, &bufferInfo, nullptr, &texture.stagingBuffer) != VK_SUCCESS )
+        throw std::runtime_error("Failed to create staging buffer :( \n");
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(this->device, texture.stagingBuffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize    = memRequirements.size;
+    allocInfo.memoryTypeIndex   = this->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if( vkAllocateMemory(this->device, &allocInfo, nullptr, &texture.stagingMemory) != VK_SUCCESS )
+        throw std::runtime_error("Failed to allocate staging buffer memory :( \n");
+
+    vkBindBufferMemory(this->device, texture.stagingBuffer, texture.stagingMemory, 0);
+
+    /* Memory stays mapped until staging buffer is released. */
+    void* data;
+    if( vkMapMemory(this->device, texture.stagingMemory, 0, size, 0, &data) != VK_SUCCESS )
+        throw std::runtime_error("Failed to map staging buffer memory. :( \n");
+
+    return data;
+}
+
+uint32_t AssetLoader::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(this->physicalDevice, &memProperties);
+
+    for( uint32_t i = 0; i < memProperties.memoryTypeCount; i++ )
+    {
+        if( (typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties )
+            return i;
+    }
+
+    throw std::runtime_error("Failed to find suitable memory type! :( \n");
+}
+
+bool AssetLoader::isSampledFormatSupported(VkFormat format, uint32_t mipLevels)
+{
+    if( format == VK_FORMAT_UNDEFINED )
+        return false;
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(this->physicalDevice, format, &formatProperties);
+
+    /* Levels are blended by linear mipmap filter of the sampler. */
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    if( mipLevels > 1 )
+        required |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    /* Transfer bits are reported by Vulkan 1.1 devices only - on 1.0 every sampled format can be copied into. */
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(this->physicalDevice, &deviceProperties);
+
+    if( deviceProperties.apiVersion >= VK_API_VERSION_1_1 )
+        required |= VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+
+    return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
+bool AssetLoader::isLinearBlitSupported(VkFormat format)
+{
+    /* Blit with linear filter requires the format to be linearly filterable, not only blittable. */
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(this->physicalDevice, format, &formatProperties);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & required) == required;
+}
\ No newline at end of file
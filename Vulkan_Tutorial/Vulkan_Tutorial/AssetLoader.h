@@ -0,0 +1,93 @@
+#pragma once
+
+#include "libs.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/* Texture decoded by AssetLoader into its own staging buffer - waits for upload into image. Streamed textures keep their levels in host memory instead. */
+struct TextureAsset
+{
+    std::string     path;
+
+    VkFormat        format          = VK_FORMAT_UNDEFINED;
+    uint32_t        width           = 0;
+    uint32_t        height          = 0;
+    uint32_t        mipLevels       = 0;
+
+    /* Levels stored in staging buffer, packed from the base level. Missing levels have to be blitted on GPU. */
+    uint32_t        uploadedLevels  = 0;
+
+    VkBuffer        stagingBuffer   = VK_NULL_HANDLE;
+    VkDeviceMemory  stagingMemory   = VK_NULL_HANDLE;
+
+    /* Streamed textures only - every level packed from the base one, copied into staging memory level by level when it is streamed in. */
+    std::vector<uint8_t>    levels;
+
+    /* Filled by upload - owned by the application. */
+    VkImage         image           = VK_NULL_HANDLE;
+    VkDeviceMemory  imageMemory     = VK_NULL_HANDLE;
+
+    bool                ready       = false;
+    std::exception_ptr  error;
+};
+
+/* Decodes textures on a pool of worker threads.
+*  Every texture gets host visible staging buffer which stays mapped while it is written - baked DDS levels are read from file
+*  straight into it. Application waits for decoded textures, records their uploads together and releases staging memory.
+*  Streamed textures are decoded into host memory instead - they live as long as the application and upload only a few levels at once.
+*/
+class AssetLoader
+{
+public:
+    AssetLoader(VkPhysicalDevice physicalDevice, VkDevice device, bool textureCompressionBC);
+    ~AssetLoader();
+
+    /* Queues texture decode and returns its id. Baked texture at compressedPath is preferred when present and supported by device.
+    *  Streamed texture gets every level even if the format supports blits - they are stored in TextureAsset::levels, not in staging buffer.
+    */
+    uint32_t        requestTexture(const std::string& path, const std::string& compressedPath, bool streamed);
+
+    /* Blocks until texture is decoded. Rethrows exception thrown while decoding. */
+    TextureAsset&   wait(uint32_t textureId);
+
+    /* Frees staging buffer - upload of texture has to be completed. */
+    void            releaseStaging(uint32_t textureId);
+
+private:
+    VkPhysicalDevice    physicalDevice;
+    VkDevice            device;
+    bool                textureCompressionBC;
+
+    /* Addresses of textures stay stable while workers write them. */
+    std::vector<std::unique_ptr<TextureAsset>>  textures;
+
+    std::vector<std::thread>            workers;
+    std::deque<std::function<void()>>   jobs;
+    bool                                stopping = false;
+
+    std::mutex                  mutex;
+    std::condition_variable     jobAvailable;
+    std::condition_variable     textureDecoded;
+
+    void    workerLoop();
+
+    void    decodeTexture(TextureAsset& texture, const std::string& compressedPath, bool streamed);
+    bool    decodeCompressedTexture(TextureAsset& texture, const std::string& compressedPath, bool streamed);
+    void    decodeImage(TextureAsset& texture, bool streamed);
+
+    /* Memory decoded levels are written into - host memory of streamed texture, mapped staging buffer otherwise. */
+    void*   allocateLevels(TextureAsset& texture, VkDeviceSize size, bool streamed);
+
+    /* Creates staging buffer of texture and maps it. */
+    void*   createStagingBuffer(TextureAsset& texture, VkDeviceSize size);
+
+    uint32_t    findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    bool        isSampledFormatSupported(VkFormat format, uint32_t mipLevels);
+    bool        isLinearBlitSupported(VkFormat format);
+};
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "DdsFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+/* "DDS " */
+static const uint32_t DDS_MAGIC = 0x20534444;
+/* "DX10" - format is described by extension header */
+static const uint32_t DDS_FOURCC_DX10 = 0x30315844;
+
+static const uint32_t DDSD_CAPS         = 0x1;
+static const uint32_t DDSD_HEIGHT       = 0x2;
+static const uint32_t DDSD_WIDTH        = 0x4;
+static const uint32_t DDSD_PIXELFORMAT  = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT  = 0x20000;
+static const uint32_t DDSD_LINEARSIZE   = 0x80000;
+
+static const uint32_t DDPF_FOURCC       = 0x4;
+
+static const uint32_t DDSCAPS_COMPLEX   = 0x8;
+static const uint32_t DDSCAPS_TEXTURE   = 0x1000;
+static const uint32_t DDSCAPS_MIPMAP    = 0x400000;
+
+static const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+/* Layouts of DDS_PIXELFORMAT, DDS_HEADER and DDS_HEADER_DXT10 */
+struct DdsPixelFormat
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t bitMasks[4];
+};
+
+struct DdsHeader
+{
+    uint32_t        size;
+    uint32_t        flags;
+    uint32_t        height;
+    uint32_t        width;
+    uint32_t        pitchOrLinearSize;
+    uint32_t        depth;
+    uint32_t        mipMapCount;
+    uint32_t        reserved1[11];
+    DdsPixelFormat  pixelFormat;
+    uint32_t        caps[4];
+    uint32_t        reserved2;
+};
+
+struct DdsHeaderDX10
+{
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DdsHeader) == 124, "DDS_HEADER has to be 124 bytes");
+static_assert(sizeof(DdsHeaderDX10) == 20, "DDS_HEADER_DXT10 has to be 20 bytes");
+
+uint32_t ddsBlockSize(DdsFormat format)
+{
+    switch( format )
+    {
+    case DDS_FORMAT_BC1_UNORM:
+    case DDS_FORMAT_BC1_UNORM_SRGB:
+        return 8;
+    case DDS_FORMAT_BC5_UNORM:
+    case DDS_FORMAT_BC7_UNORM:
+    case DDS_FORMAT_BC7_UNORM_SRGB:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+size_t ddsLevelSize(DdsFormat format, uint32_t width, uint32_t height)
+{
+    size_t blocksX = std::max((width + 3) / 4, 1u);
+    size_t blocksY = std::max((height + 3) / 4, 1u);
+
+    return blocksX * blocksY * ddsBlockSize(format);
+}
+
+size_t readDdsHeader(std::istream& file, const std::string& path, DdsImage& image)
+{
+    uint32_t        magic = 0;
+    DdsHeader       header = {};
+    DdsHeaderDX10   headerDX10 = {};
+
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    if( !file || magic != DDS_MAGIC || header.size != sizeof(DdsHeader) )
+        throw std::runtime_error("Not a DDS file: " + path + " :( \n");
+
+    /* Only block-compressed formats written by TextureBaker are supported - all of them need extension header. */
+    if( !(header.pixelFormat.flags & DDPF_FOURCC) || header.pixelFormat.fourCC != DDS_FOURCC_DX10 )
+        throw std::runtime_error("DDS file without DX10 header: " + path + " :( \n");
+
+    file.read(reinterpret_cast<char*>(&headerDX10), sizeof(headerDX10));
+
+    image.format    = static_cast<DdsFormat>(headerDX10.dxgiFormat);
+    image.width     = header.width;
+    image.height    = header.height;
+    image.mipLevels = std::max(header.mipMapCount, 1u);
+
+    if( !file || ddsBlockSize(image.format) == 0 || headerDX10.resourceDimension != DDS_DIMENSION_TEXTURE2D || headerDX10.arraySize > 1 )
+        throw std::runtime_error("Unsupported DDS texture: " + path + " :( \n");
+
+    size_t dataSize = 0;
+    for( uint32_t level = 0; level < image.mipLevels; level++ )
+        dataSize += ddsLevelSize(image.format, std::max(image.width >> level, 1u), std::max(image.height >> level, 1u));
+
+    return dataSize;
+}
+
+bool readDds(const std::string& path, DdsImage& image)
+{
+    std::ifstream file(path, std::ios::binary);
+    if( !file.is_open() )
+        return false;
+
+    size_t dataSize = readDdsHeader(file, path, image);
+
+    image.data.resize(dataSize);
+    file.read(reinterpret_cast<char*>(image.data.data()), dataSize);
+
+    if( !file )
+        throw std::runtime_error("Truncated DDS file: " + path + " :( \n");
+
+    return true;
+}
+
+void writeDds(const std::string& path, const DdsImage& image)
+{
+    DdsHeader header = {};
+    header.size                 = sizeof(DdsHeader);
+    header.flags                = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.height               = image.height;
+    header.width                = image.width;
+    header.pitchOrLinearSize    = static_cast<uint32_t>(ddsLevelSize(image.format, image.width, image.height));
+    header.depth                = 1;
+    header.mipMapCount          = image.mipLevels;
+    header.pixelFormat.size     = sizeof(DdsPixelFormat);
+    header.pixelFormat.flags    = DDPF_FOURCC;
+    header.pixelFormat.fourCC   = DDS_FOURCC_DX10;
+    header.caps[0]              = DDSCAPS_TEXTURE | (image.mipLevels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+    DdsHeaderDX10 headerDX10 = {};
+    headerDX10.dxgiFormat           = image.format;
+    headerDX10.resourceDimension    = DDS_DIMENSION_TEXTURE2D;
+    headerDX10.arraySize            = 1;
+
+    std::ofstream file(path, std::ios::binary);
+    if( !file.is_open() )
+        throw std::runtime_error("Failed to create file: " + path + " :( \n");
+
+    file.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&headerDX10), sizeof(headerDX10));
+    file.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+
+    if( !file )
+        throw std::runtime_error("Failed to write file: " + path + " :( \n");
+}
\ No newline at end of file
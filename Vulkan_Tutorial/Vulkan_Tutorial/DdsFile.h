@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+/* Block-compressed formats written by TextureBaker and read by TutorialApp - values match DXGI_FORMAT. */
+enum DdsFormat : uint32_t
+{
+    DDS_FORMAT_UNKNOWN          = 0,
+    DDS_FORMAT_BC1_UNORM        = 71,
+    DDS_FORMAT_BC1_UNORM_SRGB   = 72,
+    DDS_FORMAT_BC5_UNORM        = 83,
+    DDS_FORMAT_BC7_UNORM        = 98,
+    DDS_FORMAT_BC7_UNORM_SRGB   = 99
+};
+
+/* 2D texture with full or partial mip chain. */
+struct DdsImage
+{
+    DdsFormat               format      = DDS_FORMAT_UNKNOWN;
+    uint32_t                width       = 0;
+    uint32_t                height      = 0;
+    uint32_t                mipLevels   = 0;
+
+    /* Levels packed one after another, starting from the base level. Every level is a row-major grid of 4x4 blocks. */
+    std::vector<uint8_t>    data;
+};
+
+/* Bytes of one 4x4 block - 0 for unknown formats. */
+uint32_t    ddsBlockSize(DdsFormat format);
+
+/* Bytes of mip level of given size - partial blocks on the edges are stored whole. */
+size_t      ddsLevelSize(DdsFormat format, uint32_t width, uint32_t height);
+
+/* Reads headers only and leaves the stream at the beginning of level data - image.data stays empty.
+*  Returns size of level data. Throws if stream does not hold a DDS file with one of formats above.
+*/
+size_t      readDdsHeader(std::istream& file, const std::string& path, DdsImage& image);
+
+/* Returns false if file does not exist. Throws if it is not a DDS file with one of formats above. */
+bool        readDds(const std::string& path, DdsImage& image);
+
+/* Writes DDS file with DX10 extension header. */
+void        writeDds(const std::string& path, const DdsImage& image);
\ No newline at end of file
@@ -1,14 +1,30 @@
 
 #include "TutorialApp.h"
 
-/* Image Loader */
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 /* Model Loader */
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+/* Bytes of one mip level - block-compressed formats store partial edge blocks whole. */
+static VkDeviceSize imageLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+    VkDeviceSize blocksX = std::max((width + 3) / 4, 1u);
+    VkDeviceSize blocksY = std::max((height + 3) / 4, 1u);
+
+    switch( format )
+    {
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return blocksX * blocksY * 8;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return blocksX * blocksY * 16;
+    default:
+        return static_cast<VkDeviceSize>(width) * height * 4;  /* RGBA8 */
+    }
+}
+
 /*
 * Callbacks Functionality.
 */
@@ -47,18 +63,20 @@ void TutorialApp::initVulkan()
     this->createSurface();
     this->pickPhysicalDevice();
     this->createLogicalDevice();
+    this->createAssetLoader();
     this->createSwapChain();
     this->createImageViews();
     this->createRenderPass();
     this->createDescriptorSetLayout();
     this->createGraphicsPipeline();
+    this->createColorResources();
     this->createDepthResources();
     this->createFramebuffers();
     this->createCommandPool();
+    this->loadModel();
     this->createTextureImage();
     this->createTextureImageView();
     this->createTextureSamper();
-    this->loadModel();
     this->createVertexBuffer();
     this->createIndexBuffer();
     this->createUniformBuffers();
@@ -79,7 +97,7 @@ void TutorialApp::createInstance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "eMKEngine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_1;    /* Descriptor indexing features are queried through core 1.1 function. */
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -152,14 +170,70 @@ void TutorialApp::createLogicalDevice()
     }
 
 
+    /* Compressed textures are optional - uncompressed source texture is loaded without them. */
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(this->physicalDevice, &supportedFeatures);
+    this->textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy    = VK_TRUE;
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    deviceFeatures.sampleRateShading    = supportedFeatures.sampleRateShading;
+
+    /* Texel density feedback is written by fragment shader - the feature is requested only when textures are streamed. */
+    this->textureStreaming = TEXTURE_STREAMING_BUDGET > 0 && supportedFeatures.fragmentStoresAndAtomics == VK_TRUE;
+    deviceFeatures.fragmentStoresAndAtomics = this->textureStreaming ? VK_TRUE : VK_FALSE;
+
+    /* Attachments are created with sample count chosen here - render pass and pipeline use it as well. */
+    this->sampleRateShading = supportedFeatures.sampleRateShading == VK_TRUE;
+    this->msaaSamples       = this->chooseSampleCount(MSAA_SAMPLES);
+
+    /* Streamed texture is rebound without recording command buffers again when its binding can be updated after bind. Optional. */
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(this->physicalDevice, &deviceProperties);
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(this->physicalDevice, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(this->physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+    bool descriptorIndexing = std::any_of(availableExtensions.begin(), availableExtensions.end(), [](const VkExtensionProperties& extension)
+    {
+        return strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+    });
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    if( deviceProperties.apiVersion >= VK_API_VERSION_1_1 && descriptorIndexing )
+    {
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &indexingFeatures;
+        vkGetPhysicalDeviceFeatures2(this->physicalDevice, &features);
+
+        this->descriptorUpdateAfterBind = indexingFeatures.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE;
+    }
+
+    /* Only the feature used by texture binding is enabled. */
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexingFeatures = {};
+    enabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    if( this->descriptorUpdateAfterBind )
+    {
+        this->deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);  /* Required by descriptor indexing */
+        this->deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+        enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    }
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pEnabledFeatures = &deviceFeatures;
+    createInfo.pNext = this->descriptorUpdateAfterBind ? &enabledIndexingFeatures : nullptr;
 
     createInfo.enabledExtensionCount = static_cast<uint32_t>(this->deviceExtensions.size());
     createInfo.ppEnabledExtensionNames = this->deviceExtensions.data();
@@ -290,7 +364,7 @@ void TutorialApp::createImageViews()
      */
     for ( unsigned int i = 0; i < swapChainImages.size(); i++)
     {
-        swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+        swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
     }
 }
 
@@ -298,14 +372,17 @@ void TutorialApp::createRenderPass()
 {
     /* COLOR ATTACHMENT */
     VkAttachmentDescription colorAttachment = {};
+    /* With MSAA color is rendered into multisampled image and resolved into swap chain image - only the resolved one is stored. */
+    bool multisampled = this->msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
     colorAttachment.format  = this->swapChainImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.samples = this->msaaSamples;
     colorAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;  // Clear data in attachment before rendering.
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Store rendered contents in memory, so it can be read later.
+    colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE; // Store rendered contents in memory, so it can be read later.
     colorAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout     = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colorAttachmentRef = {};
     colorAttachmentRef.attachment   = 0;
@@ -314,7 +391,7 @@ void TutorialApp::createRenderPass()
     /* DEPTH ATTACHMENT */
     VkAttachmentDescription depthAttachment = {};
     depthAttachment.format  = this->findDepthFormat();
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.samples = this->msaaSamples;
     depthAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;      /* Clear data in attachment before rendering. */
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; /* Do not store depth data for now. */
     depthAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -325,12 +402,28 @@ void TutorialApp::createRenderPass()
     VkAttachmentReference depthAttachmentRef = {};
     depthAttachmentRef.attachment   = 1;
     depthAttachmentRef.layout       = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    /* RESOLVE ATTACHMENT - swap chain image, written by resolve of multisampled color at the end of the subpass. */
+    VkAttachmentDescription resolveAttachment = {};
+    resolveAttachment.format  = this->swapChainImageFormat;
+    resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    resolveAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    resolveAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolveAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    resolveAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
+    resolveAttachment.finalLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference resolveAttachmentRef = {};
+    resolveAttachmentRef.attachment = 2;
+    resolveAttachmentRef.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     
     /* Define subpass attachments */
     VkSubpassDescription subpass    = {};
     subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount    = 1;
     subpass.pColorAttachments       = &colorAttachmentRef;
+    subpass.pResolveAttachments     = multisampled ? &resolveAttachmentRef : nullptr;
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
     /* Subpass dependencies */
@@ -340,11 +433,11 @@ void TutorialApp::createRenderPass()
     dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     dependency.dstStageMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
-    /* Render pass consist of two attachment- color and depth. */
-    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+    /* Render pass consist of two attachment- color and depth, with MSAA the third one is resolve target. */
+    std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, resolveAttachment};
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType        = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount  = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.attachmentCount  = multisampled ? 3 : 2;
     renderPassInfo.pAttachments     = attachments.data();
     renderPassInfo.subpassCount     = 1;
     renderPassInfo.pSubpasses       = &subpass;
@@ -375,13 +468,35 @@ void TutorialApp::createDescriptorSetLayout()
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     samplerLayoutBinding.stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;  /* Descriptor will be referenced in fragment shader stage. */
 
+    /* Binding to texel density feedback written by fragment shader. */
+    VkDescriptorSetLayoutBinding feedbackLayoutBinding = {};
+    feedbackLayoutBinding.binding   = 2;
+    feedbackLayoutBinding.descriptorCount    = 1;
+    feedbackLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    feedbackLayoutBinding.pImmutableSamplers = nullptr;
+    feedbackLayoutBinding.stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
+
     /* Layout info describing all of the bindings. */
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings = {uboLayoutBinding, samplerLayoutBinding, feedbackLayoutBinding};
     VkDescriptorSetLayoutCreateInfo layoutInfo = {};
     layoutInfo.sType    = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
     layoutInfo.pBindings    = bindings.data();
 
+    /* Texture binding is rewritten by streaming - with update after bind command buffers which bound the set stay valid. */
+    std::array<VkDescriptorBindingFlagsEXT, 3> bindingFlags = { 0, VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT, 0 };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+    bindingFlagsInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount   = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags  = bindingFlags.data();
+
+    if( this->descriptorUpdateAfterBind )
+    {
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    }
+
     if( vkCreateDescriptorSetLayout(this->device, &layoutInfo, nullptr, &this->descriptorSetLayout) != VK_SUCCESS )
         throw std::runtime_error("Failed to create Descriptor Set Layout. :( \n");
 }
@@ -389,7 +504,7 @@ void TutorialApp::createDescriptorSetLayout()
 void TutorialApp::createGraphicsPipeline()
 {
     auto vertShaderCode = readFile("shaders/vert.spv");
-    auto fragShaderCode = readFile("shaders/frag.spv");
+    auto fragShaderCode = readFile(this->textureStreaming ? "shaders/frag_feedback.spv" : "shaders/frag.spv");
 
     VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
     VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
@@ -466,9 +581,9 @@ void TutorialApp::createGraphicsPipeline()
     /* Multisampling */
     VkPipelineMultisampleStateCreateInfo multisampling = {};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable   = VK_FALSE;
-    multisampling.rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT;
-    multisampling.minSampleShading      = 1.f;      // Optional
+    multisampling.sampleShadingEnable   = (MIN_SAMPLE_SHADING > 0.f && this->sampleRateShading) ? VK_TRUE : VK_FALSE;
+    multisampling.rasterizationSamples  = this->msaaSamples;
+    multisampling.minSampleShading      = MIN_SAMPLE_SHADING;
     multisampling.pSampleMask           = nullptr;  //Optional
     multisampling.alphaToCoverageEnable = VK_FALSE;
     multisampling.alphaToOneEnable      = VK_FALSE;
@@ -578,7 +693,10 @@ void TutorialApp::createFramebuffers()
 
     for(size_t i=0; i< swapChainImageViews.size(); i++)
     {
-        std::array<VkImageView, 2> attachments = { swapChainImageViews[i], depthImageView };
+        /* With MSAA swap chain image is the resolve attachment. */
+        std::vector<VkImageView> attachments = { swapChainImageViews[i], depthImageView };
+        if( this->colorImageView != VK_NULL_HANDLE )
+            attachments = { colorImageView, depthImageView, swapChainImageViews[i] };
 
         VkFramebufferCreateInfo framebufferInfo = {};
         framebufferInfo.sType   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -601,95 +719,472 @@ void TutorialApp::createCommandPool()
     VkCommandPoolCreateInfo poolInfo = {};
     poolInfo.sType  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex   = queueFamilyIndices.graphicsFamily.value();    // Commands for drawing- graphics queue
-    poolInfo.flags  = 0;
+    poolInfo.flags  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;             // Streaming records its command buffers every frame
 
     if( vkCreateCommandPool(this->device, &poolInfo, nullptr, &this->commandPool) != VK_SUCCESS )
         throw std::runtime_error("Failed to create command pool :( \n");
 }
 
+void TutorialApp::createAssetLoader()
+{
+    /* Texture decoding starts right after device creation and overlaps the rest of initialization. */
+    this->assetLoader   = std::make_unique<AssetLoader>(this->physicalDevice, this->device, this->textureCompressionBC);
+    this->textureId     = this->assetLoader->requestTexture(TEXTURE_PATH, COMPRESSED_TEXTURE_PATH, this->textureStreaming);
+}
+
 void TutorialApp::createTextureImage()
 {
-    /* Local Variables */
-    int texWidth    = 0;
-    int texHeight   = 0;
-    int texChannels = 0;
+    if( this->textureStreaming )
+    {
+        /* Only mip tail is uploaded now, finer levels follow once they are visible. */
+        this->createStreamedTexture(this->textureId);
+        this->createStreamingStaging();
 
-    /* Load an image from file. */
-    stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    
-    VkDeviceSize imageSize = texWidth * texHeight * 4;  /* 4 bytes per pixel- RGBA values */
+        /* Mip tails go through staging buffer of the first frame - every one of them fits into it, rendering has not started yet. */
+        StreamingStaging& staging = this->streamingStaging[0];
+        for( auto& texture : this->streamedTextures )
+        {
+            VkCommandBuffer commandBuffer = this->beganSingleTimeCommands();
+            this->recordTextureResidency(commandBuffer, texture, texture.tailMip, staging);
+            this->endSingleTimeCommands(commandBuffer);
 
-    if(!pixels)
-        throw std::runtime_error("Failed to load texture file: textures/texture.jpg :( \n");
+            staging.used = 0;
+        }
 
-    /* Load image via staging buffer. */
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+        this->textureFormat = this->streamedTextures[0].format;
+        this->mipLevels     = this->streamedTextures[0].mipLevels;
+        return;
+    }
+
+    this->uploadTextures({ this->textureId });
+
+    const TextureAsset& texture = this->assetLoader->wait(this->textureId);
+    this->textureImage          = texture.image;
+    this->textureImageMemory    = texture.imageMemory;
+    this->textureFormat         = texture.format;
+    this->mipLevels             = texture.mipLevels;
+}
+
+void TutorialApp::uploadTextures(const std::vector<uint32_t>& textureIds)
+{
+    /* Uploads of all textures are recorded into single command buffer and submitted once. */
+    VkCommandBuffer commandBuffer = this->beganSingleTimeCommands();
+
+    for( uint32_t textureId : textureIds )
+    {
+        TextureAsset& texture = this->assetLoader->wait(textureId);
+
+        /* Create object to hold image data. Blit reads previous levels, so image is also a transfer source. */
+        this->createImage(texture.width, 
+            texture.height, 
+            texture.mipLevels,
+            texture.format, 
+            VK_IMAGE_TILING_OPTIMAL, 
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+            texture.image, 
+            texture.imageMemory
+        );
+
+        /* Copy staging buffer to created texture image.
+        *   1. Transition the texture image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL (it was created with undefined layout)
+        *   2. Execute the buffer to image copy operation - levels present in staging buffer only.
+        *   3. Transition image to SHADER_READ_ONLY_OPTIMAL layout to prepare it for shader access.
+        *      Mipmap generation transitions every level once it is no longer written.
+        */
+        this->transitionImageLayout(commandBuffer,
+            texture.image, 
+            texture.format, 
+            VK_IMAGE_LAYOUT_UNDEFINED, 
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            texture.mipLevels
+        );
     
-    /* Crate staging buffer */
-    this->createBuffer(imageSize, 
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, 
-        stagingBufferMemory
-    );
+        this->copyBufferToImage(commandBuffer,
+            texture.stagingBuffer, 
+            0,
+            texture.image,
+            texture.format,
+            texture.width,
+            texture.height,
+            0,
+            texture.uploadedLevels
+        );
 
-    /* Copy data directly to staging buffer. */
-    void* data;
-    if(vkMapMemory(this->device, stagingBufferMemory, 0, imageSize, 0, &data) != VK_SUCCESS )
-        throw std::runtime_error("Failed to map staging buffer memory. :( \n");
-    memcpy(data, pixels, static_cast<uint32_t>(imageSize));
-    vkUnmapMemory(this->device, stagingBufferMemory);
+        if( texture.uploadedLevels < texture.mipLevels )
+        {
+            this->generateMipmaps(commandBuffer, texture.image, static_cast<int32_t>(texture.width), static_cast<int32_t>(texture.height), texture.mipLevels);
+        }
+        else
+        {
+            this->transitionImageLayout(commandBuffer,
+                texture.image,
+                texture.format,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                texture.mipLevels
+            );
+        }
+    }
 
-    /* Free stbi image data */
-    stbi_image_free(pixels);
+    /* Waits for the queue - staging buffers are no longer used afterwards. */
+    this->endSingleTimeCommands(commandBuffer);
 
-    /* Create object to hold image data. */
-    this->createImage(texWidth, 
-        texHeight, 
-        VK_FORMAT_R8G8B8A8_SRGB, 
-        VK_IMAGE_TILING_OPTIMAL, 
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-        this->textureImage, 
-        this->textureImageMemory
-    );
+    for( uint32_t textureId : textureIds )
+        this->assetLoader->releaseStaging(textureId);
+}
+
+void TutorialApp::createStreamedTexture(uint32_t textureId)
+{
+    const TextureAsset& asset = this->assetLoader->wait(textureId);
+
+    /* Levels are kept in host memory of the asset loader - they are the source of every level streamed in later. */
+    StreamedTexture texture;
+    texture.textureId   = textureId;
+    texture.format      = asset.format;
+    texture.width       = asset.width;
+    texture.height      = asset.height;
+    texture.mipLevels   = asset.uploadedLevels;     /* Levels present in host memory */
+
+    /* Mip tail starts at the first level which fits into TEXTURE_MIP_TAIL_SIZE. */
+    texture.tailMip = 0;
+    while( texture.tailMip + 1 < texture.mipLevels &&
+           std::max(texture.width >> texture.tailMip, texture.height >> texture.tailMip) > TEXTURE_MIP_TAIL_SIZE )
+    {
+        texture.tailMip++;
+    }
 
-    /* Copy staging buffer to created texture image.
-    *   1. Transition the texture image to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL (it was created with undefined layout)
-    *   2. Execute the buffer to image copy operation.
-    *   3. Transition image to SHADER_READ_ONLY_OPTIMAL layout to prepare it for shader access.
-    *   TODO: Combine these operations in single command buffer and execute them asynchronously.
-    *       Create setupCommandBuffer to record commands into.
-    *       Execute commands with flushSetupCommands() that have been recorded so far. 
+    texture.residentMip     = texture.mipLevels;    /* Nothing resident yet */
+    texture.requestedMip    = texture.tailMip;
+    texture.lastUsedFrame   = this->frameCounter;
+
+    this->streamedTextures.push_back(texture);
+}
+
+void TutorialApp::createStreamingStaging()
+{
+    /* Every frame uploads at most what fits into its staging buffer - the largest level or the whole mip tail of any texture. */
+    VkDeviceSize stagingSize = 0;
+    for( const auto& texture : this->streamedTextures )
+    {
+        stagingSize = std::max({ stagingSize,
+            imageLevelSize(texture.format, texture.width, texture.height),
+            this->streamedTextureSize(texture, texture.tailMip) });
+    }
+
+    this->streamingStaging.resize(MAX_FRAMES_IN_FLIGHT);
+    for( auto& staging : this->streamingStaging )
+    {
+        this->createBuffer(stagingSize,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            staging.buffer,
+            staging.memory
+        );
+
+        void* data;
+        vkMapMemory(this->device, staging.memory, 0, stagingSize, 0, &data);
+        staging.data = static_cast<uint8_t*>(data);
+        staging.size = stagingSize;
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool           = this->commandPool;
+        allocInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount    = 1;
+
+        if( vkAllocateCommandBuffers(this->device, &allocInfo, &staging.commandBuffer) != VK_SUCCESS )
+            throw std::runtime_error("Failed to allocate streaming command buffer. :( \n");
+    }
+}
+
+void TutorialApp::recordTextureResidency(VkCommandBuffer commandBuffer, StreamedTexture& texture, uint32_t residentMip, StreamingStaging& staging)
+{
+    /* Image is replaced whenever levels are added or evicted - its base level is level residentMip of the texture.
+    *  Levels resident in the previous image are copied on GPU, only the new ones are uploaded from staging buffer.
+    *  Previous image is retired - it is destroyed once no frame in flight can sample it.
     */
-    this->transitionImageLayout(this->textureImage, 
-        VK_FORMAT_R8G8B8A8_SRGB, 
-        VK_IMAGE_LAYOUT_UNDEFINED, 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-    );
-    
-    this->copyBufferToImage(stagingBuffer, 
-        this->textureImage,
-        static_cast<uint32_t>(texWidth),
-        static_cast<uint32_t>(texHeight)
+    const TextureAsset& asset = this->assetLoader->wait(texture.textureId);
+    StreamedTexture previous = texture;
+    uint32_t levelCount = texture.mipLevels - residentMip;
+
+    this->createImage(std::max(texture.width >> residentMip, 1u),
+        std::max(texture.height >> residentMip, 1u),
+        levelCount,
+        texture.format,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        texture.image,
+        texture.imageMemory
     );
 
-    this->transitionImageLayout(this->textureImage,
-        VK_FORMAT_R8G8B8A8_SRGB,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-    );
+    this->transitionImageLayout(commandBuffer, texture.image, texture.format,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount);
 
-    /* Free staging buffer resources. */
-    vkDestroyBuffer(this->device, stagingBuffer, nullptr);
-    vkFreeMemory(this->device, stagingBufferMemory, nullptr);
+    if( previous.image != VK_NULL_HANDLE )
+    {
+        /* Frames submitted before read the previous image in fragment shader - barrier waits for them. */
+        this->transitionImageLayout(commandBuffer, previous.image, previous.format,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, previous.mipLevels - previous.residentMip);
+
+        std::vector<VkImageCopy> regions;
+        for( uint32_t level = std::max(residentMip, previous.residentMip); level < texture.mipLevels; level++ )
+        {
+            VkImageCopy region = {};
+            region.srcSubresource   = { VK_IMAGE_ASPECT_COLOR_BIT, level - previous.residentMip, 0, 1 };
+            region.dstSubresource   = { VK_IMAGE_ASPECT_COLOR_BIT, level - residentMip, 0, 1 };
+            region.extent           = { std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1 };
+            regions.push_back(region);
+        }
+
+        vkCmdCopyImage(commandBuffer,
+            previous.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+
+        this->retiredImages.push_back({ previous.image, previous.imageMemory, previous.imageView, this->frameCounter });
+    }
+
+    if( residentMip < previous.residentMip )
+    {
+        /* Levels [residentMip; previous.residentMip) are packed in host memory after all finer levels.
+        *  Offset is kept aligned to texel block size of every supported format.
+        */
+        VkDeviceSize sourceOffset = 0;
+        for( uint32_t level = 0; level < residentMip; level++ )
+            sourceOffset += imageLevelSize(texture.format, std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u));
+
+        VkDeviceSize uploadSize = this->streamedTextureSize(texture, residentMip) - this->streamedTextureSize(texture, previous.residentMip);
+        staging.used = (staging.used + 15) & ~VkDeviceSize(15);
+
+        memcpy(staging.data + staging.used, asset.levels.data() + sourceOffset, static_cast<size_t>(uploadSize));
+
+        this->copyBufferToImage(commandBuffer, staging.buffer, staging.used, texture.image, texture.format,
+            texture.width, texture.height, residentMip, previous.residentMip - residentMip);
+
+        staging.used += uploadSize;
+    }
+
+    this->transitionImageLayout(commandBuffer, texture.image, texture.format,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount);
+
+    texture.imageView = this->createImageView(texture.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+
+    VkDeviceSize size = this->streamedTextureSize(texture, residentMip);
+    this->streamedTexturesSize  = this->streamedTexturesSize - texture.size + size;
+    texture.size                = size;
+    texture.residentMip         = residentMip;
+}
+
+VkDeviceSize TutorialApp::streamedTextureSize(const StreamedTexture& texture, uint32_t residentMip)
+{
+    VkDeviceSize size = 0;
+    for( uint32_t level = residentMip; level < texture.mipLevels; level++ )
+        size += imageLevelSize(texture.format, std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u));
+
+    return size;
+}
+
+void TutorialApp::updateTextureStreaming(uint32_t currentImage)
+{
+    this->frameCounter++;
+
+    if( this->streamedTextures.empty() )
+        return;
+
+    /* Fence waited for at the start of this frame belongs to frame frameCounter - MAX_FRAMES_IN_FLIGHT - images retired up to it are not read anymore. */
+    auto retiredEnd = std::remove_if(this->retiredImages.begin(), this->retiredImages.end(), [this](const RetiredImage& retired)
+    {
+        if( retired.retiredFrame + MAX_FRAMES_IN_FLIGHT > this->frameCounter )
+            return false;
+
+        vkDestroyImageView(this->device, retired.imageView, nullptr);
+        vkDestroyImage(this->device, retired.image, nullptr);
+        vkFreeMemory(this->device, retired.imageMemory, nullptr);
+        return true;
+    });
+    this->retiredImages.erase(retiredEnd, this->retiredImages.end());
+
+    /* Fence of the previous frame rendered into this image was waited for - its feedback is complete. */
+    TextureFeedback* feedback = this->feedbackData[currentImage];
+
+    for( size_t i = 0; i < this->streamedTextures.size(); i++ )
+    {
+        StreamedTexture& texture = this->streamedTextures[i];
+
+        if( feedback[i].minMip != UINT32_MAX )
+        {
+            texture.requestedMip    = std::min(feedback[i].minMip, texture.tailMip);
+            texture.lastUsedFrame   = this->frameCounter;
+        }
+
+        feedback[i].minMip = UINT32_MAX;
+    }
+
+    /* Resident levels are planned for all textures first, so their copies are recorded into one command buffer. */
+    std::vector<uint32_t> plannedMips(this->streamedTextures.size());
+    for( size_t i = 0; i < this->streamedTextures.size(); i++ )
+        plannedMips[i] = this->streamedTextures[i].residentMip;
+
+    StreamingStaging& staging = this->streamingStaging[this->currentFrame];
+
+    VkDeviceSize plannedSize    = this->streamedTexturesSize;
+    VkDeviceSize plannedUpload  = 0;    /* Bytes of staging buffer used by this frame - aligned the same way as recordTextureResidency does */
+
+    /* Finest level of a texture which holds more than it needs goes first, then the least recently used one.
+    *  Textures used in the same frame do not evict each other - otherwise they would swap levels every frame.
+    */
+    auto findEvictionCandidate = [&](size_t requester) -> size_t
+    {
+        size_t candidate = this->streamedTextures.size();
+
+        for( size_t i = 0; i < this->streamedTextures.size(); i++ )
+        {
+            const StreamedTexture& texture = this->streamedTextures[i];
+            bool overResident = plannedMips[i] < texture.requestedMip;
+
+            if( i == requester || plannedMips[i] >= texture.tailMip )
+                continue;
+            if( !overResident && texture.lastUsedFrame >= this->streamedTextures[requester].lastUsedFrame )
+                continue;
+
+            if( candidate == this->streamedTextures.size() )
+            {
+                candidate = i;
+                continue;
+            }
+
+            const StreamedTexture& best = this->streamedTextures[candidate];
+            bool bestOverResident = plannedMips[candidate] < best.requestedMip;
+
+            if( overResident != bestOverResident ? overResident : texture.lastUsedFrame < best.lastUsedFrame )
+                candidate = i;
+        }
+
+        return candidate;
+    };
+
+    /* Most recently used textures are served first. */
+    std::vector<size_t> order(this->streamedTextures.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+    {
+        return this->streamedTextures[a].lastUsedFrame > this->streamedTextures[b].lastUsedFrame;
+    });
+
+    for( size_t i : order )
+    {
+        const StreamedTexture& texture = this->streamedTextures[i];
+        if( texture.requestedMip >= plannedMips[i] )
+            continue;
+
+        /* Levels are added from the coarsest one - each of them is usable as soon as it is resident. */
+        uint32_t targetMip = std::max(texture.requestedMip, plannedMips[i] - std::min(plannedMips[i], TEXTURE_STREAMING_LEVELS_PER_FRAME));
+
+        while( targetMip < plannedMips[i] )
+        {
+            VkDeviceSize growth = this->streamedTextureSize(texture, targetMip) - this->streamedTextureSize(texture, plannedMips[i]);
+            VkDeviceSize upload = ((plannedUpload + 15) & ~VkDeviceSize(15)) + growth;
+
+            /* New levels have to fit into staging buffer of this frame - the rest is uploaded by the following frames. */
+            if( upload > staging.size )
+            {
+                targetMip++;
+                continue;
+            }
+
+            if( plannedSize + growth <= TEXTURE_STREAMING_BUDGET )
+            {
+                plannedSize     += growth;
+                plannedUpload   = upload;
+                plannedMips[i]  = targetMip;
+                break;
+            }
+
+            size_t victim = findEvictionCandidate(i);
+            if( victim == this->streamedTextures.size() )
+            {
+                targetMip++;    /* Try smaller step - nothing more can be evicted. */
+                continue;
+            }
+
+            const StreamedTexture& victimTexture = this->streamedTextures[victim];
+            plannedSize -= this->streamedTextureSize(victimTexture, plannedMips[victim]) - this->streamedTextureSize(victimTexture, plannedMips[victim] + 1);
+            plannedMips[victim]++;
+        }
+    }
+
+    bool residencyChanged = false;
+    for( size_t i = 0; i < this->streamedTextures.size(); i++ )
+        residencyChanged |= plannedMips[i] != this->streamedTextures[i].residentMip;
+
+    if( !residencyChanged )
+        return;
+
+    /* Fence of this frame slot was waited for - its staging buffer and command buffer are free. Copies are submitted ahead of the draw
+    *  of this frame, images in use are retired rather than destroyed and the device is never stalled.
+    */
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if( vkBeginCommandBuffer(staging.commandBuffer, &beginInfo) != VK_SUCCESS )
+        throw std::runtime_error("Failed to begin recording streaming command buffer. :( \n");
+
+    staging.used = 0;
+    for( size_t i = 0; i < this->streamedTextures.size(); i++ )
+    {
+        if( plannedMips[i] != this->streamedTextures[i].residentMip )
+            this->recordTextureResidency(staging.commandBuffer, this->streamedTextures[i], plannedMips[i], staging);
+    }
+
+    if( vkEndCommandBuffer(staging.commandBuffer) != VK_SUCCESS )
+        throw std::runtime_error("Failed to record streaming command buffer! :( \n");
+
+    staging.recorded        = true;
+    this->textureImageView  = this->streamedTextures[0].imageView;
+}
+
+void TutorialApp::updateTextureDescriptor(uint32_t currentImage)
+{
+    /* Frame which used this image was waited for - its descriptor set is not in use and can be written. */
+    if( this->descriptorTextureViews[currentImage] == this->textureImageView )
+        return;
+
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout   = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView     = this->textureImageView;
+    imageInfo.sampler       = this->textureSampler;
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet          = this->descriptorSets[currentImage];
+    descriptorWrite.dstBinding      = 1;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo      = &imageInfo;
+
+    vkUpdateDescriptorSets(this->device, 1, &descriptorWrite, 0, nullptr);
+    this->descriptorTextureViews[currentImage] = this->textureImageView;
+
+    /* Without update after bind the write invalidates command buffer which bound the set - only this one is recorded again. */
+    if( !this->descriptorUpdateAfterBind )
+        this->recordCommandBuffer(currentImage);
 }
 
 void TutorialApp::createTextureImageView()
 {
+    /* View of streamed texture is recreated together with its image. */
+    if( !this->streamedTextures.empty() )
+    {
+        this->textureImageView = this->streamedTextures[0].imageView;
+        return;
+    }
+
     /* Images are accessed through image views rather than directly. Thus we have to create one for texture image. */
-    this->textureImageView = this->createImageView(this->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    this->textureImageView = this->createImageView(this->textureImage, this->textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, this->mipLevels);
 }
 
 void TutorialApp::createTextureSamper()
@@ -724,7 +1219,7 @@ void TutorialApp::createTextureSamper()
     samplerInfo.mipmapMode  = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias  = 0.f;
     samplerInfo.minLod      = 0.f;
-    samplerInfo.maxLod      = 0.f;
+    samplerInfo.maxLod      = static_cast<float>(this->mipLevels);    /* Allow sampling of the whole mip chain. */
 
     /* Image Sampler do not refer VkImage object anywhere. It is distinct object that provide interface to extract color from texture. */
     if(vkCreateSampler(this->device, &samplerInfo, nullptr, &this->textureSampler) != VK_SUCCESS )
@@ -783,23 +1278,45 @@ void TutorialApp::loadModel()
     }
 }
 
+void TutorialApp::createColorResources()
+{
+    if( this->msaaSamples == VK_SAMPLE_COUNT_1_BIT )
+        return;
+
+    this->createImage(this->swapChainExtent.width,
+            this->swapChainExtent.height,
+            1,
+            this->swapChainImageFormat,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+            colorImage,
+            colorImageMemory,
+            this->msaaSamples
+        );
+
+    this->colorImageView = this->createImageView(this->colorImage, this->swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
 void TutorialApp::createDepthResources()
 {
     VkFormat depthFormat = this->findDepthFormat();
     
-    /* Create vkImage object with given properties */
+    /* Create vkImage object with given properties - depth is not stored, so it may live in tile memory only. */
     this->createImage(this->swapChainExtent.width,
             this->swapChainExtent.height,
+            1,
             depthFormat,
             VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, 
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
             depthImage,
-            depthImageMemory
+            depthImageMemory,
+            this->msaaSamples
         );
     
     /* Crate Image view bound to previously created depth image */
-    this->depthImageView = this->createImageView(this->depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    this->depthImageView = this->createImageView(this->depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
 
 void TutorialApp::createVertexBuffer()
@@ -903,6 +1420,39 @@ void TutorialApp::createUniformBuffers()
     }
 
     /* Separate function will update buffers in every frame so it is now required to map memory here. */
+
+    /* Feedback has entry for every streamed texture - at least one, shader always writes the first entry. */
+    size_t          feedbackCount   = std::max<size_t>(this->streamedTextures.size(), 1);
+    VkDeviceSize    feedbackSize    = sizeof(TextureFeedback) * feedbackCount;
+
+    this->feedbackBuffers.resize(this->swapChainImages.size());
+    this->feedbackBuffersMemory.resize(this->swapChainImages.size());
+    this->feedbackData.resize(this->swapChainImages.size());
+
+    for( size_t i = 0; i < this->swapChainImages.size(); i++ )
+    {
+        this->createBuffer(feedbackSize,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            this->feedbackBuffers[i],
+            this->feedbackBuffersMemory[i]
+        );
+
+        void* data;
+        if( vkMapMemory(this->device, this->feedbackBuffersMemory[i], 0, feedbackSize, 0, &data) != VK_SUCCESS )
+            throw std::runtime_error("Failed to map texture feedback buffer! :( \n");
+
+        this->feedbackData[i] = static_cast<TextureFeedback*>(data);
+
+        for( size_t j = 0; j < feedbackCount; j++ )
+        {
+            TextureFeedback& feedback = this->feedbackData[i][j];
+            feedback.size       = j < this->streamedTextures.size() ?
+                glm::vec2(this->streamedTextures[j].width, this->streamedTextures[j].height) : glm::vec2(0.f);
+            feedback.minMip     = UINT32_MAX;
+            feedback.padding    = 0;
+        }
+    }
 }
 
 void TutorialApp::createDescriptorPool()
@@ -910,11 +1460,13 @@ void TutorialApp::createDescriptorPool()
     /* Provide information about descriptors type of our descriptor sets and how many of them. 
     *  This structure is referenced in by the main VkDescriptorPoolCreateInfo structure. 
     */
-    std::array<VkDescriptorPoolSize, 2> poolSize = {};
+    std::array<VkDescriptorPoolSize, 3> poolSize = {};
     poolSize[0].type    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;    /* Which descriptors types this pool is going to contain. */
     poolSize[0].descriptorCount     = static_cast<uint32_t>(this->swapChainImages.size());
     poolSize[1].type    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSize[1].descriptorCount     = static_cast<uint32_t>(this->swapChainImages.size());
+    poolSize[2].type    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize[2].descriptorCount     = static_cast<uint32_t>(this->swapChainImages.size());
 
 
     /* Allocate one pool which can contain up to swap images count descriptors sets. */
@@ -923,7 +1475,7 @@ void TutorialApp::createDescriptorPool()
     poolInfo.poolSizeCount  = static_cast<uint32_t>(poolSize.size());
     poolInfo.pPoolSizes     = poolSize.data();
     poolInfo.maxSets        = static_cast<uint32_t>(this->swapChainImages.size());
-    poolInfo.flags          = 0; /* Default Value */
+    poolInfo.flags          = this->descriptorUpdateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0;
 
     if(vkCreateDescriptorPool(this->device, &poolInfo, nullptr, &this->descriptorPool) != VK_SUCCESS )
         throw std::runtime_error("Failed to create descriptor pool. :( \n");
@@ -945,6 +1497,8 @@ void TutorialApp::createDescriptorSets()
     if(vkAllocateDescriptorSets(this->device, &allocInfo, this->descriptorSets.data()) != VK_SUCCESS )
         throw std::runtime_error("Failed to allocate descriptor sets. :( \n");
 
+    this->descriptorTextureViews.assign(this->swapChainImages.size(), this->textureImageView);
+
     /* Configure each descriptor. */
     for( size_t i = 0; i<this->swapChainImages.size(); i++)
     {
@@ -960,7 +1514,13 @@ void TutorialApp::createDescriptorSets()
         imageInfo.imageView     = this->textureImageView;
         imageInfo.sampler       = this->textureSampler;
 
-        std::array<VkWriteDescriptorSet, 2> descriptorWrite = {};
+        /* Specify texel density feedback information */
+        VkDescriptorBufferInfo feedbackInfo = {};
+        feedbackInfo.buffer = this->feedbackBuffers[i];
+        feedbackInfo.offset = 0;
+        feedbackInfo.range  = VK_WHOLE_SIZE;
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrite = {};
         /* Descriptor set for buffer object. */
         descriptorWrite[0].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrite[0].dstSet  = descriptorSets[i];
@@ -987,6 +1547,15 @@ void TutorialApp::createDescriptorSets()
         descriptorWrite[1].pImageInfo      = &imageInfo;       /* Array with the descriptors count structs - image samplers */
         descriptorWrite[1].pTexelBufferView = nullptr;         /* Optional */
 
+        /* Descriptor set for texel density feedback. */
+        descriptorWrite[2].sType   = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite[2].dstSet  = descriptorSets[i];
+        descriptorWrite[2].dstBinding      = 2;
+        descriptorWrite[2].dstArrayElement = 0;
+        descriptorWrite[2].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite[2].descriptorCount = 1;
+        descriptorWrite[2].pBufferInfo     = &feedbackInfo;
+
         vkUpdateDescriptorSets(this->device, 
             static_cast<uint32_t>(descriptorWrite.size()),
             descriptorWrite.data(), 
@@ -1010,68 +1579,86 @@ void TutorialApp::createCommandBuffers()
     if( vkAllocateCommandBuffers(this->device, &allocInfo, this->commandBuffers.data()) != VK_SUCCESS)
         throw std::runtime_error("Failed to allocate command buffers. :( \n");
 
-    // Starting command buffer recording
     for( size_t i = 0; i<this->commandBuffers.size(); i++)
-    {
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = 0;                    // Optional
-        beginInfo.pInheritanceInfo  = nullptr;  // Optional
+        this->recordCommandBuffer(i);
+}
 
-        /* If the command buffer was already recorded once, then a call to vkBeginCommandBuffer will implicitly reset it. */
-        if( vkBeginCommandBuffer( this->commandBuffers[i], &beginInfo) != VK_SUCCESS)
-            throw std::runtime_error("Failed to begin recording command buffer. :( \n");
+void TutorialApp::recordCommandBuffer(size_t imageIndex)
+{
+    // Starting command buffer recording
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = 0;                    // Optional
+    beginInfo.pInheritanceInfo  = nullptr;  // Optional
 
-        VkRenderPassBeginInfo renderPassInfo = {};
-        renderPassInfo.sType    = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass   = this->renderPass;
-        renderPassInfo.framebuffer  = this->swapChainFramebuffers[i];
-        
-        /* Define size of render area */
-        renderPassInfo.renderArea.offset    = {0,0};
-        renderPassInfo.renderArea.extent    = this->swapChainExtent;
-        
-        /* Clear values - specify clear operation.
-         * Order of clear values should be same as attachments.
-         */
-        std::array<VkClearValue, 2> clearValues = {};
-        clearValues[0].color = {0.f, 0.f, 0.f, 1.f};
-        clearValues[1].depthStencil = {1.f, 0}; 
-        renderPassInfo.clearValueCount  = static_cast<uint32_t>(clearValues.size());
-        renderPassInfo.pClearValues     = clearValues.data();
-        
-        /* RECORDING */
-        vkCmdBeginRenderPass(this->commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        
-        vkCmdBindPipeline(this->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
+    /* If the command buffer was already recorded once, then a call to vkBeginCommandBuffer will implicitly reset it. */
+    if( vkBeginCommandBuffer( this->commandBuffers[imageIndex], &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin recording command buffer. :( \n");
 
-        /* Binding vertex buffer */
-        VkBuffer vertexBuffers[] = {this->vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(this->commandBuffers[i], 0, 1, vertexBuffers, offsets);
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType    = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass   = this->renderPass;
+    renderPassInfo.framebuffer  = this->swapChainFramebuffers[imageIndex];
+    
+    /* Define size of render area */
+    renderPassInfo.renderArea.offset    = {0,0};
+    renderPassInfo.renderArea.extent    = this->swapChainExtent;
+    
+    /* Clear values - specify clear operation.
+     * Order of clear values should be same as attachments.
+     */
+    std::array<VkClearValue, 2> clearValues = {};
+    clearValues[0].color = {0.f, 0.f, 0.f, 1.f};
+    clearValues[1].depthStencil = {1.f, 0}; 
+    renderPassInfo.clearValueCount  = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues     = clearValues.data();
+    
+    /* RECORDING */
+    vkCmdBeginRenderPass(this->commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    
+    vkCmdBindPipeline(this->commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
+
+    /* Binding vertex buffer */
+    VkBuffer vertexBuffers[] = {this->vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(this->commandBuffers[imageIndex], 0, 1, vertexBuffers, offsets);
+
+    /* Binding index buffer */
+    vkCmdBindIndexBuffer(this->commandBuffers[imageIndex], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+    /* Bind descriptor sets- to update uniform data. */
+    vkCmdBindDescriptorSets(this->commandBuffers[imageIndex], 
+        VK_PIPELINE_BIND_POINT_GRAPHICS, 
+        this->pipelineLayout, 
+        0, 
+        1, 
+        &descriptorSets[imageIndex], 
+        0, 
+        nullptr);
 
-        /* Binding index buffer */
-        vkCmdBindIndexBuffer(this->commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    /* Draw command by using indexes of vertices. */
+    vkCmdDrawIndexed(this->commandBuffers[imageIndex], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
 
-        /* Bind descriptor sets- to update uniform data. */
-        vkCmdBindDescriptorSets(this->commandBuffers[i], 
-            VK_PIPELINE_BIND_POINT_GRAPHICS, 
-            this->pipelineLayout, 
-            0, 
-            1, 
-            &descriptorSets[i], 
-            0, 
-            nullptr);
+    /* END RECORDING */
+    vkCmdEndRenderPass(this->commandBuffers[imageIndex]);
 
-        /* Draw command by using indexes of vertices. */
-        vkCmdDrawIndexed(this->commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+    /* Texel density feedback is read on host once the fence of this frame is signaled. */
+    VkMemoryBarrier feedbackBarrier = {};
+    feedbackBarrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    feedbackBarrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    feedbackBarrier.dstAccessMask   = VK_ACCESS_HOST_READ_BIT;
 
-        /* END RECORDING */
-        vkCmdEndRenderPass(this->commandBuffers[i]);
+    vkCmdPipelineBarrier(this->commandBuffers[imageIndex],
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1, &feedbackBarrier,
+        0, nullptr,
+        0, nullptr
+    );
 
-        if( vkEndCommandBuffer( this->commandBuffers[i]) != VK_SUCCESS )
-            throw std::runtime_error("Failed to record command buffer! :( \n");
-    }
+    if( vkEndCommandBuffer( this->commandBuffers[imageIndex]) != VK_SUCCESS )
+        throw std::runtime_error("Failed to record command buffer! :( \n");
 }
 
 void TutorialApp::createSyncObjects()
@@ -1161,6 +1748,37 @@ uint32_t TutorialApp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags
     throw std::runtime_error("Failed to find suitable memory type. :( \n");
 }
 
+bool TutorialApp::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(this->physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) 
+    {
+        if((typeFilter & (1 << i)) && ((memProperties.memoryTypes[i].propertyFlags & properties) == properties))
+            return true;
+    }
+
+    return false;
+}
+
+/* Highest sample count supported by both color and depth attachments which does not exceed requested one */
+VkSampleCountFlagBits TutorialApp::chooseSampleCount(uint32_t samples)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(this->physicalDevice, &properties);
+
+    VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+    for( uint32_t count = std::min(samples, 8u); count > 1; count /= 2 )
+    {
+        if( supported & count )
+            return static_cast<VkSampleCountFlagBits>(count);
+    }
+
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
 VkFormat TutorialApp::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
 {
     for( VkFormat format : candidates )
@@ -1314,7 +1932,8 @@ void TutorialApp::createBuffer(VkDeviceSize deviceSize, VkBufferUsageFlags usage
     vkBindBufferMemory(this->device, buffer, bufferMemory, 0);
 }
 
-void TutorialApp::createImage(uint32_t width, uint32_t height, VkFormat imageFormat, VkImageTiling imgTiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags imgMemoryProperties, VkImage & image, VkDeviceMemory & imgMemory)
+void TutorialApp::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat imageFormat, VkImageTiling imgTiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags imgMemoryProperties, VkImage & image, VkDeviceMemory & imgMemory,
+    VkSampleCountFlagBits samples)
 {
     /* Create object to hold image data. */
     VkImageCreateInfo imageInfo = {};
@@ -1323,13 +1942,13 @@ void TutorialApp::createImage(uint32_t width, uint32_t height, VkFormat imageFor
     imageInfo.extent.width  = static_cast<uint32_t>(width);
     imageInfo.extent.height = static_cast<uint32_t>(height);
     imageInfo.extent.depth  = 1;
-    imageInfo.mipLevels     = 1;
+    imageInfo.mipLevels     = mipLevels;
     imageInfo.arrayLayers   = 1;
     imageInfo.format        = imageFormat;
     imageInfo.tiling        = imgTiling;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage         = usageFlags;
-    imageInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.samples       = samples;
     imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
 
     if(vkCreateImage(this->device, &imageInfo, nullptr, &image) != VK_SUCCESS )
@@ -1344,6 +1963,10 @@ void TutorialApp::createImage(uint32_t width, uint32_t height, VkFormat imageFor
     VkMemoryRequirements memRequirements = {};
     vkGetImageMemoryRequirements(this->device, image, &memRequirements);
 
+    /* Lazily allocated memory is optional - desktop GPUs back transient attachments by ordinary device memory. */
+    if( (imgMemoryProperties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) && !this->hasMemoryType(memRequirements.memoryTypeBits, imgMemoryProperties) )
+        imgMemoryProperties &= ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
     VkMemoryAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     allocInfo.allocationSize    = memRequirements.size;
@@ -1356,7 +1979,7 @@ void TutorialApp::createImage(uint32_t width, uint32_t height, VkFormat imageFor
     vkBindImageMemory(this->device, image, imgMemory, 0);
 }
 
-VkImageView TutorialApp::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView TutorialApp::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
 {
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType  = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1365,7 +1988,7 @@ VkImageView TutorialApp::createImageView(VkImage image, VkFormat format, VkImage
     viewInfo.format     = format;
     viewInfo.subresourceRange.aspectMask        = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel      = 0;
-    viewInfo.subresourceRange.levelCount        = 1;
+    viewInfo.subresourceRange.levelCount        = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer    = 0;
     viewInfo.subresourceRange.layerCount        = 1;
 
@@ -1392,33 +2015,133 @@ void TutorialApp::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSiz
     this->endSingleTimeCommands(commandBuffer);
 }
 
-void TutorialApp::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void TutorialApp::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, VkFormat format,
+    uint32_t width, uint32_t height, uint32_t firstLevel, uint32_t levelCount)
 {
-    VkCommandBuffer commandBuffer = this->beganSingleTimeCommands();
-    
-    /* Specify which part of the buffer is going to be copied to which part of the image */
-    VkBufferImageCopy region = {};
-    region.bufferOffset         = 0;
-    region.bufferRowLength      = 0;    /* Pixels are tightly packed */
-    region.bufferImageHeight    = 0;
+    /* Specify which part of the buffer is going to be copied to which part of the image.
+    *  Levels of the texture with base level of size width x height are tightly packed one after another, level firstLevel at bufferOffset.
+    *  Level firstLevel is copied into level 0 of the image.
+    */
+    std::vector<VkBufferImageCopy> regions(levelCount);
 
-    region.imageSubresource.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel        = 0;
-    region.imageSubresource.baseArrayLayer  = 0;
-    region.imageSubresource.layerCount      = 1;
+    width   = std::max(width >> firstLevel, 1u);
+    height  = std::max(height >> firstLevel, 1u);
 
-    region.imageOffset  = {0, 0, 0};            /* x, y, z - values */
-    region.imageExtent  = {width, height, 1};   /* width, height, depth - values*/
+    for( uint32_t level = 0; level < levelCount; level++ )
+    {
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset         = bufferOffset;
+        region.bufferRowLength      = 0;    /* Pixels are tightly packed */
+        region.bufferImageHeight    = 0;
+
+        region.imageSubresource.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel        = level;
+        region.imageSubresource.baseArrayLayer  = 0;
+        region.imageSubresource.layerCount      = 1;
+
+        region.imageOffset  = {0, 0, 0};            /* x, y, z - values */
+        region.imageExtent  = {width, height, 1};   /* width, height, depth - values*/
+
+        bufferOffset += imageLevelSize(format, width, height);
+        width   = std::max(width / 2, 1u);
+        height  = std::max(height / 2, 1u);
+    }
 
     vkCmdCopyBufferToImage(commandBuffer,
         buffer,
         image,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
+        static_cast<uint32_t>(regions.size()),
+        regions.data()
     );
+}
 
-    this->endSingleTimeCommands(commandBuffer);
+void TutorialApp::generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t width, int32_t height, uint32_t mipLevels)
+{
+    /* All levels are in TRANSFER_DST layout, base level holds loaded pixels.
+    *  Every level is transitioned to TRANSFER_SRC, blitted into the next one and then transitioned to SHADER_READ_ONLY.
+    */
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType   = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image   = image;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount     = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = 1;
+
+    for( uint32_t level = 1; level < mipLevels; level++ )
+    {
+        /* Wait until previous level is written - by copy or by previous blit. */
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout       = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+            );
+
+        int32_t nextWidth   = std::max(width / 2, 1);
+        int32_t nextHeight  = std::max(height / 2, 1);
+
+        /* Region of source level is scaled into region of destination level. */
+        VkImageBlit blit = {};
+        blit.srcOffsets[0] = {0, 0, 0};
+        blit.srcOffsets[1] = {width, height, 1};
+        blit.srcSubresource.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel        = level - 1;
+        blit.srcSubresource.baseArrayLayer  = 0;
+        blit.srcSubresource.layerCount      = 1;
+        blit.dstOffsets[0] = {0, 0, 0};
+        blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+        blit.dstSubresource.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel        = level;
+        blit.dstSubresource.baseArrayLayer  = 0;
+        blit.dstSubresource.layerCount      = 1;
+
+        vkCmdBlitImage(commandBuffer,
+            image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit,
+            VK_FILTER_LINEAR
+            );
+
+        /* Previous level is complete - hand it over to fragment shader. */
+        barrier.oldLayout       = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask   = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+            );
+
+        width   = nextWidth;
+        height  = nextHeight;
+    }
+
+    /* Last level is only written by blit. */
+    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+    barrier.oldLayout       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout       = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+        );
 }
 
 void TutorialApp::updateUniformBuffer(uint32_t currentImage)
@@ -1452,10 +2175,8 @@ void TutorialApp::updateUniformBuffer(uint32_t currentImage)
     vkUnmapMemory(this->device, this->uniformBuffersMemory[currentImage]);
 }
 
-void TutorialApp::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
+void TutorialApp::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
-    VkCommandBuffer commandBuffer = this->beganSingleTimeCommands();
-
     /* Use VkImageMemoryBarrier to ensure that write to the buffer completes before reading from it. 
     *  It is equivalent to VkBufferMemoryBarrier for buffers.
     */
@@ -1474,7 +2195,7 @@ void TutorialApp::transitionImageLayout(VkImage image, VkFormat format, VkImageL
     barrier.image   = image;
     barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseMipLevel   = 0;
-    barrier.subresourceRange.levelCount     = 1;
+    barrier.subresourceRange.levelCount     = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount     = 1;
 
@@ -1504,6 +2225,15 @@ void TutorialApp::transitionImageLayout(VkImage image, VkFormat format, VkImageL
         sourceStage         = VK_PIPELINE_STAGE_TRANSFER_BIT;
         destinationStage    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;    /* Image will be read inside fragment shader */
     }
+    else if( oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+        newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+    {
+        barrier.srcAccessMask   = 0;                                /* Reads need no availability - only execution has to wait for them. */
+        barrier.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT;
+
+        sourceStage         = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;    /* Streamed texture is copied once earlier frames stop sampling it. */
+        destinationStage    = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
     else
     {
         throw std::runtime_error("Unsupported layout transition! :( \n");
@@ -1517,8 +2247,6 @@ void TutorialApp::transitionImageLayout(VkImage image, VkFormat format, VkImageL
         0, nullptr,     /* Buffer Memory Barriers   */
         1, &barrier     /* Image Memory Barriers    */
         );
-
-    this->endSingleTimeCommands(commandBuffer);
 }
 
 VkCommandBuffer TutorialApp::beganSingleTimeCommands()
@@ -1581,6 +2309,7 @@ void TutorialApp::recreateSwapChain()
     this->createImageViews();
     this->createRenderPass();
     this->createGraphicsPipeline();
+    this->createColorResources();
     this->createDepthResources();
     this->createFramebuffers();
     this->createUniformBuffers();
@@ -1596,6 +2325,13 @@ void TutorialApp::cleanupSwapChain()
     vkDestroyImage(this->device, this->depthImage, nullptr);
     vkFreeMemory(this->device, this->depthImageMemory, nullptr);
 
+    vkDestroyImageView(this->device, this->colorImageView, nullptr);
+    vkDestroyImage(this->device, this->colorImage, nullptr);
+    vkFreeMemory(this->device, this->colorImageMemory, nullptr);
+    this->colorImageView = VK_NULL_HANDLE;
+    this->colorImage = VK_NULL_HANDLE;
+    this->colorImageMemory = VK_NULL_HANDLE;
+
     for( size_t i = 0; i < swapChainFramebuffers.size(); i++ )
         vkDestroyFramebuffer(this->device, this->swapChainFramebuffers[i], nullptr);
 
@@ -1614,6 +2350,10 @@ void TutorialApp::cleanupSwapChain()
     {
         vkDestroyBuffer(device, uniformBuffers[i], nullptr);
         vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+
+        /* Freeing memory unmaps it. */
+        vkDestroyBuffer(device, feedbackBuffers[i], nullptr);
+        vkFreeMemory(device, feedbackBuffersMemory[i], nullptr);
     }
 
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
@@ -1738,6 +2478,10 @@ void TutorialApp::drawFrame()
     // Mark the image as now being in use by current frame
     this->imagesInFlight[imageIndex] = this->inFlightFences[currentFrame];
     
+    /* Feedback of the frame which used this image is complete - resident texture levels follow it. */
+    this->updateTextureStreaming(imageIndex);
+    this->updateTextureDescriptor(imageIndex);
+
     /* With information about current image we can update its uniform buffer. */
     this->updateUniformBuffer(imageIndex);
 
@@ -1751,9 +2495,19 @@ void TutorialApp::drawFrame()
     submitInfo.pWaitSemaphores      = waitSemaphores;
     submitInfo.pWaitDstStageMask    = waitStages;
 
-    /* Which command buffer to actually submit for execution */
-    submitInfo.commandBufferCount   = 1;
-    submitInfo.pCommandBuffers      = &this->commandBuffers[imageIndex];
+    /* Which command buffer to actually submit for execution - texture streaming copies of this frame go first. */
+    std::array<VkCommandBuffer, 2> submittedBuffers;
+    uint32_t submittedCount = 0;
+
+    if( !this->streamingStaging.empty() && this->streamingStaging[this->currentFrame].recorded )
+    {
+        submittedBuffers[submittedCount++] = this->streamingStaging[this->currentFrame].commandBuffer;
+        this->streamingStaging[this->currentFrame].recorded = false;
+    }
+    submittedBuffers[submittedCount++] = this->commandBuffers[imageIndex];
+
+    submitInfo.commandBufferCount   = submittedCount;
+    submitInfo.pCommandBuffers      = submittedBuffers.data();
 
     /* Which semaphore to signal once the command buffer finished execution */
     VkSemaphore signalSemaphores[]  = { this->renderFinishedSemaphores[currentFrame] };
@@ -1816,9 +2570,38 @@ void TutorialApp::cleanup()
 
     /* Destroy and free memory for texture image. */
     vkDestroySampler(this->device, this->textureSampler, nullptr);
-    vkDestroyImageView(this->device, this->textureImageView, nullptr);
-    vkDestroyImage(this->device, this->textureImage, nullptr);
-    vkFreeMemory(this->device, this->textureImageMemory, nullptr);
+
+    if( this->streamedTextures.empty() )
+    {
+        vkDestroyImageView(this->device, this->textureImageView, nullptr);
+        vkDestroyImage(this->device, this->textureImage, nullptr);
+        vkFreeMemory(this->device, this->textureImageMemory, nullptr);
+    }
+
+    /* Streamed textures own their images - texture image view refers to view of the first one. */
+    for( auto& texture : this->streamedTextures )
+    {
+        vkDestroyImageView(this->device, texture.imageView, nullptr);
+        vkDestroyImage(this->device, texture.image, nullptr);
+        vkFreeMemory(this->device, texture.imageMemory, nullptr);
+    }
+
+    for( auto& retired : this->retiredImages )
+    {
+        vkDestroyImageView(this->device, retired.imageView, nullptr);
+        vkDestroyImage(this->device, retired.image, nullptr);
+        vkFreeMemory(this->device, retired.imageMemory, nullptr);
+    }
+
+    /* Freeing memory unmaps it. Command buffers are freed together with the pool. */
+    for( auto& staging : this->streamingStaging )
+    {
+        vkDestroyBuffer(this->device, staging.buffer, nullptr);
+        vkFreeMemory(this->device, staging.memory, nullptr);
+    }
+
+    /* Joins decoding threads and frees staging memory of textures which were never uploaded. */
+    this->assetLoader.reset();
 
     /* Destroy descriptor set layout which is bounding all of the descriptors. */
     vkDestroyDescriptorSetLayout(this->device, this->descriptorSetLayout, nullptr);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "libs.h"
+#include "AssetLoader.h"
 
 struct QueueFamilyIndices
 {
@@ -93,6 +94,52 @@ namespace std {
     };
 }
 
+/* Texel density reported by fragment shader for one texture - layout has to match TextureFeedback in shader.frag. */
+struct TextureFeedback {
+    glm::vec2   size;       /* Size of the base level - density is measured in its texels. */
+    uint32_t    minMip;     /* Finest level any fragment needed, UINT32_MAX when texture was not visible. */
+    uint32_t    padding;
+};
+
+/* Texture whose image holds only levels [residentMip; mipLevels). All levels stay in host memory of the asset loader. */
+struct StreamedTexture {
+    uint32_t        textureId;
+    VkFormat        format;
+    uint32_t        width;
+    uint32_t        height;
+    uint32_t        mipLevels;
+
+    uint32_t        tailMip;            /* First level of mip tail - always resident. */
+    uint32_t        residentMip;
+    uint32_t        requestedMip;
+    uint64_t        lastUsedFrame;
+
+    VkImage         image       = VK_NULL_HANDLE;
+    VkDeviceMemory  imageMemory = VK_NULL_HANDLE;
+    VkImageView     imageView   = VK_NULL_HANDLE;
+    VkDeviceSize    size        = 0;
+};
+
+/* Image replaced by texture streaming - frames submitted up to retiredFrame may still sample it. */
+struct RetiredImage {
+    VkImage         image;
+    VkDeviceMemory  imageMemory;
+    VkImageView     imageView;
+    uint64_t        retiredFrame;
+};
+
+/* Streamed levels are copied through it - one per frame in flight, reused once fence of its frame is signaled. Stays mapped. */
+struct StreamingStaging {
+    VkBuffer        buffer          = VK_NULL_HANDLE;
+    VkDeviceMemory  memory          = VK_NULL_HANDLE;
+    uint8_t*        data            = nullptr;
+    VkDeviceSize    size            = 0;
+    VkDeviceSize    used            = 0;
+
+    /* Residency changes of the frame - submitted together with its draw, only when recorded. */
+    VkCommandBuffer commandBuffer   = VK_NULL_HANDLE;
+    bool            recorded        = false;
+};
 
 class TutorialApp
 {
@@ -114,9 +161,29 @@ private:
     /* Model Variables */
     const std::string MODEL_PATH = "Models/chalet.obj";
     const std::string TEXTURE_PATH = "Textures/chalet.jpg";
+    /* Block-compressed texture produced by TextureBaker - preferred over TEXTURE_PATH when present and supported. */
+    const std::string COMPRESSED_TEXTURE_PATH = "Textures/chalet.dds";
 
     /* Quantity of frames */
     const size_t MAX_FRAMES_IN_FLIGHT = 2;
+
+    /* Texture streaming - device memory held by streamed textures. Levels above the mip tail are loaded when the fragment shader
+    *  reports it needs them and evicted from least recently used textures when over budget. 0 uploads whole textures at once,
+    *  so does a device without fragmentStoresAndAtomics.
+    */
+    const VkDeviceSize TEXTURE_STREAMING_BUDGET = 48ull * 1024 * 1024;
+    /* Levels not larger than this are loaded first and stay resident. */
+    const uint32_t TEXTURE_MIP_TAIL_SIZE = 256;
+    /* Finer levels loaded per texture per frame - spreads upload of large levels over several frames.
+    *  Upload of a frame is also limited by its staging buffer, which holds the largest level of streamed textures.
+    */
+    const uint32_t TEXTURE_STREAMING_LEVELS_PER_FRAME = 1;
+
+    /* Multisampling - 1, 2, 4 or 8 samples, clamped to counts supported by device. Sample shading shades given fraction
+    *  of samples separately (antialiases texture and shading edges as well), 0 shades once per pixel.
+    */
+    const uint32_t MSAA_SAMPLES = 4;
+    const float MIN_SAMPLE_SHADING = 0.f;
     
     /* Available and enable API extensions */
     std::vector<const char*> validationLayers;
@@ -132,6 +199,16 @@ private:
     VkPhysicalDevice    physicalDevice = VK_NULL_HANDLE;
     VkDevice            device;
 
+    /* BC formats can be sampled - enabled whenever the physical device supports them. */
+    bool                textureCompressionBC = false;
+
+    /* Textures are streamed when budget is set and fragment shader can write texel density feedback - uploaded whole otherwise. */
+    bool                textureStreaming = false;
+
+    /* Sample count of color and depth attachments and whether fragments may be shaded per sample. */
+    VkSampleCountFlagBits   msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    bool                    sampleRateShading = false;
+
     /* Queues */
     VkQueue graphicsQueue;
     VkQueue presentQueue;
@@ -193,6 +270,11 @@ private:
     std::vector<VkBuffer>       uniformBuffers;
     std::vector<VkDeviceMemory> uniformBuffersMemory;
 
+    /* Texel density feedback - written by fragment shader, read back after the fence of swapchain image is signaled. Stays mapped. */
+    std::vector<VkBuffer>           feedbackBuffers;
+    std::vector<VkDeviceMemory>     feedbackBuffersMemory;
+    std::vector<TextureFeedback*>   feedbackData;
+
     /* Descriptor pool to hold descriptors set. */
     VkDescriptorPool descriptorPool;
 
@@ -201,12 +283,39 @@ private:
     VkDeviceMemory  depthImageMemory;
     VkImageView     depthImageView;
 
+    /* Multisampled color - resolved into swap chain image at the end of render pass, created only with MSAA.
+    *  Color and depth never leave the render pass - both are transient attachments in lazily allocated memory where available.
+    */
+    VkImage         colorImage = VK_NULL_HANDLE;
+    VkDeviceMemory  colorImageMemory = VK_NULL_HANDLE;
+    VkImageView     colorImageView = VK_NULL_HANDLE;
+
+    /* Decodes textures on worker threads */
+    std::unique_ptr<AssetLoader> assetLoader;
+
     /* Texture Variables */
+    uint32_t        textureId;              /* Id of texture inside asset loader */
+    uint32_t        mipLevels;              /* Full mip chain of loaded texture - down to 1x1 level. */
+    VkFormat        textureFormat   = VK_FORMAT_R8G8B8A8_SRGB;
     VkImage         textureImage;
     VkDeviceMemory  textureImageMemory;
     VkImageView     textureImageView;
     VkSampler       textureSampler;
 
+    /* Streamed textures - index matches entry of feedback buffer. Texture 0 is the one bound to descriptor sets. */
+    std::vector<StreamedTexture>    streamedTextures;
+    VkDeviceSize                    streamedTexturesSize    = 0;
+    uint64_t                        frameCounter            = 0;
+
+    std::vector<StreamingStaging>   streamingStaging;
+    std::vector<RetiredImage>       retiredImages;
+
+    /* Texture view written into descriptor set of every swap chain image - a set is rewritten once its image is acquired again,
+    *  when no frame reads it. With update after bind the recorded command buffer stays valid, otherwise just that one is recorded again.
+    */
+    std::vector<VkImageView>        descriptorTextureViews;
+    bool                            descriptorUpdateAfterBind = false;
+
 #ifdef NDEBUG
     const bool enableValidationLayers = true;
 #else
@@ -225,9 +334,11 @@ private:
     void createRenderPass();
     void createDescriptorSetLayout();
     void createGraphicsPipeline();
+    void createColorResources();
     void createDepthResources();
     void createFramebuffers();
     void createCommandPool();
+    void createAssetLoader();
     void createTextureImage();
     void createTextureImageView();
     void createTextureSamper();
@@ -250,6 +361,8 @@ private:
 
     QueueFamilyIndices      findQueueFamilies(VkPhysicalDevice device);
     uint32_t                findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    bool                    hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    VkSampleCountFlagBits   chooseSampleCount(uint32_t samples);
     VkFormat                findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     VkFormat                findDepthFormat();
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
@@ -259,16 +372,28 @@ private:
 
     VkShaderModule          createShaderModule( const std::vector<char>& code );
     void                    createBuffer(VkDeviceSize deviceSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-    void                    createImage(uint32_t width, uint32_t height, VkFormat imageFormat, VkImageTiling imgTiling, VkImageUsageFlags imgFlags, 
-                                VkMemoryPropertyFlags imgMemoryProperties, VkImage& image, VkDeviceMemory& imgMemory);
-    VkImageView             createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+    void                    createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat imageFormat, VkImageTiling imgTiling, VkImageUsageFlags imgFlags, 
+                                VkMemoryPropertyFlags imgMemoryProperties, VkImage& image, VkDeviceMemory& imgMemory, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+    VkImageView             createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 
     void                    copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-    void                    copyBufferToImage( VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+    void                    copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, VkFormat format,
+                                uint32_t width, uint32_t height, uint32_t firstLevel, uint32_t levelCount);
+
+    void                    uploadTextures(const std::vector<uint32_t>& textureIds);
+    void                    generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t width, int32_t height, uint32_t mipLevels);
+
+    void                    createStreamedTexture(uint32_t textureId);
+    void                    createStreamingStaging();
+    void                    updateTextureStreaming(uint32_t currentImage);
+    void                    recordTextureResidency(VkCommandBuffer commandBuffer, StreamedTexture& texture, uint32_t residentMip, StreamingStaging& staging);
+    VkDeviceSize            streamedTextureSize(const StreamedTexture& texture, uint32_t residentMip);
+    void                    updateTextureDescriptor(uint32_t currentImage);
+    void                    recordCommandBuffer(size_t imageIndex);
 
     void                    updateUniformBuffer(uint32_t currentImage);
-    void                    transitionImageLayout(VkImage image, VkFormat format,
-                                VkImageLayout oldLayout, VkImageLayout newLayout);
+    void                    transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format,
+                                VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 
     VkCommandBuffer         beganSingleTimeCommands();
     void                    endSingleTimeCommands(VkCommandBuffer commandBuffer);
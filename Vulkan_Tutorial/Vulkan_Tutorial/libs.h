@@ -10,6 +10,7 @@
 #include <mat4x4.hpp>
 
 #include <algorithm>
+#include <numeric>
 #include <iostream>
 #include <optional>
 #include <cstdint>
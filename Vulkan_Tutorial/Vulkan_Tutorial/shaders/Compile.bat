@@ -3,5 +3,6 @@ C:\VulkanSDK\1.2.131.1\Bin32\glslc.exe shader.vert -o vert.spv
 
 rem Compiling selected fragment shaders
 C:\VulkanSDK\1.2.131.1\Bin32\glslc.exe shader.frag -o frag.spv
+C:\VulkanSDK\1.2.131.1\Bin32\glslc.exe -DTEXTURE_FEEDBACK shader.frag -o frag_feedback.spv
 
 pause
\ No newline at end of file
@@ -5,6 +5,23 @@
 /* Input Data - descriptors, global for all vertex */
 layout( binding=1 ) uniform sampler2D texSampler;
 
+/* Texel density feedback for texture streaming - layout has to match TextureFeedback structure in TutorialApp.h.
+*  Only frag_feedback.spv is compiled with TEXTURE_FEEDBACK, fragment stores need a device feature.
+*/
+#ifdef TEXTURE_FEEDBACK
+struct TextureFeedback
+{
+    vec2 size;
+    uint minMip;
+    uint padding;
+};
+
+layout( std430, binding=2 ) buffer FeedbackBuffer
+{
+    TextureFeedback textures[];
+} feedback;
+#endif
+
 /* Input Variables */
 layout( location=0 ) in vec3 fragColor;
 layout( location=1 ) in vec2 fragTexCoord;
@@ -19,4 +36,15 @@ void main()
 
     /* Out color taken from texture */
     outColor = texture(texSampler, fragTexCoord);
+
+#ifdef TEXTURE_FEEDBACK
+    /* Level needed by this fragment - derivatives are taken in uniform control flow, before the branch. */
+    vec2  texel     = fragTexCoord * feedback.textures[0].size;
+    float density   = max(dot(dFdx(texel), dFdx(texel)), dot(dFdy(texel), dFdy(texel)));
+    uint  level     = uint(max(0.5 * log2(max(density, 1.0)), 0.0));
+
+    /* One fragment out of 8x8 reports - keeps contention of the atomic low. */
+    if( (uint(gl_FragCoord.x) & 7u) == 0u && (uint(gl_FragCoord.y) & 7u) == 0u )
+        atomicMin(feedback.textures[0].minMip, level);
+#endif
 }
\ No newline at end of file